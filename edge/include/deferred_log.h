@@ -0,0 +1,109 @@
+#ifndef DEFERRED_LOG_H
+#define DEFERRED_LOG_H
+
+#include "log_catalog.h"
+#include <Arduino.h>
+#include <type_traits>
+
+/*
+Log of the edge on the Serial link, rendered as text by the host decoder (utils/log_decoder).
+LOG(id, args...) formats nothing: it encodes the ID of the message from log_catalog.h, millis() and the raw arguments in
+a record, and puts it in a ring buffer that loopLog() writes to the Serial link a few bytes at a time.
+- A record is [id:1][millis][args], millis and the numbers as unsigned LEB128 varints, LogBytes as its length and the
+  number of bytes kept as varints, followed by these bytes. The number of arguments is checked against the format string
+  at compile time.
+- On the link, a record is COBS-encoded between two 0x00 delimiters, so the decoder passes the text printed outside the
+  log (e.g. by the loop profiler) through.
+- Messages above LOG_LEVEL are compiled out, their arguments are not evaluated.
+- Until the main loop starts, a record that does not fit waits for room in the ring. Then it is dropped, and the number
+  of dropped records is logged with the next record that fits.
+*/
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO // Level of the most detailed messages compiled in, e.g. -DLOG_LEVEL=LOG_LEVEL_DEBUG
+#endif
+
+#define LOG_BUFFER_BYTES     512 // Encoded records waiting for the Serial link
+#define LOG_RECORD_MAX_BYTES 64  // Longest record before encoding, longer byte arguments are truncated
+#define LOG_DRAIN_BYTES      16  // Bytes written by each call of loopLog(), 1.4 ms at 115200 baud
+#define LOG_VARINT_MAX_BYTES 5   // Varint of a 32-bit number
+
+/**
+ * Argument of a %h conversion: bytes printed in hexadecimal.
+ */
+struct LogBytes {
+  const uint8_t* data;
+  size_t         length;
+};
+
+/**
+ * A log record being encoded.
+ */
+class LogRecord {
+public:
+  /**
+   * @param reserved The bytes kept for the numbers of the record, 5 each, so that bytes added before them are truncated.
+   */
+  LogRecord(LogId id, size_t reserved);
+
+  template <typename T>
+  void add(T value) {
+    static_assert(std::is_integral<T>::value || std::is_enum<T>::value, "Log arguments must be integers, enums or LogBytes");
+    addVarint(static_cast<uint32_t>(value));
+    reserved = reserved > LOG_VARINT_MAX_BYTES ? reserved - LOG_VARINT_MAX_BYTES : 0;
+  }
+
+  void add(const LogBytes& value);
+
+  const uint8_t* data() const { return bytes; }
+  size_t         size() const { return length; }
+
+private:
+  uint8_t bytes[LOG_RECORD_MAX_BYTES];
+  size_t  length;
+  size_t  reserved;
+
+  void addVarint(uint32_t value);
+};
+
+/**
+ * Log the LOG_START record, to call first in setup(), once Serial is started.
+ */
+void setupLog();
+
+/**
+ * Write the next bytes of the ring to the Serial link, at most LOG_DRAIN_BYTES. Must be called at every iteration of
+ * the main loop, the records that do not fit in the ring are dropped from the first call.
+ */
+void loopLog();
+
+/**
+ * Write the whole ring to the Serial link, blocking. Called before printing text, which must not split a record.
+ */
+void flushLog();
+
+/**
+ * Put an encoded record in the ring, see LOG().
+ */
+void logPush(const LogRecord& record);
+
+template <LogId id, typename... Args>
+void logWrite(const Args&... args) {
+  static_assert(sizeof...(Args) == logArgCount(LOG_FORMATS[static_cast<size_t>(id)]), "The arguments do not match the format of the log message");
+  constexpr size_t numbers = (0 + ... + (std::is_same<Args, LogBytes>::value ? 0 : 1));
+  static_assert((1 + numbers) * LOG_VARINT_MAX_BYTES < LOG_RECORD_MAX_BYTES, "Too many arguments for a log record");
+  LogRecord record(id, numbers * LOG_VARINT_MAX_BYTES);
+  (record.add(args), ...);
+  logPush(record);
+}
+
+/**
+ * Log a message of the catalog, e.g. LOG(WRONG_CODE, tries, MAX_TRIES).
+ * @param id The ID of the message in LOG_CATALOG, without LogId::.
+ * @param ... One argument per conversion of its format string.
+ */
+#define LOG(id, ...)                                                                    \
+  do {                                                                                  \
+    if constexpr (logLevelOf(LogId::id) <= LOG_LEVEL) logWrite<LogId::id>(__VA_ARGS__); \
+  } while (0)
+
+#endif // DEFERRED_LOG_H
@@ -1,19 +1,39 @@
 #ifndef EEPROM_DRIVER_H
 #define EEPROM_DRIVER_H
 
+#include "deferred_log.h"
 #include "time_range.h"
 #include <EEPROM.h>
 #include <array>
+#include <lora_mac.h>
+#include <lora_protocol.h>
 
 /*
 EEPROM storage layout (starting at address 0):
 - 0-3: Secret combination (4 bytes, each byte represents a digit from 0 to 9)
-- 100: Number of time range rules (1 byte, max 255 rules)
-- 101-...: Time range rules (16 bytes each, defined by the TimeRangeRule structure)
+- 4-7: End of the reserved block of LoRa uplink frame counters (uint32_t, big-endian)
+- 8-11: Highest LoRa downlink frame counter accepted (uint32_t, big-endian)
+- 12-16: Heartbeat policy (minInterval and maxInterval as big-endian uint16_t, jitterPercent), erased if never set
+- 17: Active bank of time range rules (1 for bank B, any other value for bank A)
+- 18: LoRa node ID (1 to 251), erased to use the default ID
+- 19-34: LoRa MAC key shared with the gateway (16 bytes), erased to use the default key
+- 100: Bank A, number of time range rules (1 byte, max 255 rules)
+- 101-2905: Bank A, time range rules (11 bytes each, defined by the TimeRangeRule structure)
+- 3000: Bank B, number of time range rules
+- 3001-5805: Bank B, time range rules
+
+A new rule set is written to the inactive bank, then the bank byte is flipped: a reset in the middle of an update
+leaves the previous rule set active instead of a half-written one.
 */
 #define EEPROM_SECRET_COMBINATION_ADDRESS     0
-#define EEPROM_TIME_RANGE_RULES_COUNT_ADDRESS 100
-#define EEPROM_TIME_RANGE_RULES_START_ADDRESS 101
+#define EEPROM_LORA_TX_COUNTER_ADDRESS        4
+#define EEPROM_LORA_RX_COUNTER_ADDRESS        8
+#define EEPROM_HEARTBEAT_POLICY_ADDRESS       12
+#define EEPROM_TIME_RANGE_BANK_ADDRESS        17
+#define EEPROM_LORA_NODE_ID_ADDRESS           18
+#define EEPROM_LORA_MAC_KEY_ADDRESS           19
+#define EEPROM_TIME_RANGE_RULES_COUNT_ADDRESS 100  // Bank A, the rules start at the next address
+#define EEPROM_TIME_RANGE_BANK_B_ADDRESS      3000 // Bank B, same layout
 
 /**
  * Structure to hold the data retrieved from EEPROM at startup, including the secret combination and the number of time range rules stored.
@@ -25,8 +45,16 @@ struct EEPROMSetupData {
 
 EEPROMSetupData setupEEPROM(); // Retrieve the secret combination and number of time range rules from EEPROM at startup
 
-void retrieveTimeRangeRulesEEPROM(TimeRangeRule* rules, size_t& ruleCount);
-void storeTimeRangeRulesEEPROM(TimeRangeRule* rules, size_t& ruleCount);
-void storeSecretCombinationEEPROM(const std::array<int, 4>& combination);
+void     retrieveTimeRangeRulesEEPROM(TimeRangeRule* rules, size_t& ruleCount);
+void     storeTimeRangeRulesEEPROM(TimeRangeRule* rules, size_t& ruleCount);
+void     stageTimeRangeRuleEEPROM(size_t index, const TimeRangeRule& rule);
+void     commitTimeRangeRulesEEPROM(uint8_t ruleCount);
+void     storeSecretCombinationEEPROM(const std::array<int, 4>& combination);
+uint32_t readFrameCounterEEPROM(int address);
+void     storeFrameCounterEEPROM(int address, uint32_t counter);
+bool     retrieveHeartbeatPolicyEEPROM(HeartbeatPolicyBody& policy);
+void     storeHeartbeatPolicyEEPROM(const HeartbeatPolicyBody& policy);
+bool     retrieveLoraNodeIdEEPROM(uint8_t& nodeId);
+bool     retrieveLoraMacKeyEEPROM(uint8_t (&key)[LORA_MAC_KEY_BYTES]);
 
 #endif // EEPROM_DRIVER_H
\ No newline at end of file
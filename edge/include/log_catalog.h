@@ -0,0 +1,161 @@
+#ifndef LOG_CATALOG_H
+#define LOG_CATALOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+Messages of the edge log (see deferred_log.h). The firmware only sends the index of a message in this list and the raw
+values of its arguments, the format strings are compiled into the host decoder (utils/log_decoder), not into the
+firmware. The decoder must be built from the same list: LOG_START carries a hash of the catalog to check it.
+Conversions of the format strings, one argument each:
+- %u unsigned, %d signed, %x hexadecimal, %b binary, %c character
+- %t Unix timestamp, printed in UTC
+- %S alarm state, printed by name (see LOG_ALARM_STATES)
+- %h bytes (LogBytes), printed in hexadecimal
+%% prints a %.
+*/
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+// X(id, level, format)
+#define LOG_CATALOG(X)                                                                                                                                                    \
+  X(LOG_START, LOG_LEVEL_INFO, "[LOG] Log started, catalog %x")                                                                                                           \
+  X(LOG_DROPPED, LOG_LEVEL_WARN, "[LOG] %u messages dropped, the Serial link is too slow")                                                                                \
+  X(SYSTEM_READY, LOG_LEVEL_INFO, "System ready!")                                                                                                                        \
+  X(TIME_STATE, LOG_LEVEL_INFO, "%t - Alarm state: %S")                                                                                                                   \
+  X(EEPROM_DIGIT_READ, LOG_LEVEL_INFO, "[EEPROM] Read secret combination digit from EEPROM: %u")                                                                          \
+  X(EEPROM_RULE_COUNT_READ, LOG_LEVEL_INFO, "[EEPROM] Read time range rules count from EEPROM: %u")                                                                       \
+  X(EEPROM_RULE_COUNT_TOO_LARGE, LOG_LEVEL_ERROR, "[EEPROM] Error: Provided ruleCount is larger than the maximum number of rules (255).")                                 \
+  X(EEPROM_RULES_TRUNCATED, LOG_LEVEL_WARN, "[EEPROM] Warning: %u rules stored in EEPROM, only the first %u rules will be retrieved.")                                    \
+  X(EEPROM_RULES_MISSING, LOG_LEVEL_WARN, "[EEPROM] Warning: Only %u rules stored in EEPROM, %u requested. The rest of the rules array is not modified.")                 \
+  X(EEPROM_RULE_READ, LOG_LEVEL_DEBUG, "[EEPROM] Retrieved time range rule %u from EEPROM: weekDayMask=%b, hourMask=%b, monthDayMask=%b, monthMask=%b")                   \
+  X(EEPROM_STORE_TOO_MANY, LOG_LEVEL_ERROR, "[EEPROM] Error: Cannot store more than 255 time range rules in EEPROM.")                                                     \
+  X(EEPROM_RULE_STAGED, LOG_LEVEL_DEBUG, "[EEPROM] Staged time range rule %u in EEPROM: weekDayMask=%b, hourMask=%b, monthDayMask=%b, monthMask=%b")                      \
+  X(EEPROM_RULES_COMMITTED, LOG_LEVEL_INFO, "[EEPROM] Committed %u time range rules in bank %c")                                                                          \
+  X(EEPROM_DIGIT_STORED, LOG_LEVEL_INFO, "[EEPROM] Stored secret combination digit in EEPROM: %u")                                                                        \
+  X(EEPROM_HEARTBEAT_POLICY_STORED, LOG_LEVEL_INFO, "[EEPROM] Stored heartbeat policy in EEPROM: min=%us, max=%us, jitter=%u%%")                                          \
+  X(EEPROM_NODE_ID_READ, LOG_LEVEL_INFO, "[EEPROM] Read LoRa node ID from EEPROM: %u")                                                                                    \
+  X(EEPROM_MAC_KEY_READ, LOG_LEVEL_INFO, "[EEPROM] Read LoRa MAC key from EEPROM")                                                                                        \
+  X(LORA_NO_NODE_ID, LOG_LEVEL_WARN, "[LoRa] Warning: no node ID in EEPROM, using the default one.")                                                                      \
+  X(LORA_NO_MAC_KEY, LOG_LEVEL_WARN, "[LoRa] Warning: no MAC key in EEPROM, using the default development key.")                                                          \
+  X(LORA_INVALID_STORED_POLICY, LOG_LEVEL_WARN, "[LoRa] Invalid heartbeat policy in EEPROM, using the default one.")                                                      \
+  X(LORA_INIT_NOT_QUEUED, LOG_LEVEL_ERROR, "[LoRa] Error: could not queue the initialization commands.")                                                                  \
+  X(LORA_TELEMETRY_DROPPED, LOG_LEVEL_WARN, "[LoRa] Duty-cycle budget exhausted, telemetry payload dropped.")                                                             \
+  X(LORA_NOT_RESPONDING, LOG_LEVEL_ERROR, "[LoRa] Error: the module is not responding correctly.")                                                                        \
+  X(LORA_READY, LOG_LEVEL_INFO, "[LoRa] Module initialized in TEST mode.")                                                                                                \
+  X(LORA_NOT_SENT, LOG_LEVEL_ERROR, "[LoRa] Error: the payload was not sent.")                                                                                            \
+  X(LORA_INVALID_PAYLOAD, LOG_LEVEL_WARN, "[LoRa] Invalid payload received.")                                                                                             \
+  X(LORA_PAYLOAD_REPLACED, LOG_LEVEL_WARN, "[LoRa] Warning: previous payload not processed yet, it is replaced.")                                                         \
+  X(LORA_LISTEN_CANCELLED, LOG_LEVEL_WARN, "[LoRa] Module not operational, listening cancelled.")                                                                         \
+  X(LORA_INVALID_NODE_ID, LOG_LEVEL_WARN, "[LoRa] Invalid node ID: %u")                                                                                                   \
+  X(LORA_WRONG_DIRECTION, LOG_LEVEL_WARN, "[LoRa] Uplink payload type received by the edge: %x")                                                                          \
+  X(LORA_REPLAYED_COUNTER, LOG_LEVEL_WARN, "[LoRa] Replayed or outdated frame counter: %u")                                                                               \
+  X(LORA_MAC_FAILED, LOG_LEVEL_WARN, "[LoRa] MAC verification failed.")                                                                                                   \
+  X(LORA_MAC_SUCCEEDED, LOG_LEVEL_INFO, "[LoRa] MAC verification succeeded.")                                                                                             \
+  X(LORA_SEND_CANCELLED, LOG_LEVEL_WARN, "[LoRa] Module not operational, send cancelled.")                                                                                \
+  X(LORA_SENDING, LOG_LEVEL_INFO, "[LoRa] Sending frame: %h\n[LoRa] Airtime: %u us, duty-cycle budget used: %u%%")                                                        \
+  X(LORA_PAYLOAD, LOG_LEVEL_INFO, "[LoRa] Payload:\n  ID: %u\n  Counter: %u\n  TS: %u\n  Type: %x\n  Length: %x\n  Data: %h\n  HMAC: %x")                                 \
+  X(LORA_EVENT_RING_FULL, LOG_LEVEL_WARN, "[LoRa] Event ring full, oldest event dropped.")                                                                                \
+  X(LORA_OUTBOX_FULL, LOG_LEVEL_WARN, "[LoRa] Outbox full, payload dropped.")                                                                                             \
+  X(LORA_OUTBOX_EVICTED, LOG_LEVEL_WARN, "[LoRa] Outbox full, lower priority payload dropped.")                                                                           \
+  X(LORA_RX_SET_COMBINATION, LOG_LEVEL_INFO, "[LoRa] Received SET_COMBINATION payload")                                                                                   \
+  X(LORA_RX_SET_TIME_RANGE, LOG_LEVEL_INFO, "[LoRa] Received SET_TIME_RANGE payload")                                                                                     \
+  X(LORA_RX_SET_TIME_RANGE_FRAGMENT, LOG_LEVEL_INFO, "[LoRa] Received SET_TIME_RANGE_FRAGMENT payload")                                                                   \
+  X(LORA_RX_SET_ALARM_STATE, LOG_LEVEL_INFO, "[LoRa] Received SET_ALARM_STATE payload")                                                                                   \
+  X(LORA_RX_SET_HEARTBEAT_POLICY, LOG_LEVEL_INFO, "[LoRa] Received SET_HEARTBEAT_POLICY payload")                                                                         \
+  X(LORA_RX_RENEW_EPOCH, LOG_LEVEL_INFO, "[LoRa] Received RENEW_EPOCH payload")                                                                                           \
+  X(LORA_RX_UNKNOWN, LOG_LEVEL_WARN, "[LoRa] Received unknown payload type from broker")                                                                                  \
+  X(SETUP_INVALID_DIGIT, LOG_LEVEL_ERROR, "Error: Invalid secret combination digit retrieved from EEPROM at index %u: %d")                                                \
+  X(SETUP_INVALID_RULE_COUNT, LOG_LEVEL_ERROR, "Error: Invalid time range rules count retrieved from EEPROM: %u")                                                         \
+  X(SETUP_INVALID_EEPROM, LOG_LEVEL_ERROR, "Error: Invalid data retrieved from EEPROM. Switching to CONFIGURATION state.")                                                \
+  X(SETUP_COMBINATION, LOG_LEVEL_INFO, "Secret combination retrieved from EEPROM: %u%u%u%u")                                                                              \
+  X(SETUP_RULE_COUNT, LOG_LEVEL_INFO, "Number of time range rules retrieved from EEPROM: %u")                                                                             \
+  X(SETUP_RULE, LOG_LEVEL_DEBUG, "Time Range Rule %u: weekDayMask=%b, hourMask=%b, monthDayMask=%b, monthMask=%b")                                                        \
+  X(MOTION_DETECTED, LOG_LEVEL_INFO, "[MOTION] Motion detected, triggering alarm!")                                                                                       \
+  X(WAITING_RELEASE, LOG_LEVEL_DEBUG, "Waiting for button release...")                                                                                                    \
+  X(RESET_AFTER_DISARM, LOG_LEVEL_INFO, "Resetting system after successful disarm...")                                                                                    \
+  X(RESET_AFTER_TIMEOUT, LOG_LEVEL_INFO, "Resetting system after alarm timeout...")                                                                                       \
+  X(PSWD_INVALID_DIGIT, LOG_LEVEL_ERROR, "[PSWD] Error: Invalid combination digit received in LoRa configuration payload at index %u: %d")                                \
+  X(PSWD_UPDATED, LOG_LEVEL_INFO, "[PSWD] Secret combination updated via LoRaWAN to: %u%u%u%u")                                                                           \
+  X(SET_RULES_BAD_LENGTH, LOG_LEVEL_WARN, "[SET_RULES] Warning: Payload length is not a multiple of TimeRangeRule size. Length=%u, TIME_RANGE_RULE_BYTES=%u")             \
+  X(SET_RULES_BAD_FRAGMENT, LOG_LEVEL_WARN, "[SET_RULES] Warning: Inconsistent fragment %u/%u of transfer %u (%u rules)")                                                 \
+  X(SET_RULES_TRANSFER_ABANDONED, LOG_LEVEL_WARN, "[SET_RULES] Transfer %u abandoned, a single-frame rule set was written over its fragments")                            \
+  X(SET_RULES_UPDATED, LOG_LEVEL_INFO, "[SET_RULES] %u time range rules updated via LoRaWAN (transfer %u)")                                                               \
+  X(SET_STATE_UPDATED, LOG_LEVEL_INFO, "[SET_STATE] Alarm state updated via LoRaWAN")                                                                                     \
+  X(SET_STATE_INVALID, LOG_LEVEL_ERROR, "[SET_STATE] Error: Invalid alarm state received: %u")                                                                            \
+  X(HEARTBEAT_POLICY_UPDATED, LOG_LEVEL_INFO, "[HEARTBEAT] Heartbeat policy updated via LoRaWAN")                                                                         \
+  X(HEARTBEAT_POLICY_INVALID, LOG_LEVEL_ERROR, "[HEARTBEAT] Error: Invalid heartbeat policy received (min: %us, max: %us, jitter: %u%%)")                                 \
+  X(SET_RTC_UPDATING, LOG_LEVEL_INFO, "[SET_RTC] Updating RTC time from payload")                                                                                         \
+  X(SET_RTC_CORRECTED, LOG_LEVEL_INFO, "Time difference: %d seconds (%t -> %t)")                                                                                          \
+  X(WRONG_CODE, LOG_LEVEL_INFO, "WRONG CODE - Attempt %u of %u")                                                                                                          \
+  X(DISARM_FAILED, LOG_LEVEL_INFO, "DISARMING FAILED - TOO MANY ATTEMPTS")                                                                                                \
+  X(ALARM_STATE_CHANGED, LOG_LEVEL_INFO, "Alarm state changed: %S -> %S")                                                                                                 \
+  X(TIME_RULES_RTC, LOG_LEVEL_DEBUG, "[TIME_RULES] Weekday=%u, Hour=%u, Day=%u, Month=%u")                                                                                \
+  X(TIME_RULES_INVALID_RTC, LOG_LEVEL_ERROR, "[TIME_RULES] Invalid time values from RTC: weekday=%u, hour=%u, day=%u, month=%u")                                          \
+  X(TIME_RULES_MASKS, LOG_LEVEL_DEBUG, "[TIME_RULES] Current time as range MASKS Weekday: %b, Hour: %b, Day: %b, Month: %b")                                              \
+  X(TIME_RULES_NONE, LOG_LEVEL_INFO, "[TIME_RULES] No time range rules provided. Monitoring will be disabled.")                                                           \
+  X(TIME_RULES_TOO_MANY, LOG_LEVEL_ERROR, "[TIME_RULES] Error: Cannot set more than 255 time range rules. Only the first 255 rules will be used. Provided ruleCount: %u")
+
+enum class LogId : uint8_t {
+#define LOG_CATALOG_ID(id, level, format) id,
+  LOG_CATALOG(LOG_CATALOG_ID)
+#undef LOG_CATALOG_ID
+  COUNT
+};
+
+static_assert(static_cast<size_t>(LogId::COUNT) <= 255, "Log message IDs must fit in a byte");
+
+// Only used in constant expressions by the firmware, so neither table takes any flash there
+static constexpr uint8_t LOG_LEVELS[] = {
+#define LOG_CATALOG_LEVEL(id, level, format) level,
+    LOG_CATALOG(LOG_CATALOG_LEVEL)
+#undef LOG_CATALOG_LEVEL
+};
+
+static constexpr const char* LOG_FORMATS[] = {
+#define LOG_CATALOG_FORMAT(id, level, format) format,
+    LOG_CATALOG(LOG_CATALOG_FORMAT)
+#undef LOG_CATALOG_FORMAT
+};
+
+// Names of the values of AlarmState, printed by %S
+static constexpr const char* LOG_ALARM_STATES[] = {"INACTIVE", "MONITORING", "TRIGGERED", "DISARMED", "FAILED_DISARM", "CONFIGURATION"};
+
+constexpr uint8_t logLevelOf(LogId id) {
+  return LOG_LEVELS[static_cast<size_t>(id)];
+}
+
+/**
+ * @return The number of arguments expected by a format string, i.e. its conversions other than %%.
+ */
+constexpr size_t logArgCount(const char* format) {
+  size_t count = 0;
+  for (size_t i = 0; format[i] != '\0'; i++) {
+    if (format[i] != '%') continue;
+    if (format[i + 1] != '%') count++;
+    i++;
+  }
+  return count;
+}
+
+/**
+ * @return The FNV-1a hash of the levels and format strings of the catalog, in order.
+ */
+constexpr uint32_t logCatalogHash() {
+  uint32_t hash = 2166136261u;
+  for (size_t id = 0; id < static_cast<size_t>(LogId::COUNT); id++) {
+    hash = (hash ^ LOG_LEVELS[id]) * 16777619u;
+    for (const char* c = LOG_FORMATS[id]; *c != '\0'; c++) {
+      hash = (hash ^ (uint8_t)*c) * 16777619u;
+    }
+  }
+  return hash;
+}
+
+constexpr uint32_t LOG_CATALOG_HASH = logCatalogHash();
+
+#endif // LOG_CATALOG_H
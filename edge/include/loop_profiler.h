@@ -0,0 +1,108 @@
+#ifndef LOOP_PROFILER_H
+#define LOOP_PROFILER_H
+
+#include <Arduino.h>
+
+// #define LOOP_PROFILER // Measure the main loop with micros(), send 'p' over Serial to print the measures and 'r' to reset them
+
+/*
+Profiler of the main loop: the duration of each run of runSecurityLogic() per AlarmState, the period between two runs
+and the runs missed because the previous one (or loopLora()) took longer than SECURITY_LOGIC_TIME_INTERVAL, and the
+duration of the sub-steps wherever they run. A step includes the steps it calls (e.g. BUTTONS includes the sound and
+the animation of a wrong combination).
+Without LOOP_PROFILER, the PROFILE_* macros expand to nothing and the profiler is not compiled.
+*/
+
+/**
+ * Sub-steps of the main loop.
+ */
+enum class ProfileStep : uint8_t {
+  LORA_LOOP,  // loopLora(): AT engine, event flush and outbox
+  LORA_RX,    // Downlink applied (EEPROM, RTC, rules)
+  HEARTBEAT,  // Periodic heartbeat queued
+  RULE_CHECK, // Time range rules of isMonitoringTime()
+  MOTION,     // Motion sensor read
+  BUTTONS,    // Buttons read and handled
+  DISPLAY,    // 4-digit display, LED and their animations
+  AUDIO,      // Buzzer, including the delay() of the sounds
+  COUNT,
+};
+
+#ifdef LOOP_PROFILER
+#define PROFILE_BINS         18 // Histogram bins of the durations, for the p99
+#define PROFILE_FIRST_BIN_US 16 // Bin i holds the durations below PROFILE_FIRST_BIN_US << i, the last bin the others
+#define PROFILE_STATES       6  // Number of AlarmState values
+
+/**
+ * Durations of a tick or of a step, in microseconds.
+ */
+struct ProfileStats {
+  uint32_t count;
+  uint32_t minUs;
+  uint32_t maxUs;
+  uint64_t totalUs;
+  uint16_t bins[PROFILE_BINS]; // Saturate at UINT16_MAX
+
+  void     add(uint32_t us);
+  uint32_t p99Us() const;
+};
+
+class LoopProfiler {
+public:
+  /**
+   * Measure a step until the end of the enclosing block.
+   */
+  class Scope {
+  public:
+    explicit Scope(ProfileStep step) : step(step), startUs(micros()) {}
+    ~Scope();
+
+  private:
+    ProfileStep step;
+    uint32_t    startUs;
+  };
+
+  /**
+   * A run of runSecurityLogic() starts: account the period since the previous one and the runs missed meanwhile.
+   * @param state The AlarmState at the start of the run, the run is accounted to it.
+   * @param intervalMs The expected period, SECURITY_LOGIC_TIME_INTERVAL.
+   */
+  void startTick(uint8_t state, uint32_t intervalMs);
+  void endTick();
+
+  void record(ProfileStep step, uint32_t us);
+
+  /**
+   * Handle the commands received over Serial: 'p' prints the measures, 'r' resets them.
+   */
+  void pollSerial();
+
+  void print(Print& out);
+  void reset();
+
+private:
+  ProfileStats ticks[PROFILE_STATES];
+  uint32_t     missedTicks[PROFILE_STATES];
+  ProfileStats period;
+  ProfileStats steps[static_cast<size_t>(ProfileStep::COUNT)];
+  uint8_t      tickState;
+  uint32_t     tickStartUs;
+  bool         hasPreviousTick; // false after a reset or a print, which would distort the next period
+
+  static void printStats(Print& out, const ProfileStats& stats);
+};
+
+extern LoopProfiler loopProfiler;
+
+#define PROFILE_STEP(step)                    LoopProfiler::Scope profileScope(step)
+#define PROFILE_TICK_START(state, intervalMs) loopProfiler.startTick(static_cast<uint8_t>(state), intervalMs)
+#define PROFILE_TICK_END()                    loopProfiler.endTick()
+#define PROFILE_POLL_SERIAL()                 loopProfiler.pollSerial()
+#else
+#define PROFILE_STEP(step)
+#define PROFILE_TICK_START(state, intervalMs)
+#define PROFILE_TICK_END()
+#define PROFILE_POLL_SERIAL()
+#endif // LOOP_PROFILER
+
+#endif // LOOP_PROFILER_H
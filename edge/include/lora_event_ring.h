@@ -0,0 +1,39 @@
+#ifndef LORA_EVENT_RING_H
+#define LORA_EVENT_RING_H
+
+#include "deferred_log.h"
+#include <Arduino.h>
+#include <lora_protocol.h>
+
+#define LORA_EVENT_RING_SIZE   16    // Maximum number of events waiting to be flushed
+#define LORA_EVENT_FLUSH_COUNT 8     // Number of events flushed without waiting for the deadline
+#define LORA_EVENT_FLUSH_DELAY 15000 // Time an event can wait for others before being flushed, in milliseconds
+
+/**
+ * Ring buffer of the events waiting to be sent, flushed as a single EVENT_BATCH payload.
+ * Events are flushed once the oldest one waited LORA_EVENT_FLUSH_DELAY, once LORA_EVENT_FLUSH_COUNT events are
+ * waiting, or at once when an alarm-class event is recorded. When the ring is full, the oldest event is dropped.
+ */
+class LoraEventRing {
+private:
+  struct Entry {
+    EventKind kind;
+    uint8_t   value[4];
+    bool      alarm; // Alarm-class event, flushed at once
+    uint32_t  ts;    // Unix timestamp of the event
+    uint32_t  ms;    // millis() of the event
+  };
+
+  Entry   entries[LORA_EVENT_RING_SIZE];
+  uint8_t head;  // Index of the oldest event
+  uint8_t count; // Number of events waiting
+
+public:
+  LoraEventRing();
+  void   record(EventKind kind, const uint8_t (&value)[4], bool alarm, uint32_t ts, uint32_t nowMs);
+  bool   isFlushDue(uint32_t nowMs) const;
+  bool   takeBatch(LoraPayload& pkt, bool& alarm);
+  size_t size() const;
+};
+
+#endif // LORA_EVENT_RING_H
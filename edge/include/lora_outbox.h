@@ -0,0 +1,50 @@
+#ifndef LORA_OUTBOX_H
+#define LORA_OUTBOX_H
+
+#include "deferred_log.h"
+#include <Arduino.h>
+#include <lora_protocol.h>
+
+#define LORA_OUTBOX_SIZE 6 // Maximum number of payloads waiting for the radio
+
+/**
+ * Priority classes of the payloads waiting in the outbox, the smallest value is sent first.
+ */
+enum class OutboxPriority : uint8_t {
+  ALARM        = 0, // The alarm is triggered or failed to be disarmed
+  STATE_CHANGE = 1, // Any other change of state (alarm state, motion state)
+  HEARTBEAT    = 2, // Periodic heartbeat
+  TELEMETRY    = 3, // Informative data, can wait or be dropped
+};
+
+/**
+ * Bounded queue of the payloads to send through LoRa, drained at the rate the radio accepts them.
+ * Payloads are sent by priority then in arrival order. A state payload (heartbeat, motion state) replaces the queued
+ * payload of the same type, so only the latest state goes out. The counter and the MAC are set when the payload is
+ * actually sent, not when it is queued.
+ */
+class LoraOutbox {
+private:
+  struct Entry {
+    LoraPayload    pkt;
+    OutboxPriority priority;
+    uint16_t       order; // Arrival order, to send the payloads of the same priority in FIFO order
+    bool           used;
+  };
+
+  Entry    entries[LORA_OUTBOX_SIZE];
+  uint16_t nextOrder;
+
+  static bool isStatePayload(PayloadType type);
+  int         findNextEntry() const;
+  int         findLowestPriorityEntry() const;
+
+public:
+  LoraOutbox();
+  bool               push(const LoraPayload& pkt, OutboxPriority priority);
+  const LoraPayload* peek(OutboxPriority& priority) const;
+  bool               pop(LoraPayload& pkt);
+  size_t             size() const;
+};
+
+#endif // LORA_OUTBOX_H
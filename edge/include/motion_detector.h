@@ -1,6 +1,7 @@
 #ifndef MOTION_DETECT_H
 #define MOTION_DETECT_H
 
+#include "loop_profiler.h"
 #include <Arduino.h>
 
 void setupMotion();
@@ -1,6 +1,7 @@
 #ifndef RTC_H
 #define RTC_H
 
+#include "loop_profiler.h"
 #include "time_range.h"
 #include <Arduino.h>
 #include <Wire.h>
@@ -1,6 +1,7 @@
 #ifndef SECURITY_AUDIO_H
 #define SECURITY_AUDIO_H
 
+#include "loop_profiler.h"
 #include <Arduino.h>
 
 void playPressBeep(int buzzerPin);
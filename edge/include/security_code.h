@@ -1,7 +1,9 @@
 #ifndef SECURITY_CODE_H
 #define SECURITY_CODE_H
 
+#include "deferred_log.h"
 #include "eeprom_driver.h"
+#include "loop_profiler.h"
 #include "lora_comm.h"
 #include "motion_detector.h"
 #include "rtc.h"
@@ -12,6 +14,7 @@
 #include <ChainableLED.h>
 #include <TM1637.h>
 #include <array>
+#include <lora_transfer.h>
 #include <optional>
 
 /**
@@ -37,7 +40,6 @@ AlarmState runSecurityLogic();
 AlarmState getAlarmState();
 void       setAlarmState(AlarmState newState);
 
-std::optional<AlarmState>  parseAlarmState(uint8_t raw);
-std::optional<PayloadType> parsePayloadType(uint8_t raw);
+std::optional<AlarmState> parseAlarmState(uint8_t raw);
 
 #endif // SECURITY_CODE_H
\ No newline at end of file
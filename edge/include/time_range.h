@@ -1,6 +1,7 @@
 #ifndef TIME_RANGE_H
 #define TIME_RANGE_H
 
+#include "deferred_log.h"
 #include <Arduino.h>
 #include <iarduino_RTC.h>
 
@@ -17,13 +18,25 @@ struct TimeRangeRule {
 };
 #define TIME_RANGE_RULE_BYTES 11
 
+#define TIME_RANGE_WEEKLY_MONTH_DAYS 0x7FFFFFFF // Every day of the month, a rule with it and every month is weekly
+#define TIME_RANGE_WEEKLY_MONTHS     0x0FFF
+
 /**
  * Class responsible for checking if the current time falls within any of the defined time ranges.
+ * setTimeRanges() compiles the rules into an index, so that a check does not depend on the number of rules:
+ * - The weekly rules (every day of every month) are merged into a week/hour bitmap, 24 bits per weekday.
+ * - The other rules are checked once a day: the hours of the current day, from the bitmap and the rules matching its
+ *   weekday, day of month and month, are kept until the date changes.
+ * The linear scan of the rules is kept as a reference.
  */
 class TimeRangeChecker {
 private:
-  TimeRangeRule* timeRanges;
+  TimeRangeRule* timeRanges; // The rules that are not weekly first
   size_t         rulesCount;
+  size_t         calendarRulesCount; // Rules that are not weekly, checked when the date changes
+  uint32_t       weekHours[7];       // Hour masks of the weekly rules, by weekday
+  uint32_t       dayHours;           // Hour mask of the current day
+  uint16_t       dayKey;             // Weekday, day of month and month of dayHours, 0 if none
 
   bool isTimeInRange(const TimeRangeRule& timeRule, const TimeRangeRule& currentTimeAsRange);
 
@@ -32,6 +45,20 @@ public:
   ~TimeRangeChecker();
   bool isMonitoringTime(iarduino_RTC& rtc);
   void setTimeRanges(const TimeRangeRule* rules, size_t ruleCount);
+
+  /**
+   * Checks a time with the index, the time must be valid.
+   * @param weekDay 0-6 (0-Sunday)
+   * @param hour 0-23
+   * @param monthDay 1-31
+   * @param month 1-12
+   */
+  bool isMonitoringTime(uint8_t weekDay, uint8_t hour, uint8_t monthDay, uint8_t month);
+
+  /**
+   * Checks a time by testing every rule, the reference of the index. Same parameters as isMonitoringTime().
+   */
+  bool isMonitoringTimeLinear(uint8_t weekDay, uint8_t hour, uint8_t monthDay, uint8_t month);
 };
 
 #endif // TIME_RANGE_H
@@ -0,0 +1,123 @@
+#include "deferred_log.h"
+
+static_assert(LOG_RECORD_MAX_BYTES < 254, "A record must be a single COBS run");
+
+#define LOG_FRAME_MAX_BYTES (LOG_RECORD_MAX_BYTES + 3) // Two delimiters and the COBS code byte
+
+uint8_t  logRing[LOG_BUFFER_BYTES]; // Encoded records, from logHead
+size_t   logHead        = 0;
+size_t   logCount       = 0;
+bool     logRealtime    = false; // Set by the first call of loopLog(), records are then dropped instead of waiting
+uint32_t droppedRecords = 0;     // Records dropped since the last one that fitted
+
+LogRecord::LogRecord(LogId id, size_t reserved) : length(0), reserved(reserved) {
+  bytes[length++] = static_cast<uint8_t>(id);
+  addVarint(millis());
+}
+
+void LogRecord::addVarint(uint32_t value) {
+  while (length < LOG_RECORD_MAX_BYTES) {
+    uint8_t low = value & 0x7F;
+    value >>= 7;
+    bytes[length++] = value ? low | 0x80 : low;
+    if (!value) return;
+  }
+}
+
+void LogRecord::add(const LogBytes& value) {
+  size_t room  = LOG_RECORD_MAX_BYTES - length - reserved;
+  size_t count = room > 4 ? room - 4 : 0; // Both lengths take at most 2 bytes within LOG_RECORD_MAX_BYTES
+  if (value.length < count) count = value.length;
+  addVarint(value.length);
+  addVarint(count);
+  memcpy(bytes + length, value.data, count);
+  length += count;
+}
+
+/**
+ * Write the next bytes of the ring to the Serial link.
+ * @param maxBytes The maximum number of bytes to write.
+ */
+void drainLog(size_t maxBytes) {
+  while (logCount > 0 && maxBytes > 0) {
+    size_t chunk = LOG_BUFFER_BYTES - logHead; // Contiguous bytes only
+    if (logCount < chunk) chunk = logCount;
+    if (maxBytes < chunk) chunk = maxBytes;
+    Serial.write(logRing + logHead, chunk);
+    logHead   = (logHead + chunk) % LOG_BUFFER_BYTES;
+    logCount -= chunk;
+    maxBytes -= chunk;
+  }
+}
+
+/**
+ * Encode a record with COBS, between two delimiters: each zero is replaced by the distance to the next one, the first
+ * distance being prepended.
+ * @param frame Buffer of at least LOG_FRAME_MAX_BYTES bytes.
+ * @return The number of bytes of the frame.
+ */
+size_t encodeLogFrame(const LogRecord& record, uint8_t* frame) {
+  size_t length    = 0;
+  frame[length++]  = 0x00;
+  size_t codeIndex = length++;
+  for (size_t i = 0; i < record.size(); i++) {
+    if (record.data()[i] == 0) {
+      frame[codeIndex] = length - codeIndex;
+      codeIndex        = length++;
+    } else {
+      frame[length++] = record.data()[i];
+    }
+  }
+  frame[codeIndex] = length - codeIndex;
+  frame[length++]  = 0x00;
+  return length;
+}
+
+/**
+ * Put a record in the ring, waiting for room until the main loop starts.
+ * @return false if the record was dropped.
+ */
+bool pushLogRecord(const LogRecord& record) {
+  uint8_t frame[LOG_FRAME_MAX_BYTES];
+  size_t  size = encodeLogFrame(record, frame);
+
+  while (LOG_BUFFER_BYTES - logCount < size) {
+    if (logRealtime) return false;
+    drainLog(size - (LOG_BUFFER_BYTES - logCount));
+  }
+
+  for (size_t i = 0; i < size; i++) {
+    logRing[(logHead + logCount + i) % LOG_BUFFER_BYTES] = frame[i];
+  }
+  logCount += size;
+  return true;
+}
+
+void logPush(const LogRecord& record) {
+  if (droppedRecords > 0) {
+    LogRecord dropped(LogId::LOG_DROPPED, LOG_VARINT_MAX_BYTES);
+    dropped.add(droppedRecords);
+    if (!pushLogRecord(dropped)) {
+      droppedRecords++;
+      return;
+    }
+    droppedRecords = 0;
+  }
+
+  if (!pushLogRecord(record)) {
+    droppedRecords++;
+  }
+}
+
+void setupLog() {
+  LOG(LOG_START, LOG_CATALOG_HASH);
+}
+
+void loopLog() {
+  logRealtime = true;
+  drainLog(LOG_DRAIN_BYTES);
+}
+
+void flushLog() {
+  drainLog(LOG_BUFFER_BYTES);
+}
@@ -1,4 +1,14 @@
 #include "eeprom_driver.h"
+#include <lora_frame_v2.h>
+
+/**
+ * @param active true for the bank holding the rules in use, false for the bank a new rule set is staged in.
+ * @return The address of the rule count of the bank, its rules start at the next address.
+ */
+static int timeRangeBankAddress(bool active) {
+  bool bankB = EEPROM.read(EEPROM_TIME_RANGE_BANK_ADDRESS) == 1;
+  return bankB == active ? EEPROM_TIME_RANGE_BANK_B_ADDRESS : EEPROM_TIME_RANGE_RULES_COUNT_ADDRESS;
+}
 
 /**
  * Retrieve the secret combination and number of time range rules from EEPROM at startup.
@@ -13,14 +23,12 @@ EEPROMSetupData setupEEPROM() {
     uint8_t value             = EEPROM.read(EEPROM_SECRET_COMBINATION_ADDRESS + i);
     data.secretCombination[i] = value;
 
-    Serial.print("[EEPROM] Read secret combination digit from EEPROM: ");
-    Serial.println(data.secretCombination[i]);
+    LOG(EEPROM_DIGIT_READ, value);
   }
 
   // Read number of time range rules
-  data.timeRangeRulesCount = EEPROM.read(EEPROM_TIME_RANGE_RULES_COUNT_ADDRESS);
-  Serial.print("[EEPROM] Read time range rules count from EEPROM: ");
-  Serial.println(data.timeRangeRulesCount);
+  data.timeRangeRulesCount = EEPROM.read(timeRangeBankAddress(true));
+  LOG(EEPROM_RULE_COUNT_READ, data.timeRangeRulesCount);
 
   return data;
 }
@@ -34,23 +42,24 @@ EEPROMSetupData setupEEPROM() {
 void retrieveTimeRangeRulesEEPROM(TimeRangeRule* rules, size_t& ruleCount) {
   // Check if the provided ruleCount is sufficient to hold the number of rules in the pointer
   if (ruleCount > 255) {
-    Serial.print("Error: Provided ruleCount is larger than the maximum number of rules (255).");
+    LOG(EEPROM_RULE_COUNT_TOO_LARGE);
     ruleCount = 255; // Adjust ruleCount to the maximum allowed
   }
 
   // Read number of time range rules stored in EEPROM
-  uint8_t storedRuleCount = EEPROM.read(EEPROM_TIME_RANGE_RULES_COUNT_ADDRESS);
+  int     bankAddress     = timeRangeBankAddress(true);
+  uint8_t storedRuleCount = EEPROM.read(bankAddress);
 
   if (storedRuleCount > ruleCount) {
-    Serial.println("[EEPROM] Warning: Provided ruleCount (" + String(ruleCount) + ") does not match the number of rules stored in EEPROM (" + String(storedRuleCount) + "). Only the first " + String(ruleCount) + " rules will be retrieved.");
+    LOG(EEPROM_RULES_TRUNCATED, storedRuleCount, ruleCount);
   } else if (storedRuleCount < ruleCount) {
+    LOG(EEPROM_RULES_MISSING, storedRuleCount, ruleCount);
     ruleCount = storedRuleCount; // Adjust ruleCount to the actual number of rules stored in EEPROM
-    Serial.println("[EEPROM] Warning: Provided ruleCount (" + String(ruleCount) + ") is larger than the number of rules stored in EEPROM (" + String(storedRuleCount) + "). Only the first " + String(storedRuleCount) + " rules will be retrieved, the rest of the rules array will not be modified.");
   }
 
   for (size_t i = 0; i < ruleCount; i++) {
     // Calculate the base address for the current rule
-    int baseAddress = EEPROM_TIME_RANGE_RULES_START_ADDRESS + i * TIME_RANGE_RULE_BYTES;
+    int baseAddress = bankAddress + 1 + i * TIME_RANGE_RULE_BYTES;
 
     // Read each byte of the TimeRangeRule structure from EEPROM and reconstruct the structure
     rules[i].weekDayMask  = EEPROM.read(baseAddress);
@@ -58,51 +67,62 @@ void retrieveTimeRangeRulesEEPROM(TimeRangeRule* rules, size_t& ruleCount) {
     rules[i].monthDayMask = (EEPROM.read(baseAddress + 5) << 24) | (EEPROM.read(baseAddress + 6) << 16) | (EEPROM.read(baseAddress + 7) << 8) | EEPROM.read(baseAddress + 8);
     rules[i].monthMask    = (EEPROM.read(baseAddress + 9) << 8) | EEPROM.read(baseAddress + 10);
 
-    Serial.print("[EEPROM] Retrieved time range rule from EEPROM: weekDayMask=");
-    Serial.print(rules[i].weekDayMask, BIN);
-    Serial.print(", hourMask=");
-    Serial.print(rules[i].hourMask, BIN);
-    Serial.print(", monthDayMask=");
-    Serial.print(rules[i].monthDayMask, BIN);
-    Serial.print(", monthMask=");
-    Serial.println(rules[i].monthMask, BIN);
+    LOG(EEPROM_RULE_READ, i, rules[i].weekDayMask, rules[i].hourMask, rules[i].monthDayMask, rules[i].monthMask);
   }
 }
 
+/**
+ * Replace the time range rules stored in EEPROM. The rules are staged in the inactive bank then committed, so the
+ * previous rules stay in use until the new ones are completely written.
+ * @param rules Pointer to the array of rules to store.
+ * @param ruleCount The number of rules to store, capped to 255.
+ */
 void storeTimeRangeRulesEEPROM(TimeRangeRule* rules, size_t& ruleCount) {
   if (ruleCount > 255) {
-    Serial.print("[EEPROM] Error: Cannot store more than 255 time range rules in EEPROM.");
+    LOG(EEPROM_STORE_TOO_MANY);
     ruleCount = 255; // Adjust ruleCount to the maximum allowed
   }
 
-  // Store the number of time range rules in EEPROM
-  EEPROM.write(EEPROM_TIME_RANGE_RULES_COUNT_ADDRESS, ruleCount);
-
   for (size_t i = 0; i < ruleCount; i++) {
-    int baseAddress = EEPROM_TIME_RANGE_RULES_START_ADDRESS + i * TIME_RANGE_RULE_BYTES;
-
-    // Store each byte of the TimeRangeRule structure in EEPROM
-    EEPROM.write(baseAddress, rules[i].weekDayMask);
-    EEPROM.write(baseAddress + 1, (rules[i].hourMask >> 24) & 0xFF);
-    EEPROM.write(baseAddress + 2, (rules[i].hourMask >> 16) & 0xFF);
-    EEPROM.write(baseAddress + 3, (rules[i].hourMask >> 8) & 0xFF);
-    EEPROM.write(baseAddress + 4, rules[i].hourMask & 0xFF);
-    EEPROM.write(baseAddress + 5, (rules[i].monthDayMask >> 24) & 0xFF);
-    EEPROM.write(baseAddress + 6, (rules[i].monthDayMask >> 16) & 0xFF);
-    EEPROM.write(baseAddress + 7, (rules[i].monthDayMask >> 8) & 0xFF);
-    EEPROM.write(baseAddress + 8, rules[i].monthDayMask & 0xFF);
-    EEPROM.write(baseAddress + 9, (rules[i].monthMask >> 8) & 0xFF);
-    EEPROM.write(baseAddress + 10, rules[i].monthMask & 0xFF);
-
-    Serial.print("[EEPROM] Stored time range rule in EEPROM: weekDayMask=");
-    Serial.print(rules[i].weekDayMask, BIN);
-    Serial.print(", hourMask=");
-    Serial.print(rules[i].hourMask, BIN);
-    Serial.print(", monthDayMask=");
-    Serial.print(rules[i].monthDayMask, BIN);
-    Serial.print(", monthMask=");
-    Serial.println(rules[i].monthMask, BIN);
+    stageTimeRangeRuleEEPROM(i, rules[i]);
   }
+  commitTimeRangeRulesEEPROM(ruleCount);
+}
+
+/**
+ * Write a rule of a new rule set to the inactive bank, the rules in use are not modified.
+ * @param index Position of the rule in the new rule set, from 0 to 254.
+ * @param rule The rule to write.
+ */
+void stageTimeRangeRuleEEPROM(size_t index, const TimeRangeRule& rule) {
+  int baseAddress = timeRangeBankAddress(false) + 1 + index * TIME_RANGE_RULE_BYTES;
+
+  // Store each byte of the TimeRangeRule structure in EEPROM
+  EEPROM.update(baseAddress, rule.weekDayMask);
+  EEPROM.update(baseAddress + 1, (rule.hourMask >> 24) & 0xFF);
+  EEPROM.update(baseAddress + 2, (rule.hourMask >> 16) & 0xFF);
+  EEPROM.update(baseAddress + 3, (rule.hourMask >> 8) & 0xFF);
+  EEPROM.update(baseAddress + 4, rule.hourMask & 0xFF);
+  EEPROM.update(baseAddress + 5, (rule.monthDayMask >> 24) & 0xFF);
+  EEPROM.update(baseAddress + 6, (rule.monthDayMask >> 16) & 0xFF);
+  EEPROM.update(baseAddress + 7, (rule.monthDayMask >> 8) & 0xFF);
+  EEPROM.update(baseAddress + 8, rule.monthDayMask & 0xFF);
+  EEPROM.update(baseAddress + 9, (rule.monthMask >> 8) & 0xFF);
+  EEPROM.update(baseAddress + 10, rule.monthMask & 0xFF);
+
+  LOG(EEPROM_RULE_STAGED, index, rule.weekDayMask, rule.hourMask, rule.monthDayMask, rule.monthMask);
+}
+
+/**
+ * Make the rules staged by stageTimeRangeRuleEEPROM() the ones in use. The switch is a single byte write.
+ * @param ruleCount The number of rules of the new rule set, all of them must have been staged.
+ */
+void commitTimeRangeRulesEEPROM(uint8_t ruleCount) {
+  int stagingAddress = timeRangeBankAddress(false);
+  EEPROM.update(stagingAddress, ruleCount);
+  EEPROM.write(EEPROM_TIME_RANGE_BANK_ADDRESS, stagingAddress == EEPROM_TIME_RANGE_BANK_B_ADDRESS ? 1 : 0);
+
+  LOG(EEPROM_RULES_COMMITTED, ruleCount, stagingAddress == EEPROM_TIME_RANGE_BANK_B_ADDRESS ? 'B' : 'A');
 }
 
 /**
@@ -114,7 +134,92 @@ void storeSecretCombinationEEPROM(const std::array<int, 4>& combination) {
     uint8_t value = combination[i] % 10; // Ensure the value is between 0 and 9
     EEPROM.write(EEPROM_SECRET_COMBINATION_ADDRESS + i, value);
 
-    Serial.print("[EEPROM] Stored secret combination digit in EEPROM: ");
-    Serial.println(value);
+    LOG(EEPROM_DIGIT_STORED, value);
   }
 }
+
+/**
+ * Read a LoRa frame counter from EEPROM.
+ * @param address The address of the counter (EEPROM_LORA_TX_COUNTER_ADDRESS or EEPROM_LORA_RX_COUNTER_ADDRESS).
+ * @return The stored counter, or 0 if the EEPROM was never written (erased bytes read as 0xFF).
+ */
+uint32_t readFrameCounterEEPROM(int address) {
+  uint32_t counter = ((uint32_t)EEPROM.read(address) << 24) | ((uint32_t)EEPROM.read(address + 1) << 16) | ((uint32_t)EEPROM.read(address + 2) << 8) | EEPROM.read(address + 3);
+  return counter == 0xFFFFFFFF ? 0 : counter;
+}
+
+/**
+ * Store a LoRa frame counter in EEPROM. Only the bytes that changed are written, to limit the wear.
+ * @param address The address of the counter (EEPROM_LORA_TX_COUNTER_ADDRESS or EEPROM_LORA_RX_COUNTER_ADDRESS).
+ * @param counter The counter to store.
+ */
+void storeFrameCounterEEPROM(int address, uint32_t counter) {
+  EEPROM.update(address, (counter >> 24) & 0xFF);
+  EEPROM.update(address + 1, (counter >> 16) & 0xFF);
+  EEPROM.update(address + 2, (counter >> 8) & 0xFF);
+  EEPROM.update(address + 3, counter & 0xFF);
+}
+
+/**
+ * Retrieve the heartbeat policy set by the last SET_HEARTBEAT_POLICY payload.
+ * @param policy Filled with the stored policy.
+ * @return false if no policy was ever stored (erased EEPROM), policy is then not modified.
+ */
+bool retrieveHeartbeatPolicyEEPROM(HeartbeatPolicyBody& policy) {
+  int     address = EEPROM_HEARTBEAT_POLICY_ADDRESS;
+  uint8_t jitter  = EEPROM.read(address + 4);
+  if (jitter == 0xFF) return false;
+
+  policy.minInterval   = (EEPROM.read(address) << 8) | EEPROM.read(address + 1);
+  policy.maxInterval   = (EEPROM.read(address + 2) << 8) | EEPROM.read(address + 3);
+  policy.jitterPercent = jitter;
+  return true;
+}
+
+/**
+ * Store the heartbeat policy so it survives a reboot.
+ * @param policy The policy to store.
+ */
+void storeHeartbeatPolicyEEPROM(const HeartbeatPolicyBody& policy) {
+  int address = EEPROM_HEARTBEAT_POLICY_ADDRESS;
+  EEPROM.update(address, (policy.minInterval >> 8) & 0xFF);
+  EEPROM.update(address + 1, policy.minInterval & 0xFF);
+  EEPROM.update(address + 2, (policy.maxInterval >> 8) & 0xFF);
+  EEPROM.update(address + 3, policy.maxInterval & 0xFF);
+  EEPROM.update(address + 4, policy.jitterPercent);
+
+  LOG(EEPROM_HEARTBEAT_POLICY_STORED, policy.minInterval, policy.maxInterval, policy.jitterPercent);
+}
+
+/**
+ * Retrieve the LoRa node ID written by the EEPROM utility.
+ * @param nodeId Filled with the stored ID.
+ * @return false if no valid ID is stored (erased EEPROM, 0 or an ID reserved for v2 frames), nodeId is then not modified.
+ */
+bool retrieveLoraNodeIdEEPROM(uint8_t& nodeId) {
+  uint8_t value = EEPROM.read(EEPROM_LORA_NODE_ID_ADDRESS);
+  if (value == 0 || value > LORA_V1_MAX_NODE_ID) return false;
+
+  nodeId = value;
+  LOG(EEPROM_NODE_ID_READ, nodeId);
+  return true;
+}
+
+/**
+ * Retrieve the LoRa MAC key written by the EEPROM utility. The key itself is never printed.
+ * @param key Filled with the stored key.
+ * @return false if no key is stored (all bytes erased), key is then not modified.
+ */
+bool retrieveLoraMacKeyEEPROM(uint8_t (&key)[LORA_MAC_KEY_BYTES]) {
+  uint8_t stored[LORA_MAC_KEY_BYTES];
+  bool    erased = true;
+  for (size_t i = 0; i < sizeof(stored); i++) {
+    stored[i] = EEPROM.read(EEPROM_LORA_MAC_KEY_ADDRESS + i);
+    erased    = erased && stored[i] == 0xFF;
+  }
+  if (erased) return false;
+
+  memcpy(key, stored, sizeof(stored));
+  LOG(EEPROM_MAC_KEY_READ);
+  return true;
+}
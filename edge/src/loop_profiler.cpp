@@ -0,0 +1,129 @@
+#include "loop_profiler.h"
+
+#ifdef LOOP_PROFILER
+#include "security_code.h"
+
+LoopProfiler loopProfiler;
+
+static const char* const STEP_NAMES[] = {"LORA_LOOP", "LORA_RX", "HEARTBEAT", "RULE_CHECK", "MOTION", "BUTTONS", "DISPLAY", "AUDIO"};
+static_assert(sizeof(STEP_NAMES) / sizeof(STEP_NAMES[0]) == static_cast<size_t>(ProfileStep::COUNT), "A name for each step");
+
+void ProfileStats::add(uint32_t us) {
+  if (count == 0 || us < minUs) minUs = us;
+  if (us > maxUs) maxUs = us;
+  totalUs += us;
+  count++;
+
+  uint8_t bin = 0;
+  while (bin < PROFILE_BINS - 1 && us >= (uint32_t)PROFILE_FIRST_BIN_US << bin) {
+    bin++;
+  }
+  if (bins[bin] < UINT16_MAX) bins[bin]++;
+}
+
+/**
+ * @return The upper bound of the bin holding the 99th percentile, at most the maximum.
+ */
+uint32_t ProfileStats::p99Us() const {
+  uint32_t total = 0;
+  for (uint16_t binCount : bins) {
+    total += binCount;
+  }
+
+  uint32_t below = 0;
+  for (uint8_t bin = 0; bin < PROFILE_BINS - 1; bin++) {
+    below += bins[bin];
+    if ((uint64_t)below * 100 >= (uint64_t)total * 99) {
+      uint32_t boundUs = (uint32_t)PROFILE_FIRST_BIN_US << bin;
+      return boundUs < maxUs ? boundUs : maxUs;
+    }
+  }
+  return maxUs;
+}
+
+LoopProfiler::Scope::~Scope() {
+  loopProfiler.record(step, micros() - startUs);
+}
+
+void LoopProfiler::startTick(uint8_t state, uint32_t intervalMs) {
+  uint32_t nowUs = micros();
+  if (hasPreviousTick) {
+    uint32_t periodUs = nowUs - tickStartUs;
+    period.add(periodUs);
+    // The runs that should have happened since the previous one, accounted to the state of the late run
+    uint32_t expected = periodUs / (intervalMs * 1000);
+    if (expected > 1) missedTicks[tickState] += expected - 1;
+  }
+  tickState       = state < PROFILE_STATES ? state : 0;
+  tickStartUs     = nowUs;
+  hasPreviousTick = true;
+}
+
+void LoopProfiler::endTick() {
+  ticks[tickState].add(micros() - tickStartUs);
+}
+
+void LoopProfiler::record(ProfileStep step, uint32_t us) {
+  steps[static_cast<size_t>(step)].add(us);
+}
+
+void LoopProfiler::pollSerial() {
+  while (Serial.available() > 0) {
+    int command = Serial.read();
+    if (command == 'p' || command == 'r') {
+      flushLog(); // The text must not split a log record
+    }
+    if (command == 'p') {
+      print(Serial);
+      hasPreviousTick = false;
+    } else if (command == 'r') {
+      reset();
+      Serial.println(F("[PROFILE] Reset."));
+    }
+  }
+}
+
+void LoopProfiler::print(Print& out) {
+  out.println(F("[PROFILE] Durations in us, the p99 is the upper bound of its histogram bin"));
+  for (uint8_t state = 0; state < PROFILE_STATES; state++) {
+    if (ticks[state].count == 0 && missedTicks[state] == 0) continue;
+    out.print(F("[PROFILE] tick "));
+    out.print(alarmStateToString(static_cast<AlarmState>(state)));
+    out.print(F(": "));
+    printStats(out, ticks[state]);
+    out.print(F(" missed="));
+    out.println(missedTicks[state]);
+  }
+
+  out.print(F("[PROFILE] period: "));
+  printStats(out, period);
+  out.println();
+
+  for (size_t step = 0; step < static_cast<size_t>(ProfileStep::COUNT); step++) {
+    if (steps[step].count == 0) continue;
+    out.print(F("[PROFILE] step "));
+    out.print(STEP_NAMES[step]);
+    out.print(F(": "));
+    printStats(out, steps[step]);
+    out.println();
+  }
+}
+
+void LoopProfiler::reset() {
+  *this = LoopProfiler{};
+}
+
+void LoopProfiler::printStats(Print& out, const ProfileStats& stats) {
+  out.print(F("n="));
+  out.print(stats.count);
+  out.print(F(" min="));
+  out.print(stats.minUs);
+  out.print(F(" mean="));
+  out.print(stats.count ? (uint32_t)(stats.totalUs / stats.count) : 0);
+  out.print(F(" max="));
+  out.print(stats.maxUs);
+  out.print(F(" p99<="));
+  out.print(stats.p99Us());
+}
+
+#endif // LOOP_PROFILER
@@ -1,354 +1,504 @@
 #include "lora_comm.h"
+#include "eeprom_driver.h"
+#include "lora_event_ring.h"
+#include "lora_outbox.h"
+#include "security_code.h"
+#include <lora_airtime.h>
+#include <lora_at_engine.h>
+#include <lora_frame_decoder.h>
+#include <lora_frame_v2.h>
+#include <lora_heartbeat.h>
+#include <lora_mac.h>
+#include <lora_replay.h>
+#include <lora_rx_window.h>
+
+#define LORA_DEFAULT_NODE_ID 1  // Node ID used while none is stored in EEPROM (see the EEPROM utility)
+#define LORA_COUNTER_BLOCK   64 // Number of uplink frame counters reserved in EEPROM at once
+#define LORA_UPLINK_V2          // Send compact v2 uplinks, comment out while the gateway only decodes v1 frames
+// #define LORA_CLASS_A            // Only listen in a short window after each uplink, the gateway must hold the downlinks (LORA_CLASS_A in the gateway)
+
+// ID of this node, from EEPROM, must be registered in the node table of the gateway with the same key
+uint8_t loraNodeId = LORA_DEFAULT_NODE_ID;
+
+// MAC state derived from the key stored in EEPROM, computed once in setupLora()
+LoraMacKey loraMacKey;
 
-static const char* LORA_RFCFG_CMD = "AT+TEST=RFCFG,868.1,SF7,125,8,15,14,ON,OFF,OFF";
+// Store the state of the LoRa module initialization
+bool lora_working = false;
 
-static const uint8_t LORA_NODE_ID = 1; // TODO: Configurable ID
+// Sends the AT commands to the module and reads its lines without blocking the main loop
+LoraAtEngine loraAt(Serial1);
 
-const String HMAC_KEY = "b5df4g1ds14b1ds4fdsv5dsfvdsbds"; // TODO: Use a proper secret key management strategy for production environments
+// Decodes the payload lines received from the module
+LoraFrameDecoder loraDecoder;
 
-// Store the state of the LoRa module initialization
-bool lora_working = false;
+// Payloads waiting for the radio, sent one at a time by loopLora()
+LoraOutbox loraOutbox;
+
+// Events waiting to be aggregated in a single EVENT_BATCH payload
+LoraEventRing eventRing;
+
+// Airtime budget of the 1% duty cycle of the sub-band
+DutyCycleGovernor dutyCycle;
+
+// Interval of the periodic heartbeats, reset on every change of state and doubled while nothing changes
+HeartbeatScheduler heartbeatScheduler;
+
+// Last valid payload received, until it is returned by listenForPayload()
+LoraPayload receivedPayload;
+bool        payloadReceived = false;
+
+// Last uplink frame counter used, and end of the block of counters reserved in EEPROM
+uint32_t txCounter      = 0;
+uint32_t txCounterLimit = 0;
 
-String payloadToHex(const LoraPayload& pkt);
-bool   waitRespAny(const char* expectedResponse1, const char* expectedResponse2, uint32_t timeoutMs);
-void   sendPayload(LoraPayload& pkt);
+// Downlink frame counters already received from the gateway
+ReplayWindow rxWindow;
 
-uint32_t parseU32BE(const String& s, size_t offset);
-bool     hexToPayloadBE(const String& hex, LoraPayload& pkt);
-void     appendHexByte(String& out, uint8_t b);
+// Window listening for downlinks after each uplink, the module sleeps the rest of the time (LORA_CLASS_A only)
+ReceiveWindow downlinkWindow;
+bool          radioAsleep = false;
 
-uint32_t computeHMAC(const LoraPayload& pkt);
-bool     verifyHMAC(const LoraPayload& pkt);
+// Timestamp of the last v1 uplink and its sending time, and number of v2 uplinks sent since then
+LoraEpoch txEpoch          = {.ts = 0, .ms = 0, .valid = false, .id = 0, .renewing = false};
+uint8_t   framesSinceEpoch = 0;
+
+size_t   uplinkWireSize(const LoraPayload& pkt);
+size_t   writeUplink(LoraPayload& pkt, uint8_t* frame);
+bool     isEpochDue();
+void     onLoraLine(const char* line, size_t length);
+void     onLoraConfigured(LoraAtEngine::Result result);
+void     onLoraTransmitted(LoraAtEngine::Result result);
+bool     isPayloadAccepted(const LoraPayload& pkt);
+void     queuePayload(const LoraPayload& pkt, OutboxPriority priority);
+void     recordEvent(EventKind kind, const uint8_t (&value)[4], bool alarm);
+void     flushEvents();
+void     transmitPayload(LoraPayload& pkt, uint32_t airtimeUs);
+bool     serveDownlinkWindow(bool uplinkWaiting);
+uint8_t  reservedAirtimePercent(OutboxPriority priority);
+uint32_t nextTxCounter();
 
 void setupLora() {
-  Serial1.begin(9600);
-  delay(500);
+  uint8_t macKey[LORA_MAC_KEY_BYTES];
+  if (!retrieveLoraNodeIdEEPROM(loraNodeId)) {
+    LOG(LORA_NO_NODE_ID);
+  }
+  if (!retrieveLoraMacKeyEEPROM(macKey)) {
+    LOG(LORA_NO_MAC_KEY);
+    memcpy(macKey, LORA_DEFAULT_MAC_KEY, sizeof(macKey));
+  }
+  loraMacKey = loraMacKeyFromBytes(macKey);
+
+  // Counters used before the reboot may be anywhere in the reserved block, so start after it
+  txCounter      = readFrameCounterEEPROM(EEPROM_LORA_TX_COUNTER_ADDRESS);
+  txCounterLimit = txCounter;
+  rxWindow.restore(readFrameCounterEEPROM(EEPROM_LORA_RX_COUNTER_ADDRESS));
+
+  // The jitter must differ between nodes and between boots so the heartbeats of several nodes do not line up
+  heartbeatScheduler.seed(((uint32_t)loraNodeId << 24) ^ micros() ^ txCounter);
+  HeartbeatPolicyBody policy;
+  if (retrieveHeartbeatPolicyEEPROM(policy) && !heartbeatScheduler.setPolicy(policy, millis())) {
+    LOG(LORA_INVALID_STORED_POLICY);
+  }
+  heartbeatScheduler.restart(millis()); // First heartbeat after the minimum interval, once the module is configured
+
+  Serial1.begin(LORA_AT_BAUD);
+  loraAt.setLineHandler(onLoraLine);
+
+  // The commands are sent by loopLora(), lora_working is set once the module acknowledged the RF configuration
+  bool queued = loraAt.enqueue("AT+MODE=TEST", "+MODE", nullptr, LORA_AT_CMD_TIMEOUT);
+  queued      = queued && loraAt.enqueue(LORA_RFCFG_CMD, "RFCFG", "OK", LORA_AT_CMD_TIMEOUT, onLoraConfigured);
+#ifdef LORA_CLASS_A // The module sleeps until the first uplink
+  queued      = queued && loraAt.enqueue("AT+LOWPOWER", "SLEEP", nullptr, LORA_AT_CMD_TIMEOUT);
+  radioAsleep = true;
+#else
+  queued      = queued && loraAt.enqueue("AT+TEST=RXLRPKT", "RXLRPKT", nullptr, LORA_AT_CMD_TIMEOUT);
+#endif // LORA_CLASS_A
+  if (!queued) {
+    LOG(LORA_INIT_NOT_QUEUED);
+  }
+}
 
-  Serial1.println("AT+MODE=TEST");
-  delay(500);
-  Serial1.println(LORA_RFCFG_CMD);
-  delay(500);
+/**
+ * Advance the AT commands sent to the LoRa module and decode the lines it printed. Never blocks, must be called at every iteration of the main loop.
+ * Due events are flushed to the outbox as a batch. The next payload of the outbox is sent once the module is back in receive mode after the previous one, if the duty-cycle budget allows it.
+ */
+void loopLora() {
+  PROFILE_STEP(ProfileStep::LORA_LOOP);
+  loraAt.poll();
 
-  // Verify the module response
-  if (!waitRespAny("RFCFG", "OK", 4000)) {
-    Serial.println(F("[LoRa] Error: the module is not responding correctly."));
-    lora_working = false;
-    return;
+  // Events wait in the ring while the outbox is full
+  if (lora_working && eventRing.isFlushDue(millis()) && loraOutbox.size() < LORA_OUTBOX_SIZE) {
+    flushEvents();
   }
-  lora_working = true;
 
-  Serial.println(F("[LoRa] Module initialized in TEST mode."));
+  OutboxPriority     priority;
+  const LoraPayload* next = loraOutbox.peek(priority);
+  if (!lora_working || !loraAt.idle()) return;
+  if (serveDownlinkWindow(next != nullptr) || !next) return;
+
+  uint32_t airtimeUs = loraTimeOnAirUs(LORA_RF_CONFIG, uplinkWireSize(*next));
+  if (dutyCycle.tryConsume(airtimeUs, reservedAirtimePercent(priority), millis())) {
+    LoraPayload pkt;
+    loraOutbox.pop(pkt);
+    transmitPayload(pkt, airtimeUs);
+  } else if (priority == OutboxPriority::TELEMETRY) {
+    LoraPayload pkt;
+    loraOutbox.pop(pkt);
+    LOG(LORA_TELEMETRY_DROPPED);
+  }
+  // Otherwise the payload stays in the outbox until the budget refills
 }
 
 /**
- * Listen for incoming LoRa payloads.
- * @return The received payload, or an empty payload if no valid payload was received.
+ * Keep the module listening while the downlink window after the last uplink is open, then put it to sleep unless an
+ * uplink is waiting. Does nothing without LORA_CLASS_A, the module then always listens.
+ * @param uplinkWaiting Whether the outbox holds a payload, the module is then kept awake to send it.
+ * @return true while the window is open, no uplink must be sent meanwhile.
  */
-LoraPayload listenForPayload() {
-  if (!lora_working) {
-    Serial.println(F("[LoRa] Module not operational, listening cancelled."));
-    return LoraPayload{};
+bool serveDownlinkWindow(bool uplinkWaiting) {
+#ifdef LORA_CLASS_A
+  if (!downlinkWindow.isOpen()) return false;
+  if (!downlinkWindow.isExpired(millis())) return true;
+
+  downlinkWindow.close();
+  if (!uplinkWaiting) {
+    loraAt.enqueue("AT+LOWPOWER", "SLEEP", nullptr, LORA_AT_CMD_TIMEOUT);
+    radioAsleep = true;
   }
+#endif // LORA_CLASS_A
+  return false;
+}
 
-  if (Serial1.available()) {
-    String line = Serial1.readStringUntil('\n');
-    line.trim();
+/**
+ * Part of the duty-cycle budget that a payload of the given priority must leave for the more important ones.
+ * @return The reserved part of the budget, in percent.
+ */
+uint8_t reservedAirtimePercent(OutboxPriority priority) {
+  switch (priority) {
+  case OutboxPriority::ALARM:        return 0;
+  case OutboxPriority::STATE_CHANGE: return 10;
+  case OutboxPriority::HEARTBEAT:    return 25;
+  case OutboxPriority::TELEMETRY:
+  default:                           return 50;
+  }
+}
 
-    if (line.startsWith("+TEST: RX \"")) {
-      Serial.println(F("[LoRa] Raw Payload received:"));
-      Serial.println(line);
+/**
+ * Called when the module answered the RF configuration command.
+ */
+void onLoraConfigured(LoraAtEngine::Result result) {
+  if (result != LoraAtEngine::Result::OK) {
+    LOG(LORA_NOT_RESPONDING);
+    lora_working = false;
+    return;
+  }
+  lora_working = true;
 
-      String hex;
+  LOG(LORA_READY);
+}
 
-      // Parse format: +TEST: RX,"<hex_data>"
-      int q1 = line.indexOf('"');
-      int q2 = line.indexOf('"', q1 + 1);
-      if (q1 >= 0 && q2 > q1) {
-        hex = line.substring(q1 + 1, q2);
-      } else {
-        return LoraPayload{}; // Invalid data
-      }
+/**
+ * Called when the module finished (or failed) sending a payload.
+ */
+void onLoraTransmitted(LoraAtEngine::Result result) {
+  if (result != LoraAtEngine::Result::OK) {
+    LOG(LORA_NOT_SENT);
+  }
+#ifdef LORA_CLASS_A
+  downlinkWindow.open(millis()); // Also after a failure, the module is switched back to receive mode anyway
+#endif // LORA_CLASS_A
+}
 
-      if (hex.length() >= (1 + 4 + 1 + 1 + 4) * 2) { // 2 hex characters = 1 byte, minimum length for a valid payload (id + ts + type + length + hmac)
-        LoraPayload pkt;
-        if (!hexToPayloadBE(hex, pkt)) {
-          return LoraPayload{}; // Invalid data
-        }
-        printPayload(pkt);
-        if (pkt.id != LORA_NODE_ID) {
-          Serial.println("[LoRa] Invalid node ID: " + String(pkt.id));
-          return LoraPayload{};
-        }
-        if (!verifyHMAC(pkt)) {
-          Serial.println("[LoRa] HMAC verification failed.");
-          return LoraPayload{};
-        }
-        Serial.println("[LoRa] HMAC verification succeeded.");
-        return pkt;
-      } else {
-        Serial.println("[LoRa] Invalid payload length: " + String(hex.length()) + " (expected " + String(sizeof(LoraPayload) * 2) + ")");
+/**
+ * Called by the AT engine for every line printed by the module. Payload lines are decoded on the fly and kept until the next call of listenForPayload().
+ * @param line The line, without line ending.
+ * @param length The number of characters of the line.
+ */
+void onLoraLine(const char* line, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    LoraFrameDecoder::Result result = loraDecoder.feed(line[i]);
+
+    if (result == LoraFrameDecoder::Result::INVALID) {
+      LOG(LORA_INVALID_PAYLOAD);
+    } else if (result == LoraFrameDecoder::Result::FRAME && isPayloadAccepted(loraDecoder.payload())) {
+      if (payloadReceived) {
+        LOG(LORA_PAYLOAD_REPLACED);
       }
+      receivedPayload = loraDecoder.payload();
+      payloadReceived = true;
+#ifdef LORA_CLASS_A
+      if (downlinkWindow.isOpen()) downlinkWindow.open(millis()); // The gateway may send another held downlink
+#endif // LORA_CLASS_A
     }
   }
-  return LoraPayload{};
+  loraDecoder.feed('\n');
 }
 
 /**
- * Blocks until a response containing either of the two expected responses is received, or until timeoutMs is reached.
- * @param expectedResponse1 The first expected response string to wait for.
- * @param expectedResponse2 The second expected response string to wait for.
- * @param timeoutMs The timeout in milliseconds to wait for a response.
- * @return true if a response containing expectedResponse1 or expectedResponse2 is received, false if timeout is reached or if an error response is received.
+ * Listen for incoming LoRa payloads.
+ * The lines printed by the module are decoded by loopLora(), this function only hands over the last valid payload.
+ * @return The received payload, or an empty payload if no valid payload was received.
  */
-bool waitRespAny(const char* expectedResponse1, const char* expectedResponse2, uint32_t timeoutMs) {
-  uint32_t start = millis();
-  String   resp;
-
-  while (millis() - start < timeoutMs) {
-    while (Serial1.available()) {
-      char c = (char)Serial1.read();
-      resp += c;
-
-      if (resp.indexOf("ERROR") >= 0 || resp.indexOf("FAIL") >= 0) {
-        Serial.print(F("<< "));
-        Serial.println(resp);
-        return false;
-      }
+LoraPayload listenForPayload() {
+  if (!lora_working) {
+    LOG(LORA_LISTEN_CANCELLED);
+    return LoraPayload{};
+  }
 
-      if ((expectedResponse1 && resp.indexOf(expectedResponse1) >= 0) || (expectedResponse2 && resp.indexOf(expectedResponse2) >= 0)) {
-        Serial.print(F("<< "));
-        Serial.println(resp);
-        return true;
-      }
-    }
+  if (!payloadReceived) {
+    return LoraPayload{};
   }
+  payloadReceived = false;
+  return receivedPayload;
+}
 
-  if (resp.length() > 0) {
-    Serial.print(F("<< (timeout) "));
-    Serial.println(resp);
+/**
+ * Check the node ID, the direction, the frame counter and the MAC of a received payload.
+ * @param pkt The decoded payload.
+ * @return true if the payload is a downlink addressed to this node, is not replayed and is authentic.
+ */
+bool isPayloadAccepted(const LoraPayload& pkt) {
+  printPayload(pkt);
+  if (pkt.id != loraNodeId) {
+    LOG(LORA_INVALID_NODE_ID, pkt.id);
+    return false;
   }
-  return false;
+  // A captured uplink of this node has a valid MAC under the same key, it must not reach the downlink counter
+  if (!isDownlinkType(pkt.type)) {
+    LOG(LORA_WRONG_DIRECTION, static_cast<uint8_t>(pkt.type));
+    return false;
+  }
+  // The counter check is cheap, replayed frames are dropped before the MAC is computed
+  if (!rxWindow.check(pkt.counter)) {
+    LOG(LORA_REPLAYED_COUNTER, pkt.counter);
+    return false;
+  }
+  if (!verifyFrameMac(loraMacKey, LoraDirection::DOWNLINK, pkt)) {
+    LOG(LORA_MAC_FAILED);
+    return false;
+  }
+  LOG(LORA_MAC_SUCCEEDED);
+  // Downlinks are rare, so the highest counter is persisted every time to close the replay window across reboots
+  if (rxWindow.accept(pkt.counter)) {
+    storeFrameCounterEEPROM(EEPROM_LORA_RX_COUNTER_ADDRESS, pkt.counter);
+  }
+  return true;
 }
 
 /**
- * Send a motion sensor detection packet.
+ * Record a motion sensor edge, sent with the next event batch.
  * @param state The current state of the motion sensor.
  */
 void loraSendMotionState(bool state) {
-  if (!lora_working) {
-    Serial.println(F("[LoRa] Module not operational, send cancelled."));
-    return;
-  }
+  recordEvent(EventKind::MOTION, {static_cast<uint8_t>(state ? 1 : 0)}, false);
+}
 
-  uint32_t unixTime = getCurrentUnixTime();
+/**
+ * Record a wrong combination, sent with the next event batch.
+ * @param attempt The number of wrong attempts so far.
+ * @param maxAttempts The number of wrong attempts that fails the disarming.
+ */
+void loraSendWrongCode(uint8_t attempt, uint8_t maxAttempts) {
+  recordEvent(EventKind::WRONG_CODE, {attempt, maxAttempts}, false);
+}
 
-  LoraPayload pkt;
-  pkt.id      = LORA_NODE_ID;
-  pkt.ts      = unixTime;
-  pkt.type    = PayloadType::MOTION_STATE;
-  pkt.length  = 1;
-  pkt.data[0] = state ? 1 : 0;
+/**
+ * Record a correction of the RTC, sent with the next event batch.
+ * @param correctionS The difference between the new and the old time, in seconds.
+ */
+void loraSendRtcCorrection(int32_t correctionS) {
+  uint8_t value[4];
+  WireField<int32_t>::write(value, correctionS);
+  recordEvent(EventKind::RTC_CORRECTION, value, false);
+}
+
+/**
+ * @return true when the next periodic heartbeat must be sent with loraSendHeartbeat().
+ */
+bool isHeartbeatDue() {
+  return heartbeatScheduler.isDue(millis());
+}
 
-  sendPayload(pkt);
+/**
+ * Apply and store a new heartbeat policy received from the gateway.
+ * @param policy The new intervals and jitter.
+ * @return false if the policy is invalid, the current one is then kept.
+ */
+bool setHeartbeatPolicy(const HeartbeatPolicyBody& policy) {
+  if (!heartbeatScheduler.setPolicy(policy, millis())) return false;
+  storeHeartbeatPolicyEEPROM(policy);
+  return true;
 }
 
 /**
- * Send a heartbeat payload through LoRa.
+ * Send a periodic heartbeat payload through LoRa. Nothing changed since the previous heartbeat, so the next one is sent after a longer interval.
  * @param state The current state of the alarm.
  */
 void loraSendHeartbeat(AlarmState state) {
-  if (!lora_working) {
-    Serial.println(F("[LoRa] Module not operational, send cancelled."));
-    return;
-  }
-
-  uint32_t unixTime = getCurrentUnixTime();
+  PROFILE_STEP(ProfileStep::HEARTBEAT);
+  uint32_t unixTime      = getCurrentUnixTime();
+  uint16_t nextHeartbeat = heartbeatScheduler.backOff(millis());
 
   LoraPayload pkt;
-  pkt.id      = LORA_NODE_ID;
-  pkt.ts      = unixTime;
-  pkt.type    = PayloadType::EDGE_HEARTBEAT;
-  pkt.length  = 1;
-  pkt.data[0] = static_cast<uint8_t>(state);
+  pkt.id = loraNodeId;
+  pkt.ts = unixTime;
+  encodePayload<PayloadType::EDGE_HEARTBEAT>({.alarmState = static_cast<uint8_t>(state), .airtimeUsage = dutyCycle.usagePercent(millis()), .nextHeartbeat = nextHeartbeat}, pkt);
 
-  sendPayload(pkt);
+  queuePayload(pkt, OutboxPriority::HEARTBEAT);
 }
 
 /**
- * Send the given payload through LoRa as hex data.
- * Add hmac signing in the future for integrity and authenticity verification.
- * @param pkt The payload to send.
+ * Record a new alarm state, sent with the next event batch. The batch is flushed at once when the alarm is triggered or failed to be disarmed.
+ * The event carries the heartbeat body of the new state, the heartbeat interval goes back to its minimum.
+ * @param state The new state of the alarm.
  */
-void sendPayload(LoraPayload& pkt) {
-  pkt.hmac = computeHMAC(pkt);
-
-  String hex = payloadToHex(pkt);
-
-  String cmd = "AT+TEST=TXLRPKT,\"" + hex + "\"";
+void loraSendAlarmState(AlarmState state) {
+  uint16_t      nextHeartbeat = heartbeatScheduler.restart(millis());
+  HeartbeatBody heartbeat     = {.alarmState = static_cast<uint8_t>(state), .airtimeUsage = dutyCycle.usagePercent(millis()), .nextHeartbeat = nextHeartbeat};
 
-  Serial.print(F("[LoRa] Sending payload: "));
-  Serial.println(cmd);
+  uint8_t value[4];
+  writeFields(heartbeat, PayloadLayout<PayloadType::EDGE_HEARTBEAT>::FIELDS, value);
 
-  Serial1.println(cmd);
-
-  // After sending a message, we have to manually switch back to listening
-  delay(300);
-  Serial1.println("AT+TEST=RXLRPKT");
+  bool isAlarm = state == AlarmState::TRIGGERED || state == AlarmState::FAILED_DISARM;
+  recordEvent(EventKind::STATE_TRANSITION, value, isAlarm);
 }
 
-String payloadToHex(const LoraPayload& pkt) {
-  String hex;
-  hex.reserve(sizeof(LoraPayload) * 2);
-
-  appendHexByte(hex, pkt.id);
-
-  appendHexByte(hex, (uint8_t)((pkt.ts >> 24) & 0xFF));
-  appendHexByte(hex, (uint8_t)((pkt.ts >> 16) & 0xFF));
-  appendHexByte(hex, (uint8_t)((pkt.ts >> 8) & 0xFF));
-  appendHexByte(hex, (uint8_t)(pkt.ts & 0xFF));
-
-  appendHexByte(hex, static_cast<uint8_t>(pkt.type));
-
-  appendHexByte(hex, (uint8_t)(pkt.length & 0xFF));
-
-  for (size_t i = 0; i < pkt.length; i++) {
-    appendHexByte(hex, pkt.data[i]);
-  }
-
-  appendHexByte(hex, (uint8_t)((pkt.hmac >> 24) & 0xFF));
-  appendHexByte(hex, (uint8_t)((pkt.hmac >> 16) & 0xFF));
-  appendHexByte(hex, (uint8_t)((pkt.hmac >> 8) & 0xFF));
-  appendHexByte(hex, (uint8_t)(pkt.hmac & 0xFF));
+/**
+ * Send the progress of a time range transfer, so the gateway only retransmits the missing fragments.
+ * @param status The fragments received so far, or the commit of the rule set.
+ */
+void loraSendTransferStatus(const TransferStatusBody& status) {
+  LoraPayload pkt;
+  pkt.id = loraNodeId;
+  pkt.ts = getCurrentUnixTime();
+  encodePayload<PayloadType::TRANSFER_STATUS>(status, pkt);
 
-  return hex;
+  queuePayload(pkt, OutboxPriority::STATE_CHANGE);
 }
 
 /**
- * Append a single byte as two uppercase hex characters.
- * @param out The output string to append to.
- * @param b The byte to append as hex.
+ * Record an event in the ring, it is sent by loopLora() with the next batch.
+ * @param kind The kind of the event.
+ * @param value The content of the event, depending on its kind.
+ * @param alarm Whether the event must be sent at once.
  */
-void appendHexByte(String& out, uint8_t b) {
-  const char* hexChars = "0123456789ABCDEF";
-  out += hexChars[b >> 4];
-  out += hexChars[b & 0x0F];
+void recordEvent(EventKind kind, const uint8_t (&value)[4], bool alarm) {
+  eventRing.record(kind, value, alarm, getCurrentUnixTime(), millis());
 }
 
 /**
- * Parse a 32-bit unsigned integer from big-endian hex (8 chars = 4 bytes).
- * @param s The hex string to parse.
- * @param offset The starting position in the string to parse from.
- * @return The parsed 32-bit unsigned integer.
+ * Move the oldest events of the ring to the outbox as a single EVENT_BATCH payload.
+ * A batch holding an alarm-class event is sent with the alarm priority.
  */
-uint32_t parseU32BE(const String& s, size_t offset) {
-  uint32_t value = 0;
-  for (size_t i = 0; i < 4; i++) {
-    String byteStr = s.substring(offset + i * 2, offset + i * 2 + 2);
-    value          = (value << 8) | (uint32_t)strtoul(byteStr.c_str(), nullptr, 16);
+void flushEvents() {
+  LoraPayload pkt;
+  bool        alarm;
+  pkt.id = loraNodeId;
+  if (eventRing.takeBatch(pkt, alarm)) {
+    queuePayload(pkt, alarm ? OutboxPriority::ALARM : OutboxPriority::STATE_CHANGE);
   }
-  return value;
 }
 
 /**
- * Convert a hex payload string into a LoraPayload using big-endian field order.
- * @param hex The hex string representing the payload.
- * @param pkt The LoraPayload object to populate.
- * @return true if the payload was successfully parsed, false otherwise.
+ * Queue a payload in the outbox, it is sent by loopLora() when the radio is available.
+ * @param pkt The payload to send, its counter and hmac are set when it is sent.
+ * @param priority The priority class of the payload.
  */
-bool hexToPayloadBE(const String& hex, LoraPayload& pkt) {
-  size_t offset = 0;
-  pkt.id        = (uint8_t)strtoul(hex.substring(offset, offset + 2).c_str(), nullptr, 16);
-  offset += 2;
-  pkt.ts = parseU32BE(hex, offset);
-  offset += 8;
-  uint32_t rawType = strtoul(hex.substring(offset, offset + 2).c_str(), nullptr, 16);
-  if (auto type = parsePayloadType(rawType)) {
-    pkt.type = type.value();
-  } else {
-    Serial.println("[LoRa] Invalid payload type: " + String(rawType));
-    return false;
+void queuePayload(const LoraPayload& pkt, OutboxPriority priority) {
+  if (!lora_working) {
+    LOG(LORA_SEND_CANCELLED);
+    return;
   }
-  offset += 2;
-  pkt.length = (uint8_t)strtoul(hex.substring(offset, offset + 2).c_str(), nullptr, 16);
-  offset += 2;
+  loraOutbox.push(pkt, priority);
+}
 
-  if (hex.length() < (1 + 4 + 1 + 1 + 4 + pkt.length) * 2) {
-    Serial.println("[LoRa] Invalid hex length: " + String(hex.length()) + " (expected at least " + String((1 + 4 + 1 + 1 + 4 + pkt.length) * 2) + ")");
-    return false; // Check expected length based on the length field
-  }
+/**
+ * Number and sign the given payload and send it through LoRa as hex data.
+ * @param pkt The payload to send.
+ * @param airtimeUs The time-on-air of the payload, already taken from the duty-cycle budget.
+ */
+void transmitPayload(LoraPayload& pkt, uint32_t airtimeUs) {
+  pkt.counter = nextTxCounter();
+
+  uint8_t frame[LORA_FRAME_MAX_BYTES];
+  size_t  frameSize = writeUplink(pkt, frame);
 
-  // Serial.print("[LoRa] Data: ");
-  for (size_t i = 0; i < pkt.length; i++) {
-    // Serial.print(hex.substring(offset, offset + 2));
-    pkt.data[i] = (uint8_t)strtoul(hex.substring(offset, offset + 2).c_str(), nullptr, 16);
-    offset += 2;
+  LOG(LORA_SENDING, LogBytes{frame, frameSize}, airtimeUs, dutyCycle.usagePercent(millis()));
+
+  // Any character wakes the module up, but the first command after the sleep may be lost
+  if (radioAsleep) {
+    loraAt.enqueue("AT", "+AT: OK", "WAKEUP", LORA_AT_CMD_TIMEOUT);
+    radioAsleep = false;
   }
-  // Serial.println();
 
-  pkt.hmac = parseU32BE(hex, offset);
-  // Serial.println(pkt.hmac, HEX);
-  offset += 8;
+  // After sending a message, we have to manually switch back to listening once the module printed TX DONE
+  loraAt.enqueueTransmit(frame, frameSize, LORA_AT_TX_TIMEOUT, onLoraTransmitted);
+  loraAt.enqueue("AT+TEST=RXLRPKT", "RXLRPKT", nullptr, LORA_AT_CMD_TIMEOUT);
+}
 
-  return true;
+/**
+ * Send the next uplink as a v1 frame, the gateway missed the one the v2 frames count their timestamps from.
+ */
+void renewLoraEpoch() {
+  txEpoch.valid = false;
 }
 
-uint32_t computeHMAC(const LoraPayload& pkt) {
-  String data = String(pkt.id) + String(pkt.ts) + String(static_cast<uint8_t>(pkt.type)) + String(pkt.length);
-  for (size_t i = 0; i < pkt.length; i++) {
-    String byteStr = String(pkt.data[i], 16);
-    byteStr.toUpperCase();
-    for (size_t j = 0; j < 2 - byteStr.length(); j++) {
-      data += "0";
-    }
-    data += byteStr;
-  }
+/**
+ * @return true if the next uplink must be a v1 frame, to renew the epoch of the v2 frames.
+ */
+bool isEpochDue() {
+#ifdef LORA_UPLINK_V2
+  return !txEpoch.valid || framesSinceEpoch >= LORA_V2_EPOCH_INTERVAL;
+#else
+  return true;
+#endif // LORA_UPLINK_V2
+}
 
-  // Serial.println("[HMAC] Computing HMAC for payload data (raw): " + String(pkt.id) + "," + String(pkt.ts) + "," + String(static_cast<uint8_t>(pkt.type)) + "," + String(pkt.length));
-  // Serial.println("[HMAC] Computing HMAC for payload data (data): " + data);
-  uint32_t hmac = 5381; // Initialize with a cryptographic magic number
+/**
+ * @return The number of bytes the payload will take on the wire, as a v2 frame if possible.
+ */
+size_t uplinkWireSize(const LoraPayload& pkt) {
+  size_t size = isEpochDue() ? 0 : writeFrameV2(loraMacKey, pkt, txEpoch, millis(), nullptr);
+  return size ? size : frameWireSize(pkt);
+}
 
-  // DJB2 hash-like algorithm
-  String mix = data + HMAC_KEY;
-  // Serial.println("[HMAC] Computing HMAC for payload data (mix): " + mix);
-  for (int i = 0; i < mix.length(); i++) {
-    // Serial.println("[HMAC] Computing HMAC for payload data (hmac): i=" + String(i) + ", " + mix);
-    hmac = ((hmac << 5) + hmac) + mix.charAt(i); // (hmac * 32 + hmac) + c = hmac * 33 + c
+/**
+ * Serialize and sign an uplink, as a compact v2 frame unless the epoch must be renewed or the payload cannot be sent as v2.
+ * A v1 frame becomes the new epoch.
+ * @param pkt The payload to send, with its counter set. Its hmac is set if it is sent as v1.
+ * @param frame Buffer of at least LORA_FRAME_MAX_BYTES bytes.
+ * @return The number of bytes written.
+ */
+size_t writeUplink(LoraPayload& pkt, uint8_t* frame) {
+  size_t size = isEpochDue() ? 0 : writeFrameV2(loraMacKey, pkt, txEpoch, millis(), frame);
+  if (size) {
+    framesSinceEpoch++;
+    return size;
   }
 
-  // Serial.println("[HMAC] HMAC result: " + String(hmac));
-  return hmac;
+  pkt.hmac         = computeFrameMac(loraMacKey, LoraDirection::UPLINK, pkt);
+  txEpoch.ts       = pkt.ts;
+  txEpoch.ms       = millis();
+  txEpoch.valid    = true;
+  txEpoch.id       = static_cast<uint8_t>(pkt.counter);
+  framesSinceEpoch = 0;
+  return writeFrame(pkt, frame);
 }
 
-bool verifyHMAC(const LoraPayload& pkt) {
-  uint32_t computedHMAC = computeHMAC(pkt);
-  // Serial.println("[HMAC] Verifying HMAC: computed=" + String(computedHMAC) + ", received=" + String(pkt.hmac));
-  return computedHMAC == pkt.hmac;
+/**
+ * Get the counter of the next uplink frame. Counters are reserved in EEPROM by blocks of LORA_COUNTER_BLOCK,
+ * so the EEPROM is written once every LORA_COUNTER_BLOCK frames and a counter is never reused after a reboot.
+ * @return The frame counter to send, starting at 1.
+ */
+uint32_t nextTxCounter() {
+  if (txCounter >= txCounterLimit) {
+    txCounterLimit = txCounter + LORA_COUNTER_BLOCK;
+    storeFrameCounterEEPROM(EEPROM_LORA_TX_COUNTER_ADDRESS, txCounterLimit);
+  }
+  return ++txCounter;
 }
 
 void printPayload(const LoraPayload& pkt) {
-  Serial.println(F("[LoRa] Payload:"));
-
-  Serial.print("  ID: ");
-  Serial.println(pkt.id);
-  Serial.print("  TS: ");
-  Serial.println(pkt.ts);
-  Serial.print("  Type: ");
-  Serial.println(static_cast<uint8_t>(pkt.type), HEX);
-  Serial.print("  Length: ");
-  Serial.println(pkt.length, HEX);
-  String dataStr;
-  for (size_t i = 0; i < pkt.length; i++) {
-    if (pkt.data[i] < 0x10) dataStr += "0";
-    dataStr += String(pkt.data[i], HEX);
-  }
-  dataStr.toUpperCase();
-  Serial.print("  Data: ");
-  Serial.println(dataStr);
-  Serial.print("  HMAC: ");
-  String hmacStr = String(pkt.hmac, HEX);
-  hmacStr.toUpperCase();
-  for (size_t i = hmacStr.length(); i < 8; i++) {
-    hmacStr = "0" + hmacStr; // Pad with leading zeros if necessary
-  }
-  Serial.println(hmacStr);
+  LOG(LORA_PAYLOAD, pkt.id, pkt.counter, pkt.ts, pkt.type, pkt.length, LogBytes{pkt.data, pkt.length}, pkt.hmac);
 }
@@ -0,0 +1,79 @@
+#include "lora_event_ring.h"
+
+LoraEventRing::LoraEventRing() : entries{}, head(0), count(0) {}
+
+/**
+ * Record an event, it is sent with the next batch.
+ * @param kind The kind of the event.
+ * @param value The content of the event, depending on its kind.
+ * @param alarm Whether the event is alarm-class, the batch is then flushed at once.
+ * @param ts The Unix timestamp of the event.
+ * @param nowMs The current time, in milliseconds (millis()).
+ */
+void LoraEventRing::record(EventKind kind, const uint8_t (&value)[4], bool alarm, uint32_t ts, uint32_t nowMs) {
+  if (count == LORA_EVENT_RING_SIZE) {
+    LOG(LORA_EVENT_RING_FULL);
+    head = (head + 1) % LORA_EVENT_RING_SIZE;
+    count--;
+  }
+
+  Entry& entry = entries[(head + count) % LORA_EVENT_RING_SIZE];
+  entry.kind   = kind;
+  memcpy(entry.value, value, sizeof(entry.value));
+  entry.alarm = alarm;
+  entry.ts    = ts;
+  entry.ms    = nowMs;
+  count++;
+}
+
+/**
+ * @param nowMs The current time, in milliseconds (millis()).
+ * @return true if the waiting events must be sent now.
+ */
+bool LoraEventRing::isFlushDue(uint32_t nowMs) const {
+  if (count == 0) return false;
+  if (count >= LORA_EVENT_FLUSH_COUNT || nowMs - entries[head].ms >= LORA_EVENT_FLUSH_DELAY) return true;
+  for (uint8_t i = 0; i < count; i++) {
+    if (entries[(head + i) % LORA_EVENT_RING_SIZE].alarm) return true;
+  }
+  return false;
+}
+
+/**
+ * Move the oldest events into an EVENT_BATCH payload. The timestamp of the payload is the one of the first event,
+ * the following events are taken as long as their offset from it fits in a record.
+ * @param pkt Filled with the ts, type, length and data of the batch.
+ * @param alarm Set if the batch holds an alarm-class event.
+ * @return false if no event is waiting.
+ */
+bool LoraEventRing::takeBatch(LoraPayload& pkt, bool& alarm) {
+  if (count == 0) return false;
+
+  const Entry& first = entries[head];
+  pkt.ts             = first.ts;
+  pkt.length         = 0;
+  alarm              = false;
+
+  uint32_t firstMs = first.ms;
+  while (count > 0) {
+    const Entry& entry    = entries[head];
+    uint32_t     offsetMs = entry.ms - firstMs;
+    if (offsetMs > UINT16_MAX) break;
+
+    EventRecord record = {.kind = static_cast<uint8_t>(entry.kind), .offsetMs = static_cast<uint16_t>(offsetMs), .value = {}};
+    memcpy(record.value, entry.value, sizeof(record.value));
+    if (!appendPayloadRecord<PayloadType::EVENT_BATCH>(record, pkt)) break; // The batch is full, the rest goes in the next one
+
+    alarm = alarm || entry.alarm;
+    head  = (head + 1) % LORA_EVENT_RING_SIZE;
+    count--;
+  }
+  return true;
+}
+
+/**
+ * @return The number of events waiting to be sent.
+ */
+size_t LoraEventRing::size() const {
+  return count;
+}
@@ -0,0 +1,121 @@
+#include "lora_outbox.h"
+
+LoraOutbox::LoraOutbox() : entries{}, nextOrder(0) {}
+
+/**
+ * Queue a payload to send.
+ * @param pkt The payload, its counter and hmac are set when it is sent.
+ * @param priority The priority class of the payload.
+ * @return false if the payload was dropped because the outbox is full of payloads with a higher or equal priority.
+ */
+bool LoraOutbox::push(const LoraPayload& pkt, OutboxPriority priority) {
+  // Coalesce: a newer state supersedes the queued one, it keeps its place in the queue and the highest priority of both
+  if (isStatePayload(pkt.type)) {
+    for (Entry& entry : entries) {
+      if (entry.used && entry.pkt.type == pkt.type) {
+        entry.pkt = pkt;
+        if (priority < entry.priority) entry.priority = priority;
+        return true;
+      }
+    }
+  }
+
+  Entry* slot = nullptr;
+  for (Entry& entry : entries) {
+    if (!entry.used) {
+      slot = &entry;
+      break;
+    }
+  }
+
+  if (!slot) {
+    // Full: evict the newest payload of the lowest priority class, only if it is less important than the new one
+    int lowest = findLowestPriorityEntry();
+    if (entries[lowest].priority <= priority) {
+      LOG(LORA_OUTBOX_FULL);
+      return false;
+    }
+    LOG(LORA_OUTBOX_EVICTED);
+    slot = &entries[lowest];
+  }
+
+  slot->pkt      = pkt;
+  slot->priority = priority;
+  slot->order    = nextOrder++;
+  slot->used     = true;
+  return true;
+}
+
+/**
+ * Take the next payload to send: the oldest one of the highest priority class.
+ * @param pkt Filled with the payload to send.
+ * @return false if the outbox is empty.
+ */
+bool LoraOutbox::pop(LoraPayload& pkt) {
+  int next = findNextEntry();
+  if (next < 0) return false;
+
+  pkt                = entries[next].pkt;
+  entries[next].used = false;
+  return true;
+}
+
+/**
+ * Look at the next payload to send without removing it, e.g. to check if the radio can send it now.
+ * @param priority Filled with the priority class of the payload.
+ * @return The payload that pop() would return, or nullptr if the outbox is empty.
+ */
+const LoraPayload* LoraOutbox::peek(OutboxPriority& priority) const {
+  int next = findNextEntry();
+  if (next < 0) return nullptr;
+
+  priority = entries[next].priority;
+  return &entries[next].pkt;
+}
+
+/**
+ * @return The number of payloads waiting to be sent.
+ */
+size_t LoraOutbox::size() const {
+  size_t count = 0;
+  for (const Entry& entry : entries) {
+    if (entry.used) count++;
+  }
+  return count;
+}
+
+/**
+ * Payloads carrying the current value of a state, a newer one makes the older one useless.
+ */
+bool LoraOutbox::isStatePayload(PayloadType type) {
+  return type == PayloadType::EDGE_HEARTBEAT || type == PayloadType::MOTION_STATE || type == PayloadType::TRANSFER_STATUS;
+}
+
+/**
+ * @return The index of the oldest entry of the highest priority class, or -1 if the outbox is empty.
+ */
+int LoraOutbox::findNextEntry() const {
+  int next = -1;
+  for (int i = 0; i < LORA_OUTBOX_SIZE; i++) {
+    if (!entries[i].used) continue;
+    // Orders are compared by difference so the wrap-around of nextOrder keeps the FIFO order
+    if (next < 0 || entries[i].priority < entries[next].priority || (entries[i].priority == entries[next].priority && (int16_t)(entries[i].order - entries[next].order) < 0)) {
+      next = i;
+    }
+  }
+  return next;
+}
+
+/**
+ * @return The index of the newest entry of the lowest priority class. The outbox must not be empty.
+ */
+int LoraOutbox::findLowestPriorityEntry() const {
+  int lowest = -1;
+  for (int i = 0; i < LORA_OUTBOX_SIZE; i++) {
+    if (!entries[i].used) continue;
+    if (lowest < 0 || entries[i].priority > entries[lowest].priority || (entries[i].priority == entries[lowest].priority && (int16_t)(entries[i].order - entries[lowest].order) > 0)) {
+      lowest = i;
+    }
+  }
+  return lowest;
+}
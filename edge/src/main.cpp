@@ -19,10 +19,11 @@ void setup() {
 
   delay(3000); // DEBUG: Wait a moment before starting the system
 
+  setupLog();
   setupSecurity();
   setupLora();
 
-  Serial.println("System ready!\n");
+  LOG(SYSTEM_READY);
 }
 
 /**
@@ -30,6 +31,10 @@ void setup() {
  * The bulk of the logic is managed by runSecurityLogic() and its AlarmState.
  */
 void loop() {
+  PROFILE_POLL_SERIAL();
+  loopLog();  // Non-blocking, writes a few bytes of the pending log records
+  loopLora(); // Non-blocking, keeps the LoRa module responsive between two runs of the security logic
+
   AlarmState currentAlarmState = getAlarmState();
 
   // Print time and alarm state at regular intervals for debugging purposes
@@ -37,12 +42,14 @@ void loop() {
   if (millis() - lastTimePrint > PRINT_TIME_INTERVAL) {
     // loraSendMotionState(isAlarmActive);
     lastTimePrint = millis();
-    Serial.println(getTimeString() + " - Alarm state: " + alarmStateToString(currentAlarmState));
+    LOG(TIME_STATE, getCurrentUnixTime(), currentAlarmState);
   }
 #endif // PRINT_TIME_IN_LOOP
 
   if (millis() - lastSecurityLogicTime > SECURITY_LOGIC_TIME_INTERVAL) {
     lastSecurityLogicTime = millis();
+    PROFILE_TICK_START(getAlarmState(), SECURITY_LOGIC_TIME_INTERVAL);
     runSecurityLogic();
+    PROFILE_TICK_END();
   }
 }
@@ -7,6 +7,7 @@ void setupMotion() {
 }
 
 bool checkMotion() {
+  PROFILE_STEP(ProfileStep::MOTION);
   int state = digitalRead(pinPir);
 
   if (state == HIGH) {
@@ -30,6 +30,7 @@ String getTimeString() {
  * @return true if the current time is within a monitoring range, false otherwise.
  */
 bool isMonitoringTime() {
+  PROFILE_STEP(ProfileStep::RULE_CHECK);
   return timeRangeChecker.isMonitoringTime(rtc);
 }
 
@@ -19,6 +19,7 @@ void startSuccessAnimation() {
  * Make sure to call startSuccessAnimation() before to initialize the animation variables.
  */
 void playSuccessAnimation(TM1637& display, ChainableLED& leds, std::array<int, 4> currentCombination) {
+  PROFILE_STEP(ProfileStep::DISPLAY);
   if (successAnimationStep < SUCCESS_ANIMATION_STEPS) {
     if (millis() - lastSuccessAnimationTime > SUCCESS_ANIMATION_DELAY) {
       successAnimationStep++;
@@ -42,6 +43,7 @@ void playSuccessAnimation(TM1637& display, ChainableLED& leds, std::array<int, 4
  * This is called when the wrong combination is entered.
  */
 void playErrorAnimation(TM1637& display, ChainableLED& leds) {
+  PROFILE_STEP(ProfileStep::DISPLAY);
   for (int i = 0; i < 4; i++) {
     display.display(0, 'E');
     display.display(1, 'r');
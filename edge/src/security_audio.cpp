@@ -6,12 +6,14 @@
 #define ALARM_SOUND_DURATION 2 * 1000 // Duration of the alarm sound in milliseconds
 
 void playPressBeep(int buzzerPin) {
+  PROFILE_STEP(ProfileStep::AUDIO);
 #ifdef USE_SOUND
   tone(buzzerPin, 2500, 30);
 #endif
 }
 
 void playGoodCombinationSound(int buzzerPin) {
+  PROFILE_STEP(ProfileStep::AUDIO);
 #ifdef USE_SOUND
   tone(buzzerPin, 1000, 100);
   delay(100);
@@ -21,6 +23,7 @@ void playGoodCombinationSound(int buzzerPin) {
 }
 
 void playWrongCombinationSound(int buzzerPin) {
+  PROFILE_STEP(ProfileStep::AUDIO);
 #ifdef USE_SOUND
   tone(buzzerPin, 150, 400);
   delay(400);
@@ -28,18 +31,21 @@ void playWrongCombinationSound(int buzzerPin) {
 }
 
 void playMotionSound(int buzzerPin) {
+  PROFILE_STEP(ProfileStep::AUDIO);
 #if defined(USE_SOUND)
   tone(buzzerPin, 100, 600);
 #endif
 }
 
 void playAlarmSound(int buzzerPin) {
+  PROFILE_STEP(ProfileStep::AUDIO);
 #if defined(USE_SOUND) && defined(ALARM_SOUND)
   tone(buzzerPin, 600, ALARM_SOUND_DURATION);
 #endif
 }
 
 void playAlarmTimeoutSound(int buzzerPin) {
+  PROFILE_STEP(ProfileStep::AUDIO);
 #if defined(USE_SOUND)
   tone(buzzerPin, 349, 200);
   delay(200);
@@ -39,8 +39,6 @@ int       tries     = 0; // Current number of tries
 
 AlarmState alarmState = AlarmState::INACTIVE; // Current state of the alarm system
 
-#define HEARTBEAT_TIME_INTERVAL 8 * 1000     // Interval for the LoRaWAN heartbeat in milliseconds
-unsigned long lastTimeHeartbeat         = 0; // Time when the last heartbeat was sent
 unsigned long alarmStartTime            = 0; // Time when the alarm was first triggered
 unsigned long alarmSuccessfulDisarmTime = 0; // Time when the alarm was successfully disarmed
 
@@ -50,6 +48,8 @@ const unsigned long ALARM_TIMEOUT                   = 60 * 1000; // Maximum time
 
 int releasePin = -1; // Pin to check for release after button press, -1 if not waiting for any button release
 
+TransferReassembly timeRangeTransfer; // Fragments of a time range rule set received through SET_TIME_RANGE_FRAGMENT payloads
+
 void clearScreen();
 void updateScreen();
 void updateLedColor();
@@ -59,8 +59,11 @@ void checkCombination();
 void processLoraPayload(const LoraPayload& pkt);
 void setExpectedCombinationFromPacket(const LoraPayload& pkt);
 void setTimeRulesFromPacket(const LoraPayload& pkt);
+void setTimeRulesFromFragment(const LoraPayload& pkt);
+void applyStoredTimeRules(size_t ruleCount);
 void setAlarmStateFromPacket(const LoraPayload& pkt);
 void setRTCTimeFromPacket(const LoraPayload& pkt, bool forceUpdate = false);
+void setHeartbeatPolicyFromPacket(const LoraPayload& pkt);
 
 void setupSecurity() {
   pinMode(BUTTON_BLUE_PIN, INPUT_PULLUP);
@@ -83,34 +86,30 @@ void setupSecurity() {
   for (int i = 0; i < 4; i++) {
     int value = eepromData.secretCombination[i];
     if (value < 0 || value > 9) {
-      Serial.print("Error: Invalid secret combination digit retrieved from EEPROM at index ");
-      Serial.print(i);
-      Serial.print(": ");
-      Serial.println(expectedCombination[i]);
+      LOG(SETUP_INVALID_DIGIT, i, expectedCombination[i]);
       validEepromData = false;
       break;
     }
   }
   if (validEepromData && eepromData.timeRangeRulesCount == 0) {
-    Serial.print("Error: Invalid time range rules count retrieved from EEPROM: ");
-    Serial.println(eepromData.timeRangeRulesCount);
+    LOG(SETUP_INVALID_RULE_COUNT, eepromData.timeRangeRulesCount);
     validEepromData = false;
   }
 
   if (!validEepromData) {
-    Serial.println("Error: Invalid data retrieved from EEPROM. Switching to CONFIGURATION state.");
+    LOG(SETUP_INVALID_EEPROM);
     setupRTC(nullptr, 0); // Setup RTC with no time range rules, effectively disabling time-based monitoring until valid configuration is set
     setAlarmState(AlarmState::CONFIGURATION);
   } else { // Valid data retrieved from EEPROM, proceed with normal setup
     size_t         ruleCount = eepromData.timeRangeRulesCount;
     TimeRangeRule* rules     = new TimeRangeRule[ruleCount];
 
-    Serial.println("Secret combination retrieved from EEPROM: " + String(eepromData.secretCombination[0]) + String(eepromData.secretCombination[1]) + String(eepromData.secretCombination[2]) + String(eepromData.secretCombination[3]));
-    Serial.println("Number of time range rules retrieved from EEPROM: " + String(eepromData.timeRangeRulesCount));
+    LOG(SETUP_COMBINATION, eepromData.secretCombination[0], eepromData.secretCombination[1], eepromData.secretCombination[2], eepromData.secretCombination[3]);
+    LOG(SETUP_RULE_COUNT, eepromData.timeRangeRulesCount);
 
     retrieveTimeRangeRulesEEPROM(rules, ruleCount);
     for (size_t i = 0; i < ruleCount; i++) {
-      Serial.println("Time Range Rule " + String(i) + ": weekDayMask=" + String(rules[i].weekDayMask, BIN) + ", hourMask=" + String(rules[i].hourMask, BIN) + ", monthDayMask=" + String(rules[i].monthDayMask, BIN) + ", monthMask=" + String(rules[i].monthMask, BIN));
+      LOG(SETUP_RULE, i, rules[i].weekDayMask, rules[i].hourMask, rules[i].monthDayMask, rules[i].monthMask);
     }
 
     setupRTC(rules, ruleCount); // Setup RTC with the retrieved time range rules to enable time-based monitoring
@@ -137,9 +136,14 @@ AlarmState runSecurityLogic() {
     processLoraPayload(pkt);              // Process configuration updates
   }
 
-  // Send heartbeat message at regular intervals to indicate that the system is alive, with the current alarm state included in the payload data
-  if (millis() - lastTimeHeartbeat > HEARTBEAT_TIME_INTERVAL) {
-    lastTimeHeartbeat = millis();
+  // Report the missing fragments of a time range transfer once they stop coming in
+  TransferStatusBody transferStatus;
+  if (timeRangeTransfer.pollStatus(millis(), transferStatus)) {
+    loraSendTransferStatus(transferStatus);
+  }
+
+  // Send heartbeat message at adaptive intervals to indicate that the system is alive, with the current alarm state included in the payload data
+  if (isHeartbeatDue()) {
     loraSendHeartbeat(getAlarmState());
   }
 
@@ -151,7 +155,8 @@ AlarmState runSecurityLogic() {
     if (!isMonitoringTime()) {
       setAlarmState(AlarmState::INACTIVE);
     } else if (checkMotion()) { // Motion detected, trigger alarm
-      Serial.println("[MOTION] Motion detected, triggering alarm!");
+      LOG(MOTION_DETECTED);
+      loraSendMotionState(true);
       playMotionSound(BUZZER_PIN);
       setAlarmState(AlarmState::TRIGGERED);
       alarmStartTime = millis(); // Start the disarm timer
@@ -166,7 +171,7 @@ AlarmState runSecurityLogic() {
     }
 
     if (isWaitingForRelease()) {
-      Serial.println("Waiting for button release...");
+      LOG(WAITING_RELEASE);
       // If we're waiting for a button release, do not handle button presses or blinking effect
       return alarmState;
     }
@@ -185,14 +190,14 @@ AlarmState runSecurityLogic() {
     // Check if we should reset the system after a successful disarm
     if (millis() - alarmSuccessfulDisarmTime > ALARM_SUCCESSFUL_DISARM_TIMEOUT) {
       // Reset the system
-      Serial.println("Resetting system after successful disarm...");
+      LOG(RESET_AFTER_DISARM);
       setAlarmState(AlarmState::INACTIVE);
     }
   } else if (alarmState == AlarmState::FAILED_DISARM) {
     // Check if we should reset the system after alarm timeout
     if (millis() - alarmStartTime > ALARM_TIMEOUT) {
       // Reset the system
-      Serial.println("Resetting system after alarm timeout...");
+      LOG(RESET_AFTER_TIMEOUT);
       playAlarmTimeoutSound(BUZZER_PIN);
       setAlarmState(AlarmState::INACTIVE);
     }
@@ -204,35 +209,45 @@ AlarmState runSecurityLogic() {
 
 // --- LoraWAN PAYLOAD PROCESSING ---
 void processLoraPayload(const LoraPayload& pkt) {
+  PROFILE_STEP(ProfileStep::LORA_RX);
+
   // Update RTC (only force update if payload type is SET_RTC_TIME)
   bool forceTimeUpdate = pkt.type == PayloadType::SET_RTC_TIME;
   setRTCTimeFromPacket(pkt, forceTimeUpdate);
 
   if (pkt.type == PayloadType::SET_COMBINATION) {
-    Serial.println("[LoRa] Received SET_COMBINATION payload");
+    LOG(LORA_RX_SET_COMBINATION);
     setExpectedCombinationFromPacket(pkt);
   } else if (pkt.type == PayloadType::SET_TIME_RANGE) {
-    Serial.println("[LoRa] Received SET_TIME_RANGE payload");
+    LOG(LORA_RX_SET_TIME_RANGE);
     setTimeRulesFromPacket(pkt);
+  } else if (pkt.type == PayloadType::SET_TIME_RANGE_FRAGMENT) {
+    LOG(LORA_RX_SET_TIME_RANGE_FRAGMENT);
+    setTimeRulesFromFragment(pkt);
   } else if (pkt.type == PayloadType::SET_ALARM_STATE) {
-    Serial.println("[LoRa] Received SET_ALARM_STATE payload");
+    LOG(LORA_RX_SET_ALARM_STATE);
     setAlarmStateFromPacket(pkt);
+  } else if (pkt.type == PayloadType::SET_HEARTBEAT_POLICY) {
+    LOG(LORA_RX_SET_HEARTBEAT_POLICY);
+    setHeartbeatPolicyFromPacket(pkt);
+  } else if (pkt.type == PayloadType::RENEW_EPOCH) {
+    LOG(LORA_RX_RENEW_EPOCH);
+    renewLoraEpoch();
+    loraSendHeartbeat(alarmState); // Sent as a v1 frame, the new epoch
   } else if (pkt.type != PayloadType::SET_RTC_TIME) { // Unknown payload
-    Serial.println("[LoRa] Received unknown payload type from broker");
+    LOG(LORA_RX_UNKNOWN);
   }
 }
 
 void setExpectedCombinationFromPacket(const LoraPayload& pkt) {
-  if (pkt.length >= 4) { // Combination config: digit1, digit2, digit3, digit4
+  CombinationBody body;
+  if (decodePayload<PayloadType::SET_COMBINATION>(pkt, body)) { // Combination config: digit1, digit2, digit3, digit4
     std::array<int, 4> newCombination;
     bool               validCombination = true;
     for (int i = 0; i < 4; i++) {
-      newCombination[i] = pkt.data[i];
+      newCombination[i] = body.digits[i];
       if (newCombination[i] < 0 || newCombination[i] > 9) {
-        Serial.print("[PSWD] Error: Invalid combination digit received in LoRa configuration payload at index ");
-        Serial.print(i);
-        Serial.print(": ");
-        Serial.println(newCombination[i]);
+        LOG(PSWD_INVALID_DIGIT, i, newCombination[i]);
         validCombination = false;
         break;
       }
@@ -241,45 +256,116 @@ void setExpectedCombinationFromPacket(const LoraPayload& pkt) {
       storeSecretCombinationEEPROM(newCombination);
       expectedCombination = newCombination;
       // TODO: Remove in production environment for security
-      Serial.println("[PSWD] Secret combination updated via LoRaWAN to: " + String(expectedCombination[0]) + String(expectedCombination[1]) + String(expectedCombination[2]) + String(expectedCombination[3]));
+      LOG(PSWD_UPDATED, expectedCombination[0], expectedCombination[1], expectedCombination[2], expectedCombination[3]);
     }
   }
 }
 
+static_assert(BODY_WIRE_SIZE<PayloadType::SET_TIME_RANGE> == TIME_RANGE_RULE_BYTES, "Wire layout of time range rules must match the EEPROM layout");
+
 void setTimeRulesFromPacket(const LoraPayload& pkt) {
-  size_t ruleCount = (pkt.length - (pkt.length % TIME_RANGE_RULE_BYTES)) / TIME_RANGE_RULE_BYTES;
-  if (ruleCount * TIME_RANGE_RULE_BYTES > MAX_PAYLOAD_DATA_SIZE) {
-    Serial.println("[SET_RULES] Error: Rule count is higher than the maximum possible data size. Length (bytes)=" + String(ruleCount * TIME_RANGE_RULE_BYTES) + ", MAX_PAYLOAD_DATA_SIZE=" + String(MAX_PAYLOAD_DATA_SIZE));
-    return; // Do not set any rules
-  }
+  size_t ruleCount = payloadRecordCount<PayloadType::SET_TIME_RANGE>(pkt);
   if (ruleCount == 0 || pkt.length % TIME_RANGE_RULE_BYTES != 0) {
-    Serial.println("[SET_RULES] Warning: Payload length is not a multiple of TimeRangeRule size. Length=" + String(pkt.length) + ", TIME_RANGE_RULE_BYTES=" + String(TIME_RANGE_RULE_BYTES));
+    LOG(SET_RULES_BAD_LENGTH, pkt.length, TIME_RANGE_RULE_BYTES);
   }
 
   TimeRangeRule rules[ruleCount];
   for (size_t i = 0; i < ruleCount; i++) {
-    TimeRangeRule rule = {
-        .weekDayMask  = pkt.data[i * TIME_RANGE_RULE_BYTES],
-        .hourMask     = (pkt.data[i * TIME_RANGE_RULE_BYTES + 1] << 24) | (pkt.data[i * TIME_RANGE_RULE_BYTES + 2] << 16) | (pkt.data[i * TIME_RANGE_RULE_BYTES + 3] << 8) | pkt.data[i * TIME_RANGE_RULE_BYTES + 4],
-        .monthDayMask = (pkt.data[i * TIME_RANGE_RULE_BYTES + 5] << 24) | (pkt.data[i * TIME_RANGE_RULE_BYTES + 6] << 16) | (pkt.data[i * TIME_RANGE_RULE_BYTES + 7] << 8) | pkt.data[i * TIME_RANGE_RULE_BYTES + 8],
-        .monthMask    = (pkt.data[i * TIME_RANGE_RULE_BYTES + 9] << 8) | pkt.data[i * TIME_RANGE_RULE_BYTES + 10],
+    TimeRangeRuleRecord record;
+    decodePayloadRecord<PayloadType::SET_TIME_RANGE>(pkt, i, record);
+
+    rules[i] = {
+        .weekDayMask  = record.weekDayMask,
+        .hourMask     = record.hourMask,
+        .monthDayMask = record.monthDayMask,
+        .monthMask    = record.monthMask,
     };
+  }
 
-    rules[i] = rule;
+  // The rules go to the bank holding the fragments of a transfer in progress: the gateway must start it over
+  TransferStatusBody transferStatus;
+  if (timeRangeTransfer.abandon(transferStatus)) {
+    LOG(SET_RULES_TRANSFER_ABANDONED, transferStatus.transferId);
+    loraSendTransferStatus(transferStatus);
   }
 
   storeTimeRangeRulesEEPROM(rules, ruleCount);
   setTimeRangeRules(rules, ruleCount);
 }
 
+/**
+ * Stage the rules of a fragment of a time range transfer in EEPROM. Once every fragment is received, the new rule set
+ * is committed and applied, the previous rules stay in use until then.
+ * @param pkt A SET_TIME_RANGE_FRAGMENT payload.
+ */
+void setTimeRulesFromFragment(const LoraPayload& pkt) {
+  TimeRangeFragmentHeader header;
+  if (!decodePayload<PayloadType::SET_TIME_RANGE_FRAGMENT>(pkt, header)) return;
+
+  size_t                     rulesInFragment = fragmentRuleCount(pkt);
+  TransferReassembly::Result result          = timeRangeTransfer.accept(header, rulesInFragment, millis());
+  if (result == TransferReassembly::Result::INVALID) {
+    LOG(SET_RULES_BAD_FRAGMENT, header.fragmentIndex, header.fragmentCount, header.transferId, header.ruleCount);
+    return;
+  }
+  if (result == TransferReassembly::Result::COMMITTED) { // The gateway missed the final status
+    loraSendTransferStatus(timeRangeTransfer.committedStatus());
+    return;
+  }
+  if (result == TransferReassembly::Result::DUPLICATE) return;
+
+  size_t firstRule = (size_t)header.fragmentIndex * TRANSFER_RULES_PER_FRAGMENT;
+  for (size_t i = 0; i < rulesInFragment; i++) {
+    TimeRangeRuleRecord record;
+    decodeFragmentRule(pkt, i, record);
+
+    TimeRangeRule rule = {
+        .weekDayMask  = record.weekDayMask,
+        .hourMask     = record.hourMask,
+        .monthDayMask = record.monthDayMask,
+        .monthMask    = record.monthMask,
+    };
+    stageTimeRangeRuleEEPROM(firstRule + i, rule);
+  }
+
+  if (result == TransferReassembly::Result::COMPLETE) {
+    commitTimeRangeRulesEEPROM(header.ruleCount);
+    applyStoredTimeRules(header.ruleCount);
+    loraSendTransferStatus(timeRangeTransfer.committedStatus());
+    LOG(SET_RULES_UPDATED, header.ruleCount, header.transferId);
+  }
+}
+
+/**
+ * Load the time range rules in use from EEPROM into the RTC time range checker.
+ * @param ruleCount The number of rules committed in EEPROM.
+ */
+void applyStoredTimeRules(size_t ruleCount) {
+  TimeRangeRule* rules = new TimeRangeRule[ruleCount];
+  retrieveTimeRangeRulesEEPROM(rules, ruleCount);
+  setTimeRangeRules(rules, ruleCount);
+  delete[] rules;
+}
+
 void setAlarmStateFromPacket(const LoraPayload& pkt) {
-  if (pkt.length >= 1) {
-    if (auto newState = parseAlarmState(pkt.data[0])) {
+  AlarmStateBody body;
+  if (decodePayload<PayloadType::SET_ALARM_STATE>(pkt, body)) {
+    if (auto newState = parseAlarmState(body.alarmState)) {
       setAlarmState(*newState);
-      Serial.println("[SET_STATE] Alarm state updated via LoRaWAN");
+      LOG(SET_STATE_UPDATED);
     } else {
-      Serial.print("[SET_STATE] Error: Invalid alarm state received: ");
-      Serial.println(pkt.data[0]);
+      LOG(SET_STATE_INVALID, body.alarmState);
+    }
+  }
+}
+
+void setHeartbeatPolicyFromPacket(const LoraPayload& pkt) {
+  HeartbeatPolicyBody body;
+  if (decodePayload<PayloadType::SET_HEARTBEAT_POLICY>(pkt, body)) {
+    if (setHeartbeatPolicy(body)) {
+      LOG(HEARTBEAT_POLICY_UPDATED);
+    } else {
+      LOG(HEARTBEAT_POLICY_INVALID, body.minInterval, body.maxInterval, body.jitterPercent);
     }
   }
 }
@@ -293,21 +379,24 @@ void setRTCTimeFromPacket(const LoraPayload& pkt, bool forceUpdate) {
   if (pkt.ts > MINIMUM_UNIX_TIME && pkt.ts < MAXIMUM_UNIX_TIME) {
     uint32_t rtcUnixTime = getCurrentUnixTime();
     if (forceUpdate || pkt.ts < rtcUnixTime - MAX_TIME_DELAY || pkt.ts > rtcUnixTime + MAX_TIME_DELAY) {
-      Serial.println("[SET_RTC] Updating RTC time from payload");
-      String   oldTimeString = getTimeString();
-      uint32_t oldTimeUnix   = getCurrentUnixTime();
+      LOG(SET_RTC_UPDATING);
+      uint32_t oldTimeUnix = getCurrentUnixTime();
 
       setCurrentUnixTime(pkt.ts);
       delay(50);
 
-      uint32_t timeDifference = abs((int64_t)(getCurrentUnixTime()) - oldTimeUnix);
-      Serial.println("Time difference: " + String(timeDifference) + " seconds (" + oldTimeString + " -> " + getTimeString() + ")");
+      uint32_t newTimeUnix = getCurrentUnixTime();
+      int32_t  correction  = (int32_t)((int64_t)newTimeUnix - oldTimeUnix);
+      loraSendRtcCorrection(correction);
+      LOG(SET_RTC_CORRECTED, correction, oldTimeUnix, newTimeUnix);
     }
   }
 }
 
 // --- HANDLING BUTTONS ---
 void handleButtons() {
+  PROFILE_STEP(ProfileStep::BUTTONS);
+
   // Button + / Up (Blue)
   if (digitalRead(BUTTON_BLUE_PIN) == LOW) {
     playPressBeep(BUZZER_PIN);
@@ -351,6 +440,7 @@ void handleButtons() {
 
 // --- DISPLAYING ---
 void clearScreen() {
+  PROFILE_STEP(ProfileStep::DISPLAY);
   tm1637.clearDisplay();
 }
 
@@ -359,6 +449,7 @@ void clearScreen() {
  * If numberLightBlink is false, display nothing (blank) for the current digit to create the blinking effect.
  */
 void updateScreen() {
+  PROFILE_STEP(ProfileStep::DISPLAY);
   if (alarmState == AlarmState::TRIGGERED) {
     for (int i = 0; i < 4; i++) {
       if (i == cursorPosition && numberLightBlink) {
@@ -398,9 +489,10 @@ void checkCombination() {
   } else {
     currentCombination = {0, 0, 0, 0};
     tries++;
-    Serial.println("WRONG CODE - Attempt " + String(tries) + " of " + String(MAX_TRIES));
+    LOG(WRONG_CODE, tries, MAX_TRIES);
+    loraSendWrongCode(tries, MAX_TRIES);
     if (tries >= MAX_TRIES) { // Final attempt failed, trigger alarm
-      Serial.println("DISARMING FAILED - TOO MANY ATTEMPTS");
+      LOG(DISARM_FAILED);
       setAlarmState(AlarmState::FAILED_DISARM);
     } else { // Not the final attempt
       playWrongCombinationSound(BUZZER_PIN);
@@ -426,6 +518,7 @@ bool isWaitingForRelease() {
  * This function is called whenever the alarm state changes to reflect the new state with the appropriate LED color.
  */
 void updateLedColor() {
+  PROFILE_STEP(ProfileStep::DISPLAY);
   if (alarmState == AlarmState::INACTIVE) {
     leds.setColorHSB(0, 0, LED_SATURATION, LED_BRIGHTNESS_INACTIVE); // Inactive state, LED off
   } else {
@@ -459,12 +552,10 @@ void setAlarmState(AlarmState newState) {
 
   AlarmState previousState = alarmState; // Temporarily store the previous state
   alarmState               = newState;   // Update state
-  Serial.print("Alarm state changed: ");
-  Serial.println(alarmStateToString(previousState) + " -> " + alarmStateToString(alarmState));
+  LOG(ALARM_STATE_CHANGED, previousState, alarmState);
 
-  // Send a heartbeat when the state changes
-  lastTimeHeartbeat = millis();
-  loraSendHeartbeat(newState);
+  // Send the new state at once, it supersedes the periodic heartbeat
+  loraSendAlarmState(newState);
 
   // Handle actions on state change
   if (alarmState == AlarmState::INACTIVE) {
@@ -538,21 +629,3 @@ std::optional<AlarmState> parseAlarmState(uint8_t raw) {
   default: return std::nullopt; // Invalid value
   }
 }
-
-/**
- * Convert a uint8_t potentially representing an PayloadType into its enum value or return nullopt
- * @param raw The raw uint8_t value to convert
- * @return PayloadType correspondig to the raw value or nullopt
- */
-std::optional<PayloadType> parsePayloadType(uint8_t raw) {
-  switch (raw) {
-  case 0x00: return PayloadType::UNKNOWN;
-  case 0x01: return PayloadType::EDGE_HEARTBEAT;
-  case 0x02: return PayloadType::MOTION_STATE;
-  case 0x11: return PayloadType::SET_COMBINATION;
-  case 0x12: return PayloadType::SET_TIME_RANGE;
-  case 0x13: return PayloadType::SET_ALARM_STATE;
-  case 0x14: return PayloadType::SET_RTC_TIME;
-  default:   return std::nullopt; // Invalid value
-  }
-}
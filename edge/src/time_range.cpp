@@ -1,8 +1,12 @@
 #include "time_range.h"
 
 TimeRangeChecker::TimeRangeChecker() {
-  timeRanges = nullptr;
-  rulesCount = 0;
+  timeRanges         = nullptr;
+  rulesCount         = 0;
+  calendarRulesCount = 0;
+  memset(weekHours, 0, sizeof(weekHours));
+  dayHours = 0;
+  dayKey   = 0;
 }
 
 // Destructor will never be called but it is still good practice to free unused memory
@@ -38,63 +42,49 @@ bool TimeRangeChecker::isTimeInRange(const TimeRangeRule& timeRule, const TimeRa
 }
 
 bool TimeRangeChecker::isMonitoringTime(iarduino_RTC& rtc) {
-  TimeRangeRule currentTimeAsRange;
-  uint16_t      weekDay  = rtc.weekday;
-  uint16_t      hour     = rtc.Hours;
-  uint16_t      monthDay = rtc.day;
-  uint16_t      month    = rtc.month;
-
-#ifdef DEBUG
-  Serial.print("[TIME_RULES] Weekday=");
-  Serial.print(weekDay);
-  Serial.print(", Hour=");
-  Serial.print(hour);
-  Serial.print(", Day=");
-  Serial.print(monthDay);
-  Serial.print(", Month=");
-  Serial.print(month);
-  Serial.print(", Hour=");
-  Serial.print(hour);
-#endif // DEBUG
+  uint16_t weekDay  = rtc.weekday;
+  uint16_t hour     = rtc.Hours;
+  uint16_t monthDay = rtc.day;
+  uint16_t month    = rtc.month;
+
+  LOG(TIME_RULES_RTC, weekDay, hour, monthDay, month);
 
   if (weekDay > 6 || hour > 23 || monthDay == 0 || monthDay > 31 || month == 0 || month > 12) {
-    Serial.print("[TIME_RULES] Invalid time values from RTC: weekday=" + String(weekDay));
-    Serial.print(", hour=" + String(hour));
-    Serial.print(", day=" + String(monthDay));
-    Serial.println(", month=" + String(month));
+    LOG(TIME_RULES_INVALID_RTC, weekDay, hour, monthDay, month);
 
     return false;
   }
 
+  return isMonitoringTime(weekDay, hour, monthDay, month);
+}
+
+bool TimeRangeChecker::isMonitoringTime(uint8_t weekDay, uint8_t hour, uint8_t monthDay, uint8_t month) {
+  uint16_t key = weekDay << 9 | monthDay << 4 | month; // Never 0, as month is 1-12
+  if (key != dayKey) {
+    uint8_t  weekDayMask  = 1 << (7 - 1 - weekDay);
+    uint32_t monthDayMask = 1UL << (31 - monthDay);
+    uint16_t monthMask    = 1 << (12 - month);
+
+    dayHours = weekHours[weekDay];
+    for (size_t i = 0; i < calendarRulesCount; ++i) {
+      const TimeRangeRule& rule = timeRanges[i];
+      if ((rule.weekDayMask & weekDayMask) && (rule.monthDayMask & monthDayMask) && (rule.monthMask & monthMask)) {
+        dayHours |= rule.hourMask;
+      }
+    }
+    dayKey = key;
+  }
+  return (dayHours & (1UL << (24 - 1 - hour))) != 0;
+}
+
+bool TimeRangeChecker::isMonitoringTimeLinear(uint8_t weekDay, uint8_t hour, uint8_t monthDay, uint8_t month) {
+  TimeRangeRule currentTimeAsRange;
   currentTimeAsRange.weekDayMask  = 1 << (7 - 1 - weekDay); // Get weekday (0-6) and convert to bitmask
   currentTimeAsRange.hourMask     = 1 << (24 - 1 - hour);   // Get hour (0-23) and convert to bitmask
   currentTimeAsRange.monthDayMask = 1 << (31 - monthDay);   // Get day of month (1-31) and convert to bitmask
   currentTimeAsRange.monthMask    = 1 << (12 - month);      // Get month (1-12) and convert to bitmask
 
-#ifdef DEBUG
-  Serial.print("[TIME_RULES] Current time: ");
-  Serial.print(rtc.gettime("d-m-Y, H:i:s, D"));
-
-  Serial.print(" Current time as range: ");
-  Serial.print("D=");
-  Serial.print(weekDay);
-  Serial.print(", H=");
-  Serial.print(hour);
-  Serial.print(", d=");
-  Serial.print(monthDay);
-  Serial.print(", m=");
-  Serial.print(month);
-
-  Serial.print(", MASKS Weekday: ");
-  Serial.print(currentTimeAsRange.weekDayMask, BIN);
-  Serial.print(", Hour: ");
-  Serial.print(currentTimeAsRange.hourMask, BIN);
-  Serial.print(", Day: ");
-  Serial.print(currentTimeAsRange.monthDayMask, BIN);
-  Serial.print(", Month: ");
-  Serial.print(currentTimeAsRange.monthMask, BIN);
-  Serial.println();
-#endif // DEBUG
+  LOG(TIME_RULES_MASKS, currentTimeAsRange.weekDayMask, currentTimeAsRange.hourMask, currentTimeAsRange.monthDayMask, currentTimeAsRange.monthMask);
 
   for (size_t i = 0; i < rulesCount; ++i) {
     if (isTimeInRange(timeRanges[i], currentTimeAsRange)) {
@@ -106,29 +96,51 @@ bool TimeRangeChecker::isMonitoringTime(iarduino_RTC& rtc) {
 
 /**
  * Sets the time range rules to be used for monitoring.
- * The provided rules are copied into the TimeRangeChecker instance.
+ * The provided rules are copied into the TimeRangeChecker instance, and the weekly ones are merged into the week/hour
+ * bitmap.
  * @param rules An array of TimeRangeRule structures defining the time ranges for monitoring.
  * @param ruleCount The number of rules in the provided array.
  * @note Allows null data to remove all existing time range rules, effectively disabling time-based monitoring.
  */
 void TimeRangeChecker::setTimeRanges(const TimeRangeRule* rules, size_t ruleCount) {
+  memset(weekHours, 0, sizeof(weekHours));
+  dayKey = 0; // The hours of the current day are checked again
+
   if (rules == nullptr || ruleCount == 0) {
-    Serial.println("[TIME_RULES] No time range rules provided. Monitoring will be disabled.");
-    rulesCount = 0;
+    LOG(TIME_RULES_NONE);
+    rulesCount         = 0;
+    calendarRulesCount = 0;
     delete[] timeRanges; // Free any existing rules
     timeRanges = nullptr;
     return;
   }
 
   if (ruleCount > 255) {
-    Serial.println("[TIME_RULES] Error: Cannot set more than 255 time range rules. Only the first 255 rules will be used. Provided ruleCount: " + String(ruleCount));
+    LOG(TIME_RULES_TOO_MANY, ruleCount);
     ruleCount = 255; // Adjust to maximum allowed
   }
 
   delete[] timeRanges; // Clear previous rules
   timeRanges = new TimeRangeRule[ruleCount];
+
+  // The rules that are not weekly are copied first, the weekly ones from the end
+  size_t calendarIndex = 0;
+  size_t weeklyIndex   = ruleCount;
   for (size_t i = 0; i < ruleCount; ++i) {
-    timeRanges[i] = rules[i];
+    const TimeRangeRule& rule   = rules[i];
+    bool                 weekly = (rule.monthDayMask & TIME_RANGE_WEEKLY_MONTH_DAYS) == TIME_RANGE_WEEKLY_MONTH_DAYS && (rule.monthMask & TIME_RANGE_WEEKLY_MONTHS) == TIME_RANGE_WEEKLY_MONTHS;
+    if (!weekly) {
+      timeRanges[calendarIndex++] = rule;
+      continue;
+    }
+
+    timeRanges[--weeklyIndex] = rule;
+    for (uint8_t weekDay = 0; weekDay < 7; ++weekDay) {
+      if (rule.weekDayMask & (1 << (7 - 1 - weekDay))) {
+        weekHours[weekDay] |= rule.hourMask;
+      }
+    }
   }
-  rulesCount = ruleCount;
+  rulesCount         = ruleCount;
+  calendarRulesCount = calendarIndex;
 }
@@ -0,0 +1,202 @@
+#include <lora_frame_decoder.h>
+#include <lora_mac.h>
+#include <string>
+#include <unity.h>
+
+#define RX_LINE(hex) (std::string(LORA_RX_PREFIX) + (hex) + "\"")
+
+static const LoraMacKey KEY = loraMacKeyFromBytes(LORA_DEFAULT_MAC_KEY);
+
+static LoraFrameDecoder decoder;
+
+void setUp() {
+  decoder.reset();
+}
+
+void tearDown() {}
+
+static LoraPayload alarmStatePayload() {
+  LoraPayload pkt = {};
+  pkt.id          = 1;
+  pkt.counter     = 42;
+  pkt.ts          = 1790000000;
+  encodePayload<PayloadType::SET_ALARM_STATE>({.alarmState = 1}, pkt);
+  pkt.hmac = computeFrameMac(KEY, LoraDirection::DOWNLINK, pkt);
+  return pkt;
+}
+
+/**
+ * @return The largest downlink: a rule set filling the data field.
+ */
+static LoraPayload timeRangePayload() {
+  LoraPayload pkt = {};
+  pkt.id          = 1;
+  pkt.counter     = 0xDEADBEEF;
+  pkt.ts          = 1790000000;
+  while (pkt.length + BODY_WIRE_SIZE<PayloadType::SET_TIME_RANGE> <= MAX_PAYLOAD_DATA_SIZE) {
+    uint8_t index = pkt.length / BODY_WIRE_SIZE<PayloadType::SET_TIME_RANGE>;
+    appendPayloadRecord<PayloadType::SET_TIME_RANGE>({.weekDayMask = index, .hourMask = 0x00FFFF00u + index, .monthDayMask = 0x7FFFFFFF, .monthMask = 0x0FFF}, pkt);
+  }
+  pkt.hmac = computeFrameMac(KEY, LoraDirection::DOWNLINK, pkt);
+  return pkt;
+}
+
+static std::string toHex(const LoraPayload& pkt) {
+  uint8_t frame[LORA_FRAME_MAX_BYTES];
+  char    hex[LORA_FRAME_MAX_BYTES * 2 + 1];
+  return std::string(hex, bytesToHex(frame, writeFrame(pkt, frame), hex));
+}
+
+/**
+ * Feed characters one by one, as they come out of the UART.
+ * @return The last result that is not PENDING, or PENDING if there is none.
+ */
+static LoraFrameDecoder::Result feedChars(const std::string& chars) {
+  LoraFrameDecoder::Result last = LoraFrameDecoder::Result::PENDING;
+  for (char c : chars) {
+    LoraFrameDecoder::Result result = decoder.feed(c);
+    if (result != LoraFrameDecoder::Result::PENDING) last = result;
+  }
+  return last;
+}
+
+static LoraFrameDecoder::Result decodeHex(const std::string& hex) {
+  return decoder.decodeHex(hex.data(), hex.size());
+}
+
+static void assertDecoded(const LoraPayload& expected) {
+  const LoraPayload& actual = decoder.payload();
+  TEST_ASSERT_EQUAL_UINT8(expected.id, actual.id);
+  TEST_ASSERT_EQUAL_UINT32(expected.counter, actual.counter);
+  TEST_ASSERT_EQUAL_UINT32(expected.ts, actual.ts);
+  TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(expected.type), static_cast<uint8_t>(actual.type));
+  TEST_ASSERT_EQUAL_UINT8(expected.length, actual.length);
+  TEST_ASSERT_EQUAL_MEMORY(expected.data, actual.data, expected.length);
+  TEST_ASSERT_EQUAL_HEX32(expected.hmac, actual.hmac);
+}
+
+static void test_round_trip() {
+  const LoraPayload payloads[] = {alarmStatePayload(), timeRangePayload()};
+  for (const LoraPayload& pkt : payloads) {
+    TEST_ASSERT_EQUAL(LoraFrameDecoder::Result::FRAME, decodeHex(toHex(pkt)));
+    assertDecoded(pkt);
+    TEST_ASSERT_TRUE(verifyFrameMac(KEY, LoraDirection::DOWNLINK, decoder.payload()));
+
+    decoder.reset();
+    TEST_ASSERT_EQUAL(LoraFrameDecoder::Result::FRAME, feedChars(RX_LINE(toHex(pkt)) + "\r\n"));
+    assertDecoded(pkt);
+  }
+}
+
+static void test_empty_data_and_lowercase_hex() {
+  LoraPayload pkt = alarmStatePayload();
+  pkt.type        = PayloadType::SET_RTC_TIME;
+  pkt.length      = 0;
+  std::string hex = toHex(pkt);
+  for (char& c : hex) {
+    c = tolower(c);
+  }
+  TEST_ASSERT_EQUAL(LoraFrameDecoder::Result::FRAME, decodeHex(hex));
+  assertDecoded(pkt);
+}
+
+static void test_frame_is_reported_at_the_closing_quote() {
+  std::string line = RX_LINE(toHex(alarmStatePayload()));
+  TEST_ASSERT_EQUAL(LoraFrameDecoder::Result::PENDING, feedChars(line.substr(0, line.size() - 1)));
+  TEST_ASSERT_EQUAL(LoraFrameDecoder::Result::FRAME, decoder.feed('"'));
+  // The rest of the line, e.g. the RSSI printed after the payload by some firmwares, is ignored
+  TEST_ASSERT_EQUAL(LoraFrameDecoder::Result::PENDING, feedChars(" 1A\r\n"));
+}
+
+static void test_whitespace_before_the_prefix() {
+  TEST_ASSERT_EQUAL(LoraFrameDecoder::Result::FRAME, feedChars("\r  " + RX_LINE(toHex(alarmStatePayload()))));
+  assertDecoded(alarmStatePayload());
+}
+
+static void test_other_lines_are_skipped() {
+  std::string hex      = toHex(alarmStatePayload());
+  const char* others[] = {
+      "+TEST: LEN:16, RSSI:-42, SNR:9\r\n",
+      "+TEST: TXLRPKT \"0102\"\r\n",
+      "+TEST: RX 0102\r\n",
+      "+test: rx \"0102\"\r\n",
+      "+TEST: RXLRPKT\r\n",
+      "\r\n",
+  };
+  for (const char* other : others) {
+    TEST_ASSERT_EQUAL(LoraFrameDecoder::Result::PENDING, feedChars(other));
+  }
+  TEST_ASSERT_EQUAL(LoraFrameDecoder::Result::PENDING, feedChars("X" + RX_LINE(hex) + "\n"));
+
+  // A line cut by the UART does not leak into the next one
+  TEST_ASSERT_EQUAL(LoraFrameDecoder::Result::PENDING, feedChars(RX_LINE(hex).substr(0, 20) + "\n"));
+  TEST_ASSERT_EQUAL(LoraFrameDecoder::Result::FRAME, feedChars(RX_LINE(hex) + "\n"));
+}
+
+static void test_malformed_frames() {
+  std::string hex         = toHex(alarmStatePayload());
+  std::string badDigit    = hex;
+  std::string unknownType = hex;
+  std::string tooLong     = hex;
+  std::string shorter     = hex;
+  badDigit[5]             = 'G';
+  unknownType.replace(2 * 9, 2, "7F"); // Type field
+  tooLong.replace(2 * 10, 2, "C9");    // Length field, MAX_PAYLOAD_DATA_SIZE + 1
+  shorter.replace(2 * 10, 2, "00");    // Length field, the data byte is left over
+
+  const std::string malformed[] = {
+      "",
+      hex.substr(0, 2 * LORA_FRAME_HEADER_BYTES - 2), // Truncated header
+      hex.substr(0, hex.size() - 2),                  // Truncated hmac
+      hex.substr(0, hex.size() - 1),                  // Odd number of digits
+      hex + "00",                                     // More bytes than announced
+      badDigit,
+      unknownType,
+      tooLong,
+      shorter,
+      hex.substr(0, 8) + " " + hex.substr(8), // Space in the hex data
+  };
+  for (const std::string& frame : malformed) {
+    TEST_ASSERT_EQUAL(LoraFrameDecoder::Result::INVALID, decodeHex(frame));
+  }
+
+  // On a line, INVALID is reported once and the next line decodes again
+  decoder.reset();
+  TEST_ASSERT_EQUAL(LoraFrameDecoder::Result::INVALID, feedChars(RX_LINE(badDigit) + "\r\n"));
+  TEST_ASSERT_EQUAL(LoraFrameDecoder::Result::INVALID, feedChars(RX_LINE(hex + "00") + "\r\n"));
+  TEST_ASSERT_EQUAL(LoraFrameDecoder::Result::INVALID, feedChars(LORA_RX_PREFIX + hex + "\r\n")); // No closing quote
+  TEST_ASSERT_EQUAL(LoraFrameDecoder::Result::FRAME, feedChars(RX_LINE(hex)));
+}
+
+static void test_v2_frame_bytes_are_collected() {
+  LoraEpoch   epoch = {.ts = 1790000000, .ms = 0, .valid = true};
+  LoraPayload pkt   = {};
+  pkt.id            = 1;
+  pkt.counter       = 3;
+  pkt.ts            = epoch.ts;
+  encodePayload<PayloadType::MOTION_STATE>({.motion = 1}, pkt);
+
+  uint8_t frame[LORA_FRAME_MAX_BYTES];
+  char    hex[LORA_FRAME_MAX_BYTES * 2 + 1];
+  size_t  size = writeFrameV2(KEY, pkt, epoch, 0, frame);
+  bytesToHex(frame, size, hex);
+
+  TEST_ASSERT_EQUAL(LoraFrameDecoder::Result::FRAME_V2, feedChars(RX_LINE(hex)));
+  TEST_ASSERT_EQUAL(size, decoder.frameV2Size());
+  TEST_ASSERT_EQUAL_MEMORY(frame, decoder.frameV2(), size);
+
+  // Shorter than the header and the hmac of a v2 frame
+  TEST_ASSERT_EQUAL(LoraFrameDecoder::Result::INVALID, decodeHex(std::string(hex).substr(0, 2 * (LORA_V2_HEADER_BYTES + LORA_FRAME_HMAC_BYTES) - 2)));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_round_trip);
+  RUN_TEST(test_empty_data_and_lowercase_hex);
+  RUN_TEST(test_frame_is_reported_at_the_closing_quote);
+  RUN_TEST(test_whitespace_before_the_prefix);
+  RUN_TEST(test_other_lines_are_skipped);
+  RUN_TEST(test_malformed_frames);
+  RUN_TEST(test_v2_frame_bytes_are_collected);
+  return UNITY_END();
+}
@@ -0,0 +1,119 @@
+#include "lora_outbox.h"
+#include <unity.h>
+
+static LoraOutbox outbox;
+
+void setUp() {
+  outbox = LoraOutbox();
+}
+
+void tearDown() {}
+
+/**
+ * @return An event batch, a payload that is never coalesced, told apart by its timestamp.
+ */
+static LoraPayload batchPayload(uint32_t ts) {
+  LoraPayload pkt = {};
+  pkt.id          = 1;
+  pkt.ts          = ts;
+  pkt.type        = PayloadType::EVENT_BATCH;
+  return pkt;
+}
+
+static LoraPayload heartbeatPayload(uint32_t ts, uint8_t alarmState) {
+  LoraPayload pkt = {};
+  pkt.id          = 1;
+  pkt.ts          = ts;
+  encodePayload<PayloadType::EDGE_HEARTBEAT>({.alarmState = alarmState, .airtimeUsage = 0, .nextHeartbeat = 600}, pkt);
+  return pkt;
+}
+
+static void test_empty_outbox() {
+  OutboxPriority priority;
+  LoraPayload    pkt;
+  TEST_ASSERT_EQUAL(0, outbox.size());
+  TEST_ASSERT_NULL(outbox.peek(priority));
+  TEST_ASSERT_FALSE(outbox.pop(pkt));
+}
+
+static void test_priority_then_fifo() {
+  TEST_ASSERT_TRUE(outbox.push(batchPayload(1), OutboxPriority::TELEMETRY));
+  TEST_ASSERT_TRUE(outbox.push(batchPayload(2), OutboxPriority::STATE_CHANGE));
+  TEST_ASSERT_TRUE(outbox.push(batchPayload(3), OutboxPriority::TELEMETRY));
+  TEST_ASSERT_TRUE(outbox.push(batchPayload(4), OutboxPriority::ALARM));
+  TEST_ASSERT_TRUE(outbox.push(batchPayload(5), OutboxPriority::STATE_CHANGE));
+
+  OutboxPriority priority;
+  TEST_ASSERT_NOT_NULL(outbox.peek(priority));
+  TEST_ASSERT_EQUAL(OutboxPriority::ALARM, priority);
+
+  const uint32_t expected[] = {4, 2, 5, 1, 3};
+  LoraPayload    pkt;
+  for (uint32_t ts : expected) {
+    TEST_ASSERT_TRUE(outbox.pop(pkt));
+    TEST_ASSERT_EQUAL_UINT32(ts, pkt.ts);
+  }
+  TEST_ASSERT_FALSE(outbox.pop(pkt));
+}
+
+static void test_state_payload_is_replaced() {
+  TEST_ASSERT_TRUE(outbox.push(batchPayload(1), OutboxPriority::HEARTBEAT));
+  TEST_ASSERT_TRUE(outbox.push(heartbeatPayload(2, 0), OutboxPriority::HEARTBEAT));
+  TEST_ASSERT_TRUE(outbox.push(heartbeatPayload(3, 1), OutboxPriority::STATE_CHANGE));
+  TEST_ASSERT_EQUAL(2, outbox.size());
+
+  // The newer heartbeat took the place of the older one, with the highest priority of both
+  LoraPayload   pkt;
+  HeartbeatBody heartbeat;
+  TEST_ASSERT_TRUE(outbox.pop(pkt));
+  TEST_ASSERT_EQUAL_UINT32(3, pkt.ts);
+  TEST_ASSERT_TRUE(decodePayload<PayloadType::EDGE_HEARTBEAT>(pkt, heartbeat));
+  TEST_ASSERT_EQUAL_UINT8(1, heartbeat.alarmState);
+  TEST_ASSERT_TRUE(outbox.pop(pkt));
+  TEST_ASSERT_EQUAL_UINT32(1, pkt.ts);
+}
+
+static void test_full_outbox_evicts_newest_lowest_priority() {
+  for (uint32_t ts = 1; ts <= LORA_OUTBOX_SIZE; ts++) {
+    TEST_ASSERT_TRUE(outbox.push(batchPayload(ts), ts <= 2 ? OutboxPriority::HEARTBEAT : OutboxPriority::TELEMETRY));
+  }
+
+  // Same priority as the lowest queued one: dropped
+  TEST_ASSERT_FALSE(outbox.push(batchPayload(10), OutboxPriority::TELEMETRY));
+  // Higher priority: the newest telemetry payload makes room for it
+  TEST_ASSERT_TRUE(outbox.push(batchPayload(11), OutboxPriority::ALARM));
+  TEST_ASSERT_EQUAL(LORA_OUTBOX_SIZE, outbox.size());
+
+  const uint32_t expected[] = {11, 1, 2, 3, 4, 5};
+  LoraPayload    pkt;
+  for (uint32_t ts : expected) {
+    TEST_ASSERT_TRUE(outbox.pop(pkt));
+    TEST_ASSERT_EQUAL_UINT32(ts, pkt.ts);
+  }
+}
+
+static void test_fifo_across_order_wrap_around() {
+  LoraPayload pkt;
+  for (uint32_t i = 0; i < 0xFFFF; i++) { // Brings the arrival order right below its wrap-around
+    outbox.push(batchPayload(0), OutboxPriority::TELEMETRY);
+    outbox.pop(pkt);
+  }
+
+  for (uint32_t ts = 1; ts <= 3; ts++) {
+    TEST_ASSERT_TRUE(outbox.push(batchPayload(ts), OutboxPriority::TELEMETRY));
+  }
+  for (uint32_t ts = 1; ts <= 3; ts++) {
+    TEST_ASSERT_TRUE(outbox.pop(pkt));
+    TEST_ASSERT_EQUAL_UINT32(ts, pkt.ts);
+  }
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_empty_outbox);
+  RUN_TEST(test_priority_then_fifo);
+  RUN_TEST(test_state_payload_is_replaced);
+  RUN_TEST(test_full_outbox_evicts_newest_lowest_priority);
+  RUN_TEST(test_fifo_across_order_wrap_around);
+  return UNITY_END();
+}
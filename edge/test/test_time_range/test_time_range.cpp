@@ -0,0 +1,181 @@
+#include "time_range.h"
+#include <unity.h>
+#include <vector>
+
+#define MONDAY    1
+#define TUESDAY   2
+#define SATURDAY  6
+#define ALL_HOURS 0x00FFFFFF
+
+static TimeRangeChecker checker;
+
+void setUp() {
+  checker.setTimeRanges(nullptr, 0);
+}
+
+void tearDown() {}
+
+// Bits of the masks, the first value of each range is the most significant bit
+static uint8_t  weekDayBit(uint8_t weekDay) { return 1 << (7 - 1 - weekDay); }
+static uint32_t hourBit(uint8_t hour) { return 1UL << (24 - 1 - hour); }
+static uint32_t monthDayBit(uint8_t monthDay) { return 1UL << (31 - monthDay); }
+static uint16_t monthBit(uint8_t month) { return 1 << (12 - month); }
+
+static uint32_t hoursBetween(uint8_t first, uint8_t last) {
+  uint32_t mask = 0;
+  for (uint8_t hour = first; hour <= last; hour++) {
+    mask |= hourBit(hour);
+  }
+  return mask;
+}
+
+/**
+ * Check a time with the index and with the linear scan, which must agree.
+ */
+static bool monitoring(uint8_t weekDay, uint8_t hour, uint8_t monthDay, uint8_t month) {
+  bool indexed = checker.isMonitoringTime(weekDay, hour, monthDay, month);
+  TEST_ASSERT_EQUAL(checker.isMonitoringTimeLinear(weekDay, hour, monthDay, month), indexed);
+  return indexed;
+}
+
+static void test_no_rules_never_monitors() {
+  TEST_ASSERT_FALSE(monitoring(MONDAY, 0, 1, 1));
+  TEST_ASSERT_FALSE(monitoring(SATURDAY, 23, 31, 12));
+}
+
+static void test_weekly_rule() {
+  TimeRangeRule rule = {weekDayBit(MONDAY), hoursBetween(8, 17), TIME_RANGE_WEEKLY_MONTH_DAYS, TIME_RANGE_WEEKLY_MONTHS};
+  checker.setTimeRanges(&rule, 1);
+
+  TEST_ASSERT_TRUE(monitoring(MONDAY, 8, 6, 3));
+  TEST_ASSERT_TRUE(monitoring(MONDAY, 17, 6, 3));
+  TEST_ASSERT_FALSE(monitoring(MONDAY, 7, 6, 3));
+  TEST_ASSERT_FALSE(monitoring(MONDAY, 18, 6, 3));
+  TEST_ASSERT_FALSE(monitoring(TUESDAY, 8, 7, 3));
+  TEST_ASSERT_TRUE(monitoring(MONDAY, 12, 31, 12)); // Any Monday of the year
+}
+
+static void test_weekly_rule_with_bits_outside_of_the_ranges() {
+  TimeRangeRule rule = {weekDayBit(SATURDAY), ALL_HOURS, 0xFFFFFFFF, 0xFFFF};
+  checker.setTimeRanges(&rule, 1);
+
+  TEST_ASSERT_TRUE(monitoring(SATURDAY, 0, 1, 1));
+  TEST_ASSERT_TRUE(monitoring(SATURDAY, 23, 30, 11));
+  TEST_ASSERT_FALSE(monitoring(MONDAY, 12, 3, 11));
+}
+
+static void test_calendar_rule() {
+  TimeRangeRule rule = {0x7F, ALL_HOURS, monthDayBit(25), monthBit(12)}; // Every hour of the 25th of December
+  checker.setTimeRanges(&rule, 1);
+
+  TEST_ASSERT_TRUE(monitoring(TUESDAY, 0, 25, 12));
+  TEST_ASSERT_TRUE(monitoring(SATURDAY, 23, 25, 12));
+  TEST_ASSERT_FALSE(monitoring(TUESDAY, 12, 24, 12));
+  TEST_ASSERT_FALSE(monitoring(TUESDAY, 12, 25, 11));
+}
+
+static void test_weekly_and_calendar_rules_combine() {
+  TimeRangeRule rules[] = {
+      {weekDayBit(MONDAY), hoursBetween(0, 5), TIME_RANGE_WEEKLY_MONTH_DAYS, TIME_RANGE_WEEKLY_MONTHS},
+      {weekDayBit(MONDAY), hoursBetween(20, 23), monthDayBit(1), (uint16_t)(monthBit(1) | monthBit(7))},
+  };
+  checker.setTimeRanges(rules, 2);
+
+  TEST_ASSERT_TRUE(monitoring(MONDAY, 3, 1, 7));
+  TEST_ASSERT_TRUE(monitoring(MONDAY, 21, 1, 7));
+  TEST_ASSERT_FALSE(monitoring(MONDAY, 12, 1, 7));
+  TEST_ASSERT_FALSE(monitoring(MONDAY, 21, 8, 7));  // Not the 1st
+  TEST_ASSERT_FALSE(monitoring(TUESDAY, 21, 1, 7)); // Not a Monday
+}
+
+static void test_new_rules_apply_to_the_current_day() {
+  TimeRangeRule rule = {weekDayBit(MONDAY), ALL_HOURS, TIME_RANGE_WEEKLY_MONTH_DAYS, TIME_RANGE_WEEKLY_MONTHS};
+  checker.setTimeRanges(&rule, 1);
+  TEST_ASSERT_TRUE(monitoring(MONDAY, 10, 6, 3));
+
+  rule.hourMask = hourBit(22);
+  checker.setTimeRanges(&rule, 1);
+  TEST_ASSERT_FALSE(monitoring(MONDAY, 10, 6, 3));
+  TEST_ASSERT_TRUE(monitoring(MONDAY, 22, 6, 3));
+
+  checker.setTimeRanges(nullptr, 0);
+  TEST_ASSERT_FALSE(monitoring(MONDAY, 22, 6, 3));
+}
+
+/**
+ * @return The next number of a xorshift generator.
+ */
+static uint32_t nextRandom(uint32_t& state) {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+/**
+ * @return Rules of every kind: weekly, on some days or months, and with bits outside of the ranges set.
+ */
+static std::vector<TimeRangeRule> mixedRules(size_t count) {
+  std::vector<TimeRangeRule> rules(count);
+  uint32_t                   state = 0x2545F491;
+  for (size_t i = 0; i < count; i++) {
+    TimeRangeRule& rule = rules[i];
+    rule.weekDayMask    = (uint8_t)nextRandom(state);
+    rule.hourMask       = nextRandom(state) & nextRandom(state) & nextRandom(state); // Few hours, so that most times do not match
+
+    // One rule in three is weekly, with or without the bits outside of the ranges
+    if (i % 3 == 0) {
+      rule.monthDayMask = (nextRandom(state) & 1) ? 0xFFFFFFFF : TIME_RANGE_WEEKLY_MONTH_DAYS;
+      rule.monthMask    = (nextRandom(state) & 1) ? 0xFFFF : TIME_RANGE_WEEKLY_MONTHS;
+    } else {
+      rule.monthDayMask = (i % 3 == 1) ? nextRandom(state) & nextRandom(state) : TIME_RANGE_WEEKLY_MONTH_DAYS;
+      rule.monthMask    = (uint16_t)(nextRandom(state) & nextRandom(state));
+    }
+  }
+  return rules;
+}
+
+/**
+ * Check the index against the linear scan for every hour of 2028 (leap year). The rules are set while the first day
+ * is known with the previous ones, so its hours must be checked again.
+ */
+static void assertIndexAgreesOverAYear(const std::vector<TimeRangeRule>& rules) {
+  static const uint8_t MONTH_DAYS[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+  uint8_t weekDay = SATURDAY; // 1st of January 2028
+  checker.isMonitoringTime(weekDay, 0, 1, 1);
+  checker.setTimeRanges(rules.data(), rules.size());
+
+  for (uint8_t month = 1; month <= 12; month++) {
+    for (uint8_t monthDay = 1; monthDay <= MONTH_DAYS[month - 1]; monthDay++) {
+      for (uint8_t hour = 0; hour < 24; hour++) {
+        bool indexed = checker.isMonitoringTime(weekDay, hour, monthDay, month);
+        bool linear  = checker.isMonitoringTimeLinear(weekDay, hour, monthDay, month);
+        if (indexed != linear) {
+          char message[96];
+          snprintf(message, sizeof(message), "%zu rules: the index gives %d, the linear scan %d on %02u/%02u %02u:00", rules.size(), indexed, linear, monthDay, month, hour);
+          TEST_FAIL_MESSAGE(message);
+        }
+      }
+      weekDay = (weekDay + 1) % 7;
+    }
+  }
+}
+
+static void test_index_agrees_with_linear_scan() {
+  for (size_t count : {1, 18, 255}) {
+    assertIndexAgreesOverAYear(mixedRules(count));
+  }
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_no_rules_never_monitors);
+  RUN_TEST(test_weekly_rule);
+  RUN_TEST(test_weekly_rule_with_bits_outside_of_the_ranges);
+  RUN_TEST(test_calendar_rule);
+  RUN_TEST(test_weekly_and_calendar_rules_combine);
+  RUN_TEST(test_new_rules_apply_to_the_current_day);
+  RUN_TEST(test_index_agrees_with_linear_scan);
+  return UNITY_END();
+}
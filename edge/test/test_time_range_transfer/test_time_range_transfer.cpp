@@ -0,0 +1,116 @@
+#include "eeprom_driver.h"
+#include <lora_transfer.h>
+#include <unity.h>
+
+#define TRANSFER_RULES 18 // Two fragments
+
+void processLoraPayload(const LoraPayload& pkt); // Downlink handler of security_code.cpp
+
+static TransferSender sender;
+
+void setUp() {
+  for (int address = 0; address < EEPROM.length(); address++) {
+    EEPROM.write(address, 0); // No rule in either bank
+  }
+}
+
+void tearDown() {}
+
+/**
+ * @return A rule told apart by its hour mask.
+ */
+static TimeRangeRule numberedRule(uint32_t number) {
+  return {.weekDayMask = 0x7F, .hourMask = number, .monthDayMask = TIME_RANGE_WEEKLY_MONTH_DAYS, .monthMask = TIME_RANGE_WEEKLY_MONTHS};
+}
+
+static void writeRule(uint8_t* out, const TimeRangeRule& rule) {
+  TimeRangeRuleRecord record = {.weekDayMask = rule.weekDayMask, .hourMask = rule.hourMask, .monthDayMask = rule.monthDayMask, .monthMask = rule.monthMask};
+  writeFields(record, PayloadLayout<PayloadType::SET_TIME_RANGE>::FIELDS, out);
+}
+
+/**
+ * Start a transfer of TRANSFER_RULES rules numbered from first.
+ */
+static void beginTransfer(uint8_t transferId, uint32_t first) {
+  uint8_t* rules = sender.ruleBuffer();
+  for (uint32_t i = 0; i < TRANSFER_RULES; i++) {
+    writeRule(rules + i * TRANSFER_RULE_BYTES, numberedRule(first + i));
+  }
+  sender.begin(transferId, TRANSFER_RULES, 0);
+}
+
+/**
+ * Receive the next fragment of the transfer.
+ */
+static void receiveFragment() {
+  LoraPayload pkt = {};
+  TEST_ASSERT_TRUE(sender.nextFragment(0, pkt));
+  sender.fragmentSent(0);
+  processLoraPayload(pkt);
+}
+
+static void receiveSingleFrame(uint32_t number) {
+  LoraPayload pkt = {};
+  pkt.type        = PayloadType::SET_TIME_RANGE;
+  writeRule(pkt.data, numberedRule(number));
+  pkt.length = TRANSFER_RULE_BYTES;
+  processLoraPayload(pkt);
+}
+
+/**
+ * Check that the active rule set is made of count rules numbered from first.
+ */
+static void assertActiveRules(size_t count, uint32_t first) {
+  TimeRangeRule rules[TRANSFER_MAX_RULES];
+  size_t        ruleCount = TRANSFER_MAX_RULES;
+  retrieveTimeRangeRulesEEPROM(rules, ruleCount);
+  TEST_ASSERT_EQUAL(count, ruleCount);
+  for (size_t i = 0; i < count; i++) {
+    TEST_ASSERT_EQUAL_UINT32(first + i, rules[i].hourMask);
+  }
+}
+
+static void test_transfer_commits_every_fragment() {
+  beginTransfer(1, 100);
+  receiveFragment();
+  assertActiveRules(0, 0); // Nothing active until the last fragment
+  receiveFragment();
+  assertActiveRules(TRANSFER_RULES, 100);
+}
+
+static void test_single_frame_set_during_a_transfer() {
+  beginTransfer(2, 100);
+  receiveFragment();
+  receiveSingleFrame(500); // Written over the staged fragment
+  assertActiveRules(1, 500);
+
+  // The rest of the transfer no longer completes it with the fragment lost in between
+  receiveFragment();
+  assertActiveRules(1, 500);
+
+  // Sent again by the gateway, every fragment is staged anew
+  beginTransfer(2, 100);
+  receiveFragment();
+  assertActiveRules(TRANSFER_RULES, 100);
+}
+
+static void test_new_rule_set_with_the_committed_transfer_id() {
+  beginTransfer(3, 100);
+  receiveFragment();
+  receiveFragment();
+
+  // The 8-bit ID of the next transfer may come back to the committed one
+  beginTransfer(3, 200);
+  receiveFragment();
+  assertActiveRules(TRANSFER_RULES, 100);
+  receiveFragment();
+  assertActiveRules(TRANSFER_RULES, 200);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_transfer_commits_every_fragment);
+  RUN_TEST(test_single_frame_set_during_a_transfer);
+  RUN_TEST(test_new_rule_set_with_the_committed_transfer_id);
+  return UNITY_END();
+}
@@ -0,0 +1,93 @@
+#ifndef HOST_LINK_H
+#define HOST_LINK_H
+
+#include <Arduino.h>
+#include <lora_protocol.h>
+
+/*
+Output of the gateway towards the host (Node-RED) on the Serial link, in the protocol selected by the host.
+Every session starts in JSON: one Json line per message. The host switches the session to binary with the handshake
+{"cmd":"hello","version":2}, answered in Json, after which the gateway only sends packets:
+- A packet is [type:1][body][crc:2], COBS-encoded and followed by a 0x00 delimiter. The CRC is a CRC-16/CCITT-FALSE
+  (polynomial 0x1021, initial value 0xFFFF) of the type and the body, big-endian.
+- UPLINK: the authenticated frame as received over the air, v1 or v2, with its metadata (see HostUplink).
+- JSON: one Json line without its line ending, for the messages that are not uplinks (statuses, errors, node list).
+The commands from the host stay Json lines in both protocols. {"cmd":"hello","version":1} switches back to JSON.
+*/
+#define HOST_PROTOCOL_JSON   1
+#define HOST_PROTOCOL_BINARY 2
+
+#define HOST_UPLINK_HEADER_BYTES 16                                                // id, counter, ts, rssi, snr, rxMs
+#define HOST_PACKET_BODY_MAX     (HOST_UPLINK_HEADER_BYTES + LORA_FRAME_MAX_BYTES) // Longer Json lines are dropped
+#define HOST_PACKET_CRC_BYTES    2
+
+enum class HostPacketType : uint8_t {
+  UPLINK = 0x01,
+  JSON   = 0x02,
+};
+
+/**
+ * Metadata of an uplink sent in binary, the header of the UPLINK packet body (big-endian):
+ * [id:1][counter:4][ts:4][rssi:2][snr:1][rxMs:4], followed by the raw frame.
+ */
+struct HostUplink {
+  uint8_t  id;      // Node ID, also in the frame
+  uint32_t counter; // Frame counter, also in the frame
+  uint32_t ts;      // Unix timestamp of the payload, rebuilt by the gateway for the v2 frames
+  int16_t  rssi;    // dBm, 0 if the module did not report it
+  int8_t   snr;     // dB, 0 if the module did not report it
+  uint32_t rxMs;    // millis() of the gateway when the frame was received
+};
+
+/**
+ * @return The CRC-16/CCITT-FALSE of the given bytes.
+ * @param crc The CRC of the previous bytes, to compute it over several buffers.
+ */
+uint16_t hostCrc16(const uint8_t* data, size_t length, uint16_t crc = 0xFFFF);
+
+/**
+ * The Serial link with the host, printed to as any stream. Each Json line printed while the session is binary is
+ * sent as a JSON packet once its line ending is printed.
+ */
+class HostLink : public Print {
+public:
+  explicit HostLink(Print& serial) : serial(serial) {}
+
+  /**
+   * Select the protocol of the session, a partial Json line is dropped.
+   * @return false if the version is not supported, the protocol is then unchanged.
+   */
+  bool setVersion(uint8_t version);
+
+  uint8_t getVersion() const { return version; }
+
+  bool isBinary() const { return version == HOST_PROTOCOL_BINARY; }
+
+  using Print::write;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+
+  /**
+   * Send an uplink as an UPLINK packet, without any text formatting. Only valid in a binary session.
+   * @param frame The raw bytes of the frame.
+   * @param frameSize The number of bytes of the frame, at most LORA_FRAME_MAX_BYTES.
+   */
+  void sendUplink(const HostUplink& uplink, const uint8_t* frame, size_t frameSize);
+
+  /**
+   * @return The number of Json lines dropped in a binary session because they were longer than HOST_PACKET_BODY_MAX.
+   */
+  uint32_t getDroppedLines() const { return droppedLines; }
+
+private:
+  Print&   serial;
+  uint8_t  version = HOST_PROTOCOL_JSON;
+  uint8_t  packet[1 + HOST_PACKET_BODY_MAX + HOST_PACKET_CRC_BYTES]; // Type, body, room for the CRC
+  size_t   lineLength   = 0;                                         // Bytes of the Json line buffered after the type
+  bool     lineTooLong  = false;
+  uint32_t droppedLines = 0;
+
+  void sendPacket(size_t length);
+};
+
+#endif // HOST_LINK_H
@@ -0,0 +1,101 @@
+#ifndef INGRESS_FILTER_H
+#define INGRESS_FILTER_H
+
+#include <lora_protocol.h>
+
+/*
+Filter of the authenticated uplinks, run before they are formatted for the host so a node sending the same payload
+again, or far more payloads than a duty-cycled node can, does not flood Node-RED and the USB link.
+- Duplicates: the frame counter of a payload is set when it is sent, so a payload sent again has a new counter and
+  passes the replay window. The gateway remembers a hash of the content (timestamp, type, data) of the last
+  INGRESS_RECENT_FRAMES payloads of each node instead.
+- Rate: token buckets per node and per payload type of the node. A node within the 1% duty cycle (about one frame every
+  5 seconds at SF7) never runs out of tokens.
+As for the link statistics, only the INGRESS_MAX_NODES nodes heard most recently are followed.
+*/
+#define INGRESS_MAX_NODES     16
+#define INGRESS_RECENT_FRAMES 4 // Payloads remembered per node to detect the duplicates
+
+/**
+ * Token bucket: up to `burst` frames at once, then one frame per `refillMs`.
+ */
+struct IngressRate {
+  uint8_t  burst;
+  uint32_t refillMs;
+};
+
+// Bucket of each node, whatever the type of its payloads
+inline constexpr IngressRate INGRESS_NODE_RATE = {.burst = 16, .refillMs = 1000};
+
+/**
+ * @return The bucket of a payload type within a node.
+ */
+constexpr IngressRate ingressTypeRate(PayloadType type) {
+  switch (type) {
+  case PayloadType::EDGE_HEARTBEAT:  return {.burst = 4, .refillMs = 10000};
+  case PayloadType::MOTION_STATE:    return {.burst = 8, .refillMs = 2000};
+  case PayloadType::EVENT_BATCH:     return {.burst = 8, .refillMs = 2000};
+  case PayloadType::TRANSFER_STATUS: return {.burst = 8, .refillMs = 2000}; // One per window of fragments
+  default:                           return {.burst = 4, .refillMs = 5000};
+  }
+}
+
+class IngressFilter {
+public:
+  enum class Verdict : uint8_t {
+    FORWARD,
+    DUPLICATE,
+    RATE_LIMITED,
+  };
+
+  /**
+   * Check an authenticated uplink and account it. A duplicate does not take any token.
+   */
+  Verdict check(const LoraPayload& pkt, uint32_t nowMs);
+
+  /**
+   * Read the frames dropped from a node since the start of the window.
+   * @return false if the node is not followed, the counters are then 0.
+   */
+  bool drops(uint8_t id, uint32_t& duplicates, uint32_t& limited) const;
+
+  /**
+   * Stop following a node, e.g. once removed from the node table.
+   */
+  void remove(uint8_t id);
+
+  /**
+   * Clear the drop counters of every node, the buckets and the recent payloads are kept.
+   */
+  void startWindow();
+
+private:
+  struct Bucket {
+    uint8_t  tokens;
+    uint32_t refilledMs; // millis() when the last token was added
+  };
+
+  // Uplink types with their own bucket, the other types share the last one
+  static constexpr PayloadType BUCKET_TYPES[] = {PayloadType::EDGE_HEARTBEAT, PayloadType::MOTION_STATE, PayloadType::EVENT_BATCH, PayloadType::TRANSFER_STATUS};
+  static constexpr size_t      BUCKET_COUNT   = sizeof(BUCKET_TYPES) / sizeof(BUCKET_TYPES[0]) + 1;
+
+  struct NodeSlot {
+    uint8_t  id; // 0 if the slot is free
+    uint32_t lastSeenMs;
+    uint32_t recent[INGRESS_RECENT_FRAMES]; // Hashes of the last payloads, 0 if none
+    uint8_t  nextRecent;
+    Bucket   node;
+    Bucket   types[BUCKET_COUNT];
+    uint32_t duplicates;
+    uint32_t limited;
+  };
+
+  NodeSlot slots[INGRESS_MAX_NODES] = {};
+
+  NodeSlot*       slotFor(uint8_t id, uint32_t nowMs);
+  static size_t   bucketIndex(PayloadType type);
+  static bool     take(Bucket& bucket, const IngressRate& rate, uint32_t nowMs);
+  static uint32_t contentHash(const LoraPayload& pkt);
+};
+
+#endif // INGRESS_FILTER_H
@@ -0,0 +1,114 @@
+#ifndef JSON_CODEC_H
+#define JSON_CODEC_H
+
+#include <Arduino.h>
+
+/*
+Json of the Serial link with Node-RED, without heap allocation.
+The lines are flat objects whose values are numbers, strings without escape sequences, true, false or null. The
+writer can also print arrays of numbers, which the reader skips as invalid.
+JsonReader walks the members of a line in a single pass, in any order, pointing into the line instead of copying it.
+JsonWriter prints the members straight to the output stream.
+*/
+
+/**
+ * Single-pass reader of the members of a flat Json object, e.g. {"id":1,"type":19,"data":"01"}.
+ */
+class JsonReader {
+public:
+  enum class Kind : uint8_t {
+    NUMBER,
+    STRING,  // value points after the opening quote, valueLength excludes the quotes
+    LITERAL, // true, false or null
+  };
+
+  /**
+   * @param json The line, it must outlive the reader.
+   * @param length The number of characters of the line.
+   */
+  JsonReader(const char* json, size_t length) : pos(json), end(json + length) {}
+
+  /**
+   * Move to the next member of the object.
+   * @return false at the end of the object, or if the line is not a valid flat object (see isValid()).
+   */
+  bool next();
+
+  /**
+   * @return false if a syntax error was found, the members read before it are still valid.
+   */
+  bool isValid() const { return valid; }
+
+  /**
+   * @return true if the key of the current member is the given name.
+   */
+  bool keyIs(const char* name) const { return strlen(name) == keyLength && memcmp(name, key, keyLength) == 0; }
+
+  /**
+   * Read the value of the current member as an unsigned integer.
+   * @return false if it is not made of decimal digits only, or does not fit in 64 bits.
+   */
+  bool toUint(uint64_t& out) const;
+
+  Kind        kind        = Kind::LITERAL;
+  const char* value       = nullptr; // Value of the current member, not null-terminated
+  size_t      valueLength = 0;
+
+private:
+  const char* pos;
+  const char* end;
+  const char* key       = nullptr; // Key of the current member, without the quotes
+  size_t      keyLength = 0;
+  bool        started   = false; // The opening brace was read
+  bool        finished  = false; // The closing brace was read, or an error was found
+  bool        valid     = true;
+
+  void skipSpaces();
+  bool readString(const char*& start, size_t& length);
+  bool fail();
+};
+
+/**
+ * Streaming writer of a flat Json object, members are printed as they are added.
+ */
+class JsonWriter {
+public:
+  explicit JsonWriter(Print& out) : out(out) { out.write('{'); }
+
+  JsonWriter& member(const char* name, uint32_t value);
+  JsonWriter& member(const char* name, int32_t value);
+  JsonWriter& member(const char* name, const char* value);
+
+  /**
+   * Add integers as an array, e.g. [-95,-80,-71].
+   */
+  template <typename T>
+  JsonWriter& memberArray(const char* name, const T* values, size_t count) {
+    writeName(name);
+    out.write('[');
+    for (size_t i = 0; i < count; i++) {
+      if (i > 0) out.write(',');
+      out.print(values[i]);
+    }
+    out.write(']');
+    return *this;
+  }
+
+  /**
+   * Add bytes as a string of uppercase hex characters, e.g. "01AB".
+   */
+  JsonWriter& memberHex(const char* name, const uint8_t* bytes, size_t length);
+
+  /**
+   * Close the object and end the line.
+   */
+  void endLine() { out.println('}'); }
+
+private:
+  Print& out;
+  bool   first = true;
+
+  void writeName(const char* name);
+};
+
+#endif // JSON_CODEC_H
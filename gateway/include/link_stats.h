@@ -0,0 +1,77 @@
+#ifndef LINK_STATS_H
+#define LINK_STATS_H
+
+#include <Arduino.h>
+
+/*
+Radio statistics of the edge nodes, to size the spreading factor and the power and to spot a failing node before it
+goes silent. They are gathered over a window of LINK_STATS_PERIOD_MS, published, then started over.
+Only the LINK_STATS_MAX_NODES nodes heard most recently are followed: the node table already takes a fifth of the RAM of
+the board, the statistics of all its nodes would not fit.
+*/
+#define LINK_STATS_MAX_NODES  16
+#define LINK_STATS_PERIOD_MS  300000 // Window of the statistics, 5 minutes
+#define LINK_STATS_GAP_BINS   8      // Inter-arrival histogram: < 1 s, < 4 s, < 16 s, ... (x4), last bin >= 4096 s
+#define LINK_STATS_NO_COUNTER 0      // Frame counters start at 1
+
+/**
+ * Signal quality of a received frame, printed by the LoRa module on the line before the frame.
+ */
+struct LoraRxMetadata {
+  int16_t rssi; // dBm
+  int8_t  snr;  // dB
+  bool    valid;
+};
+
+/**
+ * Statistics of a node over the current window.
+ */
+struct LinkStats {
+  uint8_t  id;                         // 0 if the slot is free
+  uint32_t lastCounter;                // Highest frame counter received, kept across windows to count the gaps
+  uint32_t lastArrivalMs;              // millis() of the last frame, kept across windows
+  uint32_t frames;                     // Frames received in the window
+  uint32_t lost;                       // Frames missing from the frame counter sequence, estimated
+  uint16_t samples;                    // Frames with a RSSI and a SNR
+  int16_t  rssiMin;                    // dBm
+  int16_t  rssiMax;                    // dBm
+  int32_t  rssiSum;                    // dBm
+  int8_t   snrMin;                     // dB
+  int8_t   snrMax;                     // dB
+  int32_t  snrSum;                     // dB
+  uint16_t gaps[LINK_STATS_GAP_BINS];  // Histogram of the delays between two frames
+};
+
+class LinkStatsTable {
+public:
+  /**
+   * Account an authenticated frame of a node. A node not followed yet takes a free slot, or the one of the node heard
+   * least recently.
+   * @param counter The frame counter, the gaps in the sequence are counted as lost frames.
+   * @param meta The signal quality of the frame, ignored if not valid.
+   */
+  void record(uint8_t id, uint32_t counter, const LoraRxMetadata& meta, uint32_t nowMs);
+
+  /**
+   * Stop following a node, e.g. once removed from the node table.
+   */
+  void remove(uint8_t id);
+
+  /**
+   * @return The slot at this index, free if its id is 0.
+   */
+  const LinkStats& at(size_t index) const { return slots[index]; }
+
+  /**
+   * Start a new window: the statistics of every node are cleared, and a node without any frame in the window that
+   * ended is no longer followed.
+   */
+  void startWindow();
+
+private:
+  LinkStats slots[LINK_STATS_MAX_NODES] = {};
+
+  static uint8_t gapBin(uint32_t gapMs);
+};
+
+#endif // LINK_STATS_H
@@ -1,38 +1,58 @@
 #ifndef MAIN_H
 #define MAIN_H
 
+#include "host_link.h"
+#include "ingress_filter.h"
+#include "json_codec.h"
+#include "link_stats.h"
 #include <SoftwareSerial.h>
-
-enum class PayloadType : uint8_t {
-  UNKNOWN        = 0x00, // Bad data
-  EDGE_HEARTBEAT = 0x01, // Heartbeat message sent periodically to indicate that the system is alive, with the current alarm state included in the payload data
-  MOTION_STATE   = 0x02, // Message sent when motion is detected, with the motion state (e.g., detected or not detected) included in the payload data
-  CONFIGURATION  = 0x03, // TODO: Add support for configuration messages (e.g., changing the secret combination, time range rules, etc.)
-};
-
-#define MAX_PAYLOAD_DATA_SIZE 200
-
-struct LoraPayload {
-  uint8_t     id;     // 1 byte : ID of the sender node, set by the sender
-  uint32_t    ts;     // 4 bytes : Unix timestamp of when the payload was created, set by the sender
-  PayloadType type;   // 1 byte : Type of the payload (e.g., heartbeat, motion state, configuration, etc.), set by the sender
-  uint8_t     length; // 1 byte : Length of the payload data in bytes, set by the sender
-  String      data;   // Represents MAX_PAYLOAD_DATA_SIZE bytes : Payload data as hexadecimal string, content depends on the payload type, set by the sender
-  String      hmac;   // Represents 4 bytes : HMAC signature of the payload for integrity and authenticity verification
-} __attribute__((packed));
+#include <lora_protocol.h>
 
 void listenLora();
 void listenSerial();
+void pumpSerialInputs();
+void reportOverruns();
+void onLoraLine(const char* line, size_t length);
+bool sendDownlink(LoraPayload& pkt);
 void printPayload(const LoraPayload& pkt);
 
-// Lora (hex) -> LoraPayload -> Json -> Serial (Json)
-String loraToSerial(const String& loraLine);
-bool   hexToPayload(const String& hex, LoraPayload& pkt);
-String payloadToJson(const LoraPayload& pkt);
+// Lora (hex) -> LoraPayload -> Json -> Serial (Json, or binary packets once the host switched the session)
+bool parseRxMetadata(const char* loraLine, size_t length, LoraRxMetadata& meta);
+bool loraToSerial(const char* loraLine, size_t length, HostLink& out);
+void trackUplinkLiveness(const LoraPayload& pkt);
+bool hexToUplink(const char* hex, size_t length, LoraPayload& pkt);
+void requestEpochRenewal(uint8_t id);
+bool hexToPayload(const char* hex, size_t length, LoraPayload& pkt);
+void uplinkToJson(const LoraPayload& pkt, const LoraRxMetadata& meta, Print& out);
+void payloadToJson(const LoraPayload& pkt, const LoraRxMetadata& meta, Print& out);
+void eventToJson(const LoraPayload& event, size_t index, const LoraRxMetadata& meta, Print& out);
+JsonWriter& writePayloadMembers(JsonWriter& json, const LoraPayload& pkt);
+JsonWriter& writeRxMetadata(JsonWriter& json, const LoraRxMetadata& meta);
 
 // Serial (Json) -> Json -> LoraPayload ->Lora (hex)
-String      serialToLora(const String& serialLine);
-LoraPayload jsonToPayload(const String& json);
-String      payloadToHex(const LoraPayload& pkt);
+bool        serialToHello(const char* serialLine, size_t length);
+bool        serialToDownlink(const char* serialLine, size_t length);
+LoraPayload jsonToPayload(const char* json, size_t length);
+
+// Serial (Json) -> time range rule set too large for a frame -> fragments -> Lora (hex)
+bool serialToTransfer(const char* serialLine, size_t length);
+void pumpTimeRangeTransfer();
+void handleTransferStatus(const LoraPayload& pkt);
+void reportTransfer(const char* status);
+
+// Downlinks held until the receive window of their node (LORA_CLASS_A)
+bool holdDownlink(const LoraPayload& pkt);
+void serveDownlinkWindow();
+
+// Node table managed over Serial, and liveness of the edge nodes (adaptive heartbeat)
+bool serialToNodeCommand(const char* serialLine, size_t length);
+void publishLinkStats();
+void trackNodeLiveness(const LoraPayload& pkt);
+void checkNodeLiveness();
+
+// Frame counters (replay protection)
+uint32_t nextTxCounter();
+uint32_t readFrameCounterEEPROM(int address);
+void     storeFrameCounterEEPROM(int address, uint32_t counter);
 
 #endif // MAIN_H
\ No newline at end of file
@@ -0,0 +1,63 @@
+#ifndef NODE_LIVENESS_H
+#define NODE_LIVENESS_H
+
+#include <Arduino.h>
+
+/*
+Liveness of an edge node: when it was last heard and when its next heartbeat is due. It is kept in the node table for
+every registered node, so it takes 4 bytes: times are counted in ticks of 2^NODE_LIVENESS_TICK_SHIFT ms on 16 bits,
+which wrap after about 74 hours. A delay announced by a heartbeat is capped to NODE_LIVENESS_MAX_TICKS so it can be
+compared across the wrap, and check() holds the last-seen time of a node silent for longer at that age.
+*/
+#define NODE_LIVENESS_TICK_SHIFT 12     // A tick is 4096 ms, so millis() wraps on a whole number of ticks
+#define NODE_LIVENESS_MAX_TICKS  0x7FFF // Longest delay or age that can be told apart, about 37 hours
+
+/**
+ * @return The liveness tick of a millis() value.
+ */
+inline uint16_t livenessTick(uint32_t nowMs) { return static_cast<uint16_t>(nowMs >> NODE_LIVENESS_TICK_SHIFT); }
+
+/**
+ * Liveness of a node.
+ */
+class NodeLiveness {
+public:
+  /**
+   * Account an authenticated uplink of the node. A node reported offline waits for its next heartbeat to be judged again.
+   * @return true if the node was reported offline: it is online again.
+   */
+  bool heard(uint16_t nowTick);
+
+  /**
+   * Account a heartbeat of the node, heard() first.
+   * @param offlineDelayMs The silence after this heartbeat before the node is offline.
+   */
+  void heartbeat(uint16_t nowTick, uint32_t offlineDelayMs);
+
+  /**
+   * Check whether the heartbeats announced by the node are missing. Must be called at least once every
+   * NODE_LIVENESS_MAX_TICKS ticks.
+   * @return true once, when the node must be reported offline.
+   */
+  bool check(uint16_t nowTick);
+
+  bool isHeard() const { return offlineAt != UNHEARD; }
+  bool isOffline() const { return offlineAt == OFFLINE; }
+
+  /**
+   * @return The seconds elapsed since the last uplink of the node, at most about NODE_LIVENESS_MAX_TICKS ticks.
+   */
+  uint32_t silenceSeconds(uint16_t nowTick) const { return ((uint32_t)static_cast<uint16_t>(nowTick - lastSeen) << NODE_LIVENESS_TICK_SHIFT) / 1000; }
+
+private:
+  // Values of offlineAt that are states rather than ticks, a deadline falling on them is moved to FIRST_DEADLINE
+  static constexpr uint16_t UNHEARD        = 0; // No uplink since the boot of the gateway
+  static constexpr uint16_t NO_HEARTBEAT   = 1; // Heard, but no heartbeat since the boot or since it was offline
+  static constexpr uint16_t OFFLINE        = 2; // Reported offline
+  static constexpr uint16_t FIRST_DEADLINE = 3;
+
+  uint16_t lastSeen  = 0;       // Tick of the last authenticated uplink
+  uint16_t offlineAt = UNHEARD; // Tick after which the node is offline, or one of the states above
+};
+
+#endif // NODE_LIVENESS_H
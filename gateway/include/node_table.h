@@ -0,0 +1,105 @@
+#ifndef NODE_TABLE_H
+#define NODE_TABLE_H
+
+#include "node_liveness.h"
+#include <lora_frame_v2.h>
+#include <lora_mac.h>
+#include <lora_replay.h>
+
+/*
+Edge nodes served by the gateway, indexed by node ID for a constant-time lookup on the receive path.
+Each registered node has its own MAC key and uplink frame counters, kept in EEPROM so the table survives a reboot.
+Its RAM entry only holds what changes with each uplink: the replay window, the epoch of its v2 uplinks and its
+liveness. The key is read from EEPROM when a frame of the node is authenticated or signed.
+
+EEPROM layout of the table (starting at EEPROM_NODE_TABLE_ADDRESS), one entry per node ID from 1 to NODE_TABLE_MAX_ID:
+- 0-15: MAC key of the node, erased (all 0xFF) if the node is not registered
+- 16-19: End of the block of uplink frame counters reserved for the node (uint32_t, big-endian)
+*/
+#define NODE_TABLE_MAX_ID         LORA_V1_MAX_NODE_ID // Highest node ID, each one takes 24 bytes of RAM
+#define NODE_TABLE_COUNTER_BLOCK  64                  // Uplink frame counters reserved in EEPROM at once
+#define EEPROM_NODE_TABLE_ADDRESS 16
+#define EEPROM_NODE_ENTRY_BYTES   (LORA_MAC_KEY_BYTES + 4)
+
+static_assert(NODE_TABLE_MAX_ID <= LORA_V1_MAX_NODE_ID, "Higher first bytes mark v2 frames");
+
+/**
+ * State of a registered edge node.
+ */
+struct NodeEntry {
+  CompactReplayWindow rxWindow; // Uplink frame counters already received from the node
+  LoraEpoch           epoch;    // Last v1 uplink of the node, to rebuild the timestamps of its v2 uplinks
+  NodeLiveness        liveness; // Last uplink and next heartbeat due, to report the node offline
+};
+
+static_assert(sizeof(NodeEntry) == 24, "The node table must fit in the RAM of the board");
+
+class NodeTable {
+public:
+  /**
+   * Read the registered nodes and their frame counters from EEPROM, must be called once at boot.
+   */
+  void load();
+
+  /**
+   * @return The registered node with this ID, or nullptr.
+   */
+  NodeEntry* find(uint8_t id) {
+    if (id == 0 || id > NODE_TABLE_MAX_ID || !isRegistered(id)) return nullptr;
+    return &entries[id - 1];
+  }
+
+  /**
+   * @return The SipHash state of the key of a registered node, read from EEPROM.
+   */
+  LoraMacKey macKey(uint8_t id) const;
+
+  /**
+   * Register a node, or replace the key of a registered node. A new node starts with no frame counter received, a
+   * registered node keeps its counters: remove it first if the edge device was replaced and starts over at 1.
+   * @return false if the ID is out of range.
+   */
+  bool set(uint8_t id, const uint8_t (&key)[LORA_MAC_KEY_BYTES]);
+
+  /**
+   * Unregister a node, its frames are dropped from now on.
+   * @return false if the node was not registered.
+   */
+  bool remove(uint8_t id);
+
+  /**
+   * Mark the counter of an authenticated uplink of the node as received. Persisting every uplink would wear the EEPROM
+   * out, so the counters are reserved by blocks of NODE_TABLE_COUNTER_BLOCK: the end of a block is stored before its
+   * first counter is accepted, and the window restarts there after a reboot. No uplink can be replayed across a reboot,
+   * the cost is that the uplinks left in the block are dropped until the node reaches its end. The blocks are aligned
+   * on their size, so the end of the current one follows from the highest counter and takes no RAM.
+   */
+  void acceptUplink(uint8_t id, uint32_t counter);
+
+  /**
+   * Consider every uplink frame counter of the node up to the end of the block of the given one as received, e.g. the
+   * end of a block reserved before the node table existed.
+   */
+  void restoreCounter(uint8_t id, uint32_t counter);
+
+  /**
+   * @return The number of registered nodes.
+   */
+  size_t count() const;
+
+private:
+  NodeEntry entries[NODE_TABLE_MAX_ID]              = {}; // Node ID i is at index i - 1
+  uint8_t   registered[(NODE_TABLE_MAX_ID + 7) / 8] = {}; // Bit i % 8 of byte i / 8 is set if node ID i + 1 is registered
+
+  bool isRegistered(uint8_t id) const { return registered[(id - 1) / 8] & (1 << ((id - 1) % 8)); }
+  void setRegistered(uint8_t id, bool value);
+
+  static int entryAddress(uint8_t id) { return EEPROM_NODE_TABLE_ADDRESS + (id - 1) * EEPROM_NODE_ENTRY_BYTES; }
+
+  /**
+   * @return The end of the block of NODE_TABLE_COUNTER_BLOCK counters holding the given counter.
+   */
+  static uint32_t blockEnd(uint32_t counter) { return (counter + NODE_TABLE_COUNTER_BLOCK - 1) / NODE_TABLE_COUNTER_BLOCK * NODE_TABLE_COUNTER_BLOCK; }
+};
+
+#endif // NODE_TABLE_H
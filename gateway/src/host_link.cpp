@@ -0,0 +1,89 @@
+#include "host_link.h"
+
+uint16_t hostCrc16(const uint8_t* data, size_t length, uint16_t crc) {
+  for (size_t i = 0; i < length; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+bool HostLink::setVersion(uint8_t newVersion) {
+  if (newVersion != HOST_PROTOCOL_JSON && newVersion != HOST_PROTOCOL_BINARY) return false;
+  version     = newVersion;
+  lineLength  = 0;
+  lineTooLong = false;
+  return true;
+}
+
+size_t HostLink::write(uint8_t c) {
+  if (!isBinary()) return serial.write(c);
+
+  if (c == '\n') {
+    if (lineTooLong) {
+      droppedLines++;
+    } else if (lineLength > 0) {
+      packet[0] = static_cast<uint8_t>(HostPacketType::JSON);
+      sendPacket(1 + lineLength);
+    }
+    lineLength  = 0;
+    lineTooLong = false;
+  } else if (c != '\r') {
+    if (lineLength == HOST_PACKET_BODY_MAX) {
+      lineTooLong = true;
+    } else {
+      packet[1 + lineLength++] = c;
+    }
+  }
+  return 1;
+}
+
+size_t HostLink::write(const uint8_t* buffer, size_t size) {
+  if (!isBinary()) return serial.write(buffer, size);
+
+  for (size_t i = 0; i < size; i++) {
+    write(buffer[i]);
+  }
+  return size;
+}
+
+void HostLink::sendUplink(const HostUplink& uplink, const uint8_t* frame, size_t frameSize) {
+  if (!isBinary() || frameSize > LORA_FRAME_MAX_BYTES) return;
+
+  // The packet buffer is shared with the Json lines, which are only printed between two whole lines
+  uint8_t* body = packet + 1;
+  packet[0]     = static_cast<uint8_t>(HostPacketType::UPLINK);
+  body[0]       = uplink.id;
+  WireField<uint32_t>::write(body + 1, uplink.counter);
+  WireField<uint32_t>::write(body + 5, uplink.ts);
+  WireField<int16_t>::write(body + 9, uplink.rssi);
+  WireField<int8_t>::write(body + 11, uplink.snr);
+  WireField<uint32_t>::write(body + 12, uplink.rxMs);
+  memcpy(body + HOST_UPLINK_HEADER_BYTES, frame, frameSize);
+  sendPacket(1 + HOST_UPLINK_HEADER_BYTES + frameSize);
+}
+
+/**
+ * Append the CRC to the first bytes of the packet buffer, then write them COBS-encoded: each run of up to 254 non-zero
+ * bytes is preceded by its length plus one, and stands for the run followed by a zero unless it is 254 bytes long.
+ * @param length The number of bytes of the type and the body.
+ */
+void HostLink::sendPacket(size_t length) {
+  WireField<uint16_t>::write(packet + length, hostCrc16(packet, length));
+  length += HOST_PACKET_CRC_BYTES;
+
+  size_t start = 0;
+  while (true) {
+    size_t end = start;
+    while (end < length && packet[end] != 0 && end - start < 254) {
+      end++;
+    }
+    serial.write(static_cast<uint8_t>(end - start + 1));
+    serial.write(packet + start, end - start);
+    if (end == length) break;
+    start = packet[end] == 0 ? end + 1 : end;
+  }
+  serial.write((uint8_t)0); // Delimiter
+}
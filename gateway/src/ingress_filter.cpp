@@ -0,0 +1,117 @@
+#include "ingress_filter.h"
+
+constexpr PayloadType IngressFilter::BUCKET_TYPES[];
+
+IngressFilter::Verdict IngressFilter::check(const LoraPayload& pkt, uint32_t nowMs) {
+  NodeSlot* slot = slotFor(pkt.id, nowMs);
+  slot->lastSeenMs = nowMs;
+
+  uint32_t hash = contentHash(pkt);
+  for (uint32_t recent : slot->recent) {
+    if (recent == hash) {
+      slot->duplicates++;
+      return Verdict::DUPLICATE;
+    }
+  }
+  slot->recent[slot->nextRecent] = hash;
+  slot->nextRecent               = (slot->nextRecent + 1) % INGRESS_RECENT_FRAMES;
+
+  // The type bucket is checked first, a type over its rate does not drain the tokens of the other types
+  if (!take(slot->types[bucketIndex(pkt.type)], ingressTypeRate(pkt.type), nowMs) || !take(slot->node, INGRESS_NODE_RATE, nowMs)) {
+    slot->limited++;
+    return Verdict::RATE_LIMITED;
+  }
+  return Verdict::FORWARD;
+}
+
+bool IngressFilter::drops(uint8_t id, uint32_t& duplicates, uint32_t& limited) const {
+  duplicates = 0;
+  limited    = 0;
+  for (const NodeSlot& slot : slots) {
+    if (slot.id != id || id == 0) continue;
+    duplicates = slot.duplicates;
+    limited    = slot.limited;
+    return true;
+  }
+  return false;
+}
+
+void IngressFilter::remove(uint8_t id) {
+  for (NodeSlot& slot : slots) {
+    if (slot.id == id) slot = NodeSlot{};
+  }
+}
+
+void IngressFilter::startWindow() {
+  for (NodeSlot& slot : slots) {
+    slot.duplicates = 0;
+    slot.limited    = 0;
+  }
+}
+
+/**
+ * @return The slot of the node, taken from the node heard least recently if the node is not followed yet. A new slot
+ * starts with full buckets.
+ */
+IngressFilter::NodeSlot* IngressFilter::slotFor(uint8_t id, uint32_t nowMs) {
+  NodeSlot* oldest = &slots[0];
+  for (NodeSlot& slot : slots) {
+    if (slot.id == id) return &slot;
+    if (slot.id == 0) {
+      if (oldest->id != 0) oldest = &slot; // The first free slot is taken before any used one
+    } else if (oldest->id != 0 && nowMs - slot.lastSeenMs > nowMs - oldest->lastSeenMs) {
+      oldest = &slot;
+    }
+  }
+
+  *oldest    = NodeSlot{};
+  oldest->id = id;
+  oldest->node = {INGRESS_NODE_RATE.burst, nowMs};
+  for (size_t i = 0; i < BUCKET_COUNT; i++) {
+    PayloadType type = i < BUCKET_COUNT - 1 ? BUCKET_TYPES[i] : PayloadType::UNKNOWN;
+    oldest->types[i] = {ingressTypeRate(type).burst, nowMs};
+  }
+  return oldest;
+}
+
+size_t IngressFilter::bucketIndex(PayloadType type) {
+  for (size_t i = 0; i < BUCKET_COUNT - 1; i++) {
+    if (BUCKET_TYPES[i] == type) return i;
+  }
+  return BUCKET_COUNT - 1;
+}
+
+/**
+ * Add the tokens earned since the last refill, then take one.
+ * @return false if the bucket is empty.
+ */
+bool IngressFilter::take(Bucket& bucket, const IngressRate& rate, uint32_t nowMs) {
+  uint32_t earned = (nowMs - bucket.refilledMs) / rate.refillMs;
+  if (earned > 0) {
+    bucket.tokens = earned >= (uint32_t)(rate.burst - bucket.tokens) ? rate.burst : bucket.tokens + earned;
+    bucket.refilledMs += earned * rate.refillMs; // The time toward the next token is kept
+  }
+  if (bucket.tokens == 0) return false;
+  bucket.tokens--;
+  return true;
+}
+
+/**
+ * FNV-1a hash of the content of a payload, without its counter and MAC which change each time it is sent.
+ * @return The hash, never 0 so 0 can mark an empty entry.
+ */
+uint32_t IngressFilter::contentHash(const LoraPayload& pkt) {
+  uint8_t header[6];
+  WireField<uint32_t>::write(header, pkt.ts);
+  header[4] = static_cast<uint8_t>(pkt.type);
+  header[5] = pkt.length;
+
+  uint32_t hash = 2166136261u;
+  for (uint8_t b : header) {
+    hash = (hash ^ b) * 16777619u;
+  }
+  for (size_t i = 0; i < pkt.length; i++) {
+    hash = (hash ^ pkt.data[i]) * 16777619u;
+  }
+  return hash != 0 ? hash : 1;
+}
@@ -0,0 +1,131 @@
+#include "json_codec.h"
+#include <lora_hex.h>
+
+bool JsonReader::next() {
+  if (finished) return false;
+
+  skipSpaces();
+  if (!started) {
+    if (pos == end || *pos != '{') return fail();
+    started = true;
+    pos++;
+    skipSpaces();
+    if (pos != end && *pos == '}') { // Empty object
+      finished = true;
+      return false;
+    }
+  }
+
+  // Member: "key" : value
+  if (!readString(key, keyLength)) return fail();
+  skipSpaces();
+  if (pos == end || *pos != ':') return fail();
+  pos++;
+  skipSpaces();
+  if (pos == end) return fail();
+
+  if (*pos == '"') {
+    kind = Kind::STRING;
+    if (!readString(value, valueLength)) return fail();
+  } else {
+    kind  = (*pos == '-' || (*pos >= '0' && *pos <= '9')) ? Kind::NUMBER : Kind::LITERAL;
+    value = pos;
+    while (pos != end && *pos != ',' && *pos != '}' && *pos != ' ' && *pos != '\t') {
+      if (*pos == '{' || *pos == '[' || *pos == '"') return fail(); // Nested values are not supported
+      pos++;
+    }
+    valueLength = pos - value;
+    if (valueLength == 0) return fail();
+  }
+
+  // Separator before the next member, or end of the object
+  skipSpaces();
+  if (pos == end) return fail();
+  if (*pos == '}') {
+    finished = true;
+  } else if (*pos != ',') {
+    return fail();
+  }
+  pos++;
+  return true;
+}
+
+bool JsonReader::toUint(uint64_t& out) const {
+  if (kind != Kind::NUMBER || valueLength == 0 || valueLength > 20) return false;
+  uint64_t result = 0;
+  for (size_t i = 0; i < valueLength; i++) {
+    uint8_t digit = value[i] - '0';
+    if (digit > 9 || result > (UINT64_MAX - digit) / 10) return false;
+    result = result * 10 + digit;
+  }
+  out = result;
+  return true;
+}
+
+void JsonReader::skipSpaces() {
+  while (pos != end && (*pos == ' ' || *pos == '\t' || *pos == '\r' || *pos == '\n')) {
+    pos++;
+  }
+}
+
+/**
+ * Read a string at the current position, without its quotes. Escape sequences are not supported.
+ */
+bool JsonReader::readString(const char*& start, size_t& length) {
+  if (pos == end || *pos != '"') return false;
+  start = ++pos;
+  while (pos != end && *pos != '"') {
+    if (*pos == '\\') return false;
+    pos++;
+  }
+  if (pos == end) return false;
+  length = pos - start;
+  pos++; // Closing quote
+  return true;
+}
+
+bool JsonReader::fail() {
+  valid    = false;
+  finished = true;
+  return false;
+}
+
+JsonWriter& JsonWriter::member(const char* name, uint32_t value) {
+  writeName(name);
+  out.print(value);
+  return *this;
+}
+
+JsonWriter& JsonWriter::member(const char* name, int32_t value) {
+  writeName(name);
+  out.print(value);
+  return *this;
+}
+
+JsonWriter& JsonWriter::member(const char* name, const char* value) {
+  writeName(name);
+  out.write('"');
+  out.print(value);
+  out.write('"');
+  return *this;
+}
+
+JsonWriter& JsonWriter::memberHex(const char* name, const uint8_t* bytes, size_t length) {
+  writeName(name);
+  out.write('"');
+  char hex[33]; // Written by chunks, one write per character would be slow on the USB link
+  for (size_t i = 0; i < length; i += 16) {
+    size_t chunk = length - i < 16 ? length - i : 16;
+    out.write((const uint8_t*)hex, bytesToHex(bytes + i, chunk, hex));
+  }
+  out.write('"');
+  return *this;
+}
+
+void JsonWriter::writeName(const char* name) {
+  if (!first) out.write(',');
+  first = false;
+  out.write('"');
+  out.print(name);
+  out.print("\":");
+}
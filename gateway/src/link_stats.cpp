@@ -0,0 +1,80 @@
+#include "link_stats.h"
+
+void LinkStatsTable::record(uint8_t id, uint32_t counter, const LoraRxMetadata& meta, uint32_t nowMs) {
+  LinkStats* stats  = nullptr;
+  LinkStats* oldest = &slots[0];
+  for (LinkStats& slot : slots) {
+    if (slot.id == id) {
+      stats = &slot;
+      break;
+    }
+    if (slot.id == 0) {
+      if (oldest->id != 0) oldest = &slot; // The first free slot is taken before any used one
+    } else if (oldest->id != 0 && nowMs - slot.lastArrivalMs > nowMs - oldest->lastArrivalMs) {
+      oldest = &slot;
+    }
+  }
+  if (!stats) {
+    stats     = oldest;
+    *stats    = LinkStats{};
+    stats->id = id;
+  } else {
+    stats->gaps[gapBin(nowMs - stats->lastArrivalMs)]++;
+  }
+
+  if (stats->lastCounter == LINK_STATS_NO_COUNTER) {
+    stats->lastCounter = counter; // First frame heard, the frames before it are not counted as lost
+  } else if (counter > stats->lastCounter) {
+    stats->lost += counter - stats->lastCounter - 1;
+    stats->lastCounter = counter;
+  } else if (stats->lost > 0) {
+    stats->lost--; // Late frame, accepted by the replay window after a higher counter
+  }
+
+  stats->frames++;
+  stats->lastArrivalMs = nowMs;
+  if (!meta.valid) return;
+
+  if (stats->samples == 0 || meta.rssi < stats->rssiMin) stats->rssiMin = meta.rssi;
+  if (stats->samples == 0 || meta.rssi > stats->rssiMax) stats->rssiMax = meta.rssi;
+  if (stats->samples == 0 || meta.snr < stats->snrMin) stats->snrMin = meta.snr;
+  if (stats->samples == 0 || meta.snr > stats->snrMax) stats->snrMax = meta.snr;
+  stats->rssiSum += meta.rssi;
+  stats->snrSum += meta.snr;
+  stats->samples++;
+}
+
+void LinkStatsTable::remove(uint8_t id) {
+  for (LinkStats& slot : slots) {
+    if (slot.id == id) slot = LinkStats{};
+  }
+}
+
+void LinkStatsTable::startWindow() {
+  for (LinkStats& slot : slots) {
+    if (slot.id == 0) continue;
+    if (slot.frames == 0) {
+      slot = LinkStats{};
+      continue;
+    }
+
+    LinkStats next     = {};
+    next.id            = slot.id;
+    next.lastCounter   = slot.lastCounter;
+    next.lastArrivalMs = slot.lastArrivalMs;
+    slot               = next;
+  }
+}
+
+/**
+ * @return The histogram bin of a delay between two frames: bin i holds the delays below 4^i seconds.
+ */
+uint8_t LinkStatsTable::gapBin(uint32_t gapMs) {
+  uint32_t limitS = 1;
+  uint8_t  bin    = 0;
+  while (bin < LINK_STATS_GAP_BINS - 1 && gapMs / 1000 >= limitS) {
+    limitS *= 4;
+    bin++;
+  }
+  return bin;
+}
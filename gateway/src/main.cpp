@@ -1,24 +1,107 @@
 #include "main.h"
+#include "host_link.h"
+#include "json_codec.h"
+#include "node_table.h"
+#include <EEPROM.h>
+#include <lora_airtime.h>
+#include <lora_at_engine.h>
+#include <lora_frame_decoder.h>
+#include <lora_frame_v2.h>
+#include <lora_heartbeat.h>
+#include <lora_line_reader.h>
+#include <lora_mac.h>
+#include <lora_replay.h>
+#include <lora_rx_window.h>
+#include <lora_transfer.h>
 
 // #define DEBUG_SERIAL_PRINT // Print computed data to Serial for debugging
 // #define SEND_TEST_DATA     // Send test data through LoRa at a regular interval
+// #define LORA_CLASS_A       // Hold the downlinks until the receive window after an uplink of their node (LORA_CLASS_A in the edge firmware)
 
 // --- CONFIGURATION ---
-#define LORA_RX     8
-#define LORA_TX     9
-#define EXPECTED_ID 1 // TODO: Configurable ID
+#define LORA_RX              8
+#define LORA_TX              9
+#define LORA_DEFAULT_NODE_ID 1 // Node registered with the default key while the node table is empty
+#define SERIAL_RX_RING       256
+#define SERIAL_LINE_MAX      (64 + MAX_PAYLOAD_DATA_SIZE * 2) // Longest command: a full payload, larger rule sets come in several lines
 
-#define LORA_RFCFG_CMD "AT+TEST=RFCFG,868.1,SF7,125,8,15,14,ON,OFF,OFF"
+/*
+EEPROM storage layout (starting at address 0):
+- 0-3: End of the reserved block of downlink frame counters (uint32_t, big-endian)
+- 4-7: Uplink frame counter of the single edge node of the firmwares without node table, moved to the table at first boot
+- 16-5035: Node table, 20 bytes per node ID (see node_table.h)
+*/
+#define EEPROM_LORA_TX_COUNTER_ADDRESS 0
+#define EEPROM_LORA_RX_COUNTER_ADDRESS 4
+#define LORA_COUNTER_BLOCK             64 // Number of frame counters reserved in EEPROM at once
 
 SoftwareSerial loraSerial(LORA_RX, LORA_TX);
 
+// Sends the AT commands to the module and reads its lines without blocking the loop
+LoraAtEngine loraAt(loraSerial);
+
+// Lines received from Serial, the host waits while they are not read
+LineReader<SERIAL_RX_RING, SERIAL_LINE_MAX> serialLines(Serial, true);
+
+// Messages to the host, in Json or in binary packets depending on the handshake of the session
+HostLink host(Serial);
+
+// Signal quality reported by the LoRa module just before the frame it received
+LoraRxMetadata lastRx;
+
+// Radio statistics of the nodes heard recently, published every LINK_STATS_PERIOD_MS
+LinkStatsTable linkStats;
+uint32_t       linkStatsWindowStart = 0;
+
+// Duplicates and floods of the nodes, dropped before they are sent to the host
+IngressFilter ingress;
+
+// Overrun counters of both links last reported to Serial
+uint32_t reportedOverruns = 0;
+
+// Airtime budget of the 1% duty cycle of the sub-band, shared by all the downlinks
+DutyCycleGovernor dutyCycle;
+
+// Edge nodes served by the gateway, with their keys and frame counters, managed over Serial
+NodeTable nodes;
+
+// Tick of the last check of the liveness of the nodes
+uint16_t livenessCheckedTick = 0;
+
+// Last downlink frame counter used, and end of the block of counters reserved in EEPROM.
+// The counter is shared by all the nodes, each of them only sees it increase.
+uint32_t txCounter      = 0;
+uint32_t txCounterLimit = 0;
+
+#ifdef LORA_CLASS_A
+// Downlinks waiting for the receive window of their node
+DownlinkQueue heldDownlinks;
+#endif // LORA_CLASS_A
+
+// Time range rule set sent to an edge node in SET_TIME_RANGE_FRAGMENT payloads, only the missing fragments are retransmitted
+TransferSender timeRangeTransfer;
+uint8_t        transferNode  = 0; // Destination node of the transfer
+size_t         transferRules = 0; // Rules received so far while the lines of a rule set come in from Serial
+
 // Test
 const unsigned long TEST_CONFIG_PAYLOAD_INTERVAL = 10000; // Interval to send test configuration payloads in milliseconds
 unsigned long       lastTestConfigPayloadTime    = 0;
 
 void setup() {
+  // Counters used before the reboot may be anywhere in the reserved block, so start after it
+  txCounter      = readFrameCounterEEPROM(EEPROM_LORA_TX_COUNTER_ADDRESS);
+  txCounterLimit = txCounter;
+
+  nodes.load();
+  if (nodes.count() == 0) { // Serve the single node of the firmwares without node table, with its last counter
+    // That counter was persisted once per block, the block after it may have been accepted before the upgrade
+    uint32_t legacyCounter = readFrameCounterEEPROM(EEPROM_LORA_RX_COUNTER_ADDRESS);
+    nodes.set(LORA_DEFAULT_NODE_ID, LORA_DEFAULT_MAC_KEY);
+    nodes.restoreCounter(LORA_DEFAULT_NODE_ID, legacyCounter > 0 ? legacyCounter + LORA_COUNTER_BLOCK : 0);
+  }
+
   Serial.begin(115200);
-  loraSerial.begin(9600);
+  loraSerial.begin(LORA_AT_BAUD);
 
   while (!Serial) {
     delay(100); // Wait for serial port to connect
@@ -29,12 +112,11 @@ void setup() {
   Serial.println(F("--- Initialising the gateway ---"));
 #endif // DEBUG_SERIAL_PRINT
 
-  // Simple AT initialization sequence for the LoRa module
-  loraSerial.println("AT+MODE=TEST");
-  delay(500);
-  loraSerial.println(LORA_RFCFG_CMD);
-  delay(500);
-  loraSerial.println("AT+TEST=RXLRPKT");
+  // Simple AT initialization sequence for the LoRa module, sent by listenLora()
+  loraAt.setLineHandler(onLoraLine);
+  loraAt.enqueue("AT+MODE=TEST", "+MODE", nullptr, LORA_AT_CMD_TIMEOUT);
+  loraAt.enqueue(LORA_RFCFG_CMD, "RFCFG", nullptr, LORA_AT_CMD_TIMEOUT);
+  loraAt.enqueue("AT+TEST=RXLRPKT", "RXLRPKT", nullptr, LORA_AT_CMD_TIMEOUT);
 
 #ifdef DEBUG_SERIAL_PRINT
   Serial.println(F("Listening (Freq: 868.1MHz)..."));
@@ -44,321 +126,857 @@ void setup() {
 }
 
 void loop() {
+  // Never waits: the receive buffers of both links are drained at every iteration, and between the steps that print
   listenLora();
   listenSerial();
-  delay(50); // Small delay to avoid busy looping
+  checkNodeLiveness();
+  pumpTimeRangeTransfer();
+  serveDownlinkWindow();
+  reportOverruns();
+  publishLinkStats();
 
 #ifdef SEND_TEST_DATA // Send test data through LoRa at a regular interval
-  if (millis() - lastTestConfigPayloadTime > TEST_CONFIG_PAYLOAD_INTERVAL) {
+  NodeEntry* testNode = nodes.find(LORA_DEFAULT_NODE_ID);
+  if (testNode && millis() - lastTestConfigPayloadTime > TEST_CONFIG_PAYLOAD_INTERVAL) {
     lastTestConfigPayloadTime = millis();
 #ifdef DEBUG_SERIAL_PRINT
     Serial.println(F("Sending a test configuration payload..."));
 #endif // DEBUG_SERIAL_PRINT
 
     // Send a test configuration payload every 10 seconds for testing purposes
-    LoraPayload pkt{
-        .id     = EXPECTED_ID,
-        .ts     = 123456, // Use current time in seconds as timestamp
-        .type   = PayloadType::CONFIGURATION,
-        .length = 4,
-        .data   = "DEADBEEF", // Example configuration data
-        .hmac   = "ABCD1234"  // Example HMAC
-    };
-    String hex      = payloadToHex(pkt);
-    String loraLine = "AT+TEST=TXLRPKT,\"" + hex + "\"";
-    loraSerial.println(loraLine);
-    delay(300);
-    loraSerial.println("AT+TEST=RXLRPKT");
+    LoraPayload pkt;
+    pkt.id = LORA_DEFAULT_NODE_ID;
+    pkt.ts = 123456; // Use current time in seconds as timestamp
+    encodePayload<PayloadType::SET_ALARM_STATE>({.alarmState = 1}, pkt);
+    sendDownlink(pkt);
   }
 #endif // SEND_TEST_DATA
 }
 
 /**
- * Non-blocking wait for LoRa module data and transmit the response to Serial for the Node RED server.
+ * Non-blocking wait for LoRa module data: advances the AT commands and hands the received lines to onLoraLine().
  */
 void listenLora() {
-  if (loraSerial.available()) {
-    String loraLine = loraSerial.readStringUntil('\n');
-    loraLine.trim();
+  loraAt.poll();
+}
 
+/**
+ * Called by the AT engine for every line printed by the LoRa module, transmits the payloads to Serial for the Node RED server.
+ * @param line The line, without line ending.
+ * @param length The number of characters of the line.
+ */
+void onLoraLine(const char* line, size_t length) {
 #ifdef DEBUG_SERIAL_PRINT
-    if (loraLine.startsWith("+TEST: RX \"")) {
-      Serial.println(String("[LoRa] Payload received (raw): ") + loraLine);
-    }
+  if (strncmp(line, "+TEST: RX \"", 11) == 0) {
+    Serial.println(String("[LoRa] Payload received (raw): ") + line);
+  }
 #endif // DEBUG_SERIAL_PRINT
 
-    String json = loraToSerial(loraLine);
-    if (json.length() > 0) {
-      Serial.println(json);
-    }
+  if (parseRxMetadata(line, length, lastRx)) return;
+  if (loraToSerial(line, length, host)) {
+    pumpSerialInputs(); // Printing waits for the USB link, meanwhile the LoRa module keeps printing
   }
 }
 
 /**
- * Non-blocking wait for Serial data and transmit the response to LoRa module.
+ * Non-blocking wait for Serial data and transmit the response to LoRa module. A partial line is kept until its end
+ * arrives, one complete line is handled per call.
  */
 void listenSerial() {
-  if (Serial.available()) {
-    String serialLine = Serial.readStringUntil('\n');
-    serialLine.trim();
+  if (!Serial) { // The host closed the port, the next one starts its session in Json
+    host.setVersion(HOST_PROTOCOL_JSON);
+    return;
+  }
 
+  size_t      length;
+  const char* line = serialLines.readLine(length);
+  if (line) {
 #ifdef DEBUG_SERIAL_PRINT
-    Serial.println(String("[Serial] Command received: ") + serialLine);
+    Serial.println(String("[Serial] Command received: ") + line);
 #endif // DEBUG_SERIAL_PRINT
 
-    String loraLine = serialToLora(serialLine);
-    if (loraLine.length() > 0) {
-      loraSerial.println(loraLine);
-      delay(300);
-      loraSerial.println("AT+TEST=RXLRPKT");
+    if (serialToHello(line, length)) return;
+    if (serialToTransfer(line, length)) return; // Sent by pumpTimeRangeTransfer()
+    if (serialToNodeCommand(line, length)) return;
+
+#ifdef LORA_CLASS_A
+    LoraPayload pkt = jsonToPayload(line, length);
+    if (nodes.find(pkt.id) && isPayloadLengthValid(pkt.type, pkt.length)) {
+      holdDownlink(pkt);
+      return;
     }
+#endif // LORA_CLASS_A
+
+    if (!serialToDownlink(line, length)) {
 #ifdef DEBUG_SERIAL_PRINT
-    else {
       Serial.println("[Serial] Invalid command, could not convert to LoRa.");
+#endif // DEBUG_SERIAL_PRINT
     }
+  }
+}
+
+/**
+ * Move the bytes already received from the LoRa module and from Serial into their ring buffers, without handling them.
+ * Called between the steps that can take long, so the small receive buffer of SoftwareSerial does not overflow.
+ */
+void pumpSerialInputs() {
+  loraAt.pump();
+  serialLines.pump();
+}
+
+/**
+ * Report the data lost on both links since the last report, with the totals since boot, e.g.
+ * {"error":"overrun","loraBytes":12,"loraLines":0,"serialBytes":0,"serialLines":1}. Bytes are lost when the LoRa module
+ * prints faster than the loop reads, lines when they are longer than the buffer of their link.
+ */
+void reportOverruns() {
+  uint32_t total = loraAt.getByteOverruns() + loraAt.getLineOverruns() + serialLines.getByteOverruns() + serialLines.getLineOverruns();
+  if (total == reportedOverruns) return;
+
+  reportedOverruns = total;
+  JsonWriter(host)
+      .member("error", "overrun")
+      .member("loraBytes", loraAt.getByteOverruns())
+      .member("loraLines", loraAt.getLineOverruns())
+      .member("serialBytes", serialLines.getByteOverruns())
+      .member("serialLines", serialLines.getLineOverruns())
+      .endLine();
+}
+
+/**
+ * Number and sign a downlink with the key of its node, queue its transmission, then switch the LoRa module back to
+ * listening once it printed TX DONE. The frame is written straight into the command queue, as bytes then hex.
+ * Downlinks exceeding the duty-cycle budget are dropped and reported to Serial, e.g. {"error":"duty_cycle","airtimeUsage":97}.
+ * @param pkt The downlink, pkt.id is the destination node. Its counter and hmac are set if it is sent.
+ * @return false if the downlink was dropped, it then took no frame counter.
+ */
+bool sendDownlink(LoraPayload& pkt) {
+  if (loraAt.freeSlots() < 2) {
+#ifdef DEBUG_SERIAL_PRINT
+    Serial.println("[LoRa] Command queue full, payload dropped.");
 #endif // DEBUG_SERIAL_PRINT
+    return false;
+  }
+
+  uint32_t airtimeUs = loraTimeOnAirUs(LORA_RF_CONFIG, frameWireSize(pkt));
+  if (!dutyCycle.tryConsume(airtimeUs, 0, millis())) {
+    JsonWriter(host).member("error", "duty_cycle").member("airtimeUsage", (uint32_t)dutyCycle.usagePercent(millis())).endLine();
+    return false;
   }
+#ifdef DEBUG_SERIAL_PRINT
+  Serial.println("[LoRa] Airtime: " + String(airtimeUs) + " us, duty-cycle budget used: " + String(dutyCycle.usagePercent(millis())) + "%");
+#endif // DEBUG_SERIAL_PRINT
+
+  pkt.counter = nextTxCounter();
+  pkt.hmac    = computeFrameMac(nodes.macKey(pkt.id), LoraDirection::DOWNLINK, pkt);
+  uint8_t frame[LORA_FRAME_MAX_BYTES];
+  loraAt.enqueueTransmit(frame, writeFrame(pkt, frame), LORA_AT_TX_TIMEOUT);
+  loraAt.enqueue("AT+TEST=RXLRPKT", "RXLRPKT", nullptr, LORA_AT_CMD_TIMEOUT);
+  return true;
 }
 
 /**
- * Converts a raw LoRa line (e.g. +TEST: RX,"<hex_data>") into a Json string representing the payload, or an empty string if the line is not recognized or the payload is invalid.
+ * Read the signal quality printed by the LoRa module before each received frame, e.g. +TEST: LEN:19, RSSI:-42, SNR:9.
  * @param loraLine The raw line received from the LoRa module.
- * @return A Json string representing the payload, e.g. {"id":1,"seq":0,"ts":0,"type":2,"data":1}, or an empty string if the line is not recognized or the payload is invalid.
+ * @param length The number of characters of the line.
+ * @param meta Set to the RSSI and SNR of the line, valid until the next frame is received.
+ * @return true if the line was such a line.
  */
-String loraToSerial(const String& loraLine) {
-  String json = "";
+bool parseRxMetadata(const char* loraLine, size_t length, LoraRxMetadata& meta) {
+  const size_t prefixLength = sizeof("+TEST: LEN:") - 1;
+  if (length <= prefixLength || strncmp(loraLine, "+TEST: LEN:", prefixLength) != 0) return false;
 
-  // Expected format: +TEST: RX,"<hex_data>"
-  if (loraLine.startsWith("+TEST: RX \"")) {
-    int q1 = loraLine.indexOf('"');
-    int q2 = loraLine.indexOf('"', q1 + 1);
+  // The line is null-terminated by the line reader
+  const char* rssiField = strstr(loraLine + prefixLength, "RSSI:");
+  const char* snrField  = strstr(loraLine + prefixLength, "SNR:");
+  meta.valid            = rssiField && snrField;
+  meta.rssi             = rssiField ? (int16_t)strtol(rssiField + 5, nullptr, 10) : 0;
+  meta.snr              = snrField ? (int8_t)strtol(snrField + 4, nullptr, 10) : 0;
+  return true;
+}
 
-    if (q1 >= 0 && q2 > q1) {
-      String hexData = loraLine.substring(q1 + 1, q2);
+/**
+ * Converts a raw LoRa line (e.g. +TEST: RX "<hex_data>") into the messages of the uplink it holds, sent to the host as they are built.
+ * Payloads from a node missing from the node table, with an already received frame counter or with a wrong MAC are dropped.
+ * Both v1 and compact v2 uplinks are accepted, they give the same Json. In a binary session, the frame is sent as received with its metadata instead.
+ * An authenticated uplink repeating a recent payload of its node, or over the rate of its node, is accounted then dropped before being formatted,
+ * after its transfer status, if any, was handed to the time range transfer.
+ * @param loraLine The raw line received from the LoRa module.
+ * @param length The number of characters of the line.
+ * @param out The host receiving the uplink, e.g. {"id":1,"cnt":7,"ts":0,"type":2,"length":1,"data":"01","hmac":"ABCD1234"}, one line per event for an event batch.
+ * @return true if the line was a valid uplink, false if nothing was sent.
+ */
+bool loraToSerial(const char* loraLine, size_t length, HostLink& out) {
+  // Expected format: +TEST: RX "<hex_data>"
+  const size_t prefixLength = sizeof("+TEST: RX \"") - 1;
+  if (length <= prefixLength || strncmp(loraLine, "+TEST: RX \"", prefixLength) != 0) return false;
+
+  const char* hex = loraLine + prefixLength;
+  const char* end = static_cast<const char*>(memchr(hex, '"', length - prefixLength));
+  if (!end) return false;
 #ifdef DEBUG_SERIAL_PRINT
-      Serial.println(String("[LoRa] Hex payload extracted: ") + hexData);
+  Serial.println(String("[LoRa] Hex payload extracted: ") + String(hex).substring(0, end - hex));
 #endif // DEBUG_SERIAL_PRINT
-      LoraPayload pkt;
 
-      if (hexToPayload(hexData, pkt)) {
-        if (pkt.id == EXPECTED_ID) {
-          json = payloadToJson(pkt);
+  LoraRxMetadata meta = lastRx;
+  lastRx.valid        = false; // Only describes this frame
 
+  LoraPayload pkt;
+  if (!hexToUplink(hex, end - hex, pkt)) {
 #ifdef DEBUG_SERIAL_PRINT
-          Serial.println(String("Converted LoRa hex to json Payload: ") + json);
+    Serial.println("Uplink dropped: invalid, from an unknown node, replayed or not authentic.");
 #endif // DEBUG_SERIAL_PRINT
-        }
-      }
+    return false;
+  }
+
+  nodes.acceptUplink(pkt.id, pkt.counter);
+  linkStats.record(pkt.id, pkt.counter, meta, millis());
+  trackUplinkLiveness(pkt);
+  handleTransferStatus(pkt); // A status repeating the previous one still asks for the missing fragments again
+  if (ingress.check(pkt, millis()) != IngressFilter::Verdict::FORWARD) {
 #ifdef DEBUG_SERIAL_PRINT
-      else {
-        Serial.println("Failed to convert hex to payload, invalid hex data.");
-      }
+    Serial.println("Uplink dropped: duplicate or over the rate of the node.");
 #endif // DEBUG_SERIAL_PRINT
-    }
+#ifdef LORA_CLASS_A
+    heldDownlinks.onUplink(pkt.id, millis() - loraRxReportMs(end - hex)); // The node listens after any uplink
+#endif // LORA_CLASS_A
+    return false;
+  }
+  if (out.isBinary()) {
+    uint8_t    frame[LORA_FRAME_MAX_BYTES];
+    size_t     frameSize = (end - hex) / 2; // Well-formed, checked by hexToUplink()
+    HostUplink uplink    = {
+        .id      = pkt.id,
+        .counter = pkt.counter,
+        .ts      = pkt.ts,
+        .rssi    = meta.valid ? meta.rssi : (int16_t)0,
+        .snr     = meta.valid ? meta.snr : (int8_t)0,
+        .rxMs    = (uint32_t)millis(),
+    };
+    hexToBytes(hex, frameSize * 2, frame);
+    out.sendUplink(uplink, frame, frameSize);
+  } else {
+    uplinkToJson(pkt, meta, out);
   }
+#ifdef LORA_CLASS_A
+  heldDownlinks.onUplink(pkt.id, millis() - loraRxReportMs(end - hex));
+#endif // LORA_CLASS_A
+  return true;
+}
 
-  return json;
+/**
+ * Updates the liveness of the node with an authenticated uplink, once per event for an event batch.
+ * @param pkt The authenticated payload received from the node.
+ */
+void trackUplinkLiveness(const LoraPayload& pkt) {
+  trackNodeLiveness(pkt); // Heard, even if none of the events of a batch is known
+  if (pkt.type != PayloadType::EVENT_BATCH) return;
+
+  LoraPayload event;
+  for (size_t i = 0; i < payloadRecordCount<PayloadType::EVENT_BATCH>(pkt); i++) {
+    if (expandEventRecord(pkt, i, event)) trackNodeLiveness(event);
+  }
 }
 
 /**
- * Converts a Json string representing a LoraPayload into a raw LoRa command line to send to the module, or an empty string if the Json is invalid.
- * @param serialLine The Json string received from Serial, e.g. {"id":1,"seq":0,"ts":0,"type":2,"data":1}
- * @return A raw LoRa command line to send to the module, e.g. AT+TEST=TXLRPKT,"<hex_data>", or an empty string if the Json is invalid.
+ * Prints an authenticated uplink as Json lines.
+ * An EVENT_BATCH payload is unpacked into one line per event, in the form the event would have been sent alone (see expandEventRecord()),
+ * with its index in the batch instead of the hmac.
+ * @param pkt The authenticated payload received from the node.
+ * @param meta The signal quality of the frame, repeated in each line.
+ * @param out The stream receiving the Json lines.
  */
-String serialToLora(const String& serialLine) {
-  LoraPayload pkt = jsonToPayload(serialLine);
-  printPayload(pkt);
-  if (pkt.id == 0) {
-    // Invalid payload, return empty string
-    return "";
+void uplinkToJson(const LoraPayload& pkt, const LoraRxMetadata& meta, Print& out) {
+  if (pkt.type != PayloadType::EVENT_BATCH) {
+    payloadToJson(pkt, meta, out);
+    return;
+  }
+
+  LoraPayload event;
+  for (size_t i = 0; i < payloadRecordCount<PayloadType::EVENT_BATCH>(pkt); i++) {
+    if (!expandEventRecord(pkt, i, event)) continue; // Unknown kind, e.g. from a newer edge firmware
+    eventToJson(event, i, meta, out);
   }
-  String hex      = payloadToHex(pkt);
-  String loraLine = "AT+TEST=TXLRPKT,\"" + hex + "\"";
-  return loraLine;
 }
 
 /**
- * Converts a hex string into a LoraPayload struct.
- * The hex string is expected to represent the binary data of the LoraPayload struct, with each byte represented as two hex characters (e.g. "0100000000003039" for a payload with id=1, seq=0, ts=0, type=CONFIGURATION, data=12345).
- * @param hex The hex string to convert.
- * @param pkt The output LoraPayload struct to fill with the converted data.
- * @return true if the conversion was successful, false if the hex string is invalid (e.g. wrong length, non-hex characters, etc.).
- */
-bool hexToPayload(const String& hex, LoraPayload& pkt) {
-  // Parse a 32-bit unsigned integer from big-endian hex (8 chars = 4 bytes).
-  auto parseU32BE = [](const String& s, size_t offset) -> uint32_t {
-    uint32_t value = 0;
-    for (size_t i = 0; i < 4; i++) {
-      String byteStr = s.substring(offset + i * 2, offset + i * 2 + 2);
-      value          = (value << 8) | (uint32_t)strtoul(byteStr.c_str(), nullptr, 16);
+ * Update the liveness of an edge node with an authenticated uplink. A heartbeat announces when the next one is due.
+ * If the node was reported offline, it is reported online again, e.g. {"id":1,"status":"online"}.
+ * @param pkt The authenticated payload received from the node.
+ */
+void trackNodeLiveness(const LoraPayload& pkt) {
+  NodeEntry* node = nodes.find(pkt.id);
+  if (!node) return;
+
+  uint16_t now = livenessTick(millis());
+  if (node->liveness.heard(now)) {
+    JsonWriter(host).member("id", (uint32_t)pkt.id).member("status", "online").endLine();
+  }
+
+  HeartbeatBody body;
+  if (decodePayload<PayloadType::EDGE_HEARTBEAT>(pkt, body)) {
+    node->liveness.heartbeat(now, heartbeatOfflineDelayMs(body.nextHeartbeat));
+  }
+}
+
+/**
+ * Report each edge node offline once the heartbeats it announced are missing, e.g. {"id":1,"status":"offline","silence":125}.
+ * A node that is quiet but sent its heartbeats on time stays online, however long its heartbeat interval is.
+ * Every registered node is checked once per liveness tick, silence is the time since its last uplink in seconds.
+ */
+void checkNodeLiveness() {
+  uint16_t now = livenessTick(millis());
+  if (now == livenessCheckedTick) return;
+  livenessCheckedTick = now;
+
+  for (uint8_t id = 1; id <= NODE_TABLE_MAX_ID; id++) {
+    NodeEntry* node = nodes.find(id);
+    if (!node || !node->liveness.check(now)) continue;
+    JsonWriter(host).member("id", (uint32_t)id).member("status", "offline").member("silence", node->liveness.silenceSeconds(now)).endLine();
+  }
+}
+
+/**
+ * Publish the radio statistics of the nodes heard recently at the end of each window, one compact Json line per node, e.g.
+ * {"id":1,"link":300,"frames":58,"lost":2,"duplicates":0,"limited":0,"rssi":[-97,-88,-80],"snr":[-4,3,8],"gaps":[0,0,12,44,1,0,0,0]}
+ * - link: length of the window, in seconds
+ * - frames, lost: frames received in the window, and frames missing from the sequence of their frame counters
+ * - duplicates, limited: frames of the window dropped by the ingress filter, left out if the filter does not follow the node
+ * - rssi, snr: minimum, mean and maximum, in dBm and dB, left out if the module did not report them
+ * - gaps: histogram of the delays between two frames of the node, bin i counting the delays below 4^i seconds
+ * A node without any frame in the window is published once with 0 frames, then no longer followed.
+ */
+void publishLinkStats() {
+  uint32_t now = millis();
+  if (now - linkStatsWindowStart < LINK_STATS_PERIOD_MS) return;
+
+  for (size_t i = 0; i < LINK_STATS_MAX_NODES; i++) {
+    const LinkStats& stats = linkStats.at(i);
+    if (stats.id == 0) continue;
+
+    JsonWriter json(host);
+    json.member("id", (uint32_t)stats.id)
+        .member("link", (now - linkStatsWindowStart) / 1000)
+        .member("frames", stats.frames)
+        .member("lost", stats.lost);
+    uint32_t duplicates, limited;
+    if (ingress.drops(stats.id, duplicates, limited)) {
+      json.member("duplicates", duplicates).member("limited", limited);
     }
-    return value;
-  };
+    if (stats.samples > 0) {
+      int32_t rssi[] = {stats.rssiMin, stats.rssiSum / stats.samples, stats.rssiMax};
+      int32_t snr[]  = {stats.snrMin, stats.snrSum / stats.samples, stats.snrMax};
+      json.memberArray("rssi", rssi, 3).memberArray("snr", snr, 3);
+    }
+    json.memberArray("gaps", stats.gaps, LINK_STATS_GAP_BINS);
+    json.endLine();
+    pumpSerialInputs();
+  }
+  linkStats.startWindow();
+  ingress.startWindow();
+  linkStatsWindowStart = now;
+}
 
-  size_t offset = 0;
+/**
+ * Handle the handshake selecting the protocol of the messages to the host for the rest of the session, e.g.
+ * {"cmd":"hello","version":2}. It is answered in the current protocol, e.g. {"hello":2,"format":"binary"}, the messages
+ * after the answer use the new one. An unsupported version is answered with {"error":"hello","reason":"unsupported_version"}.
+ * @param serialLine The Json line received from Serial.
+ * @param length The number of characters of the line.
+ * @return true if the line was a handshake.
+ */
+bool serialToHello(const char* serialLine, size_t length) {
+  bool     hello   = false;
+  uint64_t version = 0;
 
-  pkt.id = (uint8_t)strtoul(hex.substring(offset, offset + 2).c_str(), nullptr, 16);
-  offset += 2;
-  pkt.ts = parseU32BE(hex, offset);
-  offset += 8;
-  pkt.type = static_cast<PayloadType>(strtoul(hex.substring(offset, offset + 2).c_str(), nullptr, 16));
-  offset += 2;
-  pkt.length = (uint8_t)strtoul(hex.substring(offset, offset + 2).c_str(), nullptr, 16);
-  offset += 2;
+  JsonReader reader(serialLine, length);
+  while (reader.next()) {
+    if (reader.keyIs("cmd")) {
+      hello = reader.kind == JsonReader::Kind::STRING && reader.valueLength == 5 && memcmp(reader.value, "hello", 5) == 0;
+    } else if (reader.keyIs("version")) {
+      reader.toUint(version);
+    }
+  }
+  if (!hello) return false;
 
-  if (hex.length() - 8 < offset + pkt.length * 2) { // Invalid hex string, not enough data for the declared length
-#ifdef DEBUG_SERIAL_PRINT
-    Serial.println("Invalid hex string: not enough data for the declared length. Expected at least " + String(offset + pkt.length * 2) + String(" characters, but got ") + String(hex.length()) + " characters. offset: " + String(offset) + " length: " + String(pkt.length));
-#endif // DEBUG_SERIAL_PRINT
-    return false;
+  if (version != HOST_PROTOCOL_JSON && version != HOST_PROTOCOL_BINARY) {
+    JsonWriter(host).member("error", "hello").member("reason", "unsupported_version").endLine();
+    return true;
+  }
+  JsonWriter(host).member("hello", (uint32_t)version).member("format", version == HOST_PROTOCOL_BINARY ? "binary" : "json").endLine();
+  host.setVersion(version);
+  return true;
+}
+
+/**
+ * Handle the node table commands received from Serial, each answered with one Json line per node:
+ * - {"cmd":"node_set","id":2,"key":"<16 bytes>"} registers a node or replaces its key, answers {"id":2,"node":"registered"}
+ * - {"cmd":"node_remove","id":2} unregisters a node, answers {"id":2,"node":"removed"}
+ * - {"cmd":"node_list"} lists the registered nodes, e.g. {"id":2,"cnt":130,"lastSeen":42,"status":"online"}, lastSeen
+ *   being the number of seconds since the last uplink of the node, or -1 if none was received since the gateway started
+ * Invalid commands are answered with {"error":"node","reason":"..."}.
+ * @param serialLine The Json line received from Serial.
+ * @param length The number of characters of the line.
+ * @return true if the line was a node table command.
+ */
+bool serialToNodeCommand(const char* serialLine, size_t length) {
+  const char* cmd       = nullptr;
+  size_t      cmdLength = 0;
+  const char* key       = nullptr;
+  size_t      keyLength = 0;
+  uint64_t    idNumber  = 0;
+
+  JsonReader reader(serialLine, length);
+  while (reader.next()) {
+    if (reader.keyIs("cmd") && reader.kind == JsonReader::Kind::STRING) {
+      cmd       = reader.value;
+      cmdLength = reader.valueLength;
+    } else if (reader.keyIs("id")) {
+      if (!reader.toUint(idNumber)) idNumber = 0;
+    } else if (reader.keyIs("key") && reader.kind == JsonReader::Kind::STRING) {
+      key       = reader.value;
+      keyLength = reader.valueLength;
+    }
   }
+  if (!cmd) return false;
 
-  pkt.data = hex.substring(offset, offset + pkt.length * 2); // Each byte is represented by 2 hex characters
-  offset += pkt.length * 2;
-  pkt.hmac = hex.substring(offset, offset + 8); // Each byte is represented by 2 hex characters
-  offset += 8;
+  auto    cmdIs = [&](const char* name) { return strlen(name) == cmdLength && memcmp(name, cmd, cmdLength) == 0; };
+  uint8_t id    = idNumber > 0 && idNumber <= NODE_TABLE_MAX_ID ? idNumber : 0;
 
+  if (cmdIs("node_list")) {
+    for (uint8_t nodeId = 1; nodeId <= NODE_TABLE_MAX_ID; nodeId++) {
+      const NodeEntry* node = nodes.find(nodeId);
+      if (!node) continue;
+      const NodeLiveness& live     = node->liveness;
+      int32_t             lastSeen = live.isHeard() ? (int32_t)live.silenceSeconds(livenessTick(millis())) : -1;
+      JsonWriter(host)
+          .member("id", (uint32_t)nodeId)
+          .member("cnt", node->rxWindow.highestCounter())
+          .member("lastSeen", lastSeen)
+          .member("status", !live.isHeard() ? "unknown" : (live.isOffline() ? "offline" : "online"))
+          .endLine();
+      pumpSerialInputs();
+    }
+  } else if (cmdIs("node_set")) {
+    uint8_t keyBytes[LORA_MAC_KEY_BYTES];
+    if (id == 0 || keyLength != LORA_MAC_KEY_BYTES * 2 || !hexToBytes(key, keyLength, keyBytes)) {
+      JsonWriter(host).member("error", "node").member("reason", "invalid_node").endLine();
+    } else {
+      nodes.set(id, keyBytes);
+      JsonWriter(host).member("id", (uint32_t)id).member("node", "registered").endLine();
+    }
+  } else if (cmdIs("node_remove")) {
+    if (nodes.remove(id)) {
+      linkStats.remove(id);
+      ingress.remove(id);
+      JsonWriter(host).member("id", (uint32_t)id).member("node", "removed").endLine();
+    } else {
+      JsonWriter(host).member("error", "node").member("reason", "unknown_node").endLine();
+    }
+  } else {
+    JsonWriter(host).member("error", "node").member("reason", "unknown_command").endLine();
+  }
   return true;
 }
 
 /**
- * Converts a LoraPayload struct into a Json string representation.
- * The Json string will have the format {"id":1,"seq":0,"ts":0,"type":2,"data":1}.
- * @param pkt The LoraPayload struct to convert.
- * @return A Json string representation of the payload.
- */
-String payloadToJson(const LoraPayload& pkt) {
-  String json = "{";
-  json += "\"id\":" + String(pkt.id) + ",";
-  json += "\"ts\":" + String(pkt.ts) + ",";
-  json += "\"type\":" + String(static_cast<uint8_t>(pkt.type)) + ",";
-  json += "\"length\":" + String(pkt.length) + ",";
-  json += "\"data\":\"" + pkt.data + "\",";
-  json += "\"hmac\":\"" + String(pkt.hmac) + "\"";
-  json += "}";
-  return json;
+ * Converts a Json string representing a LoraPayload into a downlink sent by sendDownlink().
+ * The payload is numbered and signed by the gateway with the key of the destination node, so the Json does not need to provide the counter nor the hmac.
+ * @param serialLine The Json line received from Serial, e.g. {"id":1,"ts":0,"type":19,"length":1,"data":"01"}
+ * @param length The number of characters of the line.
+ * @return false if the Json is invalid or its node unknown, nothing was sent.
+ */
+bool serialToDownlink(const char* serialLine, size_t length) {
+  LoraPayload pkt = jsonToPayload(serialLine, length);
+  printPayload(pkt);
+  if (!nodes.find(pkt.id) || !isPayloadLengthValid(pkt.type, pkt.length)) return false;
+  sendDownlink(pkt); // The hmac received from Serial is ignored
+  return true;
 }
 
 /**
- * Converts a Json string representing a LoraPayload back into a LoraPayload struct.
- * @param json The Json string to convert, e.g. {"id":1,"seq":0,"ts":0,"type":2,"data":1}
- * @return The corresponding LoraPayload struct. If the Json is invalid or missing fields, the returned struct will have default values (0 or equivalent).
+ * Start the transfer of a time range rule set too large for a single SET_TIME_RANGE frame (more than 18 rules, up to 255).
+ * The Json has the same form as for a SET_TIME_RANGE payload, its length field is ignored. The rules are written straight
+ * into the buffer of the transfer, a few at a time: every line but the last one of the rule set has "more":true, e.g.
+ * {"id":1,"type":18,"data":"<up to 17 rules of 11 bytes>","more":true} then {"id":1,"type":18,"data":"<the last rules>"}.
+ * A transfer in progress is replaced by the first line, or cancelled if the rules are invalid. Only one node receives a transfer at a time.
+ * @param serialLine The Json line received from Serial.
+ * @param length The number of characters of the line.
+ * @return true if the line was part of such a rule set, it is then sent by pumpTimeRangeTransfer() once complete.
  */
-LoraPayload jsonToPayload(const String& json) {
-  // Expected LoraPayload in Json, e.g. {"id":1,"seq":0,"ts":0,"type":2,"data":1}
-  LoraPayload pkt = {
-      .id     = 0,
-      .ts     = 0,
-      .type   = PayloadType::UNKNOWN, // Default to UNKNOWN
-      .length = 1,                    // Default to 1
-  };
-  pkt.data = "00"; // Default to 0
-
-  // Extract id
-  int pos = json.indexOf("\"id\":");
-  if (pos >= 0) {
-    int    end = json.indexOf(",", pos);
-    String val = json.substring(pos + 5, end);
-    pkt.id     = (uint8_t)strtol(val.c_str(), nullptr, 10);
-  }
-
-  // Extract ts
-  pos = json.indexOf("\"ts\":");
-  if (pos >= 0) {
-    int      end     = json.indexOf(",", pos);
-    String   val     = json.substring(pos + 5, end);
-    uint64_t tsValue = strtoull(val.c_str(), nullptr, 10);
-    if (tsValue > 0xFFFFFFFFu) {
-      tsValue /= 1000; // Accept ms timestamps and convert to seconds.
-    }
-    if (tsValue > 0xFFFFFFFFu) {
-      tsValue = 0xFFFFFFFFu;
+bool serialToTransfer(const char* serialLine, size_t length) {
+  const char* hex      = nullptr;
+  size_t      hexSize  = 0;
+  uint64_t    type     = 0;
+  uint64_t    idNumber = 0;
+  bool        more     = false;
+
+  JsonReader reader(serialLine, length);
+  while (reader.next()) {
+    if (reader.keyIs("type")) {
+      reader.toUint(type);
+    } else if (reader.keyIs("id")) {
+      reader.toUint(idNumber);
+    } else if (reader.keyIs("data") && reader.kind == JsonReader::Kind::STRING) {
+      hex     = reader.value;
+      hexSize = reader.valueLength;
+    } else if (reader.keyIs("more")) {
+      more = reader.kind == JsonReader::Kind::LITERAL && reader.valueLength == 4 && memcmp(reader.value, "true", 4) == 0;
     }
-    pkt.ts = (uint32_t)tsValue;
   }
+  if (!reader.isValid() || !hex || type != static_cast<uint8_t>(PayloadType::SET_TIME_RANGE)) return false;
+
+  uint8_t nodeId = idNumber <= NODE_TABLE_MAX_ID ? idNumber : 0;
+  size_t  first  = nodeId == transferNode ? transferRules : 0; // A line for another node starts a new rule set
+  if (!more && first == 0 && hexSize <= MAX_PAYLOAD_DATA_SIZE * 2) return false; // Fits in a single frame
 
-  // Extract type
-  pos = json.indexOf("\"type\":");
-  if (pos >= 0) {
-    int    end = json.indexOf(",", pos);
-    String val = json.substring(pos + 7, end);
-    pkt.type   = static_cast<PayloadType>(strtol(val.c_str(), nullptr, 10));
+  transferRules = 0;
+  if (!nodes.find(nodeId)) {
+    JsonWriter(host).member("error", "transfer").member("reason", "unknown_node").endLine();
+    return true;
   }
 
-  // Extract length
-  pos = json.indexOf("\"length\":");
-  if (pos >= 0) {
-    int    end = json.indexOf(",", pos + 9);
-    String val = json.substring(pos + 9, end);
-    pkt.length = (uint8_t)strtol(val.c_str(), nullptr, 10);
+  size_t ruleCount = first + hexSize / 2 / TRANSFER_RULE_BYTES;
+  if (hexSize % (2 * TRANSFER_RULE_BYTES) != 0 || ruleCount > TRANSFER_MAX_RULES || !hexToBytes(hex, hexSize, timeRangeTransfer.ruleBuffer() + first * TRANSFER_RULE_BYTES)) {
+    JsonWriter(host).member("error", "transfer").member("reason", "invalid_rules").endLine();
+    return true;
   }
 
-  // Extract data
-  pos = json.indexOf("\"data\":\"");
-  if (pos >= 0) {
-    int    end = json.indexOf("\"", pos + 8);
-    String val = json.substring(pos + 8, end);
-    pkt.data   = val;
+  transferNode = nodeId;
+  if (more) {
+    transferRules = ruleCount;
+    return true;
   }
+  // The low byte of the next downlink counter differs from the one of the previous transfer, even after a reboot
+  timeRangeTransfer.begin(static_cast<uint8_t>(txCounter + 1), ruleCount, millis());
+  return true;
+}
 
-  // Extract hmac
-  pos = json.indexOf("\"hmac\":\"");
-  if (pos >= 0) {
-    int end  = json.indexOf("\"", pos + 8);
-    pkt.hmac = json.substring(pos + 8, end);
+/**
+ * Send the next fragment of the time range transfer in progress when the LoRa module can take it, and give up once the
+ * edge node stopped answering or was removed from the node table. A fragment refused by the duty cycle is sent again LORA_TRANSFER_RETRY_DELAY later.
+ */
+void pumpTimeRangeTransfer() {
+#ifdef LORA_CLASS_A
+  // Held fragments were not sent yet, the edge node cannot have answered
+  size_t fragmentsHeld = heldDownlinks.pending(transferNode);
+#else
+  size_t fragmentsHeld = 0;
+#endif // LORA_CLASS_A
+  if (fragmentsHeld == 0 && timeRangeTransfer.poll(millis()) == TransferSender::Event::FAILED) {
+    reportTransfer("failed");
+    return;
   }
 
-  if (pkt.length > MAX_PAYLOAD_DATA_SIZE) {
-    pkt.length = MAX_PAYLOAD_DATA_SIZE; // Truncate if length exceeds max
-  } else if (pkt.length == 0) {
-    pkt.length = 1;    // Default to 1 if length is 0
-    pkt.data   = "00"; // Default to "00"
+  NodeEntry* node = nodes.find(transferNode);
+  if (!node) return; // No fragment is sent anymore, the transfer fails once its status timeout expires
+
+  LoraPayload pkt;
+#ifdef LORA_CLASS_A
+  // Half of the queue is left to the other downlinks
+  if (fragmentsHeld >= LORA_DOWNLINK_QUEUE_SIZE / 2 || !timeRangeTransfer.nextFragment(millis(), pkt)) return;
+  pkt.id = transferNode;
+  pkt.ts = 0; // No time, the edge node keeps its RTC
+  if (holdDownlink(pkt)) {
+    timeRangeTransfer.fragmentSent(millis());
+  } else {
+    timeRangeTransfer.deferFragment(millis());
   }
+  return;
+#endif // LORA_CLASS_A
 
-  return pkt;
+  if (loraAt.freeSlots() < 2 || !timeRangeTransfer.nextFragment(millis(), pkt)) return;
+  pkt.id = transferNode;
+  pkt.ts = 0; // No time, the edge node keeps its RTC
+
+  if (sendDownlink(pkt)) {
+    timeRangeTransfer.fragmentSent(millis());
+  } else {
+    timeRangeTransfer.deferFragment(millis());
+  }
 }
 
 /**
- * Converts a LoraPayload struct into a hex string representation of its binary data, where each byte is represented as two hex characters (e.g. "0100000000003039" for a payload with id=1, seq=0, ts=0, type=CONFIGURATION, data=12345).
- * @param pkt The LoraPayload struct to convert.
- * @return A hex string representation of the payload's binary data.
- */
-String payloadToHex(const LoraPayload& pkt) {
-  // Append a single byte as two uppercase hex characters.
-  auto appendHexByte = [](String& out, uint8_t b) {
-    const char* hexChars = "0123456789ABCDEF";
-    out += hexChars[b >> 4];
-    out += hexChars[b & 0x0F];
-  };
-  auto appendHexBytesFromHexString = [](String& out, String hexStr, size_t maxBytes) {
-    const char* hexChars = "0123456789ABCDEF";
-    for (size_t i = 0; i < hexStr.length() && i < maxBytes * 2; i += 2) {
-      String  byteStr = hexStr.substring(i, i + 2);
-      uint8_t byteVal = (uint8_t)strtoul(byteStr.c_str(), nullptr, 16);
-      out += hexChars[byteVal >> 4];
-      out += hexChars[byteVal & 0x0F];
+ * Hand a TRANSFER_STATUS uplink to the time range transfer in progress: the fragments the edge node is missing are
+ * sent again, and the outcome is reported to Serial.
+ * @param pkt An authenticated uplink of an edge node, other payload types and other nodes are ignored.
+ */
+void handleTransferStatus(const LoraPayload& pkt) {
+  TransferStatusBody status;
+  if (pkt.id != transferNode || !decodePayload<PayloadType::TRANSFER_STATUS>(pkt, status)) return;
+
+  TransferSender::Event event = timeRangeTransfer.onStatus(status, millis());
+  if (event == TransferSender::Event::COMMITTED) {
+    reportTransfer("committed");
+  } else if (event == TransferSender::Event::FAILED) {
+    reportTransfer("failed");
+  }
+}
+
+/**
+ * Hold a downlink until the next receive window of its node, it is numbered and signed when it is sent.
+ * A full queue is reported to Serial, e.g. {"error":"downlink_queue","id":1}.
+ * @param pkt The downlink, pkt.id is the destination node.
+ * @return false if the downlink was dropped.
+ */
+bool holdDownlink(const LoraPayload& pkt) {
+#ifdef LORA_CLASS_A
+  if (heldDownlinks.push(pkt)) return true;
+  JsonWriter(host).member("error", "downlink_queue").member("id", (uint32_t)pkt.id).endLine();
+#endif // LORA_CLASS_A
+  return false;
+}
+
+/**
+ * Send the oldest held downlink of the node whose receive window is due. A downlink refused by the duty cycle waits
+ * for the next window. Does nothing without LORA_CLASS_A, downlinks are then sent as soon as they are received.
+ */
+void serveDownlinkWindow() {
+#ifdef LORA_CLASS_A
+  const LoraPayload* held = heldDownlinks.peek(millis());
+  if (!held || loraAt.freeSlots() < 2) return;
+
+  NodeEntry* node = nodes.find(held->id);
+  if (!node) { // Removed from the node table while its downlink was held
+    heldDownlinks.sent(millis(), 0);
+    return;
+  }
+
+  LoraPayload pkt = *held;
+  if (!sendDownlink(pkt)) {
+    heldDownlinks.skipWindow();
+    return;
+  }
+  heldDownlinks.sent(millis(), loraTxMs(LORA_RF_CONFIG, frameWireSize(pkt)));
+  if (pkt.type == PayloadType::SET_TIME_RANGE_FRAGMENT) {
+    timeRangeTransfer.restartTimeout(millis()); // The status timeout counts from the actual transmission
+  }
+#endif // LORA_CLASS_A
+}
+
+/**
+ * Report the outcome of the time range transfer to Serial, e.g. {"id":1,"transfer":42,"status":"committed"}.
+ * @param status "committed" once the edge node uses the new rule set, "failed" if it kept the previous one.
+ */
+void reportTransfer(const char* status) {
+  JsonWriter(host).member("id", (uint32_t)transferNode).member("transfer", (uint32_t)timeRangeTransfer.getTransferId()).member("status", status).endLine();
+}
+
+/**
+ * Decode an uplink frame, v1 or v2, look its node up in the node table and check its frame counter and MAC with the state of the node.
+ * The counter check is cheap, replayed frames are dropped before the MAC is computed.
+ * Each authentic v1 frame renews the epoch of the node used to rebuild the timestamps of its following v2 frames.
+ * @param hex The hex string of the frame, not null-terminated.
+ * @param length The number of hex characters.
+ * @param pkt The output LoraPayload struct, in v1 form whatever the version of the frame.
+ * @return true if the payload is an uplink from a registered node, is not replayed and is authentic. Its counter must then be accepted with NodeTable::acceptUplink().
+ */
+bool hexToUplink(const char* hex, size_t length, LoraPayload& pkt) {
+  uint8_t firstByte = 0;
+  if (length >= 2 && hexToBytes(hex, 2, &firstByte) && isFrameV2(firstByte)) {
+    LoraFrameDecoder decoder;
+    if (decoder.decodeHex(hex, length) != LoraFrameDecoder::Result::FRAME_V2) return false;
+    uint8_t    id   = decoder.frameV2()[1];
+    NodeEntry* node = nodes.find(id);
+    if (!node) return false;
+
+    FrameV2Result result = decodeFrameV2(nodes.macKey(id), decoder.frameV2(), decoder.frameV2Size(), node->rxWindow, node->epoch, millis(), pkt);
+    if (result == FrameV2Result::STALE_EPOCH) {
+      requestEpochRenewal(id);
     }
-  };
+#ifdef DEBUG_SERIAL_PRINT
+    if (result != FrameV2Result::OK) {
+      Serial.println("v2 frame rejected, reason " + String(static_cast<uint8_t>(result)));
+    }
+#endif // DEBUG_SERIAL_PRINT
+    return result == FrameV2Result::OK;
+  }
+
+  // A captured downlink has a valid MAC under the key of its node, its type is checked before the counter
+  if (!hexToPayload(hex, length, pkt) || !isUplinkType(pkt.type)) return false;
+  NodeEntry* node = nodes.find(pkt.id);
+  if (!node || !node->rxWindow.check(pkt.counter) || !verifyFrameMac(nodes.macKey(pkt.id), LoraDirection::UPLINK, pkt)) return false;
+  node->epoch.ts       = pkt.ts;
+  node->epoch.ms       = millis();
+  node->epoch.valid    = true;
+  node->epoch.id       = static_cast<uint8_t>(pkt.counter);
+  node->epoch.renewing = false;
+  return true;
+}
+
+/**
+ * Ask an edge node for a v1 frame, its v2 frames count their timestamps from an epoch the gateway missed.
+ * The frame telling so is not authenticated yet: a single RENEW_EPOCH is sent per epoch of the node, so neither a
+ * burst of stale frames nor a forger sends more, and the downlink still goes through the duty-cycle budget. The
+ * edge node renews its epoch every LORA_V2_EPOCH_INTERVAL frames anyway if this downlink is lost.
+ * @param id The node the stale frame claims to come from, registered in the node table.
+ */
+void requestEpochRenewal(uint8_t id) {
+  NodeEntry* node = nodes.find(id);
+  if (!node || node->epoch.renewing) return;
+  node->epoch.renewing = true;
+
+  LoraPayload pkt;
+  pkt.id = id;
+  pkt.ts = 0; // No time, the edge node keeps its RTC
+  encodePayload<PayloadType::RENEW_EPOCH>({}, pkt);
+#ifdef LORA_CLASS_A
+  holdDownlink(pkt); // Sent in the window following the next authentic uplink of the node
+#else
+  sendDownlink(pkt);
+#endif // LORA_CLASS_A
+}
+
+/**
+ * Converts a hex string into a LoraPayload struct.
+ * The hex string is expected to represent the binary data of the LoraPayload struct, with each byte represented as two hex characters (e.g. "01000000070000000001010101ABCD1234" for a payload with id=1, counter=7, ts=0, type=EDGE_HEARTBEAT, length=1, data=01, hmac=ABCD1234).
+ * @param hex The hex string to convert, not null-terminated.
+ * @param length The number of hex characters.
+ * @param pkt The output LoraPayload struct to fill with the converted data.
+ * @return true if the conversion was successful, false if the hex string is invalid (e.g. wrong length, non-hex characters, unknown type, etc.).
+ */
+bool hexToPayload(const char* hex, size_t length, LoraPayload& pkt) {
+  LoraFrameDecoder decoder;
+  if (decoder.decodeHex(hex, length) != LoraFrameDecoder::Result::FRAME) {
+#ifdef DEBUG_SERIAL_PRINT
+    Serial.print("Invalid hex string: ");
+    Serial.write((const uint8_t*)hex, length);
+    Serial.println();
+#endif // DEBUG_SERIAL_PRINT
+    return false;
+  }
+
+  pkt = decoder.payload();
+  if (!isPayloadLengthValid(pkt.type, pkt.length)) {
+#ifdef DEBUG_SERIAL_PRINT
+    Serial.println("Invalid payload length " + String(pkt.length) + " for type " + String(static_cast<uint8_t>(pkt.type)));
+#endif // DEBUG_SERIAL_PRINT
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Prints a LoraPayload struct as a Json line, without building it in memory.
+ * The Json line has the format {"id":1,"cnt":7,"ts":0,"type":1,"length":1,"data":"01","hmac":"ABCD1234","rssi":-87,"snr":6}.
+ * @param pkt The LoraPayload struct to convert.
+ * @param meta The signal quality of the frame of the payload, rssi and snr are left out if it is not valid.
+ * @param out The stream receiving the line.
+ */
+void payloadToJson(const LoraPayload& pkt, const LoraRxMetadata& meta, Print& out) {
+  uint8_t hmacBytes[LORA_FRAME_HMAC_BYTES];
+  WireField<uint32_t>::write(hmacBytes, pkt.hmac);
+
+  JsonWriter json(out);
+  writePayloadMembers(json, pkt).memberHex("hmac", hmacBytes, LORA_FRAME_HMAC_BYTES);
+  writeRxMetadata(json, meta).endLine();
+}
 
-  String hex;
-  hex.reserve(sizeof(LoraPayload) * 2);
+/**
+ * Prints an event expanded from an EVENT_BATCH payload as a Json line. The MAC only authenticates the whole batch, so
+ * the event is referenced by the counter of the batch and its index in it instead.
+ * The Json line has the format {"id":1,"cnt":7,"ts":0,"type":2,"length":1,"data":"01","evt":0,"rssi":-87,"snr":6}.
+ * @param event The payload built by expandEventRecord().
+ * @param index The index of the event in its batch.
+ * @param meta The signal quality of the frame of the batch, rssi and snr are left out if it is not valid.
+ * @param out The stream receiving the line.
+ */
+void eventToJson(const LoraPayload& event, size_t index, const LoraRxMetadata& meta, Print& out) {
+  JsonWriter json(out);
+  writePayloadMembers(json, event).member("evt", (uint32_t)index);
+  writeRxMetadata(json, meta).endLine();
+}
 
-  appendHexByte(hex, pkt.id);
+/**
+ * Write the members of a payload shared by the Json lines of the uplinks, before the hmac or the event index.
+ */
+JsonWriter& writePayloadMembers(JsonWriter& json, const LoraPayload& pkt) {
+  return json.member("id", (uint32_t)pkt.id)
+      .member("cnt", pkt.counter)
+      .member("ts", pkt.ts)
+      .member("type", (uint32_t) static_cast<uint8_t>(pkt.type))
+      .member("length", (uint32_t)pkt.length)
+      .memberHex("data", pkt.data, pkt.length);
+}
+
+/**
+ * Write the signal quality of a frame, left out if it is not valid.
+ */
+JsonWriter& writeRxMetadata(JsonWriter& json, const LoraRxMetadata& meta) {
+  if (meta.valid) {
+    json.member("rssi", (int32_t)meta.rssi).member("snr", (int32_t)meta.snr);
+  }
+  return json;
+}
 
-  appendHexByte(hex, (uint8_t)((pkt.ts >> 24) & 0xFF));
-  appendHexByte(hex, (uint8_t)((pkt.ts >> 16) & 0xFF));
-  appendHexByte(hex, (uint8_t)((pkt.ts >> 8) & 0xFF));
-  appendHexByte(hex, (uint8_t)(pkt.ts & 0xFF));
+/**
+ * Converts a Json line representing a LoraPayload into a LoraPayload struct, in a single pass and whatever the order of its members.
+ * Unknown members (e.g. cnt, which is assigned by the gateway) are ignored.
+ * @param json The Json line to convert, e.g. {"id":1,"ts":0,"type":19,"length":1,"data":"01","hmac":"ABCD1234"}
+ * @param length The number of characters of the line.
+ * @return The corresponding LoraPayload struct. Missing members keep their default values (0 or equivalent), and the id is set to 0 if the line is not valid Json or its data is not hex.
+ */
+LoraPayload jsonToPayload(const char* json, size_t length) {
+  LoraPayload pkt = {
+      .id      = 0,
+      .counter = 0,                    // Assigned by the gateway when the payload is sent
+      .ts      = 0,
+      .type    = PayloadType::UNKNOWN, // Default to UNKNOWN
+      .length  = 1,                    // Default to 1
+      .data    = {0},                  // Default to 0
+      .hmac    = 0,
+  };
 
-  appendHexByte(hex, static_cast<uint8_t>(pkt.type));
+  // The data is decoded once the length is known, whichever member comes first
+  const char* dataHex    = nullptr;
+  size_t      dataLength = 0;
+  uint64_t    number     = 0;
 
-  appendHexByte(hex, (uint8_t)(pkt.length & 0xFF));
+  JsonReader reader(json, length);
+  while (reader.next()) {
+    if (reader.keyIs("id") && reader.toUint(number)) {
+      pkt.id = (uint8_t)number;
+    } else if (reader.keyIs("ts") && reader.toUint(number)) {
+      if (number > 0xFFFFFFFFu) {
+        number /= 1000; // Accept ms timestamps and convert to seconds.
+      }
+      pkt.ts = number > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)number;
+    } else if (reader.keyIs("type") && reader.toUint(number)) {
+      pkt.type = parsePayloadType((uint8_t)number).value_or(PayloadType::UNKNOWN);
+    } else if (reader.keyIs("length") && reader.toUint(number)) {
+      pkt.length = (uint8_t)number;
+    } else if (reader.keyIs("data") && reader.kind == JsonReader::Kind::STRING) {
+      dataHex    = reader.value;
+      dataLength = reader.valueLength;
+    } else if (reader.keyIs("hmac") && reader.kind == JsonReader::Kind::STRING) {
+      uint8_t hmacBytes[LORA_FRAME_HMAC_BYTES];
+      if (reader.valueLength == LORA_FRAME_HMAC_BYTES * 2 && hexToBytes(reader.value, LORA_FRAME_HMAC_BYTES * 2, hmacBytes)) {
+        uint32_t hmac;
+        WireField<uint32_t>::read(hmacBytes, hmac);
+        pkt.hmac = hmac;
+      }
+    }
+  }
+  if (!reader.isValid()) {
+    pkt.id = 0; // Not a Json object, mark the payload as invalid
+    return pkt;
+  }
 
-  appendHexBytesFromHexString(hex, pkt.data, pkt.length);
+  if (pkt.length > MAX_PAYLOAD_DATA_SIZE) {
+    pkt.length = MAX_PAYLOAD_DATA_SIZE; // Truncate if length exceeds max
+  } else if (pkt.length == 0) {
+    pkt.length = 1; // Default to 1 if length is 0, data is already 0
+  }
 
-  appendHexBytesFromHexString(hex, pkt.hmac, 4);
+  // Missing bytes are left to 0, extra data is ignored
+  if (dataLength > (size_t)pkt.length * 2) {
+    dataLength = pkt.length * 2;
+  }
+  if (dataHex && !hexToBytes(dataHex, dataLength & ~(size_t)1, pkt.data)) {
+    pkt.id = 0; // Invalid hex data, mark the payload as invalid
+  }
 
-  return hex;
+  return pkt;
 }
 
 void printPayload(const LoraPayload& pkt) {
@@ -367,15 +985,51 @@ void printPayload(const LoraPayload& pkt) {
 
   Serial.print("  ID: ");
   Serial.println(pkt.id);
+  Serial.print("  Counter: ");
+  Serial.println(pkt.counter);
   Serial.print("  TS: ");
   Serial.println(pkt.ts);
   Serial.print("  Type: ");
   Serial.println(static_cast<uint8_t>(pkt.type), HEX);
   Serial.print("  Length: ");
   Serial.println(pkt.length, HEX);
+  char dataHex[MAX_PAYLOAD_DATA_SIZE * 2 + 1];
+  bytesToHex(pkt.data, pkt.length, dataHex);
   Serial.print("  Data: ");
-  Serial.println(pkt.data);
+  Serial.println(dataHex);
   Serial.print("  HMAC: ");
-  Serial.println(pkt.hmac);
+  Serial.println(pkt.hmac, HEX);
 #endif // DEBUG_SERIAL_PRINT
 }
+
+/**
+ * Get the counter of the next downlink frame. Counters are reserved in EEPROM by blocks of LORA_COUNTER_BLOCK,
+ * so the EEPROM is written once every LORA_COUNTER_BLOCK frames and a counter is never reused after a reboot.
+ * @return The frame counter to send, starting at 1.
+ */
+uint32_t nextTxCounter() {
+  if (txCounter >= txCounterLimit) {
+    txCounterLimit = txCounter + LORA_COUNTER_BLOCK;
+    storeFrameCounterEEPROM(EEPROM_LORA_TX_COUNTER_ADDRESS, txCounterLimit);
+  }
+  return ++txCounter;
+}
+
+/**
+ * Read a frame counter from EEPROM.
+ * @return The stored counter, or 0 if the EEPROM was never written (erased bytes read as 0xFF).
+ */
+uint32_t readFrameCounterEEPROM(int address) {
+  uint32_t counter = ((uint32_t)EEPROM.read(address) << 24) | ((uint32_t)EEPROM.read(address + 1) << 16) | ((uint32_t)EEPROM.read(address + 2) << 8) | EEPROM.read(address + 3);
+  return counter == 0xFFFFFFFF ? 0 : counter;
+}
+
+/**
+ * Store a frame counter in EEPROM. Only the bytes that changed are written, to limit the wear.
+ */
+void storeFrameCounterEEPROM(int address, uint32_t counter) {
+  EEPROM.update(address, (counter >> 24) & 0xFF);
+  EEPROM.update(address + 1, (counter >> 16) & 0xFF);
+  EEPROM.update(address + 2, (counter >> 8) & 0xFF);
+  EEPROM.update(address + 3, counter & 0xFF);
+}
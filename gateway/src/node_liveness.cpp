@@ -0,0 +1,21 @@
+#include "node_liveness.h"
+
+bool NodeLiveness::heard(uint16_t nowTick) {
+  bool wasOffline = offlineAt == OFFLINE;
+  lastSeen        = nowTick;
+  if (offlineAt == UNHEARD || wasOffline) offlineAt = NO_HEARTBEAT;
+  return wasOffline;
+}
+
+void NodeLiveness::heartbeat(uint16_t nowTick, uint32_t offlineDelayMs) {
+  uint32_t ticks = (offlineDelayMs >> NODE_LIVENESS_TICK_SHIFT) + 1; // Rounded up
+  offlineAt      = static_cast<uint16_t>(nowTick + (ticks < NODE_LIVENESS_MAX_TICKS ? ticks : NODE_LIVENESS_MAX_TICKS));
+  if (offlineAt < FIRST_DEADLINE) offlineAt = FIRST_DEADLINE;
+}
+
+bool NodeLiveness::check(uint16_t nowTick) {
+  if (static_cast<uint16_t>(nowTick - lastSeen) > NODE_LIVENESS_MAX_TICKS) lastSeen = static_cast<uint16_t>(nowTick - NODE_LIVENESS_MAX_TICKS);
+  if (offlineAt < FIRST_DEADLINE || static_cast<int16_t>(nowTick - offlineAt) <= 0) return false;
+  offlineAt = OFFLINE;
+  return true;
+}
@@ -0,0 +1,91 @@
+#include "node_table.h"
+#include "main.h"
+#include <EEPROM.h>
+
+void NodeTable::load() {
+  for (uint8_t id = 1; id <= NODE_TABLE_MAX_ID; id++) {
+    int  address      = entryAddress(id);
+    bool isRegistered = false;
+    for (size_t i = 0; i < LORA_MAC_KEY_BYTES; i++) {
+      isRegistered = isRegistered || EEPROM.read(address + i) != 0xFF;
+    }
+    setRegistered(id, isRegistered);
+    entries[id - 1] = NodeEntry{};
+    if (!isRegistered) continue;
+
+    // Counters accepted before the reboot may be anywhere in the reserved block, so start after it. The block of an
+    // older firmware may not be aligned: the window starts at the end of the aligned block holding it.
+    entries[id - 1].rxWindow.restore(blockEnd(readFrameCounterEEPROM(address + LORA_MAC_KEY_BYTES)));
+  }
+}
+
+LoraMacKey NodeTable::macKey(uint8_t id) const {
+  uint8_t key[LORA_MAC_KEY_BYTES];
+  int     address = entryAddress(id);
+  for (size_t i = 0; i < LORA_MAC_KEY_BYTES; i++) {
+    key[i] = EEPROM.read(address + i);
+  }
+  return loraMacKeyFromBytes(key);
+}
+
+bool NodeTable::set(uint8_t id, const uint8_t (&key)[LORA_MAC_KEY_BYTES]) {
+  if (id == 0 || id > NODE_TABLE_MAX_ID) return false;
+
+  int address = entryAddress(id);
+  if (!isRegistered(id)) {
+    entries[id - 1] = NodeEntry{}; // No counter received, no epoch yet, not heard
+    setRegistered(id, true);
+    storeFrameCounterEEPROM(address + LORA_MAC_KEY_BYTES, 0);
+  }
+
+  for (size_t i = 0; i < LORA_MAC_KEY_BYTES; i++) {
+    EEPROM.update(address + i, key[i]);
+  }
+  return true;
+}
+
+bool NodeTable::remove(uint8_t id) {
+  if (!find(id)) return false;
+
+  setRegistered(id, false);
+  int address = entryAddress(id);
+  for (size_t i = 0; i < EEPROM_NODE_ENTRY_BYTES; i++) {
+    EEPROM.update(address + i, 0xFF);
+  }
+  return true;
+}
+
+void NodeTable::acceptUplink(uint8_t id, uint32_t counter) {
+  NodeEntry* node = find(id);
+  if (!node) return;
+
+  if (counter > blockEnd(node->rxWindow.highestCounter())) { // Reserve the next block first, a reboot right after cannot reopen the counter
+    storeFrameCounterEEPROM(entryAddress(id) + LORA_MAC_KEY_BYTES, blockEnd(counter));
+  }
+  node->rxWindow.accept(counter);
+}
+
+void NodeTable::restoreCounter(uint8_t id, uint32_t counter) {
+  NodeEntry* node = find(id);
+  if (!node) return;
+
+  node->rxWindow.restore(blockEnd(counter));
+  storeFrameCounterEEPROM(entryAddress(id) + LORA_MAC_KEY_BYTES, blockEnd(counter));
+}
+
+size_t NodeTable::count() const {
+  size_t count = 0;
+  for (uint8_t id = 1; id <= NODE_TABLE_MAX_ID; id++) {
+    if (isRegistered(id)) count++;
+  }
+  return count;
+}
+
+void NodeTable::setRegistered(uint8_t id, bool value) {
+  uint8_t bit = static_cast<uint8_t>(1 << ((id - 1) % 8));
+  if (value) {
+    registered[(id - 1) / 8] |= bit;
+  } else {
+    registered[(id - 1) / 8] &= static_cast<uint8_t>(~bit);
+  }
+}
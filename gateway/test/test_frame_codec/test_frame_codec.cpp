@@ -0,0 +1,305 @@
+#include "main.h"
+#include "node_table.h"
+#include <lora_frame_decoder.h>
+#include <lora_frame_v2.h>
+#include <lora_transfer.h>
+#include <unity.h>
+
+#define NODE_ID 7
+#define NODE_TS 1790000000
+
+extern NodeTable      nodes;             // Node table of the gateway, in main.cpp
+extern uint32_t       txCounter;         // Last downlink frame counter used, in main.cpp
+extern TransferSender timeRangeTransfer; // Time range transfer of the gateway, in main.cpp
+extern uint8_t        transferNode;
+
+static const LoraMacKey KEY = loraMacKeyFromBytes(LORA_DEFAULT_MAC_KEY);
+
+void setUp() {
+  nodes.remove(NODE_ID);
+  nodes.set(NODE_ID, LORA_DEFAULT_MAC_KEY);
+}
+
+void tearDown() {}
+
+/**
+ * @return A signed heartbeat, with an interval that the v2 frames carry exactly.
+ */
+static LoraPayload heartbeatPayload(uint32_t counter, uint32_t ts) {
+  LoraPayload pkt = {};
+  pkt.id          = NODE_ID;
+  pkt.counter     = counter;
+  pkt.ts          = ts;
+  encodePayload<PayloadType::EDGE_HEARTBEAT>({.alarmState = 2, .airtimeUsage = 7, .nextHeartbeat = 960}, pkt);
+  pkt.hmac = computeFrameMac(KEY, LoraDirection::UPLINK, pkt);
+  return pkt;
+}
+
+static void assertSamePayload(const LoraPayload& expected, const LoraPayload& actual) {
+  TEST_ASSERT_EQUAL_UINT8(expected.id, actual.id);
+  TEST_ASSERT_EQUAL_UINT32(expected.counter, actual.counter);
+  TEST_ASSERT_EQUAL_UINT32(expected.ts, actual.ts);
+  TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(expected.type), static_cast<uint8_t>(actual.type));
+  TEST_ASSERT_EQUAL_UINT8(expected.length, actual.length);
+  TEST_ASSERT_EQUAL_MEMORY(expected.data, actual.data, expected.length);
+}
+
+/**
+ * @return The number of hex characters of the v1 frame of a payload, written to hex.
+ */
+static size_t frameToHex(const LoraPayload& pkt, char* hex) {
+  uint8_t frame[LORA_FRAME_MAX_BYTES];
+  size_t  size = writeFrame(pkt, frame);
+  TEST_ASSERT_EQUAL(frameWireSize(pkt), size);
+  return bytesToHex(frame, size, hex);
+}
+
+static void test_v1_round_trip() {
+  LoraPayload pkt = heartbeatPayload(42, NODE_TS);
+  char        hex[LORA_FRAME_MAX_BYTES * 2 + 1];
+  size_t      length = frameToHex(pkt, hex);
+  TEST_ASSERT_EQUAL(2 * frameWireSize(pkt), length);
+
+  LoraPayload decoded;
+  TEST_ASSERT_TRUE(hexToPayload(hex, length, decoded));
+  assertSamePayload(pkt, decoded);
+  TEST_ASSERT_EQUAL_HEX32(pkt.hmac, decoded.hmac);
+}
+
+static void test_v1_round_trip_of_the_largest_payload() {
+  LoraPayload pkt = {};
+  pkt.id          = NODE_ID;
+  pkt.counter     = 0x01020304;
+  pkt.ts          = NODE_TS;
+
+  TimeRangeFragmentHeader header = {.transferId = 3, .fragmentIndex = 0, .fragmentCount = 1, .ruleCount = 1, .ruleSetHash = 0x01020304};
+  encodePayload<PayloadType::SET_TIME_RANGE_FRAGMENT>(header, pkt);
+  while (pkt.length + BODY_WIRE_SIZE<PayloadType::SET_TIME_RANGE> <= MAX_PAYLOAD_DATA_SIZE) {
+    memset(pkt.data + pkt.length, 0xA5, BODY_WIRE_SIZE<PayloadType::SET_TIME_RANGE>); // Filler rules, the codec does not look into them
+    pkt.length += BODY_WIRE_SIZE<PayloadType::SET_TIME_RANGE>;
+  }
+
+  char        hex[LORA_FRAME_MAX_BYTES * 2 + 1];
+  size_t      length = frameToHex(pkt, hex);
+  LoraPayload decoded;
+  TEST_ASSERT_TRUE(hexToPayload(hex, length, decoded));
+  assertSamePayload(pkt, decoded);
+}
+
+static void test_v1_uplink_is_authenticated() {
+  LoraPayload pkt = heartbeatPayload(5, NODE_TS);
+  char        hex[LORA_FRAME_MAX_BYTES * 2 + 1];
+  size_t      length = frameToHex(pkt, hex);
+
+  LoraPayload decoded;
+  TEST_ASSERT_TRUE(hexToUplink(hex, length, decoded));
+  assertSamePayload(pkt, decoded);
+  TEST_ASSERT_TRUE(nodes.find(NODE_ID)->epoch.valid);
+  TEST_ASSERT_EQUAL_UINT32(NODE_TS, nodes.find(NODE_ID)->epoch.ts);
+
+  hex[length - 1] = hex[length - 1] == '0' ? '1' : '0'; // Last digit of the hmac
+  TEST_ASSERT_FALSE(hexToUplink(hex, length, decoded));
+
+  // The same frame signed as a downlink, e.g. captured from the gateway
+  pkt.hmac = computeFrameMac(KEY, LoraDirection::DOWNLINK, pkt);
+  length   = frameToHex(pkt, hex);
+  TEST_ASSERT_FALSE(hexToUplink(hex, length, decoded));
+
+  nodes.remove(NODE_ID);
+  pkt    = heartbeatPayload(5, NODE_TS);
+  length = frameToHex(pkt, hex);
+  TEST_ASSERT_FALSE(hexToUplink(hex, length, decoded));
+}
+
+static void test_v2_round_trip_with_estimated_timestamp() {
+  LoraEpoch   epoch = {.ts = NODE_TS, .ms = 0, .valid = true};
+  LoraPayload pkt   = heartbeatPayload(3, NODE_TS + 10);
+  uint8_t     frame[LORA_FRAME_MAX_BYTES];
+  size_t      size = writeFrameV2(KEY, pkt, epoch, 10000, frame);
+  TEST_ASSERT_GREATER_THAN(0, size);
+  TEST_ASSERT_LESS_THAN(frameWireSize(pkt), size);
+  TEST_ASSERT_FALSE(frame[0] & LORA_V2_FLAG_TIMESTAMP);
+
+  ReplayWindow  window;
+  LoraEpoch     receiverEpoch = epoch;
+  LoraPayload   decoded;
+  FrameV2Result result = decodeFrameV2(KEY, frame, size, window, receiverEpoch, 10400, decoded);
+  TEST_ASSERT_EQUAL(FrameV2Result::OK, result);
+  assertSamePayload(pkt, decoded);
+}
+
+static void test_v2_round_trip_with_timestamp_delta() {
+  LoraEpoch   epoch = {.ts = NODE_TS, .ms = 0, .valid = true};
+  LoraPayload pkt   = heartbeatPayload(300, NODE_TS + 300); // Created long before it is sent
+  uint8_t     frame[LORA_FRAME_MAX_BYTES];
+  size_t      size = writeFrameV2(KEY, pkt, epoch, 900000, frame);
+  TEST_ASSERT_GREATER_THAN(0, size);
+  TEST_ASSERT_TRUE(frame[0] & LORA_V2_FLAG_TIMESTAMP);
+
+  ReplayWindow window;
+  window.restore(290);
+  LoraEpoch   receiverEpoch = epoch;
+  LoraPayload decoded;
+  TEST_ASSERT_EQUAL(FrameV2Result::OK, decodeFrameV2(KEY, frame, size, window, receiverEpoch, 900000, decoded));
+  assertSamePayload(pkt, decoded);
+
+  // Without the epoch, the delta cannot be turned into a timestamp
+  LoraEpoch noEpoch = {};
+  TEST_ASSERT_EQUAL(FrameV2Result::NO_EPOCH, decodeFrameV2(KEY, frame, size, window, noEpoch, 900000, decoded));
+
+  window.accept(300);
+  TEST_ASSERT_EQUAL(FrameV2Result::REPLAYED, decodeFrameV2(KEY, frame, size, window, receiverEpoch, 900000, decoded));
+}
+
+static void test_v2_single_event_carries_its_age() {
+  // A motion event flushed from the event ring 15 s after it was recorded
+  LoraEpoch   epoch = {.ts = NODE_TS, .ms = 0, .valid = true, .id = 1};
+  LoraPayload pkt   = {};
+  pkt.id            = NODE_ID;
+  pkt.counter       = 4;
+  pkt.ts            = NODE_TS + 585;
+  appendPayloadRecord<PayloadType::EVENT_BATCH>({.kind = static_cast<uint8_t>(EventKind::MOTION), .offsetMs = 0, .value = {1}}, pkt);
+  uint8_t frame[LORA_FRAME_MAX_BYTES];
+  size_t  size = writeFrameV2(KEY, pkt, epoch, 600000, frame);
+  TEST_ASSERT_EQUAL(10, size); // Less than half of the 22 bytes of the v1 frame
+  TEST_ASSERT_FALSE(frame[0] & LORA_V2_FLAG_TIMESTAMP);
+
+  ReplayWindow window;
+  LoraPayload  decoded;
+  TEST_ASSERT_EQUAL(FrameV2Result::OK, decodeFrameV2(KEY, frame, size, window, epoch, 600000, decoded));
+  assertSamePayload(pkt, decoded);
+
+  // Older than LORA_V2_MAX_EVENT_AGE, the timestamp is sent as a delta
+  pkt.ts = NODE_TS + 300;
+  size   = writeFrameV2(KEY, pkt, epoch, 600000, frame);
+  TEST_ASSERT_TRUE(frame[0] & LORA_V2_FLAG_TIMESTAMP);
+  TEST_ASSERT_EQUAL(FrameV2Result::OK, decodeFrameV2(KEY, frame, size, window, epoch, 600000, decoded));
+  assertSamePayload(pkt, decoded);
+
+  // A batch of several events keeps its records
+  pkt.ts = NODE_TS + 600;
+  appendPayloadRecord<PayloadType::EVENT_BATCH>({.kind = static_cast<uint8_t>(EventKind::MOTION), .offsetMs = 900, .value = {0}}, pkt);
+  size = writeFrameV2(KEY, pkt, epoch, 600000, frame);
+  TEST_ASSERT_EQUAL(FrameV2Result::OK, decodeFrameV2(KEY, frame, size, window, epoch, 600000, decoded));
+  assertSamePayload(pkt, decoded);
+}
+
+static void test_v2_frame_of_a_lost_epoch_is_stale() {
+  // The receiver missed the v1 frame (counter 17) that renewed the epoch of the sender 100 s after its own
+  LoraEpoch   receiverEpoch = {.ts = NODE_TS, .ms = 0, .valid = true, .id = 1};
+  LoraEpoch   senderEpoch   = {.ts = NODE_TS + 100, .ms = 100000, .valid = true, .id = 17};
+  LoraPayload pkt           = heartbeatPayload(20, NODE_TS + 140);
+  uint8_t     frame[LORA_FRAME_MAX_BYTES];
+  size_t      size = writeFrameV2(KEY, pkt, senderEpoch, 130000, frame);
+  TEST_ASSERT_TRUE(frame[0] & LORA_V2_FLAG_TIMESTAMP);
+
+  ReplayWindow window;
+  window.restore(16);
+  LoraPayload decoded;
+  TEST_ASSERT_EQUAL(FrameV2Result::STALE_EPOCH, decodeFrameV2(KEY, frame, size, window, receiverEpoch, 130000, decoded));
+  TEST_ASSERT_EQUAL(FrameV2Result::OK, decodeFrameV2(KEY, frame, size, window, senderEpoch, 130000, decoded));
+  assertSamePayload(pkt, decoded);
+
+  // Told apart before the MAC, whatever the MAC
+  frame[size - 1] ^= 0x01;
+  TEST_ASSERT_EQUAL(FrameV2Result::STALE_EPOCH, decodeFrameV2(KEY, frame, size, window, receiverEpoch, 130000, decoded));
+  TEST_ASSERT_EQUAL(FrameV2Result::BAD_MAC, decodeFrameV2(KEY, frame, size, window, senderEpoch, 130000, decoded));
+}
+
+static void test_stale_v2_uplink_requests_a_single_renewal() {
+  LoraPayload v1 = heartbeatPayload(1, NODE_TS);
+  char        hex[LORA_FRAME_MAX_BYTES * 2 + 1];
+  size_t      length = frameToHex(v1, hex);
+  LoraPayload decoded;
+  TEST_ASSERT_TRUE(hexToUplink(hex, length, decoded));
+  nodes.acceptUplink(NODE_ID, 1);
+
+  // Two frames with a delta from the epoch of a later v1 frame, which was lost
+  LoraEpoch lostEpoch = {.ts = NODE_TS + 100, .ms = (uint32_t)millis(), .valid = true, .id = 17};
+  uint8_t   frame[LORA_FRAME_MAX_BYTES];
+  char      v2Hex[LORA_FRAME_MAX_BYTES * 2 + 1];
+  uint32_t  downlinks = txCounter;
+  for (uint32_t counter = 18; counter <= 19; counter++) {
+    LoraPayload v2       = heartbeatPayload(counter, NODE_TS + 160);
+    size_t      v2Length = bytesToHex(frame, writeFrameV2(KEY, v2, lostEpoch, lostEpoch.ms, frame), v2Hex);
+    TEST_ASSERT_FALSE(hexToUplink(v2Hex, v2Length, decoded));
+    TEST_ASSERT_TRUE(nodes.find(NODE_ID)->epoch.renewing);
+  }
+  TEST_ASSERT_EQUAL_UINT32(downlinks + 1, txCounter); // A single RENEW_EPOCH downlink
+
+  // The v1 frame sent in answer renews the epoch
+  v1     = heartbeatPayload(20, NODE_TS + 170);
+  length = frameToHex(v1, hex);
+  TEST_ASSERT_TRUE(hexToUplink(hex, length, decoded));
+  TEST_ASSERT_FALSE(nodes.find(NODE_ID)->epoch.renewing);
+  TEST_ASSERT_EQUAL_UINT8(20, nodes.find(NODE_ID)->epoch.id);
+}
+
+static void test_v2_uplink_needs_the_epoch_of_its_node() {
+  LoraPayload v1 = heartbeatPayload(1, NODE_TS);
+  char        hex[LORA_FRAME_MAX_BYTES * 2 + 1];
+  size_t      length = frameToHex(v1, hex);
+
+  // Sent once the v1 frame renewed the epoch of the edge, with a delta as the payload waited
+  LoraEpoch   epoch = {.ts = NODE_TS, .ms = (uint32_t)millis(), .valid = true, .id = 1};
+  LoraPayload v2    = heartbeatPayload(2, NODE_TS + 60);
+  uint8_t     frame[LORA_FRAME_MAX_BYTES];
+  char        v2Hex[LORA_FRAME_MAX_BYTES * 2 + 1];
+  size_t      v2Length = bytesToHex(frame, writeFrameV2(KEY, v2, epoch, epoch.ms, frame), v2Hex);
+
+  LoraPayload decoded;
+  TEST_ASSERT_FALSE(hexToUplink(v2Hex, v2Length, decoded));
+  TEST_ASSERT_TRUE(hexToUplink(hex, length, decoded));
+  nodes.find(NODE_ID)->epoch.ms = epoch.ms;
+  TEST_ASSERT_TRUE(hexToUplink(v2Hex, v2Length, decoded));
+  assertSamePayload(v2, decoded);
+}
+
+/**
+ * Host receiving nothing, the uplinks are only followed through the state of the gateway.
+ */
+class NullPrint : public Print {
+public:
+  size_t write(uint8_t) override { return 1; }
+};
+
+static void test_transfer_status_over_the_ingress_rate_reaches_the_transfer() {
+  memset(timeRangeTransfer.ruleBuffer(), 0, 20 * TRANSFER_RULE_BYTES);
+  timeRangeTransfer.begin(9, 20, millis());
+  transferNode = NODE_ID;
+
+  NullPrint nullPrint;
+  HostLink  sink(nullPrint);
+  char      line[LORA_FRAME_MAX_BYTES * 2 + 16];
+  for (uint32_t counter = 1; counter <= 10; counter++) {
+    LoraPayload pkt = {};
+    pkt.id          = NODE_ID;
+    pkt.counter     = counter;
+    pkt.ts          = NODE_TS + counter; // Not a duplicate, only over the rate of the payload type
+    uint8_t state   = static_cast<uint8_t>(counter < 10 ? TransferState::IN_PROGRESS : TransferState::COMMITTED);
+    encodePayload<PayloadType::TRANSFER_STATUS>({.transferId = 9, .state = state, .receivedMask = 0x0001}, pkt);
+    pkt.hmac = computeFrameMac(KEY, LoraDirection::UPLINK, pkt);
+
+    size_t length = sprintf(line, "+TEST: RX \"");
+    length += frameToHex(pkt, line + length);
+    length += sprintf(line + length, "\"");
+    loraToSerial(line, length, sink);
+  }
+  TEST_ASSERT_FALSE(timeRangeTransfer.isActive()); // Committed, though the last status was not forwarded to the host
+  transferNode = 0;
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_v1_round_trip);
+  RUN_TEST(test_v1_round_trip_of_the_largest_payload);
+  RUN_TEST(test_v1_uplink_is_authenticated);
+  RUN_TEST(test_v2_round_trip_with_estimated_timestamp);
+  RUN_TEST(test_v2_round_trip_with_timestamp_delta);
+  RUN_TEST(test_v2_single_event_carries_its_age);
+  RUN_TEST(test_v2_frame_of_a_lost_epoch_is_stale);
+  RUN_TEST(test_stale_v2_uplink_requests_a_single_renewal);
+  RUN_TEST(test_v2_uplink_needs_the_epoch_of_its_node);
+  RUN_TEST(test_transfer_status_over_the_ingress_rate_reaches_the_transfer);
+  return UNITY_END();
+}
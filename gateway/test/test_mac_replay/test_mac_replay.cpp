@@ -0,0 +1,207 @@
+#include "main.h"
+#include "node_table.h"
+#include <EEPROM.h>
+#include <unity.h>
+
+#define NODE_ID 9
+
+static NodeTable table;
+
+void setUp() {
+  table.remove(NODE_ID);
+}
+
+void tearDown() {}
+
+static LoraPayload motionPayload(uint32_t counter) {
+  LoraPayload pkt = {};
+  pkt.id          = NODE_ID;
+  pkt.counter     = counter;
+  pkt.ts          = 1790000000;
+  encodePayload<PayloadType::MOTION_STATE>({.motion = 1}, pkt);
+  return pkt;
+}
+
+static void test_siphash_reference_vectors() {
+  // Vectors of the SipHash-2-4 paper: key 00 01 .. 0F, message 00 01 .. of the given length
+  uint8_t key[LORA_MAC_KEY_BYTES];
+  uint8_t message[15];
+  for (uint8_t i = 0; i < sizeof(key); i++) {
+    key[i] = i;
+  }
+  for (uint8_t i = 0; i < sizeof(message); i++) {
+    message[i] = i;
+  }
+
+  LoraMacKey state = loraMacKeyFromBytes(key);
+  TEST_ASSERT_EQUAL_HEX64(0x726fdb47dd0e0e31ULL, sipHash24(state, message, 0));
+  TEST_ASSERT_EQUAL_HEX64(0x93f5f5799a932462ULL, sipHash24(state, message, 8));
+  TEST_ASSERT_EQUAL_HEX64(0xa129ca6149be45e5ULL, sipHash24(state, message, 15));
+}
+
+static void test_mac_is_bound_to_the_direction() {
+  LoraMacKey  key = loraMacKeyFromBytes(LORA_DEFAULT_MAC_KEY);
+  LoraPayload pkt = motionPayload(1);
+  pkt.hmac        = computeFrameMac(key, LoraDirection::UPLINK, pkt);
+
+  TEST_ASSERT_NOT_EQUAL(pkt.hmac, computeFrameMac(key, LoraDirection::DOWNLINK, pkt));
+  TEST_ASSERT_TRUE(verifyFrameMac(key, LoraDirection::UPLINK, pkt));
+  TEST_ASSERT_FALSE(verifyFrameMac(key, LoraDirection::DOWNLINK, pkt));
+}
+
+static void test_mac_covers_every_field_and_the_key() {
+  LoraMacKey  key = loraMacKeyFromBytes(LORA_DEFAULT_MAC_KEY);
+  LoraPayload pkt = motionPayload(1);
+  pkt.hmac        = computeFrameMac(key, LoraDirection::UPLINK, pkt);
+
+  LoraPayload changed = pkt;
+  changed.counter++;
+  TEST_ASSERT_FALSE(verifyFrameMac(key, LoraDirection::UPLINK, changed));
+  changed    = pkt;
+  changed.ts = pkt.ts + 1;
+  TEST_ASSERT_FALSE(verifyFrameMac(key, LoraDirection::UPLINK, changed));
+  changed         = pkt;
+  changed.data[0] = 0;
+  TEST_ASSERT_FALSE(verifyFrameMac(key, LoraDirection::UPLINK, changed));
+
+  uint8_t otherKey[LORA_MAC_KEY_BYTES];
+  memcpy(otherKey, LORA_DEFAULT_MAC_KEY, sizeof(otherKey));
+  otherKey[0] ^= 0x01;
+  TEST_ASSERT_FALSE(verifyFrameMac(loraMacKeyFromBytes(otherKey), LoraDirection::UPLINK, pkt));
+}
+
+static void test_replay_window_rejects_duplicates_and_old_counters() {
+  ReplayWindow window;
+  TEST_ASSERT_FALSE(window.check(0)); // Senders start at 1
+  TEST_ASSERT_TRUE(window.check(1));
+  TEST_ASSERT_TRUE(window.accept(1));
+  TEST_ASSERT_FALSE(window.check(1));
+
+  TEST_ASSERT_TRUE(window.accept(100));
+  TEST_ASSERT_EQUAL_UINT32(100, window.highestCounter());
+  // Reordered by the radio: accepted once, as long as it is in the window
+  TEST_ASSERT_TRUE(window.check(100 - REPLAY_WINDOW_SIZE + 1));
+  TEST_ASSERT_FALSE(window.accept(100 - REPLAY_WINDOW_SIZE + 1));
+  TEST_ASSERT_FALSE(window.check(100 - REPLAY_WINDOW_SIZE + 1));
+  TEST_ASSERT_FALSE(window.check(100 - REPLAY_WINDOW_SIZE));
+  TEST_ASSERT_TRUE(window.check(99));
+}
+
+static void test_replay_window_after_a_jump_and_a_restore() {
+  ReplayWindow window;
+  window.accept(10);
+  window.accept(10 + 2 * REPLAY_WINDOW_SIZE); // The window is cleared, only the new counter is known
+  TEST_ASSERT_TRUE(window.check(10 + 2 * REPLAY_WINDOW_SIZE - 1));
+  TEST_ASSERT_FALSE(window.check(10 + 2 * REPLAY_WINDOW_SIZE));
+
+  window.restore(500);
+  TEST_ASSERT_FALSE(window.check(500));
+  TEST_ASSERT_FALSE(window.check(450)); // Every counter up to the restored one counts as received
+  TEST_ASSERT_TRUE(window.check(501));
+}
+
+static void test_node_table_registers_by_id() {
+  TEST_ASSERT_FALSE(table.set(0, LORA_DEFAULT_MAC_KEY));
+  TEST_ASSERT_FALSE(table.set(NODE_TABLE_MAX_ID + 1, LORA_DEFAULT_MAC_KEY));
+  TEST_ASSERT_NULL(table.find(NODE_ID));
+
+  TEST_ASSERT_TRUE(table.set(NODE_ID, LORA_DEFAULT_MAC_KEY));
+  TEST_ASSERT_NOT_NULL(table.find(NODE_ID));
+  TEST_ASSERT_EQUAL(1, table.count());
+  TEST_ASSERT_TRUE(table.remove(NODE_ID));
+  TEST_ASSERT_FALSE(table.remove(NODE_ID));
+  TEST_ASSERT_NULL(table.find(NODE_ID));
+}
+
+static void test_node_table_reserves_counters_ahead() {
+  table.set(NODE_ID, LORA_DEFAULT_MAC_KEY);
+  table.acceptUplink(NODE_ID, 1); // Reserves 1-64
+  table.acceptUplink(NODE_ID, 50);
+  TEST_ASSERT_EQUAL_UINT32(NODE_TABLE_COUNTER_BLOCK, readFrameCounterEEPROM(EEPROM_NODE_TABLE_ADDRESS + (NODE_ID - 1) * EEPROM_NODE_ENTRY_BYTES + LORA_MAC_KEY_BYTES));
+  table.acceptUplink(NODE_ID, 70); // Reserves 65-128
+
+  // After a reboot, the window restarts at the end of the reserved block
+  static NodeTable rebooted;
+  rebooted.load();
+  NodeEntry* node = rebooted.find(NODE_ID);
+  TEST_ASSERT_NOT_NULL(node);
+  LoraMacKey key      = rebooted.macKey(NODE_ID);
+  LoraMacKey expected = loraMacKeyFromBytes(LORA_DEFAULT_MAC_KEY);
+  TEST_ASSERT_EQUAL_MEMORY(&expected, &key, sizeof(key));
+  TEST_ASSERT_FALSE(node->rxWindow.check(100));
+  TEST_ASSERT_FALSE(node->rxWindow.check(2 * NODE_TABLE_COUNTER_BLOCK));
+  TEST_ASSERT_TRUE(node->rxWindow.check(2 * NODE_TABLE_COUNTER_BLOCK + 1));
+
+  // A node registered again after its removal starts over at 1
+  table.remove(NODE_ID);
+  table.set(NODE_ID, LORA_DEFAULT_MAC_KEY);
+  rebooted.load();
+  TEST_ASSERT_TRUE(rebooted.find(NODE_ID)->rxWindow.check(1));
+}
+
+static void test_node_table_restores_an_unaligned_counter_past_its_block() {
+  table.set(NODE_ID, LORA_DEFAULT_MAC_KEY);
+  table.restoreCounter(NODE_ID, 100); // e.g. the single counter of an older firmware
+  TEST_ASSERT_FALSE(table.find(NODE_ID)->rxWindow.check(2 * NODE_TABLE_COUNTER_BLOCK));
+
+  table.acceptUplink(NODE_ID, 2 * NODE_TABLE_COUNTER_BLOCK + 1);
+  static NodeTable rebooted;
+  rebooted.load();
+  TEST_ASSERT_FALSE(rebooted.find(NODE_ID)->rxWindow.check(2 * NODE_TABLE_COUNTER_BLOCK + 1));
+}
+
+static void test_node_table_serves_every_v1_node_id() {
+  TEST_ASSERT_TRUE(table.set(NODE_TABLE_MAX_ID, LORA_DEFAULT_MAC_KEY));
+  TEST_ASSERT_NOT_NULL(table.find(NODE_TABLE_MAX_ID));
+  TEST_ASSERT_NULL(table.find(NODE_TABLE_MAX_ID - 1));
+  TEST_ASSERT_TRUE(table.remove(NODE_TABLE_MAX_ID));
+  TEST_ASSERT_EQUAL(LORA_V1_MAX_NODE_ID, NODE_TABLE_MAX_ID);
+}
+
+static void test_liveness_reports_a_missing_heartbeat_once() {
+  NodeLiveness live;
+  TEST_ASSERT_FALSE(live.isHeard());
+  TEST_ASSERT_FALSE(live.heard(1000));
+  TEST_ASSERT_FALSE(live.check(60000)); // Never reported offline before its first heartbeat
+
+  live.heartbeat(1000, 10 * 4096);
+  TEST_ASSERT_FALSE(live.check(1010));
+  TEST_ASSERT_TRUE(live.check(1012));
+  TEST_ASSERT_TRUE(live.isOffline());
+  TEST_ASSERT_FALSE(live.check(1013));
+  TEST_ASSERT_TRUE(live.heard(1014)); // Online again
+  TEST_ASSERT_FALSE(live.isOffline());
+}
+
+static void test_liveness_across_the_tick_wrap() {
+  NodeLiveness live;
+  live.heard(0xFFF0);
+  live.heartbeat(0xFFF0, 0xFFFFFFFF); // Capped to NODE_LIVENESS_MAX_TICKS
+  TEST_ASSERT_FALSE(live.check(0x0100));
+  TEST_ASSERT_FALSE(live.check(static_cast<uint16_t>(0xFFF0 + NODE_LIVENESS_MAX_TICKS)));
+  TEST_ASSERT_TRUE(live.check(static_cast<uint16_t>(0xFFF0 + NODE_LIVENESS_MAX_TICKS + 1)));
+
+  // The last-seen time of a node silent for longer is held at the largest age
+  for (uint32_t tick = 0xFFF0; tick < 0xFFF0 + 3 * NODE_LIVENESS_MAX_TICKS; tick += 0x1000) {
+    live.check(static_cast<uint16_t>(tick));
+  }
+  uint16_t now = static_cast<uint16_t>(0xFFF0 + 3 * NODE_LIVENESS_MAX_TICKS);
+  live.check(now);
+  TEST_ASSERT_EQUAL_UINT32(((uint32_t)NODE_LIVENESS_MAX_TICKS << NODE_LIVENESS_TICK_SHIFT) / 1000, live.silenceSeconds(now));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_siphash_reference_vectors);
+  RUN_TEST(test_mac_is_bound_to_the_direction);
+  RUN_TEST(test_mac_covers_every_field_and_the_key);
+  RUN_TEST(test_replay_window_rejects_duplicates_and_old_counters);
+  RUN_TEST(test_replay_window_after_a_jump_and_a_restore);
+  RUN_TEST(test_node_table_registers_by_id);
+  RUN_TEST(test_node_table_reserves_counters_ahead);
+  RUN_TEST(test_node_table_restores_an_unaligned_counter_past_its_block);
+  RUN_TEST(test_node_table_serves_every_v1_node_id);
+  RUN_TEST(test_liveness_reports_a_missing_heartbeat_once);
+  RUN_TEST(test_liveness_across_the_tick_wrap);
+  return UNITY_END();
+}
@@ -0,0 +1,57 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+/*
+Subset of the Arduino API on Linux, to run the logic of the firmware as a host process (ARDUINO_NATIVE is defined).
+The serial ports are file descriptors chosen on the command line (see native_main.cpp), the clock and the pins are
+controlled through native_hal.h: the monotonic clock of the system or a virtual clock, inputs driven by a script.
+*/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "HardwareSerial.h"
+#include "Print.h"
+#include "Stream.h"
+#include "WString.h"
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t*)(address))
+
+#define constrain(value, low, high) ((value) < (low) ? (low) : ((value) > (high) ? (high) : (value)))
+
+typedef uint8_t byte;
+typedef bool    boolean;
+
+unsigned long millis();
+unsigned long micros();
+void          delay(unsigned long ms);
+void          delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int  digitalRead(uint8_t pin);
+int  analogRead(uint8_t pin);
+void analogWrite(uint8_t pin, int value);
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration = 0);
+void noTone(uint8_t pin);
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+// Firmware entry points, called by the runtime
+void setup();
+void loop();
+
+#endif // ARDUINO_H
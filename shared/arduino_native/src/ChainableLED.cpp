@@ -0,0 +1,36 @@
+#include "ChainableLED.h"
+#include "native_hal.h"
+
+void ChainableLED::setColorRGB(uint8_t led, uint8_t red, uint8_t green, uint8_t blue) {
+  if (led >= ledCount || led >= CHAINABLE_LED_MAX) return;
+  colors[led][0] = red;
+  colors[led][1] = green;
+  colors[led][2] = blue;
+  nativeTrace("led %u %u %u %u %u", clkPin, led, red, green, blue);
+}
+
+/**
+ * Same conversion as the library.
+ */
+static float hueToRgb(float p, float q, float t) {
+  if (t < 0) t += 1;
+  if (t > 1) t -= 1;
+  if (t < 1.0f / 6) return p + (q - p) * 6 * t;
+  if (t < 1.0f / 2) return q;
+  if (t < 2.0f / 3) return p + (q - p) * (2.0f / 3 - t) * 6;
+  return p;
+}
+
+void ChainableLED::setColorHSB(uint8_t led, float hue, float saturation, float brightness) {
+  float red   = brightness;
+  float green = brightness;
+  float blue  = brightness;
+  if (saturation != 0) {
+    float q = brightness < 0.5f ? brightness * (1 + saturation) : brightness + saturation - brightness * saturation;
+    float p = 2 * brightness - q;
+    red     = hueToRgb(p, q, hue + 1.0f / 3);
+    green   = hueToRgb(p, q, hue);
+    blue    = hueToRgb(p, q, hue - 1.0f / 3);
+  }
+  setColorRGB(led, (uint8_t)(255.0f * red), (uint8_t)(255.0f * green), (uint8_t)(255.0f * blue));
+}
@@ -0,0 +1,32 @@
+#ifndef CHAINABLE_LED_H
+#define CHAINABLE_LED_H
+
+#include <Arduino.h>
+
+#define CHAINABLE_LED_MAX 8
+
+/**
+ * Chain of RGB LEDs of the Grove library. Each color set is traced (see native_hal.h) in RGB.
+ */
+class ChainableLED {
+public:
+  uint8_t colors[CHAINABLE_LED_MAX][3] = {}; // RGB of each LED
+
+  ChainableLED(uint8_t clkPin, uint8_t dataPin, uint8_t ledCount) : clkPin(clkPin), ledCount(ledCount) {}
+
+  void init() {}
+  void setColorRGB(uint8_t led, uint8_t red, uint8_t green, uint8_t blue);
+
+  /**
+   * @param hue 0-1
+   * @param saturation 0-1
+   * @param brightness 0-1
+   */
+  void setColorHSB(uint8_t led, float hue, float saturation, float brightness);
+
+private:
+  uint8_t clkPin;
+  uint8_t ledCount;
+};
+
+#endif // CHAINABLE_LED_H
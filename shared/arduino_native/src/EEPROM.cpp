@@ -0,0 +1,26 @@
+#include "EEPROM.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+EEPROMClass EEPROM;
+
+bool EEPROMClass::open(const char* path) {
+  fd = ::open(path, O_RDWR | O_CREAT, 0600);
+  if (fd < 0) return false;
+
+  ssize_t size = pread(fd, data, NATIVE_EEPROM_SIZE, 0);
+  if (size < 0) size = 0;
+  memset(data + size, 0xFF, NATIVE_EEPROM_SIZE - size);
+  if (size < NATIVE_EEPROM_SIZE) pwrite(fd, data + size, NATIVE_EEPROM_SIZE - size, size);
+  return true;
+}
+
+void EEPROMClass::write(int address, uint8_t value) {
+  if (address < 0 || address >= NATIVE_EEPROM_SIZE) return;
+  data[address] = value;
+  if (fd >= 0) pwrite(fd, &value, 1, address); // Written through, as the board commits each byte
+}
+
+void EEPROMClass::update(int address, uint8_t value) {
+  if (read(address) != value) write(address, value);
+}
@@ -0,0 +1,52 @@
+#ifndef EEPROM_H
+#define EEPROM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define NATIVE_EEPROM_SIZE 8192 // Data flash of the Uno R4
+
+/**
+ * EEPROM of the board, kept in a file so the frame counters and the keys survive a restart of the process.
+ * An address outside of the EEPROM reads as 0 and is not written, as in the Arduino library.
+ */
+class EEPROMClass {
+public:
+  EEPROMClass() { memset(data, 0xFF, sizeof(data)); }
+
+  /**
+   * Load the EEPROM from a file, created erased (all 0xFF) if it does not exist.
+   * @return false if the file cannot be opened.
+   */
+  bool open(const char* path);
+
+  uint8_t  read(int address) const { return address >= 0 && address < NATIVE_EEPROM_SIZE ? data[address] : 0; }
+  void     write(int address, uint8_t value);
+  void     update(int address, uint8_t value);
+  uint16_t length() const { return NATIVE_EEPROM_SIZE; }
+
+  template <typename T>
+  T& get(int address, T& value) const {
+    for (size_t i = 0; i < sizeof(T); i++) {
+      reinterpret_cast<uint8_t*>(&value)[i] = read(address + i);
+    }
+    return value;
+  }
+
+  template <typename T>
+  const T& put(int address, const T& value) {
+    for (size_t i = 0; i < sizeof(T); i++) {
+      update(address + i, reinterpret_cast<const uint8_t*>(&value)[i]);
+    }
+    return value;
+  }
+
+private:
+  uint8_t data[NATIVE_EEPROM_SIZE];
+  int     fd = -1;
+};
+
+extern EEPROMClass EEPROM;
+
+#endif // EEPROM_H
@@ -0,0 +1,27 @@
+#ifndef HARDWARE_SERIAL_H
+#define HARDWARE_SERIAL_H
+
+#include "native_port.h"
+
+#define NATIVE_SERIAL_RX_BUFFER 512
+
+/**
+ * Serial port of the board, connected by the runtime to stdin/stdout or to the client of a Unix socket.
+ */
+class HardwareSerial : public NativePort {
+public:
+  HardwareSerial() : NativePort(NATIVE_SERIAL_RX_BUFFER) {}
+
+  void begin(unsigned long baud) { setBaudRate(baud); }
+  void end() {}
+
+  /**
+   * @return false while no host is connected, as the USB serial port of the board before the host opens it.
+   */
+  operator bool() { return connected(); }
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+#endif // HARDWARE_SERIAL_H
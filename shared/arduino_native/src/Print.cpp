@@ -0,0 +1,39 @@
+#include "Print.h"
+#include <stdio.h>
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  size_t n = 0;
+  while (size--) {
+    if (!write(*buffer++)) break;
+    n++;
+  }
+  return n;
+}
+
+size_t Print::print(double value, int digits) {
+  char text[64];
+  int  length = snprintf(text, sizeof(text), "%.*f", digits, value);
+  return write(text, length < (int)sizeof(text) ? length : sizeof(text) - 1);
+}
+
+size_t Print::printNumber(unsigned long long value, int base) {
+  if (base < 2) base = 10;
+  char  digits[65];
+  char* end = digits + sizeof(digits);
+  char* pos = end;
+  do {
+    unsigned digit = value % base;
+    *--pos         = digit < 10 ? '0' + digit : 'A' + digit - 10;
+    value /= base;
+  } while (value > 0);
+  return write(pos, end - pos);
+}
+
+/**
+ * Print a signed value, with a minus sign in base 10 only: other bases print the bits of the value, as the Arduino core.
+ */
+size_t Print::printSigned(long long value, int base, unsigned bits) {
+  if (base == DEC && value < 0) return print('-') + printNumber(0ULL - (unsigned long long)value, base);
+  unsigned long long mask = bits >= 64 ? ~0ULL : (1ULL << bits) - 1;
+  return printNumber((unsigned long long)value & mask, base);
+}
@@ -0,0 +1,58 @@
+#ifndef PRINT_H
+#define PRINT_H
+
+#include "WString.h"
+#include <string.h>
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+/**
+ * Text output of the Arduino core: numbers are printed without heap allocation, in uppercase for HEX.
+ */
+class Print {
+public:
+  virtual ~Print() {}
+
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size);
+  size_t         write(const char* str) { return str ? write((const uint8_t*)str, strlen(str)) : 0; }
+  size_t         write(const char* buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+
+  size_t print(const __FlashStringHelper* str) { return write(reinterpret_cast<const char*>(str)); }
+  size_t print(const String& str) { return write(str.c_str(), str.length()); }
+  size_t print(const char* str) { return write(str); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(unsigned char value, int base = DEC) { return printNumber(value, base); }
+  size_t print(int value, int base = DEC) { return printSigned(value, base, 8 * sizeof(int)); }
+  size_t print(unsigned int value, int base = DEC) { return printNumber(value, base); }
+  size_t print(long value, int base = DEC) { return printSigned(value, base, 8 * sizeof(long)); }
+  size_t print(unsigned long value, int base = DEC) { return printNumber(value, base); }
+  size_t print(long long value, int base = DEC) { return printSigned(value, base, 64); }
+  size_t print(unsigned long long value, int base = DEC) { return printNumber(value, base); }
+  size_t print(double value, int digits = 2);
+
+  size_t println() { return write("\r\n"); }
+
+  template <typename T>
+  size_t println(const T& value) {
+    size_t n = print(value);
+    return n + println();
+  }
+
+  template <typename T>
+  size_t println(const T& value, int format) {
+    size_t n = print(value, format);
+    return n + println();
+  }
+
+  virtual void flush() {}
+
+private:
+  size_t printNumber(unsigned long long value, int base);
+  size_t printSigned(long long value, int base, unsigned bits);
+};
+
+#endif // PRINT_H
@@ -0,0 +1,26 @@
+#ifndef SOFTWARE_SERIAL_H
+#define SOFTWARE_SERIAL_H
+
+#include <Arduino.h>
+
+#define _SS_MAX_RX_BUFF 64 // Receive buffer of the Arduino library
+
+/**
+ * Software UART of the board, connected by the runtime to the device given on the command line (e.g. a USB LoRa
+ * module). Only the first instance is connected.
+ */
+class SoftwareSerial : public NativePort {
+public:
+  SoftwareSerial(uint8_t receivePin, uint8_t transmitPin);
+
+  void begin(long baud) { setBaudRate(baud); }
+  void end() {}
+  bool listen() { return true; }
+  bool isListening() { return true; }
+  bool overflow() { return false; }
+};
+
+// The first SoftwareSerial created, or nullptr
+extern SoftwareSerial* nativeSoftwareSerial;
+
+#endif // SOFTWARE_SERIAL_H
@@ -0,0 +1,28 @@
+#include "Stream.h"
+
+String Stream::readString() {
+  String result;
+  int    c;
+  while ((c = read()) >= 0) {
+    result += (char)c;
+  }
+  return result;
+}
+
+String Stream::readStringUntil(char terminator) {
+  String result;
+  int    c;
+  while ((c = read()) >= 0 && c != terminator) {
+    result += (char)c;
+  }
+  return result;
+}
+
+size_t Stream::readBytes(uint8_t* buffer, size_t length) {
+  size_t n = 0;
+  int    c;
+  while (n < length && (c = read()) >= 0) {
+    buffer[n++] = (uint8_t)c;
+  }
+  return n;
+}
@@ -0,0 +1,26 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "Print.h"
+
+/**
+ * Input of the Arduino core. The reading helpers only take the bytes already received, they never wait for a timeout.
+ */
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read()      = 0;
+  virtual int peek()      = 0;
+
+  void setTimeout(unsigned long timeoutMs) { timeout = timeoutMs; }
+
+  String readString();
+  String readStringUntil(char terminator);
+  size_t readBytes(uint8_t* buffer, size_t length);
+  size_t readBytes(char* buffer, size_t length) { return readBytes((uint8_t*)buffer, length); }
+
+protected:
+  unsigned long timeout = 1000; // Kept for the API, the reads do not wait
+};
+
+#endif // STREAM_H
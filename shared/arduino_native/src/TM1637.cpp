@@ -0,0 +1,26 @@
+#include "TM1637.h"
+#include "native_hal.h"
+
+void TM1637::display(int8_t digitValues[]) {
+  memcpy(digits, digitValues, sizeof(digits));
+  traceDigits();
+}
+
+void TM1637::display(uint8_t address, int8_t value) {
+  if (address >= TM1637_DIGITS || digits[address] == value) return;
+  digits[address] = value;
+  traceDigits();
+}
+
+void TM1637::clearDisplay() {
+  memset(digits, 0x7f, sizeof(digits));
+  traceDigits();
+}
+
+void TM1637::traceDigits() {
+  char text[TM1637_DIGITS + 1] = {};
+  for (size_t i = 0; i < TM1637_DIGITS; i++) {
+    text[i] = digits[i] >= 0 && digits[i] < 16 ? "0123456789ABCDEF"[digits[i]] : '_';
+  }
+  nativeTrace("display %u %s", clkPin, text);
+}
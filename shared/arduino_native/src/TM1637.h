@@ -0,0 +1,38 @@
+#ifndef TM1637_H
+#define TM1637_H
+
+#include <Arduino.h>
+
+#define BRIGHT_DARKEST 0
+#define BRIGHT_TYPICAL 2
+#define BRIGHTEST      7
+
+#define POINT_ON  1
+#define POINT_OFF 0
+
+#define TM1637_DIGITS 4
+
+/**
+ * 4-digit display of the Grove library. Each change of the display is traced (see native_hal.h) as the 4 digits shown,
+ * a blank digit as '_'.
+ */
+class TM1637 {
+public:
+  int8_t digits[TM1637_DIGITS]; // Value of each digit (0-15), 0x7f if blank
+
+  TM1637(uint8_t clkPin, uint8_t dataPin) : clkPin(clkPin) { memset(digits, 0x7f, sizeof(digits)); }
+
+  void init() { clearDisplay(); }
+  void set(uint8_t brightness = BRIGHT_TYPICAL, uint8_t setData = 0x40, uint8_t setAddr = 0xc0) {}
+  void point(bool on) {}
+  void display(int8_t digitValues[]);
+  void display(uint8_t address, int8_t value);
+  void clearDisplay();
+
+private:
+  uint8_t clkPin;
+
+  void traceDigits();
+};
+
+#endif // TM1637_H
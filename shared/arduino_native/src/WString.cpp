@@ -0,0 +1,201 @@
+#include "WString.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * Digits of an unsigned value in the given base, lowercase as utoa() of the Arduino core.
+ */
+static std::string formatUnsigned(unsigned long long value, unsigned char base) {
+  if (base < 2 || base > 36) base = 10;
+  char  digits[65];
+  char* end = digits + sizeof(digits);
+  char* pos = end;
+  do {
+    unsigned digit = value % base;
+    *--pos         = digit < 10 ? '0' + digit : 'a' + digit - 10;
+    value /= base;
+  } while (value > 0);
+  return std::string(pos, end);
+}
+
+/**
+ * Digits of a signed value, only written with a minus sign in base 10 as ltoa() of the Arduino core.
+ */
+static std::string formatSigned(long long value, unsigned char base, unsigned bits) {
+  if (base == 10 && value < 0) return "-" + formatUnsigned(0ULL - (unsigned long long)value, base);
+  unsigned long long mask = bits >= 64 ? ~0ULL : (1ULL << bits) - 1;
+  return formatUnsigned((unsigned long long)value & mask, base);
+}
+
+String::String(unsigned char value, unsigned char base) : buffer(formatUnsigned(value, base)) {}
+String::String(int value, unsigned char base) : buffer(formatSigned(value, base, 8 * sizeof(int))) {}
+String::String(unsigned int value, unsigned char base) : buffer(formatUnsigned(value, base)) {}
+String::String(long value, unsigned char base) : buffer(formatSigned(value, base, 8 * sizeof(long))) {}
+String::String(unsigned long value, unsigned char base) : buffer(formatUnsigned(value, base)) {}
+String::String(long long value, unsigned char base) : buffer(formatSigned(value, base, 64)) {}
+String::String(unsigned long long value, unsigned char base) : buffer(formatUnsigned(value, base)) {}
+String::String(float value, unsigned char decimalPlaces) : String((double)value, decimalPlaces) {}
+
+String::String(double value, unsigned char decimalPlaces) {
+  char text[64];
+  snprintf(text, sizeof(text), "%.*f", decimalPlaces, value);
+  buffer = text;
+}
+
+bool String::reserve(unsigned int size) {
+  buffer.reserve(size);
+  return true;
+}
+
+bool String::concat(const String& str) {
+  buffer += str.buffer;
+  return true;
+}
+
+bool String::concat(const char* cstr) {
+  if (!cstr) return false;
+  buffer += cstr;
+  return true;
+}
+
+bool String::concat(char c) {
+  buffer += c;
+  return true;
+}
+
+String& String::operator+=(const String& rhs) {
+  concat(rhs);
+  return *this;
+}
+
+String& String::operator+=(const char* cstr) {
+  concat(cstr);
+  return *this;
+}
+
+String& String::operator+=(char c) {
+  concat(c);
+  return *this;
+}
+
+String operator+(const String& lhs, const String& rhs) {
+  String result(lhs);
+  result += rhs;
+  return result;
+}
+
+String operator+(const String& lhs, const char* rhs) {
+  String result(lhs);
+  result += rhs;
+  return result;
+}
+
+String operator+(const char* lhs, const String& rhs) {
+  String result(lhs);
+  result += rhs;
+  return result;
+}
+
+String operator+(const String& lhs, char rhs) {
+  String result(lhs);
+  result += rhs;
+  return result;
+}
+
+bool String::endsWith(const String& suffix) const {
+  if (suffix.buffer.size() > buffer.size()) return false;
+  return buffer.compare(buffer.size() - suffix.buffer.size(), suffix.buffer.size(), suffix.buffer) == 0;
+}
+
+void String::setCharAt(unsigned int index, char c) {
+  if (index < buffer.size()) buffer[index] = c;
+}
+
+int String::indexOf(char c, unsigned int fromIndex) const {
+  size_t pos = buffer.find(c, fromIndex);
+  return pos == std::string::npos ? -1 : (int)pos;
+}
+
+int String::indexOf(const String& str, unsigned int fromIndex) const {
+  size_t pos = buffer.find(str.buffer, fromIndex);
+  return pos == std::string::npos ? -1 : (int)pos;
+}
+
+int String::lastIndexOf(char c) const {
+  size_t pos = buffer.rfind(c);
+  return pos == std::string::npos ? -1 : (int)pos;
+}
+
+int String::lastIndexOf(const String& str) const {
+  size_t pos = buffer.rfind(str.buffer);
+  return pos == std::string::npos ? -1 : (int)pos;
+}
+
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const {
+  if (beginIndex > endIndex) {
+    unsigned int swap = beginIndex;
+    beginIndex        = endIndex;
+    endIndex          = swap;
+  }
+  if (beginIndex >= buffer.size()) return String();
+  if (endIndex > buffer.size()) endIndex = buffer.size();
+  return String(buffer.c_str() + beginIndex, endIndex - beginIndex);
+}
+
+void String::replace(char find, char replace) {
+  for (char& c : buffer) {
+    if (c == find) c = replace;
+  }
+}
+
+void String::replace(const String& find, const String& replace) {
+  if (find.buffer.empty()) return;
+  size_t pos = 0;
+  while ((pos = buffer.find(find.buffer, pos)) != std::string::npos) {
+    buffer.replace(pos, find.buffer.size(), replace.buffer);
+    pos += replace.buffer.size();
+  }
+}
+
+void String::remove(unsigned int index) {
+  if (index < buffer.size()) buffer.erase(index);
+}
+
+void String::remove(unsigned int index, unsigned int count) {
+  if (index < buffer.size()) buffer.erase(index, count);
+}
+
+void String::toLowerCase() {
+  for (char& c : buffer) {
+    c = tolower((unsigned char)c);
+  }
+}
+
+void String::toUpperCase() {
+  for (char& c : buffer) {
+    c = toupper((unsigned char)c);
+  }
+}
+
+void String::trim() {
+  size_t begin = buffer.find_first_not_of(" \t\r\n\v\f");
+  if (begin == std::string::npos) {
+    buffer.clear();
+    return;
+  }
+  size_t end = buffer.find_last_not_of(" \t\r\n\v\f");
+  buffer     = buffer.substr(begin, end - begin + 1);
+}
+
+long String::toInt() const {
+  return atol(buffer.c_str());
+}
+
+float String::toFloat() const {
+  return (float)toDouble();
+}
+
+double String::toDouble() const {
+  return atof(buffer.c_str());
+}
@@ -0,0 +1,84 @@
+#ifndef WSTRING_H
+#define WSTRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper*>(string_literal))
+
+/**
+ * Arduino String on top of std::string, with the same conversions and search functions as the Arduino core.
+ */
+class String {
+public:
+  String(const char* cstr = "") : buffer(cstr ? cstr : "") {}
+  String(const char* cstr, size_t length) : buffer(cstr, length) {}
+  String(const __FlashStringHelper* str) : String(reinterpret_cast<const char*>(str)) {}
+  explicit String(char c) : buffer(1, c) {}
+  explicit String(unsigned char value, unsigned char base = 10);
+  explicit String(int value, unsigned char base = 10);
+  explicit String(unsigned int value, unsigned char base = 10);
+  explicit String(long value, unsigned char base = 10);
+  explicit String(unsigned long value, unsigned char base = 10);
+  explicit String(long long value, unsigned char base = 10);
+  explicit String(unsigned long long value, unsigned char base = 10);
+  explicit String(float value, unsigned char decimalPlaces = 2);
+  explicit String(double value, unsigned char decimalPlaces = 2);
+
+  unsigned int length() const { return buffer.size(); }
+  const char*  c_str() const { return buffer.c_str(); }
+  bool         reserve(unsigned int size);
+
+  bool concat(const String& str);
+  bool concat(const char* cstr);
+  bool concat(char c);
+
+  String& operator+=(const String& rhs);
+  String& operator+=(const char* cstr);
+  String& operator+=(char c);
+
+  friend String operator+(const String& lhs, const String& rhs);
+  friend String operator+(const String& lhs, const char* rhs);
+  friend String operator+(const char* lhs, const String& rhs);
+  friend String operator+(const String& lhs, char rhs);
+
+  bool equals(const String& str) const { return buffer == str.buffer; }
+  bool equals(const char* cstr) const { return buffer == (cstr ? cstr : ""); }
+  bool operator==(const String& rhs) const { return equals(rhs); }
+  bool operator==(const char* cstr) const { return equals(cstr); }
+  bool operator!=(const String& rhs) const { return !equals(rhs); }
+  bool operator!=(const char* cstr) const { return !equals(cstr); }
+  bool startsWith(const String& prefix) const { return buffer.compare(0, prefix.buffer.size(), prefix.buffer) == 0; }
+  bool endsWith(const String& suffix) const;
+
+  char charAt(unsigned int index) const { return index < buffer.size() ? buffer[index] : 0; }
+  void setCharAt(unsigned int index, char c);
+  char operator[](unsigned int index) const { return charAt(index); }
+
+  int indexOf(char c, unsigned int fromIndex = 0) const;
+  int indexOf(const String& str, unsigned int fromIndex = 0) const;
+  int lastIndexOf(char c) const;
+  int lastIndexOf(const String& str) const;
+
+  String substring(unsigned int beginIndex) const { return substring(beginIndex, length()); }
+  String substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+  void replace(char find, char replace);
+  void replace(const String& find, const String& replace);
+  void remove(unsigned int index);
+  void remove(unsigned int index, unsigned int count);
+  void toLowerCase();
+  void toUpperCase();
+  void trim();
+
+  long   toInt() const;
+  float  toFloat() const;
+  double toDouble() const;
+
+private:
+  std::string buffer;
+};
+
+#endif // WSTRING_H
@@ -0,0 +1,26 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * I2C bus of the board. The emulated devices (e.g. the RTC of iarduino_RTC.h) do not go through it, a transmission to
+ * any other address is not acknowledged.
+ */
+class TwoWire {
+public:
+  void    begin() {}
+  void    setClock(uint32_t) {}
+  void    beginTransmission(uint8_t) {}
+  uint8_t endTransmission(bool = true) { return 2; } // Address not acknowledged
+  uint8_t requestFrom(uint8_t, size_t, bool = true) { return 0; }
+  size_t  write(uint8_t) { return 1; }
+  size_t  write(const uint8_t*, size_t size) { return size; }
+  int     available() { return 0; }
+  int     read() { return -1; }
+};
+
+extern TwoWire Wire;
+
+#endif // WIRE_H
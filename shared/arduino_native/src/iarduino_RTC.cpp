@@ -0,0 +1,90 @@
+#include "iarduino_RTC.h"
+#include "native_hal.h"
+#include <time.h>
+
+static bool     rtcSet       = false;
+static int64_t  rtcUnixAtSet = 0; // Unix time of the module when it was set
+static uint64_t rtcSetAtUs   = 0; // nativeElapsedUs() when it was set
+
+static const char* const WEEKDAYS[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+static const char* const MONTHS[]   = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+void nativeSetRtcTime(uint32_t unixTime) {
+  rtcSet       = true;
+  rtcUnixAtSet = unixTime;
+  rtcSetAtUs   = nativeElapsedUs();
+}
+
+static int64_t rtcUnixTime() {
+  if (!rtcSet) nativeSetRtcTime(time(nullptr));
+  return rtcUnixAtSet + (int64_t)((nativeElapsedUs() - rtcSetAtUs) / 1000000);
+}
+
+void iarduino_RTC::settime(int sec, int min, int hour, int newDay, int newMonth, int newYear, int newWeekday) {
+  time_t    local = (time_t)(rtcUnixTime() + timeZone * 3600);
+  struct tm fields;
+  gmtime_r(&local, &fields);
+  if (sec >= 0) fields.tm_sec = sec;
+  if (min >= 0) fields.tm_min = min;
+  if (hour >= 0) fields.tm_hour = hour;
+  if (newDay >= 0) fields.tm_mday = newDay;
+  if (newMonth >= 0) fields.tm_mon = newMonth - 1;
+  if (newYear >= 0) fields.tm_year = newYear + 100;
+  (void)newWeekday; // Computed from the date
+  nativeSetRtcTime((uint32_t)(timegm(&fields) - timeZone * 3600));
+}
+
+void iarduino_RTC::settimeUnix(uint32_t unixTime) {
+  nativeSetRtcTime(unixTime);
+}
+
+uint32_t iarduino_RTC::gettimeUnix() {
+  update();
+  return Unix;
+}
+
+const char* iarduino_RTC::gettime(const char* format) {
+  update();
+  size_t length = 0;
+  for (const char* c = format; *c && length < sizeof(text) - 5; c++) {
+    char* out  = text + length;
+    int   room = sizeof(text) - length;
+    switch (*c) {
+    case 's': length += snprintf(out, room, "%02u", seconds); break;
+    case 'i': length += snprintf(out, room, "%02u", minutes); break;
+    case 'h': length += snprintf(out, room, "%02u", hours); break;
+    case 'H': length += snprintf(out, room, "%02u", Hours); break;
+    case 'd': length += snprintf(out, room, "%02u", day); break;
+    case 'w': length += snprintf(out, room, "%u", weekday); break;
+    case 'D': length += snprintf(out, room, "%s", WEEKDAYS[weekday]); break;
+    case 'm': length += snprintf(out, room, "%02u", month); break;
+    case 'M': length += snprintf(out, room, "%s", MONTHS[month - 1]); break;
+    case 'y': length += snprintf(out, room, "%02u", year); break;
+    case 'Y': length += snprintf(out, room, "%u", 2000 + year); break;
+    case 'a': length += snprintf(out, room, "%s", midday ? "pm" : "am"); break;
+    case 'A': length += snprintf(out, room, "%s", midday ? "PM" : "AM"); break;
+    default:  text[length++] = *c; break;
+    }
+  }
+  text[length] = '\0';
+  return text;
+}
+
+/**
+ * Read the module into the fields, in local time.
+ */
+void iarduino_RTC::update() {
+  Unix         = (uint32_t)rtcUnixTime();
+  time_t local = (time_t)((int64_t)Unix + timeZone * 3600);
+  struct tm fields;
+  gmtime_r(&local, &fields);
+  seconds = fields.tm_sec;
+  minutes = fields.tm_min;
+  Hours   = fields.tm_hour;
+  hours   = Hours % 12 == 0 ? 12 : Hours % 12;
+  midday  = Hours >= 12;
+  day     = fields.tm_mday;
+  weekday = fields.tm_wday;
+  month   = fields.tm_mon + 1;
+  year    = fields.tm_year % 100;
+}
@@ -0,0 +1,61 @@
+#ifndef IARDUINO_RTC_H
+#define IARDUINO_RTC_H
+
+#include <Arduino.h>
+#include <Wire.h>
+
+#define RTC_DS1302 1
+#define RTC_DS1307 2
+#define RTC_DS3231 3
+#define RTC_RV3028 4
+
+/**
+ * Real time clock of the iarduino_RTC library, running on the clock of the emulated board: it advances with millis(),
+ * including the virtual clock. All the instances share the one module of the board, which starts at the time given to
+ * nativeSetRtcTime(), or at the time of the system.
+ * As with the library, the fields are only updated by gettime() and gettimeUnix().
+ */
+class iarduino_RTC {
+public:
+  uint8_t  seconds = 0; // 0-59
+  uint8_t  minutes = 0; // 0-59
+  uint8_t  hours   = 0; // 1-12
+  uint8_t  Hours   = 0; // 0-23
+  uint8_t  midday  = 0; // 0 before noon, 1 after
+  uint8_t  day     = 0; // 1-31
+  uint8_t  weekday = 0; // 0-6, 0 is Sunday
+  uint8_t  month   = 0; // 1-12
+  uint8_t  year    = 0; // 0-99
+  uint32_t Unix    = 0;
+
+  explicit iarduino_RTC(uint8_t module, uint8_t rst = 0, uint8_t clk = 0, uint8_t dat = 0) {}
+
+  void begin(TwoWire* wire = &Wire) {}
+
+  /**
+   * Set the time of the module, a negative field is left unchanged.
+   * @param year 0-99, from 2000
+   */
+  void settime(int sec, int min = -1, int hour = -1, int day = -1, int month = -1, int year = -1, int weekday = -1);
+
+  void     settimeUnix(uint32_t unixTime);
+  uint32_t gettimeUnix();
+
+  /**
+   * @param format Characters replaced by the time: s i h H (seconds, minutes, hours 1-12 and 0-23), d w D (day, weekday
+   * 0-6, weekday name), m M (month, month name), y Y (year on 2 and 4 digits), a A (am/pm), the others are copied.
+   */
+  const char* gettime(const char* format = "");
+  const char* gettime(const String& format) { return gettime(format.c_str()); }
+
+  // Offset of the local time of the fields from the Unix time, in hours
+  void settimezone(int8_t zone) { timeZone = zone; }
+
+private:
+  int8_t timeZone = 0;
+  char   text[64] = {};
+
+  void update();
+};
+
+#endif // IARDUINO_RTC_H
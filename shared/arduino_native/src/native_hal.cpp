@@ -0,0 +1,134 @@
+#include "native_hal.h"
+#include "native_port.h"
+#include <Arduino.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+
+static bool     virtualClock = false;
+static uint64_t virtualUs    = 0;
+static uint64_t startUs      = 0; // System clock at the first reading
+
+static int8_t pinLevels[NATIVE_MAX_PINS]; // -1 while neither written nor set
+static bool   pinsReady = false;
+static FILE*  trace     = nullptr;
+
+static uint64_t systemUs() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+void nativeUseVirtualClock(uint64_t start) {
+  virtualClock = true;
+  virtualUs    = start;
+}
+
+bool nativeVirtualClock() {
+  return virtualClock;
+}
+
+void nativeAdvanceClock(uint64_t us) {
+  virtualUs += us;
+}
+
+uint64_t nativeElapsedUs() {
+  if (virtualClock) return virtualUs;
+  if (startUs == 0) startUs = systemUs();
+  return systemUs() - startUs;
+}
+
+static int8_t* pinLevel(uint8_t pin) {
+  if (!pinsReady) {
+    memset(pinLevels, -1, sizeof(pinLevels));
+    pinsReady = true;
+  }
+  return pin < NATIVE_MAX_PINS ? &pinLevels[pin] : nullptr;
+}
+
+void nativeSetPin(uint8_t pin, int value) {
+  int8_t* level = pinLevel(pin);
+  if (level) *level = value ? HIGH : LOW;
+}
+
+int nativePinLevel(uint8_t pin) {
+  int8_t* level = pinLevel(pin);
+  return level && *level >= 0 ? *level : LOW;
+}
+
+void nativeTraceTo(FILE* file) {
+  trace = file;
+}
+
+void nativeTrace(const char* format, ...) {
+  if (!trace) return;
+  fprintf(trace, "%lu ", millis());
+  va_list args;
+  va_start(args, format);
+  vfprintf(trace, format, args);
+  va_end(args);
+  fputc('\n', trace);
+}
+
+unsigned long millis() {
+  return (unsigned long)(uint32_t)(nativeElapsedUs() / 1000); // Wraps after 49 days, as on the board
+}
+
+unsigned long micros() {
+  return (unsigned long)(uint32_t)nativeElapsedUs();
+}
+
+void delay(unsigned long ms) {
+  nativeFlushPorts();
+  if (virtualClock) {
+    virtualUs += (uint64_t)ms * 1000;
+  } else {
+    usleep(ms * 1000);
+  }
+  nativeNextCycle();
+}
+
+void delayMicroseconds(unsigned int us) {
+  if (virtualClock) {
+    virtualUs += us;
+  } else {
+    usleep(us);
+  }
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  int8_t* level = pinLevel(pin);
+  if (level && *level < 0 && mode == INPUT_PULLUP) *level = HIGH;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  nativeSetPin(pin, value);
+  nativeTrace("pin %u %u", pin, value ? HIGH : LOW);
+}
+
+int digitalRead(uint8_t pin) {
+  return nativePinLevel(pin);
+}
+
+int  analogRead(uint8_t) { return 0; }
+void analogWrite(uint8_t, int) {}
+
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration) {
+  nativeTrace("tone %u %u %lu", pin, frequency, duration);
+}
+
+void noTone(uint8_t pin) {
+  nativeTrace("tone %u 0 0", pin);
+}
+
+long random(long max) {
+  return max > 0 ? ::random() % max : 0;
+}
+
+long random(long min, long max) {
+  return min < max ? min + random(max - min) : min;
+}
+
+void randomSeed(unsigned long seed) {
+  srandom(seed);
+}
@@ -0,0 +1,44 @@
+#ifndef NATIVE_HAL_H
+#define NATIVE_HAL_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+Controls of the emulated board, for the runtime (see native_main.cpp) and for any program driving the firmware:
+- Clock: the monotonic clock of the system by default. The virtual clock only advances when told to, and delay()
+  advances it instead of sleeping, so hours of firmware time run in a fraction of a second.
+- Pins: a digital input reads the level it was set to. Until then an INPUT_PULLUP reads HIGH and an INPUT reads LOW.
+- Trace: the outputs of the board (tones, display, LEDs, pins written) are printed with their millis() to a file.
+*/
+
+#define NATIVE_MAX_PINS 32
+
+// Switch to the virtual clock, starting at `startUs`
+void nativeUseVirtualClock(uint64_t startUs = 0);
+
+// @return true if the clock is virtual
+bool nativeVirtualClock();
+
+// Advance the virtual clock, does nothing with the system clock
+void nativeAdvanceClock(uint64_t us);
+
+// Time since the start of the process, or the virtual time, in microseconds
+uint64_t nativeElapsedUs();
+
+// Set the time of the RTC module (iarduino_RTC.h), in UTC, e.g. to replay a given day
+void nativeSetRtcTime(uint32_t unixTime);
+
+// Drive a digital input, e.g. a button pressed (LOW) or the output of the motion sensor (HIGH)
+void nativeSetPin(uint8_t pin, int value);
+
+// @return The level of a pin, as last written by the firmware or set with nativeSetPin()
+int nativePinLevel(uint8_t pin);
+
+// Print the outputs of the board to this file (e.g. stderr), nullptr to stop
+void nativeTraceTo(FILE* file);
+
+// Print a line to the trace, prefixed with millis()
+void nativeTrace(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+#endif // NATIVE_HAL_H
@@ -0,0 +1,185 @@
+#include "native_hal.h"
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <SoftwareSerial.h>
+#include <signal.h>
+#include <unistd.h>
+#include <vector>
+
+/*
+Runtime of the native build: connects the serial ports of the firmware to the descriptors given on the command line,
+then calls setup() and loop() until every input ended (never with a device or a Unix socket) or for a given duration.
+  --lora <path>   Device of the LoRa module (e.g. /dev/ttyUSB0), a pty, or a capture of its lines replayed once
+  --lora pty      Create a pty for the LoRa side, its path is printed to stderr
+  --host stdio    Serial on stdin/stdout (default)
+  --host unix:<path>  Serial on the clients of a Unix socket, one at a time
+  --eeprom <file> File holding the EEPROM (default: eeprom.bin)
+  --clock virtual Run on the virtual clock: each loop() takes --tick ms and delay() does not wait (default: real)
+  --tick <ms>     Firmware time of a loop() on the virtual clock (default: 1)
+  --duration <s>  Stop after this firmware time, whatever the inputs
+  --rtc <unix>    Start time of the RTC module, in UTC (default: the time of the system)
+  --pins <file>   Script of the digital inputs, one "<millis> <pin> <level>" per line
+  --trace <file>  Print the outputs of the board (tones, display, LEDs, pins) with their millis(), - for stderr
+*/
+#define NATIVE_IDLE_WAIT_MS    1   // Wait for input when a loop() received nothing, instead of spinning
+#define NATIVE_DRAIN_MS        100 // Time given to the firmware to handle the buffered input once an input ended
+#define NATIVE_VIRTUAL_TICK_MS 1
+
+HardwareSerial  Serial;
+HardwareSerial  Serial1;
+SoftwareSerial* nativeSoftwareSerial = nullptr;
+
+SoftwareSerial::SoftwareSerial(uint8_t, uint8_t) : NativePort(_SS_MAX_RX_BUFF) {
+  if (!nativeSoftwareSerial) nativeSoftwareSerial = this;
+}
+
+// Programs with their own main() (e.g. utils/lora_sim, the unit tests) only take the serial ports
+#if !defined(ARDUINO_NATIVE_NO_RUNTIME) && !defined(PIO_UNIT_TESTING)
+
+/**
+ * Level of a pin set at a given time, read from the pin script.
+ */
+struct PinEvent {
+  uint64_t atMs;
+  uint8_t  pin;
+  uint8_t  level;
+};
+
+static std::vector<PinEvent> pinEvents;
+static size_t                nextPinEvent = 0;
+
+/**
+ * Load the pin script, one "<millis> <pin> <level>" per line in chronological order, '#' starting a comment.
+ * @return false if the file cannot be read or a line is invalid.
+ */
+static bool loadPinScript(const char* path) {
+  FILE* file = fopen(path, "r");
+  if (!file) return false;
+
+  char line[128];
+  bool valid = true;
+  while (valid && fgets(line, sizeof(line), file)) {
+    char* comment = strchr(line, '#');
+    if (comment) *comment = '\0';
+    unsigned long long atMs;
+    unsigned           pin, level;
+    int                fields = sscanf(line, "%llu %u %u", &atMs, &pin, &level);
+    if (fields <= 0) continue; // Empty line
+    valid = fields == 3 && pin < NATIVE_MAX_PINS && level <= 1 && (pinEvents.empty() || atMs >= pinEvents.back().atMs);
+    if (valid) pinEvents.push_back({.atMs = atMs, .pin = (uint8_t)pin, .level = (uint8_t)level});
+  }
+  fclose(file);
+  return valid;
+}
+
+// Set the pins of the script whose time has come
+static void applyPinEvents() {
+  uint64_t nowMs = nativeElapsedUs() / 1000;
+  while (nextPinEvent < pinEvents.size() && pinEvents[nextPinEvent].atMs <= nowMs) {
+    const PinEvent& event = pinEvents[nextPinEvent++];
+    nativeSetPin(event.pin, event.level);
+    nativeTrace("input %u %u", event.pin, event.level);
+  }
+}
+
+static int usage(const char* program) {
+  fprintf(stderr, "Usage: %s [--lora <device>|pty] [--host stdio|unix:<path>] [--eeprom <file>] [--clock real|virtual] [--tick <ms>] [--duration <s>] [--rtc <unix>] [--pins <file>] [--trace <file>|-]\n", program);
+  return 2;
+}
+
+int main(int argc, char** argv) {
+  const char*   lora       = nullptr;
+  const char*   host       = "stdio";
+  const char*   eeprom     = "eeprom.bin";
+  const char*   pins       = nullptr;
+  const char*   traceFile  = nullptr;
+  bool          virtualRun = false;
+  unsigned long tickMs     = NATIVE_VIRTUAL_TICK_MS;
+  uint64_t      durationMs = 0;
+  const char*   rtc        = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 < argc && strcmp(argv[i], "--lora") == 0) {
+      lora = argv[++i];
+    } else if (i + 1 < argc && strcmp(argv[i], "--host") == 0) {
+      host = argv[++i];
+    } else if (i + 1 < argc && strcmp(argv[i], "--eeprom") == 0) {
+      eeprom = argv[++i];
+    } else if (i + 1 < argc && strcmp(argv[i], "--clock") == 0 && (strcmp(argv[i + 1], "real") == 0 || strcmp(argv[i + 1], "virtual") == 0)) {
+      virtualRun = strcmp(argv[++i], "virtual") == 0;
+    } else if (i + 1 < argc && strcmp(argv[i], "--tick") == 0 && atol(argv[i + 1]) > 0) {
+      tickMs = atol(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "--duration") == 0 && atol(argv[i + 1]) > 0) {
+      durationMs = (uint64_t)atol(argv[++i]) * 1000;
+    } else if (i + 1 < argc && strcmp(argv[i], "--rtc") == 0) {
+      rtc = argv[++i];
+    } else if (i + 1 < argc && strcmp(argv[i], "--pins") == 0) {
+      pins = argv[++i];
+    } else if (i + 1 < argc && strcmp(argv[i], "--trace") == 0) {
+      traceFile = argv[++i];
+    } else {
+      return usage(argv[0]);
+    }
+  }
+
+  signal(SIGPIPE, SIG_IGN); // A Unix socket client leaving is handled by the port
+  if (virtualRun) nativeUseVirtualClock();
+  if (rtc) nativeSetRtcTime(strtoul(rtc, nullptr, 10));
+
+  if (pins && !loadPinScript(pins)) {
+    fprintf(stderr, "Cannot read the pin script %s\n", pins);
+    return 1;
+  }
+  if (traceFile) {
+    FILE* trace = strcmp(traceFile, "-") == 0 ? stderr : fopen(traceFile, "w");
+    if (!trace) {
+      perror(traceFile);
+      return 1;
+    }
+    setvbuf(trace, nullptr, _IOFBF, 1 << 16);
+    nativeTraceTo(trace);
+  }
+  if (!EEPROM.open(eeprom)) {
+    perror(eeprom);
+    return 1;
+  }
+  if (strcmp(host, "stdio") == 0) {
+    Serial.attach(STDIN_FILENO, STDOUT_FILENO);
+  } else if (strncmp(host, "unix:", 5) != 0 || !Serial.listenUnix(host + 5)) {
+    fprintf(stderr, "Cannot serve the host on %s\n", host);
+    return 1;
+  }
+  // The LoRa module is on the SoftwareSerial of the gateway, and on Serial1 of the edge
+  NativePort& loraPort = nativeSoftwareSerial ? static_cast<NativePort&>(*nativeSoftwareSerial) : Serial1;
+  if (lora && !(strcmp(lora, "pty") == 0 ? loraPort.openPty() : loraPort.open(lora))) {
+    perror(lora);
+    return 1;
+  }
+
+  applyPinEvents();
+  setup();
+  nativeFlushPorts();
+
+  // With a duration, the firmware runs for that long whatever its inputs, otherwise until they end
+  unsigned long endedAt = 0;
+  bool          ended   = false;
+  while (durationMs ? nativeElapsedUs() / 1000 < durationMs : !ended || millis() - endedAt < NATIVE_DRAIN_MS) {
+    nativeNextCycle();
+    applyPinEvents();
+    loop();
+    nativeFlushPorts();
+    if (!ended && nativeInputEnded()) {
+      ended   = true;
+      endedAt = millis();
+    }
+    if (virtualRun) {
+      nativeConsumeActivity();
+      nativeAdvanceClock((uint64_t)tickMs * 1000); // Each loop() takes a tick of firmware time
+    } else if (!nativeConsumeActivity()) {
+      nativeWaitForInput(NATIVE_IDLE_WAIT_MS);
+    }
+  }
+  nativeTraceTo(nullptr);
+  return 0;
+}
+
+#endif // ARDUINO_NATIVE_NO_RUNTIME, PIO_UNIT_TESTING
@@ -0,0 +1,257 @@
+#include "native_port.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define NATIVE_MAX_PORTS 8
+
+static NativePort* ports[NATIVE_MAX_PORTS];
+static size_t      portCount = 0;
+static bool        activity  = false;
+
+NativePort::NativePort(size_t rxBufferSize) : rxBuffer(new uint8_t[rxBufferSize]), rxBufferSize(rxBufferSize) {
+  if (portCount < NATIVE_MAX_PORTS) ports[portCount++] = this;
+}
+
+NativePort::~NativePort() {
+  closeClient();
+  if (listenFd >= 0) close(listenFd);
+  delete[] rxBuffer;
+}
+
+void NativePort::attach(int newReadFd, int newWriteFd) {
+  readFd  = newReadFd;
+  writeFd = newWriteFd;
+  ended   = false;
+}
+
+bool NativePort::open(const char* path) {
+  struct stat info;
+  if (stat(path, &info) != 0) return false;
+
+  if (S_ISREG(info.st_mode)) { // Capture of the lines of a module, replayed once
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+    attach(fd, -1);
+    return true;
+  }
+
+  int fd = ::open(path, O_RDWR | O_NOCTTY);
+  if (fd < 0) return false;
+  if (isatty(fd)) {
+    struct termios tty;
+    tcgetattr(fd, &tty);
+    cfmakeraw(&tty);
+    tcsetattr(fd, TCSANOW, &tty);
+  }
+  attach(fd, fd);
+  return true;
+}
+
+bool NativePort::openPty() {
+  int fd = posix_openpt(O_RDWR | O_NOCTTY);
+  if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) return false;
+
+  // Raw mode on the slave side, otherwise the lines written by the other program would be echoed back to it.
+  // The slave stays open for the life of the process: the master would otherwise hang up each time the other program
+  // closes it, and could not be polled.
+  int slave = ::open(ptsname(fd), O_RDWR | O_NOCTTY);
+  if (slave < 0) return false;
+  struct termios tty;
+  tcgetattr(slave, &tty);
+  cfmakeraw(&tty);
+  tcsetattr(slave, TCSANOW, &tty);
+  fprintf(stderr, "pty: %s\n", ptsname(fd));
+  isPty = true;
+  attach(fd, fd);
+  return true;
+}
+
+bool NativePort::listenUnix(const char* path) {
+  struct sockaddr_un address = {};
+  address.sun_family         = AF_UNIX;
+  if (strlen(path) >= sizeof(address.sun_path)) return false;
+  strcpy(address.sun_path, path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) return false;
+  unlink(path); // Left by a previous run
+  if (bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(fd, 1) != 0) {
+    close(fd);
+    return false;
+  }
+  listenFd = fd;
+  return true;
+}
+
+void NativePort::setBaudRate(unsigned long baud) {
+  if (readFd < 0 || !isatty(readFd) || isPty) return;
+
+  static const struct {
+    unsigned long baud;
+    speed_t       speed;
+  } speeds[] = {{9600, B9600}, {19200, B19200}, {38400, B38400}, {57600, B57600}, {115200, B115200}, {230400, B230400}};
+  for (const auto& entry : speeds) {
+    if (entry.baud != baud) continue;
+    struct termios tty;
+    tcgetattr(readFd, &tty);
+    cfsetspeed(&tty, entry.speed);
+    tcsetattr(readFd, TCSANOW, &tty);
+    return;
+  }
+  fprintf(stderr, "Unsupported baud rate %lu, the speed of the device is unchanged\n", baud);
+}
+
+bool NativePort::connected() {
+  if (listenFd < 0) return true;
+  acceptClient();
+  return readFd >= 0;
+}
+
+int NativePort::pollFd() const {
+  if (readFd >= 0) return readFd;
+  return listenFd;
+}
+
+int NativePort::available() {
+  if (rxHead == rxTail) fill();
+  return rxTail - rxHead;
+}
+
+int NativePort::read() {
+  if (!available()) return -1;
+  return rxBuffer[rxHead++];
+}
+
+int NativePort::peek() {
+  if (!available()) return -1;
+  return rxBuffer[rxHead];
+}
+
+size_t NativePort::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t NativePort::write(const uint8_t* buffer, size_t size) {
+  for (size_t i = 0; i < size;) {
+    if (txLength == NATIVE_PORT_TX_BUFFER) flush();
+    size_t chunk = size - i < NATIVE_PORT_TX_BUFFER - txLength ? size - i : NATIVE_PORT_TX_BUFFER - txLength;
+    memcpy(txBuffer + txLength, buffer + i, chunk);
+    txLength += chunk;
+    i += chunk;
+  }
+  return size;
+}
+
+/**
+ * Write the buffered bytes, waiting for the descriptor as the firmware would wait for a full UART or USB buffer.
+ */
+void NativePort::flush() {
+  if (listenFd >= 0) acceptClient();
+  size_t sent = 0;
+  while (writeFd >= 0 && sent < txLength) {
+    ssize_t n = ::write(writeFd, txBuffer + sent, txLength - sent);
+    if (n > 0) {
+      sent += n;
+    } else if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+      struct pollfd entry = {writeFd, POLLOUT, 0};
+      poll(&entry, 1, 100);
+    } else if (listenFd >= 0) {
+      closeClient(); // The client left, the next one starts a new session
+    } else {
+      break;
+    }
+  }
+  txLength = 0;
+}
+
+/**
+ * Read the next bytes of the descriptor if some are waiting, never blocks.
+ */
+void NativePort::fill() {
+  if (listenFd >= 0) acceptClient();
+  if (readFd < 0 || ended || refilled) return;
+
+  struct pollfd entry = {readFd, POLLIN, 0};
+  if (poll(&entry, 1, 0) <= 0 || !(entry.revents & (POLLIN | POLLHUP | POLLERR))) return;
+
+  ssize_t n = ::read(readFd, rxBuffer, rxBufferSize);
+  if (n > 0) {
+    rxHead   = 0;
+    rxTail   = n;
+    refilled = true;
+    activity = true;
+  } else if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+    // Nothing to read
+  } else if (listenFd >= 0) {
+    closeClient();
+  } else {
+    if (n < 0) perror("read");
+    ended = true;
+  }
+}
+
+void NativePort::acceptClient() {
+  if (readFd >= 0) return;
+  struct pollfd entry = {listenFd, POLLIN, 0};
+  if (poll(&entry, 1, 0) <= 0) return;
+
+  int fd = accept(listenFd, nullptr, nullptr);
+  if (fd < 0) return;
+  rxHead = rxTail = 0;
+  attach(fd, fd);
+}
+
+void NativePort::closeClient() {
+  if (readFd >= 0) close(readFd);
+  if (writeFd >= 0 && writeFd != readFd) close(writeFd);
+  readFd   = -1;
+  writeFd  = -1;
+  txLength = 0;
+}
+
+void nativeWaitForInput(int timeoutMs) {
+  struct pollfd entries[NATIVE_MAX_PORTS];
+  nfds_t        count = 0;
+  for (size_t i = 0; i < portCount; i++) {
+    int fd = ports[i]->pollFd();
+    if (fd < 0 || ports[i]->atEnd()) continue;
+    entries[count++] = {fd, POLLIN, 0};
+  }
+  poll(entries, count, timeoutMs);
+}
+
+void nativeNextCycle() {
+  for (size_t i = 0; i < portCount; i++) {
+    ports[i]->refilled = false;
+  }
+}
+
+void nativeFlushPorts() {
+  for (size_t i = 0; i < portCount; i++) {
+    ports[i]->flush();
+  }
+}
+
+bool nativeConsumeActivity() {
+  bool seen = activity;
+  activity  = false;
+  return seen;
+}
+
+bool nativeInputEnded() {
+  bool ended = false;
+  for (size_t i = 0; i < portCount; i++) {
+    if (ports[i]->pollFd() < 0) continue; // Not connected
+    if (!ports[i]->atEnd()) return false;
+    ended = true;
+  }
+  return ended;
+}
@@ -0,0 +1,112 @@
+#ifndef NATIVE_PORT_H
+#define NATIVE_PORT_H
+
+#include "Stream.h"
+
+#define NATIVE_PORT_TX_BUFFER 4096
+
+/**
+ * Serial port of a host process, backed by file descriptors: a serial device, a pty, stdin/stdout, a replayed capture
+ * file or the client of a Unix socket. The bytes written are buffered and sent at the end of each loop() (or once the
+ * buffer is full), the reads never wait.
+ * The receive buffer is refilled at most once per loop(), as a UART receives a limited number of bytes meanwhile: a
+ * pipe or a capture file would otherwise flood the firmware faster than any real link.
+ */
+class NativePort : public Stream {
+public:
+  /**
+   * @param rxBufferSize The number of bytes read from the descriptor at once, i.e. the size of the receive buffer of
+   * the emulated UART: the firmware sees at most this many bytes available, as on the board.
+   */
+  explicit NativePort(size_t rxBufferSize);
+  ~NativePort();
+
+  /**
+   * Read and write the given descriptors, which are closed with the port. writeFd may be -1 to discard the output.
+   */
+  void attach(int readFd, int writeFd);
+
+  /**
+   * Open a serial device, a pty or a capture file, set in raw mode if it is a terminal. A capture file is only read.
+   * @return false if the path cannot be opened.
+   */
+  bool open(const char* path);
+
+  /**
+   * Create a pty and read and write its master side, the slave side is printed to stderr for the other program.
+   * @return false if the pty cannot be created.
+   */
+  bool openPty();
+
+  /**
+   * Listen on a Unix socket and serve one client at a time, the output is discarded while no client is connected.
+   * @return false if the socket cannot be created.
+   */
+  bool listenUnix(const char* path);
+
+  /**
+   * Set the speed of a terminal, as begin() does on the board. Does nothing for the other descriptors.
+   */
+  void setBaudRate(unsigned long baud);
+
+  /**
+   * @return true while a client is connected, or if the port is not a socket.
+   */
+  bool connected();
+
+  /**
+   * @return true once the descriptor read reached its end (closed pipe, end of the capture file) and every byte read
+   * was consumed.
+   */
+  bool atEnd() const { return ended && rxHead == rxTail; }
+
+  /**
+   * @return The descriptor to wait on for input, or -1.
+   */
+  int pollFd() const;
+
+  int    available() override;
+  int    read() override;
+  int    peek() override;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  void   flush() override;
+  using Print::write;
+
+private:
+  uint8_t* rxBuffer;
+  size_t   rxBufferSize;
+  size_t   rxHead = 0;
+  size_t   rxTail = 0;
+  uint8_t  txBuffer[NATIVE_PORT_TX_BUFFER];
+  size_t   txLength = 0;
+  int      readFd   = -1;
+  int      writeFd  = -1;
+  int      listenFd = -1; // Unix socket waiting for the next client
+  bool     isPty    = false;
+  bool     ended    = false;
+  bool     refilled = false; // The receive buffer was refilled since the start of the loop()
+
+  friend void nativeNextCycle();
+
+  void fill();
+  void acceptClient();
+  void closeClient();
+};
+
+// Poll the descriptors of every port and wait until one of them has input, or until the timeout
+void nativeWaitForInput(int timeoutMs);
+
+// Let every port receive its next bytes, at the start of each loop() and after a delay()
+void nativeNextCycle();
+
+// Send the buffered output of every port
+void nativeFlushPorts();
+
+// Input seen on a port since the last call, the runtime does not wait for input while there is some
+bool nativeConsumeActivity();
+
+// @return true once every connected port read the end of its input, e.g. a replayed capture with stdin closed
+bool nativeInputEnded();
+
+#endif // NATIVE_PORT_H
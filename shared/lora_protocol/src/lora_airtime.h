@@ -0,0 +1,133 @@
+#ifndef LORA_AIRTIME_H
+#define LORA_AIRTIME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+Time-on-air of the LoRa frames and duty-cycle budget.
+The radio uses the 868.0-868.6 MHz sub-band (EU868 band g1), limited to a 1% duty cycle: at most 36 s of airtime
+per hour for each device.
+*/
+
+// RF configuration of the LoRa module in TEST mode: frequency, SF, bandwidth, TX preamble, RX preamble, power, CRC, IQ inversion, public network
+#define LORA_RFCFG_CMD "AT+TEST=RFCFG,868.1,SF7,125,8,15,14,ON,OFF,OFF"
+
+#define LORA_DUTY_CYCLE_PERCENT 1                                                       // Duty cycle allowed on the sub-band
+#define LORA_DUTY_CYCLE_PERIOD  3600000UL                                               // Period over which the duty cycle is measured, in milliseconds
+#define LORA_AIRTIME_BUDGET_US  (LORA_DUTY_CYCLE_PERIOD * 10 * LORA_DUTY_CYCLE_PERCENT) // Airtime allowed per period, in microseconds
+#define LORA_DUTY_CYCLE_SLOTS   12                                                      // Slots of the sliding window over the period
+#define LORA_DUTY_CYCLE_SLOT_MS (LORA_DUTY_CYCLE_PERIOD / LORA_DUTY_CYCLE_SLOTS)         // Duration of a slot, in milliseconds
+
+/**
+ * Modulation parameters needed to compute the time-on-air of a frame.
+ */
+struct LoraRfConfig {
+  uint8_t  spreadingFactor; // 7 to 12
+  uint16_t bandwidthKhz;    // 125, 250 or 500
+  uint8_t  codingRate;      // 1 to 4 for 4/5 to 4/8
+  uint16_t preambleLength;  // Programmed preamble symbols
+  bool     crc;             // Payload CRC enabled
+  bool     implicitHeader;  // Implicit header mode (no PHY header)
+};
+
+// Parameters of LORA_RFCFG_CMD, the module always uses the 4/5 coding rate in TEST mode
+inline constexpr LoraRfConfig LORA_RF_CONFIG = {
+    .spreadingFactor = 7,
+    .bandwidthKhz    = 125,
+    .codingRate      = 1,
+    .preambleLength  = 8,
+    .crc             = true,
+    .implicitHeader  = false,
+};
+
+/**
+ * Time-on-air of a LoRa frame (Semtech SX1276 datasheet, section 4.1.1.7).
+ * @param config The modulation parameters.
+ * @param payloadBytes The number of bytes given to the radio.
+ * @return The time-on-air in microseconds.
+ */
+constexpr uint32_t loraTimeOnAirUs(const LoraRfConfig& config, size_t payloadBytes) {
+  uint32_t symbolUs = (1000UL << config.spreadingFactor) / config.bandwidthKhz;
+  // Low data rate optimization is mandatory when a symbol lasts more than 16 ms (SF11 and SF12 at 125 kHz)
+  int32_t lowDataRate = symbolUs > 16000 ? 1 : 0;
+
+  int32_t numerator   = 8 * (int32_t)payloadBytes - 4 * config.spreadingFactor + 28 + (config.crc ? 16 : 0) - (config.implicitHeader ? 20 : 0);
+  int32_t denominator = 4 * (config.spreadingFactor - 2 * lowDataRate);
+  int32_t blocks      = numerator > 0 ? (numerator + denominator - 1) / denominator : 0;
+
+  // Preamble lasts (preambleLength + 4.25) symbols, computed in quarter symbols to stay in integers
+  uint32_t preambleUs = (config.preambleLength * 4 + 17) * symbolUs / 4;
+  uint32_t payloadUs  = (8 + blocks * (config.codingRate + 4)) * symbolUs;
+  return preambleUs + payloadUs;
+}
+
+static_assert(loraTimeOnAirUs(LORA_RF_CONFIG, 16) == 51456, "16 bytes at SF7/125 kHz last 51.456 ms");
+
+/**
+ * Airtime budget of a device, over a sliding window: a frame can only be sent if the airtime of the frames sent during
+ * the last period, plus its own, fits in the budget. So no window of one period ever holds more than the budget.
+ * The window is kept as slots of LORA_DUTY_CYCLE_SLOT_MS, plus the current one: a frame is counted for one period
+ * plus at most one slot, which errs on the safe side.
+ * A part of the budget can be kept for more important frames, so periodic traffic cannot starve the alarms.
+ */
+class DutyCycleGovernor {
+public:
+  /**
+   * Take the airtime of a frame from the budget, if enough of it is left.
+   * @param airtimeUs The time-on-air of the frame.
+   * @param reservedPercent The part of the budget that must remain available after this frame.
+   * @param nowMs The current time, in milliseconds (millis()).
+   * @return true if the frame can be sent, false if it must be deferred or dropped.
+   */
+  bool tryConsume(uint32_t airtimeUs, uint8_t reservedPercent, uint32_t nowMs) {
+    advance(nowMs);
+    uint32_t availableUs = LORA_AIRTIME_BUDGET_US - usedUs();
+    uint32_t reservedUs  = LORA_AIRTIME_BUDGET_US / 100 * reservedPercent;
+    if (availableUs < airtimeUs || availableUs - airtimeUs < reservedUs) return false;
+    slotUs[current] += airtimeUs;
+    return true;
+  }
+
+  /**
+   * @param nowMs The current time, in milliseconds (millis()).
+   * @return The part of the budget in use, from 0 to 100 (percent).
+   */
+  uint8_t usagePercent(uint32_t nowMs) {
+    advance(nowMs);
+    return (uint8_t)(usedUs() / (LORA_AIRTIME_BUDGET_US / 100));
+  }
+
+private:
+  uint32_t slotUs[LORA_DUTY_CYCLE_SLOTS + 1] = {}; // Airtime of the frames sent in each slot, as a ring
+  uint32_t slotStartMs                       = 0;  // Start of the current slot
+  uint8_t  current                           = 0;  // Index of the current slot in the ring
+  bool     started                           = false;
+
+  uint32_t usedUs() const {
+    uint32_t used = 0;
+    for (uint32_t airtimeUs : slotUs) {
+      used += airtimeUs;
+    }
+    return used;
+  }
+
+  /**
+   * Move the current slot to the one holding nowMs, the slots that left the window are cleared.
+   */
+  void advance(uint32_t nowMs) {
+    if (!started) {
+      slotStartMs = nowMs;
+      started     = true;
+      return;
+    }
+    uint32_t elapsedSlots = (nowMs - slotStartMs) / LORA_DUTY_CYCLE_SLOT_MS;
+    slotStartMs += elapsedSlots * LORA_DUTY_CYCLE_SLOT_MS;
+    for (uint32_t i = 0; i < elapsedSlots && i <= LORA_DUTY_CYCLE_SLOTS; i++) {
+      current         = (current + 1) % (LORA_DUTY_CYCLE_SLOTS + 1);
+      slotUs[current] = 0;
+    }
+  }
+};
+
+#endif // LORA_AIRTIME_H
@@ -0,0 +1,188 @@
+#ifndef LORA_AT_ENGINE_H
+#define LORA_AT_ENGINE_H
+
+#include "lora_hex.h"
+#include "lora_line_reader.h"
+#include "lora_protocol.h"
+#include <Arduino.h>
+
+/*
+Non-blocking driver of the AT commands of the LoRa module (Seeed LoRa-E5 in TEST mode).
+Commands are queued as transactions and sent one at a time: a transaction completes when a response line contains
+one of its expected strings, when the module answers ERROR/FAIL, or when its timeout expires. poll() must be called
+from the main loop, it never waits for the module.
+*/
+
+#define LORA_AT_BAUD             9600                            // Baud rate of the UART of the module
+#define LORA_AT_QUEUE_SIZE       6                               // Maximum number of pending transactions
+#define LORA_AT_RX_RING          256                             // Bytes buffered between two polls, about 270 ms at 9600 baud
+#define LORA_AT_COMMAND_MAX      (20 + LORA_FRAME_MAX_BYTES * 2) // Longest command: AT+TEST=TXLRPKT,"<hex_frame>"
+#define LORA_AT_LINE_MAX         (16 + LORA_FRAME_MAX_BYTES * 2) // Longest line: +TEST: RX "<hex_frame>"
+#define LORA_AT_RX_INFO_LINE_MAX 40                              // Line printed before each frame received: +TEST: LEN:215, RSSI:-120, SNR:-20
+#define LORA_AT_TX_TIMEOUT       3000                            // Time allowed for AT+TEST=TXLRPKT to print TX DONE
+#define LORA_AT_CMD_TIMEOUT      1000                            // Time allowed for the other commands to answer
+
+/**
+ * @return The time to send this many characters over the UART of the module (8N1, 10 bits per character), rounded up.
+ */
+constexpr uint32_t loraAtUartMs(size_t chars) {
+  return (uint32_t)((chars * 10 * 1000 + LORA_AT_BAUD - 1) / LORA_AT_BAUD);
+}
+
+class LoraAtEngine {
+public:
+  enum class Result : uint8_t {
+    OK,      // A line containing one of the expected strings was received
+    ERROR,   // The module answered ERROR or FAIL
+    TIMEOUT, // No expected line was received before the timeout
+  };
+
+  using Callback    = void (*)(Result result);
+  using LineHandler = void (*)(const char* line, size_t length);
+
+  explicit LoraAtEngine(Stream& serial) : serial(serial), reader(serial, false) {}
+
+  /**
+   * Set the function called for every line printed by the module, including the responses of the transactions
+   * (e.g. to decode the +TEST: RX lines).
+   */
+  void setLineHandler(LineHandler handler) { lineHandler = handler; }
+
+  /**
+   * Queue a command. It is sent once the previous transactions are completed.
+   * @param command The AT command, without line ending.
+   * @param expected The string completing the transaction when a response line contains it.
+   * @param alternative Another string completing the transaction, or nullptr.
+   * @param timeoutMs Time allowed for the response, counted from when the command is written.
+   * @param callback Function called when the transaction completes, or nullptr.
+   * @return false if the queue is full or the command is too long, the command is then dropped.
+   */
+  bool enqueue(const char* command, const char* expected, const char* alternative, uint16_t timeoutMs, Callback callback = nullptr) {
+    size_t length = strlen(command);
+    if (count == LORA_AT_QUEUE_SIZE || length >= LORA_AT_COMMAND_MAX) return false;
+
+    memcpy(push(expected, alternative, timeoutMs, callback).command, command, length + 1);
+    return true;
+  }
+
+  /**
+   * Queue AT+TEST=TXLRPKT,"<hex_frame>", formatted straight into the command buffer of the transaction.
+   * The transaction completes when the module printed TX DONE.
+   * @param frame The bytes of the frame to send.
+   * @param size The number of bytes of the frame.
+   * @param timeoutMs Time allowed for the transmission, counted from when the command is written.
+   * @param callback Function called when the transaction completes, or nullptr.
+   * @return false if the queue is full or the frame is too long, the command is then dropped.
+   */
+  bool enqueueTransmit(const uint8_t* frame, size_t size, uint16_t timeoutMs, Callback callback = nullptr) {
+    static const char prefix[] = "AT+TEST=TXLRPKT,\"";
+    size_t            length   = sizeof(prefix) - 1 + size * 2 + 1; // Prefix, hex frame, closing quote
+    if (count == LORA_AT_QUEUE_SIZE || length >= LORA_AT_COMMAND_MAX) return false;
+
+    char* command = push("TX DONE", nullptr, timeoutMs, callback).command;
+    memcpy(command, prefix, sizeof(prefix) - 1);
+    bytesToHex(frame, size, command + sizeof(prefix) - 1);
+    command[length - 1] = '"';
+    command[length]     = '\0';
+    return true;
+  }
+
+  /**
+   * Read the lines printed by the module, complete the active transaction and send the next command.
+   * Only processes the bytes already received, never waits.
+   */
+  void poll() {
+    size_t      length;
+    const char* line;
+    while ((line = reader.readLine(length))) {
+      processLine(line, length);
+    }
+
+    if (active && millis() - sentAt >= queue[head].timeoutMs) {
+      complete(Result::TIMEOUT);
+    }
+    if (!active && count > 0) {
+      serial.println(queue[head].command);
+      sentAt = millis();
+      active = true;
+    }
+  }
+
+  /**
+   * Buffer the bytes received from the module without processing them, to call between the long steps of the loop.
+   */
+  void pump() { reader.pump(); }
+
+  /**
+   * @return The number of bytes received from the module and dropped because they were not polled in time.
+   */
+  uint32_t getByteOverruns() const { return reader.getByteOverruns(); }
+
+  /**
+   * @return The number of lines dropped because they were longer than LORA_AT_LINE_MAX.
+   */
+  uint32_t getLineOverruns() const { return reader.getLineOverruns(); }
+
+  /**
+   * @return true if no transaction is pending.
+   */
+  bool idle() const { return count == 0; }
+
+  /**
+   * @return The number of free slots in the queue.
+   */
+  uint8_t freeSlots() const { return LORA_AT_QUEUE_SIZE - count; }
+
+private:
+  struct Transaction {
+    char        command[LORA_AT_COMMAND_MAX];
+    const char* expected;
+    const char* alternative;
+    uint16_t    timeoutMs;
+    Callback    callback;
+  };
+
+  Stream&                                       serial;
+  LineReader<LORA_AT_RX_RING, LORA_AT_LINE_MAX> reader;
+  LineHandler                                   lineHandler = nullptr;
+  Transaction                                   queue[LORA_AT_QUEUE_SIZE];
+  uint8_t                                       head        = 0;     // Index of the oldest transaction (the active one if active is true)
+  uint8_t                                       count       = 0;     // Number of queued transactions, including the active one
+  bool                                          active      = false; // The command of queue[head] was written and waits for its response
+  uint32_t                                      sentAt      = 0;     // millis() when the active command was written
+
+  /**
+   * Append a transaction to the queue, the caller checked that a slot is free and writes its command.
+   */
+  Transaction& push(const char* expected, const char* alternative, uint16_t timeoutMs, Callback callback) {
+    Transaction& t = queue[(head + count) % LORA_AT_QUEUE_SIZE];
+    t.expected     = expected;
+    t.alternative  = alternative;
+    t.timeoutMs    = timeoutMs;
+    t.callback     = callback;
+    count++;
+    return t;
+  }
+
+  void processLine(const char* line, size_t length) {
+    if (active) {
+      const Transaction& t = queue[head];
+      if (strstr(line, "ERROR") || strstr(line, "FAIL")) {
+        complete(Result::ERROR);
+      } else if ((t.expected && strstr(line, t.expected)) || (t.alternative && strstr(line, t.alternative))) {
+        complete(Result::OK);
+      }
+    }
+    if (lineHandler) lineHandler(line, length);
+  }
+
+  void complete(Result result) {
+    Callback callback = queue[head].callback;
+    head              = (head + 1) % LORA_AT_QUEUE_SIZE;
+    count--;
+    active = false;
+    if (callback) callback(result); // Called last, so the callback can queue new commands
+  }
+};
+
+#endif // LORA_AT_ENGINE_H
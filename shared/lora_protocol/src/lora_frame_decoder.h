@@ -0,0 +1,187 @@
+#ifndef LORA_FRAME_DECODER_H
+#define LORA_FRAME_DECODER_H
+
+#include "lora_frame_v2.h"
+#include "lora_hex.h"
+#include "lora_protocol.h"
+
+#define LORA_RX_PREFIX "+TEST: RX \"" // Start of a line printed by the LoRa module when a payload is received
+
+/**
+ * Single-pass decoder for the `+TEST: RX "<hex_data>"` lines printed by the LoRa module.
+ * Characters are fed one by one as they come out of the UART and are decoded straight into a LoraPayload:
+ * no line or hex string is buffered and the heap is never used.
+ * v2 frames need the state of their sender to be decoded: their bytes are only collected, see decodeFrameV2().
+ */
+class LoraFrameDecoder {
+public:
+  enum class Result : uint8_t {
+    PENDING,  // More characters are needed (or the current line is not a payload line)
+    FRAME,    // A complete and well-formed payload was decoded, available through payload()
+    INVALID,  // The current line is a payload line but its content is malformed
+    FRAME_V2, // A complete v2 frame was received, its bytes are available through frameV2()
+  };
+
+  LoraFrameDecoder() { reset(); }
+
+  /**
+   * Forget any partially decoded line and wait for the start of a new one.
+   */
+  void reset() {
+    stage      = Stage::PREFIX;
+    prefixPos  = 0;
+    bytePos    = 0;
+    highNibble = 0xFF;
+    version2   = false;
+  }
+
+  /**
+   * Feed the next character received from the LoRa module.
+   * @param c The character to decode.
+   * @return FRAME (or FRAME_V2) when the closing quote of a valid payload line is reached, INVALID when a payload line is malformed, PENDING otherwise.
+   */
+  Result feed(char c) {
+    if (c == '\n') {
+      reset();
+      return Result::PENDING;
+    }
+
+    switch (stage) {
+    case Stage::PREFIX:
+      if (prefixPos == 0 && (c == '\r' || c == ' ')) {
+        return Result::PENDING; // Ignore leading whitespace, like String::trim() did
+      }
+      if (c != LORA_RX_PREFIX[prefixPos]) {
+        stage = Stage::SKIP; // Not a payload line (command response, RSSI info, etc.)
+        return Result::PENDING;
+      }
+      if (++prefixPos == sizeof(LORA_RX_PREFIX) - 1) {
+        stage = Stage::HEX_DATA;
+      }
+      return Result::PENDING;
+
+    case Stage::HEX_DATA: {
+      if (c == '"') {
+        stage = Stage::SKIP;
+        if (version2) {
+          return (bytePos >= LORA_V2_HEADER_BYTES + LORA_FRAME_HMAC_BYTES && highNibble == 0xFF) ? Result::FRAME_V2 : Result::INVALID;
+        }
+        bool complete = bytePos >= LORA_FRAME_HEADER_BYTES && bytePos == frameWireSize(pkt);
+        return (complete && highNibble == 0xFF) ? Result::FRAME : Result::INVALID;
+      }
+
+      uint8_t nibble = HEX_NIBBLE[static_cast<uint8_t>(c)];
+      if (nibble == 0xFF) {
+        stage = Stage::SKIP;
+        return Result::INVALID;
+      }
+      if (highNibble == 0xFF) {
+        highNibble = nibble;
+        return Result::PENDING;
+      }
+
+      uint8_t b  = (highNibble << 4) | nibble;
+      highNibble = 0xFF;
+      if (!storeByte(b)) {
+        stage = Stage::SKIP;
+        return Result::INVALID;
+      }
+      return Result::PENDING;
+    }
+
+    case Stage::SKIP:
+    default:
+      return Result::PENDING;
+    }
+  }
+
+  /**
+   * Decode a bare hex frame (without the module prefix and quotes).
+   * @param hex The hex characters of the frame.
+   * @param length The number of characters.
+   * @return FRAME (or FRAME_V2) if the whole frame was decoded, INVALID otherwise.
+   */
+  Result decodeHex(const char* hex, size_t length) {
+    reset();
+    stage = Stage::HEX_DATA;
+    for (size_t i = 0; i < length; i++) {
+      if (feed(hex[i]) == Result::INVALID) return Result::INVALID;
+    }
+    return feed('"');
+  }
+
+  /**
+   * @return The last decoded payload. Only meaningful right after feed() returned FRAME.
+   */
+  const LoraPayload& payload() const { return pkt; }
+
+  /**
+   * @return The bytes of the last v2 frame. Only meaningful right after feed() returned FRAME_V2.
+   */
+  const uint8_t* frameV2() const { return raw; }
+
+  /**
+   * @return The number of bytes of the last v2 frame.
+   */
+  size_t frameV2Size() const { return bytePos; }
+
+private:
+  enum class Stage : uint8_t {
+    PREFIX,   // Matching LORA_RX_PREFIX
+    HEX_DATA, // Decoding hex characters until the closing quote
+    SKIP,     // Ignoring the rest of the line
+  };
+
+  // A v2 frame is stored as raw bytes in place of the payload
+  union {
+    LoraPayload pkt;
+    uint8_t     raw[LORA_FRAME_MAX_BYTES];
+  };
+  Stage       stage;
+  uint8_t     prefixPos;  // Number of LORA_RX_PREFIX characters matched so far
+  uint16_t    bytePos;    // Number of payload bytes decoded so far
+  uint8_t     highNibble; // Pending high nibble of the current byte, or 0xFF if none
+  bool        version2;   // The first byte is the one of a v2 frame
+
+  /**
+   * Store a decoded byte in the payload field matching its position in the frame (big-endian field order).
+   * v2 frames are only copied, they are decoded later by decodeFrameV2().
+   * @param b The decoded byte.
+   * @return false if the byte makes the payload invalid (unknown type, length too large, too many bytes).
+   */
+  bool storeByte(uint8_t b) {
+    uint16_t pos = bytePos++;
+
+    if (pos == 0 && isFrameV2(b)) {
+      version2 = true;
+    }
+    if (version2) {
+      if (pos >= LORA_FRAME_MAX_BYTES) return false;
+      raw[pos] = b;
+    } else if (pos == 0) {
+      pkt.id = b;
+    } else if (pos <= 4) {
+      pkt.counter = (pos == 1) ? b : (pkt.counter << 8) | b;
+    } else if (pos <= 8) {
+      pkt.ts = (pos == 5) ? b : (pkt.ts << 8) | b;
+    } else if (pos == 9) {
+      if (auto type = parsePayloadType(b)) {
+        pkt.type = type.value();
+      } else {
+        return false;
+      }
+    } else if (pos == 10) {
+      if (b > MAX_PAYLOAD_DATA_SIZE) return false;
+      pkt.length = b;
+    } else if (pos < LORA_FRAME_HEADER_BYTES + pkt.length) {
+      pkt.data[pos - LORA_FRAME_HEADER_BYTES] = b;
+    } else if (pos < LORA_FRAME_HEADER_BYTES + pkt.length + LORA_FRAME_HMAC_BYTES) {
+      pkt.hmac = (pos == LORA_FRAME_HEADER_BYTES + pkt.length) ? b : (pkt.hmac << 8) | b;
+    } else {
+      return false; // More bytes than announced by the length field
+    }
+    return true;
+  }
+};
+
+#endif // LORA_FRAME_DECODER_H
@@ -0,0 +1,354 @@
+#ifndef LORA_FRAME_V2_H
+#define LORA_FRAME_V2_H
+
+#include "lora_mac.h"
+#include "lora_replay.h"
+
+/*
+Compact v2 uplink frame (big-endian fields):
+[MARKER|FLAGS:1][ID:1][COUNTER:1][TYPE:4|LENGTH:4][LENGTH:0-1][EPOCH:0-1][TS_DELTA:0-5][DATA:0-200][HMAC:4]
+
+- MARKER: the 6 high bits of the first byte are set. A v1 frame starts with the node ID, which is at most
+  LORA_V1_MAX_NODE_ID, so the receiver tells both versions apart from the first byte.
+- COUNTER: low byte of the frame counter. The receiver rebuilds the full counter from the highest one of its
+  replay window, so up to 255 consecutive frames can be lost, minus the size of the window.
+- TYPE: payload type, only the uplink types (below 0x10) can be sent as v2.
+  LENGTH: length of DATA, or LORA_V2_LENGTH_ESCAPE if it is given by the next byte.
+  With LORA_V2_FLAG_INLINE, the nibble holds the first data byte instead, and DATA runs until HMAC.
+- EPOCH: with LORA_V2_FLAG_TIMESTAMP, low byte of the frame counter of the v1 frame of the epoch.
+- TS_DELTA: with LORA_V2_FLAG_TIMESTAMP, seconds elapsed since the epoch, as a varint (7 bits per byte, least
+  significant first). Without it, the receiver estimates the timestamp from the epoch and its own clock: the sender
+  only omits it when the estimate is within LORA_V2_TS_TOLERANCE seconds.
+- HMAC: SipHash-2-4 over the uplink direction byte (see lora_mac.h), the full counter, the full timestamp (with
+  LORA_V2_FLAG_TIMESTAMP) and the frame bytes, so a frame decoded with a wrong counter or epoch is rejected.
+
+The epoch is the timestamp of the last v1 frame, anchored to the time it was sent (or received). The sender sends
+a v1 frame every LORA_V2_EPOCH_INTERVAL frames to renew it and to resynchronize the counter. If that frame is lost, the
+receiver still estimates the timestamps from its older epoch, but a delta counts from an epoch it does not know: the
+EPOCH byte tells it so before any MAC is computed (FrameV2Result::STALE_EPOCH), and it asks the sender for a new v1
+frame with a RENEW_EPOCH downlink.
+Heartbeat bodies are compacted: the alarm state is inlined, nextHeartbeat takes a single byte (see encodeIntervalCompact())
+and airtimeUsage is only sent when it is not 0. An event batch holding a single event, e.g. a motion event, is compacted
+to its inlined kind, its age and its value without trailing zeros: the age is the time the event waited in the event
+ring, so the receiver estimates its timestamp without a delta (see eventAgeV2()).
+*/
+
+#define LORA_V2_MARKER         0xFC // Bits set in the first byte of every v2 frame
+#define LORA_V2_FLAG_TIMESTAMP 0x01 // The frame carries a timestamp delta
+#define LORA_V2_FLAG_INLINE    0x02 // The first data byte is carried by the length nibble
+#define LORA_V2_LENGTH_ESCAPE  0x0F // Length nibble announcing an extra length byte
+#define LORA_V2_HEADER_BYTES   4    // marker + id + counter + type/length
+#define LORA_V2_TS_TOLERANCE   2    // Largest error allowed on an estimated timestamp, in seconds
+#define LORA_V2_EPOCH_INTERVAL 16   // Number of frames sent between two v1 frames
+#define LORA_V2_MAX_EVENT_AGE  255  // Largest age of a single event sent instead of its timestamp, in seconds
+#define LORA_V1_MAX_NODE_ID    (LORA_V2_MARKER - 1)
+
+/**
+ * Reference timestamp of the v2 frames.
+ */
+struct LoraEpoch {
+  uint32_t ts;       // Timestamp of the last v1 frame
+  uint32_t ms;       // millis() when this frame was sent or received
+  bool     valid;    // false until a v1 frame was sent or received
+  uint8_t  id;       // Low byte of the frame counter of this frame, carried by the v2 frames with a timestamp delta
+  bool     renewing; // Receiver only: a newer v1 frame was requested, see FrameV2Result::STALE_EPOCH
+
+  /**
+   * @return The timestamp of a frame sent at the given time, estimated from the epoch.
+   */
+  uint32_t estimate(uint32_t nowMs) const { return ts + (nowMs - ms) / 1000; }
+};
+
+/**
+ * Result of the decoding of a v2 frame.
+ */
+enum class FrameV2Result : uint8_t {
+  OK,          // The frame is authentic, its counter must now be accepted by the replay window
+  MALFORMED,   // The frame is truncated or its fields are inconsistent
+  REPLAYED,    // The counter was already received or is too old
+  NO_EPOCH,    // The frame carries a timestamp delta but no epoch was received yet
+  STALE_EPOCH, // The frame carries a timestamp delta from an epoch whose v1 frame was missed, a new one must be requested
+  BAD_MAC,     // The MAC does not match
+};
+
+/**
+ * @return true if the first byte of a frame is the one of a v2 frame.
+ */
+constexpr bool isFrameV2(uint8_t firstByte) {
+  return (firstByte & LORA_V2_MARKER) == LORA_V2_MARKER;
+}
+
+/**
+ * Encode an interval on one byte, as a 4-bit mantissa and a 4-bit exponent: (mantissa << exponent) seconds.
+ * The interval is rounded up, by at most 1/8, so a receiver never expects a heartbeat too early.
+ */
+constexpr uint8_t encodeIntervalCompact(uint16_t seconds) {
+  uint32_t mantissa = seconds;
+  uint8_t  exponent = 0;
+  while (mantissa > 0x0F) {
+    mantissa = (mantissa + 1) / 2;
+    exponent++;
+  }
+  return (uint8_t)((exponent << 4) | mantissa);
+}
+
+constexpr uint16_t decodeIntervalCompact(uint8_t compact) {
+  uint32_t seconds = (uint32_t)(compact & 0x0F) << (compact >> 4);
+  return seconds > UINT16_MAX ? UINT16_MAX : (uint16_t)seconds;
+}
+
+static_assert(decodeIntervalCompact(encodeIntervalCompact(900)) == 960, "900 s is rounded up to 15 << 6 s");
+static_assert(decodeIntervalCompact(encodeIntervalCompact(8)) == 8, "Short intervals are exact");
+
+/**
+ * Write a varint, 7 bits per byte, least significant first.
+ * @return The number of bytes written (1 to 5).
+ */
+inline size_t writeVarint(uint32_t value, uint8_t* out) {
+  size_t size = 0;
+  while (value >= 0x80) {
+    out[size++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  out[size++] = (uint8_t)value;
+  return size;
+}
+
+/**
+ * Read a varint written by writeVarint().
+ * @return The number of bytes read, or 0 if the varint is truncated or too long.
+ */
+inline size_t readVarint(const uint8_t* in, size_t available, uint32_t& value) {
+  value = 0;
+  for (size_t i = 0; i < available && i < 5; i++) {
+    value |= (uint32_t)(in[i] & 0x7F) << (7 * i);
+    if ((in[i] & 0x80) == 0) return i + 1;
+  }
+  return 0;
+}
+
+/**
+ * Rebuild a full frame counter from its low byte: the closest value that is not older than the replay window.
+ * @param highest The highest counter received from the sender.
+ * @param low The low byte received.
+ * @param windowSize The number of counters remembered by the replay window.
+ */
+constexpr uint32_t rebuildFrameCounter(uint32_t highest, uint8_t low, uint32_t windowSize = REPLAY_WINDOW_SIZE) {
+  uint32_t counter = (highest & ~0xFFUL) | low;
+  return (counter < highest && highest - counter >= windowSize) ? counter + 0x100 : counter;
+}
+
+/**
+ * @return true if the payload is an event batch holding a single event, sent in the compact form of compactDataV2().
+ */
+inline bool isSingleEventV2(const LoraPayload& pkt) {
+  EventRecord record;
+  return pkt.type == PayloadType::EVENT_BATCH && pkt.length == BODY_WIRE_SIZE<PayloadType::EVENT_BATCH> && decodePayloadRecord<PayloadType::EVENT_BATCH>(pkt, 0, record) && record.offsetMs == 0;
+}
+
+/**
+ * Age of the single event of a batch sent now, carried by the v2 frame instead of its timestamp.
+ * @return The seconds between the timestamp of the payload and the estimate of the receiver, or 0 if the payload is not
+ * a single event or its timestamp is not within LORA_V2_MAX_EVENT_AGE before the estimate (it is then sent as a delta).
+ */
+inline uint8_t eventAgeV2(const LoraPayload& pkt, const LoraEpoch& epoch, uint32_t nowMs) {
+  uint32_t estimate = epoch.estimate(nowMs);
+  if (!isSingleEventV2(pkt) || pkt.ts > estimate || estimate - pkt.ts > LORA_V2_MAX_EVENT_AGE) return 0;
+  return static_cast<uint8_t>(estimate - pkt.ts);
+}
+
+/**
+ * Data of a payload as carried by a v2 frame. Heartbeats are compacted to [alarmState][nextHeartbeat:1][airtimeUsage],
+ * airtimeUsage being omitted while it is 0. A single event is compacted to [kind][age][value], the trailing zeros of the
+ * value being omitted. Other payloads are unchanged.
+ * @param age The age of a single event, see eventAgeV2().
+ * @param out Buffer of at least MAX_PAYLOAD_DATA_SIZE bytes.
+ * @return The number of bytes written.
+ */
+inline size_t compactDataV2(const LoraPayload& pkt, uint8_t age, uint8_t* out) {
+  HeartbeatBody heartbeat;
+  if (pkt.length == BODY_WIRE_SIZE<PayloadType::EDGE_HEARTBEAT> && decodePayload<PayloadType::EDGE_HEARTBEAT>(pkt, heartbeat)) {
+    out[0] = heartbeat.alarmState;
+    out[1] = encodeIntervalCompact(heartbeat.nextHeartbeat);
+    out[2] = heartbeat.airtimeUsage;
+    return heartbeat.airtimeUsage ? 3 : 2;
+  }
+  EventRecord event;
+  if (isSingleEventV2(pkt) && decodePayloadRecord<PayloadType::EVENT_BATCH>(pkt, 0, event)) {
+    size_t valueLength = sizeof(event.value);
+    while (valueLength > 0 && event.value[valueLength - 1] == 0) {
+      valueLength--;
+    }
+    out[0] = event.kind;
+    out[1] = age;
+    memcpy(out + 2, event.value, valueLength);
+    return 2 + valueLength;
+  }
+  memcpy(out, pkt.data, pkt.length);
+  return pkt.length;
+}
+
+/**
+ * Inverse of compactDataV2(): fill the data and length fields of a payload of known type. The timestamp of a single
+ * event is moved back by its age.
+ * @return false if the data does not match the type.
+ */
+inline bool expandDataV2(const uint8_t* in, size_t length, LoraPayload& pkt) {
+  if (pkt.type == PayloadType::EDGE_HEARTBEAT) {
+    if (length != 2 && length != 3) return false;
+    encodePayload<PayloadType::EDGE_HEARTBEAT>({.alarmState = in[0], .airtimeUsage = (uint8_t)(length == 3 ? in[2] : 0), .nextHeartbeat = decodeIntervalCompact(in[1])}, pkt);
+    return true;
+  }
+  if (pkt.type == PayloadType::EVENT_BATCH && length < BODY_WIRE_SIZE<PayloadType::EVENT_BATCH>) { // Single event
+    if (length < 2) return false;
+    EventRecord event = {.kind = in[0], .offsetMs = 0, .value = {}};
+    memcpy(event.value, in + 2, length - 2);
+    pkt.ts -= in[1];
+    pkt.length = 0;
+    return appendPayloadRecord<PayloadType::EVENT_BATCH>(event, pkt);
+  }
+  if (!isPayloadLengthValid(pkt.type, length)) return false;
+  memcpy(pkt.data, in, length);
+  pkt.length = (uint8_t)length;
+  return true;
+}
+
+/**
+ * MAC of a v2 frame, over the uplink direction, the full counter, the full timestamp if the frame carries one, and the
+ * frame bytes.
+ * @param frame The frame bytes, without the hmac field.
+ */
+inline uint32_t computeFrameMacV2(const LoraMacKey& key, uint32_t counter, bool withTimestamp, uint32_t ts, const uint8_t* frame, size_t size) {
+  uint8_t input[9 + LORA_FRAME_MAX_BYTES];
+  size_t  offset = 0;
+  input[offset++] = static_cast<uint8_t>(LoraDirection::UPLINK); // v2 frames are only sent by the edge nodes
+  WireField<uint32_t>::write(input + offset, counter);
+  offset += 4;
+  if (withTimestamp) {
+    WireField<uint32_t>::write(input + offset, ts);
+    offset += 4;
+  }
+  memcpy(input + offset, frame, size);
+  return static_cast<uint32_t>(sipHash24(key, input, offset + size));
+}
+
+/**
+ * @param ts The timestamp of the payload, plus the age of its event for a single event.
+ * @return true if the timestamp of a payload must be sent, because the receiver could not estimate it from the epoch.
+ */
+inline bool needsTimestampV2(uint32_t ts, const LoraEpoch& epoch, uint32_t nowMs) {
+  uint32_t estimate = epoch.estimate(nowMs);
+  uint32_t error    = ts > estimate ? ts - estimate : estimate - ts;
+  return error > LORA_V2_TS_TOLERANCE;
+}
+
+/**
+ * Serialize and sign a payload as a v2 frame. pkt.counter must be set, pkt.hmac is ignored.
+ * @param epoch The epoch of the sender.
+ * @param nowMs The current time, in milliseconds (millis()).
+ * @param out Buffer of at least LORA_FRAME_MAX_BYTES bytes, or nullptr to only compute the size.
+ * @return The number of bytes of the frame, or 0 if the payload cannot be sent as v2 (it must then be sent as v1).
+ */
+inline size_t writeFrameV2(const LoraMacKey& key, const LoraPayload& pkt, const LoraEpoch& epoch, uint32_t nowMs, uint8_t* out) {
+  uint8_t type = static_cast<uint8_t>(pkt.type);
+  if (!epoch.valid || type > 0x0F || pkt.length > MAX_PAYLOAD_DATA_SIZE) return 0;
+
+  uint8_t age           = eventAgeV2(pkt, epoch, nowMs);
+  bool    withTimestamp = needsTimestampV2(pkt.ts + age, epoch, nowMs);
+  if (withTimestamp && pkt.ts < epoch.ts) return 0; // Negative delta, the epoch must be renewed
+
+  uint8_t data[MAX_PAYLOAD_DATA_SIZE];
+  size_t  dataLength = compactDataV2(pkt, age, data);
+  bool    inlined    = dataLength > 0 && data[0] <= 0x0F;
+
+  uint8_t frame[LORA_FRAME_MAX_BYTES];
+  size_t  size = 0;
+  frame[size++] = LORA_V2_MARKER | (withTimestamp ? LORA_V2_FLAG_TIMESTAMP : 0) | (inlined ? LORA_V2_FLAG_INLINE : 0);
+  frame[size++] = pkt.id;
+  frame[size++] = static_cast<uint8_t>(pkt.counter);
+  if (inlined) {
+    frame[size++] = (type << 4) | data[0];
+  } else if (dataLength < LORA_V2_LENGTH_ESCAPE) {
+    frame[size++] = (type << 4) | (uint8_t)dataLength;
+  } else {
+    frame[size++] = (type << 4) | LORA_V2_LENGTH_ESCAPE;
+    frame[size++] = (uint8_t)dataLength;
+  }
+  if (withTimestamp) {
+    frame[size++] = epoch.id;
+    size += writeVarint(pkt.ts - epoch.ts, frame + size);
+  }
+  size_t skipped = inlined ? 1 : 0;
+  memcpy(frame + size, data + skipped, dataLength - skipped);
+  size += dataLength - skipped;
+
+  if (out) {
+    WireField<uint32_t>::write(frame + size, computeFrameMacV2(key, pkt.counter, withTimestamp, pkt.ts, frame, size));
+    memcpy(out, frame, size + LORA_FRAME_HMAC_BYTES);
+  }
+  return size + LORA_FRAME_HMAC_BYTES;
+}
+
+/**
+ * Decode and authenticate a v2 frame. The counter is checked against the replay window before the MAC is computed.
+ * @param frame The frame bytes, starting with the marker.
+ * @param window The replay window of the sender, see BasicReplayWindow::accept() once the frame is accepted.
+ * @param epoch The epoch of the sender, from its last v1 frame.
+ * @param nowMs The current time, in milliseconds (millis()).
+ * @param pkt The decoded payload, in the same form as a v1 payload (pkt.ts is 0 if it is unknown).
+ */
+template <typename Bitmap>
+FrameV2Result decodeFrameV2(const LoraMacKey& key, const uint8_t* frame, size_t size, const BasicReplayWindow<Bitmap>& window, const LoraEpoch& epoch, uint32_t nowMs, LoraPayload& pkt) {
+  if (size < LORA_V2_HEADER_BYTES + LORA_FRAME_HMAC_BYTES || !isFrameV2(frame[0])) return FrameV2Result::MALFORMED;
+  size_t end = size - LORA_FRAME_HMAC_BYTES;
+
+  bool withTimestamp = frame[0] & LORA_V2_FLAG_TIMESTAMP;
+  bool inlined       = frame[0] & LORA_V2_FLAG_INLINE;
+  auto type          = parsePayloadType(frame[3] >> 4);
+  if (!type || !isUplinkType(type.value())) return FrameV2Result::MALFORMED;
+
+  pkt.id      = frame[1];
+  pkt.counter = rebuildFrameCounter(window.highestCounter(), frame[2], window.SIZE);
+  pkt.type    = type.value();
+  if (!window.check(pkt.counter)) return FrameV2Result::REPLAYED;
+
+  size_t  pos        = LORA_V2_HEADER_BYTES;
+  size_t  dataLength = frame[3] & 0x0F;
+  uint8_t data[MAX_PAYLOAD_DATA_SIZE];
+  if (!inlined && dataLength == LORA_V2_LENGTH_ESCAPE) {
+    if (pos >= end) return FrameV2Result::MALFORMED;
+    dataLength = frame[pos++];
+  }
+
+  if (withTimestamp) {
+    uint32_t delta = 0;
+    size_t   used  = pos < end ? readVarint(frame + pos + 1, end - pos - 1, delta) : 0;
+    if (used == 0) return FrameV2Result::MALFORMED;
+    if (!epoch.valid) return FrameV2Result::NO_EPOCH;
+    if (frame[pos] != epoch.id) return FrameV2Result::STALE_EPOCH;
+    pos += 1 + used;
+    pkt.ts = epoch.ts + delta;
+  } else {
+    pkt.ts = epoch.valid ? epoch.estimate(nowMs) : 0;
+  }
+
+  // The inlined byte is followed by the rest of the data, up to the hmac field
+  size_t skipped = inlined ? 1 : 0;
+  if (inlined) {
+    data[0]    = frame[3] & 0x0F;
+    dataLength = 1 + end - pos;
+  }
+  if (dataLength > MAX_PAYLOAD_DATA_SIZE || pos + dataLength - skipped != end) return FrameV2Result::MALFORMED;
+  memcpy(data + skipped, frame + pos, dataLength - skipped);
+
+  uint8_t expected[LORA_FRAME_HMAC_BYTES];
+  WireField<uint32_t>::write(expected, computeFrameMacV2(key, pkt.counter, withTimestamp, pkt.ts, frame, end));
+  if (!constantTimeEquals(expected, frame + end, LORA_FRAME_HMAC_BYTES)) return FrameV2Result::BAD_MAC;
+  uint32_t hmac;
+  WireField<uint32_t>::read(frame + end, hmac);
+  pkt.hmac = hmac;
+
+  return expandDataV2(data, dataLength, pkt) ? FrameV2Result::OK : FrameV2Result::MALFORMED;
+}
+
+#endif // LORA_FRAME_V2_H
@@ -0,0 +1,112 @@
+#ifndef LORA_HEARTBEAT_H
+#define LORA_HEARTBEAT_H
+
+#include "lora_protocol.h"
+
+/*
+Adaptive heartbeat: a change of state is sent at once, then the heartbeat interval doubles at each periodic heartbeat
+while nothing changes, up to the maximum interval of the policy. Each interval is randomly shortened or lengthened
+by the jitter of the policy so the heartbeats of several nodes do not stay aligned.
+Every heartbeat announces the time until the next one, the receiver considers the node offline after
+LORA_HEARTBEAT_MISSED_ALLOWED + 1 announced intervals without any heartbeat.
+*/
+
+#define LORA_HEARTBEAT_MISSED_ALLOWED 1     // Number of consecutive heartbeats that can be lost before the node is considered offline
+#define LORA_HEARTBEAT_GRACE_MS       10000 // Extra delay allowed for transmission and duty-cycle deferral
+#define LORA_HEARTBEAT_MAX_JITTER     50    // Maximum jitter of a policy, in percent
+
+// Default policy: 8 s after a change (the former fixed interval), up to 15 minutes while nothing changes
+inline constexpr HeartbeatPolicyBody DEFAULT_HEARTBEAT_POLICY = {
+    .minInterval   = 8,
+    .maxInterval   = 900,
+    .jitterPercent = 10,
+};
+
+/**
+ * @return true if the policy can be applied: intervals not null and ordered, jitter not larger than LORA_HEARTBEAT_MAX_JITTER.
+ */
+constexpr bool isHeartbeatPolicyValid(const HeartbeatPolicyBody& policy) {
+  return policy.minInterval > 0 && policy.minInterval <= policy.maxInterval && policy.jitterPercent <= LORA_HEARTBEAT_MAX_JITTER;
+}
+
+/**
+ * Time after which a node is considered offline if no new heartbeat is received.
+ * @param nextHeartbeat The delay announced by the last heartbeat, in seconds.
+ * @return The delay since the reception of the last heartbeat, in milliseconds.
+ */
+constexpr uint32_t heartbeatOfflineDelayMs(uint16_t nextHeartbeat) {
+  return (uint32_t)nextHeartbeat * 1000 * (LORA_HEARTBEAT_MISSED_ALLOWED + 1) + LORA_HEARTBEAT_GRACE_MS;
+}
+
+/**
+ * Schedule of the periodic heartbeats of a node.
+ */
+class HeartbeatScheduler {
+public:
+  HeartbeatScheduler() : policy(DEFAULT_HEARTBEAT_POLICY), intervalS(DEFAULT_HEARTBEAT_POLICY.minInterval), dueMs(0), randomState(0x9E3779B9) {}
+
+  /**
+   * Seed the jitter, with a value different for each node (e.g. node ID and boot time).
+   */
+  void seed(uint32_t value) { randomState = value ? value : 0x9E3779B9; }
+
+  /**
+   * Apply a new policy, the next heartbeat is scheduled with its minimum interval.
+   * @return false if the policy is invalid, the current one is then kept.
+   */
+  bool setPolicy(const HeartbeatPolicyBody& newPolicy, uint32_t nowMs) {
+    if (!isHeartbeatPolicyValid(newPolicy)) return false;
+    policy = newPolicy;
+    restart(nowMs);
+    return true;
+  }
+
+  const HeartbeatPolicyBody& getPolicy() const { return policy; }
+
+  /**
+   * A change of state is being sent: back to the minimum interval.
+   * @return The delay until the next periodic heartbeat, in seconds (to announce in the heartbeat).
+   */
+  uint16_t restart(uint32_t nowMs) {
+    intervalS = policy.minInterval;
+    return schedule(nowMs);
+  }
+
+  /**
+   * A periodic heartbeat is being sent while nothing changed: the interval doubles, up to the maximum of the policy.
+   * @return The delay until the next periodic heartbeat, in seconds (to announce in the heartbeat).
+   */
+  uint16_t backOff(uint32_t nowMs) {
+    intervalS = intervalS > policy.maxInterval / 2 ? policy.maxInterval : intervalS * 2;
+    return schedule(nowMs);
+  }
+
+  /**
+   * @return true once the delay announced by the last heartbeat has elapsed.
+   */
+  bool isDue(uint32_t nowMs) const { return (int32_t)(nowMs - dueMs) >= 0; }
+
+private:
+  HeartbeatPolicyBody policy;
+  uint16_t            intervalS;   // Current interval without jitter
+  uint32_t            dueMs;       // millis() when the next periodic heartbeat must be sent
+  uint32_t            randomState; // xorshift32 state of the jitter
+
+  uint16_t schedule(uint32_t nowMs) {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+
+    // Uniform offset in [-jitter, +jitter] percent of the interval
+    int32_t spreadS = (int32_t)intervalS * policy.jitterPercent / 100;
+    int32_t offsetS = spreadS ? (int32_t)(randomState % (2 * spreadS + 1)) - spreadS : 0;
+    int32_t delayS  = (int32_t)intervalS + offsetS;
+    if (delayS < 1) delayS = 1;
+    if (delayS > UINT16_MAX) delayS = UINT16_MAX;
+
+    dueMs = nowMs + (uint32_t)delayS * 1000;
+    return (uint16_t)delayS;
+  }
+};
+
+#endif // LORA_HEARTBEAT_H
@@ -0,0 +1,61 @@
+#ifndef LORA_HEX_H
+#define LORA_HEX_H
+
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Build the lookup table converting an ASCII character into its hex nibble value (0xFF for non-hex characters).
+ */
+constexpr std::array<uint8_t, 256> makeHexNibbleTable() {
+  std::array<uint8_t, 256> table{};
+  for (size_t i = 0; i < table.size(); i++) {
+    table[i] = 0xFF;
+  }
+  for (uint8_t i = 0; i < 10; i++) {
+    table['0' + i] = i;
+  }
+  for (uint8_t i = 0; i < 6; i++) {
+    table['A' + i] = 10 + i;
+    table['a' + i] = 10 + i;
+  }
+  return table;
+}
+
+inline constexpr std::array<uint8_t, 256> HEX_NIBBLE = makeHexNibbleTable();
+inline constexpr char                     HEX_DIGITS[] = "0123456789ABCDEF";
+
+/**
+ * Write bytes as uppercase hex characters followed by a null terminator.
+ * @param out Buffer of at least 2 * length + 1 characters.
+ * @return The number of hex characters written (without the null terminator).
+ */
+inline size_t bytesToHex(const uint8_t* bytes, size_t length, char* out) {
+  for (size_t i = 0; i < length; i++) {
+    out[2 * i]     = HEX_DIGITS[bytes[i] >> 4];
+    out[2 * i + 1] = HEX_DIGITS[bytes[i] & 0x0F];
+  }
+  out[2 * length] = '\0';
+  return 2 * length;
+}
+
+/**
+ * Decode hex characters into bytes.
+ * @param hex The hex characters, two per byte.
+ * @param hexLength The number of characters to decode, must be even.
+ * @param out Buffer receiving hexLength / 2 bytes.
+ * @return false if the length is odd or a character is not a hex digit.
+ */
+inline bool hexToBytes(const char* hex, size_t hexLength, uint8_t* out) {
+  if (hexLength % 2 != 0) return false;
+  for (size_t i = 0; i < hexLength; i += 2) {
+    uint8_t high = HEX_NIBBLE[static_cast<uint8_t>(hex[i])];
+    uint8_t low  = HEX_NIBBLE[static_cast<uint8_t>(hex[i + 1])];
+    if ((high | low) == 0xFF) return false;
+    out[i / 2] = (high << 4) | low;
+  }
+  return true;
+}
+
+#endif // LORA_HEX_H
@@ -0,0 +1,136 @@
+#ifndef LORA_LINE_READER_H
+#define LORA_LINE_READER_H
+
+#include <Arduino.h>
+
+/*
+Non-blocking line framing of a serial stream, for the LoRa module UART and the USB Serial link.
+The receive buffer of a stream is small (64 bytes for SoftwareSerial, about 65 ms at 9600 baud) and is filled by its
+interrupt whatever the loop is doing. pump() moves the bytes it holds into a larger ring buffer: it is cheap and can be
+called between any two long steps of the loop (e.g. after printing a Json line). readLine() then assembles the buffered
+bytes into lines, a partial line is kept until its end arrives instead of waiting for it.
+*/
+
+/**
+ * Fixed-size FIFO of bytes. Bytes pushed while it is full are dropped and counted.
+ * @tparam N The capacity, a power of 2.
+ */
+template <size_t N>
+class ByteRing {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "The capacity of a ByteRing must be a power of 2");
+
+public:
+  /**
+   * @return false if the ring is full, the byte is then dropped.
+   */
+  bool push(uint8_t value) {
+    if (isFull()) {
+      overruns++;
+      return false;
+    }
+    buffer[tail++ & (N - 1)] = value;
+    return true;
+  }
+
+  /**
+   * @return false if the ring is empty.
+   */
+  bool pop(uint8_t& value) {
+    if (isEmpty()) return false;
+    value = buffer[head++ & (N - 1)];
+    return true;
+  }
+
+  bool isEmpty() const { return head == tail; }
+
+  bool isFull() const { return (size_t)(tail - head) == N; }
+
+  /**
+   * @return The number of bytes dropped because the ring was full.
+   */
+  uint32_t getOverruns() const { return overruns; }
+
+private:
+  uint8_t  buffer[N];
+  size_t   head     = 0; // Free-running indexes, masked on access, their difference is the number of bytes held
+  size_t   tail     = 0;
+  uint32_t overruns = 0;
+};
+
+/**
+ * Lines of a serial stream, without their line ending. Empty lines are skipped.
+ * @tparam RingSize The capacity of the ring buffer, a power of 2.
+ * @tparam LineMax The size of the longest line, including the terminating null character.
+ */
+template <size_t RingSize, size_t LineMax>
+class LineReader {
+public:
+  /**
+   * @param stream The stream to read.
+   * @param flowControlled true if the sender waits while the bytes are not read (USB CDC): pump() then leaves them in
+   * the stream once the ring is full. Otherwise, they are dropped and counted as overruns, as the stream would lose
+   * them anyway.
+   */
+  LineReader(Stream& stream, bool flowControlled) : stream(stream), flowControlled(flowControlled) {}
+
+  /**
+   * Move the bytes already received by the stream into the ring buffer, never waits.
+   */
+  void pump() {
+    while ((!flowControlled || !ring.isFull()) && stream.available()) {
+      ring.push((uint8_t)stream.read());
+    }
+  }
+
+  /**
+   * Assemble the buffered bytes into the next line, pumping the stream each time the ring buffer runs empty.
+   * A line longer than LineMax - 1 characters is dropped and counted as a line overrun.
+   * @param length Set to the number of characters of the line.
+   * @return The null-terminated line, valid until the next call, or nullptr if no complete line was received yet.
+   */
+  const char* readLine(size_t& length) {
+    uint8_t c;
+    while (true) {
+      if (ring.isEmpty()) pump();
+      if (!ring.pop(c)) return nullptr;
+
+      if (c == '\n') {
+        bool complete = !truncated && lineLength > 0;
+        length        = lineLength;
+        lineLength    = 0;
+        truncated     = false;
+        if (!complete) continue;
+        line[length] = '\0';
+        return line;
+      }
+      if (c == '\r') continue;
+      if (lineLength == LineMax - 1) {
+        if (!truncated) lineOverruns++;
+        truncated = true; // The rest of the line is dropped with it
+        continue;
+      }
+      line[lineLength++] = (char)c;
+    }
+  }
+
+  /**
+   * @return The number of bytes dropped because the ring buffer was full.
+   */
+  uint32_t getByteOverruns() const { return ring.getOverruns(); }
+
+  /**
+   * @return The number of lines dropped because they were longer than LineMax - 1 characters.
+   */
+  uint32_t getLineOverruns() const { return lineOverruns; }
+
+private:
+  Stream&            stream;
+  bool               flowControlled;
+  ByteRing<RingSize> ring;
+  char               line[LineMax];
+  size_t             lineLength   = 0;
+  bool               truncated    = false; // The current line is too long, it is dropped once its end arrives
+  uint32_t           lineOverruns = 0;
+};
+
+#endif // LORA_LINE_READER_H
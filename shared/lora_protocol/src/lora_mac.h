@@ -0,0 +1,150 @@
+#ifndef LORA_MAC_H
+#define LORA_MAC_H
+
+#include "lora_protocol.h"
+
+/*
+Keyed MAC of the LoRa frames: SipHash-2-4 over the direction of the frame and its raw bytes (header + data, in wire
+order), truncated to the 32 bits of the hmac field. Both directions share the key of the node, the direction byte makes
+an uplink fail the MAC when it is replayed as a downlink, and the other way around.
+*/
+
+#define LORA_MAC_KEY_BYTES 16
+
+// Key of the edge nodes while none is stored in their EEPROM, registered at the gateway while its node table is empty.
+// Only suitable for development: each node must get its own key
+inline constexpr uint8_t LORA_DEFAULT_MAC_KEY[LORA_MAC_KEY_BYTES] = {0xb5, 0xdf, 0x4a, 0x1d, 0x51, 0x4b, 0x1d, 0x54, 0xfd, 0x5c, 0x5d, 0x5f, 0x7d, 0x5b, 0xd5, 0x3e};
+
+/**
+ * Direction of a frame, first byte of the MAC input.
+ */
+enum class LoraDirection : uint8_t {
+  UPLINK   = 0x01, // Edge -> gateway
+  DOWNLINK = 0x02, // Gateway -> edge
+};
+
+/**
+ * SipHash state derived from the 128-bit key. It only depends on the key, so it is computed once (at boot or
+ * when the key changes) instead of for every frame.
+ */
+struct LoraMacKey {
+  uint64_t v0;
+  uint64_t v1;
+  uint64_t v2;
+  uint64_t v3;
+};
+
+inline uint64_t loadU64LE(const uint8_t* in) {
+  uint64_t value = 0;
+  for (int i = 7; i >= 0; i--) {
+    value = (value << 8) | in[i];
+  }
+  return value;
+}
+
+inline uint64_t rotl64(uint64_t x, int b) {
+  return (x << b) | (x >> (64 - b));
+}
+
+inline void sipRound(uint64_t& v0, uint64_t& v1, uint64_t& v2, uint64_t& v3) {
+  v0 += v1;
+  v1 = rotl64(v1, 13);
+  v1 ^= v0;
+  v0 = rotl64(v0, 32);
+  v2 += v3;
+  v3 = rotl64(v3, 16);
+  v3 ^= v2;
+  v0 += v3;
+  v3 = rotl64(v3, 21);
+  v3 ^= v0;
+  v2 += v1;
+  v1 = rotl64(v1, 17);
+  v1 ^= v2;
+  v2 = rotl64(v2, 32);
+}
+
+/**
+ * Precompute the SipHash state of a key.
+ * @param key The 16 bytes of the shared secret.
+ */
+inline LoraMacKey loraMacKeyFromBytes(const uint8_t (&key)[LORA_MAC_KEY_BYTES]) {
+  uint64_t k0 = loadU64LE(key);
+  uint64_t k1 = loadU64LE(key + 8);
+  return LoraMacKey{
+      .v0 = k0 ^ 0x736f6d6570736575ULL,
+      .v1 = k1 ^ 0x646f72616e646f6dULL,
+      .v2 = k0 ^ 0x6c7967656e657261ULL,
+      .v3 = k1 ^ 0x7465646279746573ULL,
+  };
+}
+
+/**
+ * SipHash-2-4 of a byte buffer.
+ * @return The 64-bit hash.
+ */
+inline uint64_t sipHash24(const LoraMacKey& key, const uint8_t* data, size_t length) {
+  uint64_t v0 = key.v0, v1 = key.v1, v2 = key.v2, v3 = key.v3;
+
+  const uint8_t* end = data + length - (length % 8);
+  for (; data != end; data += 8) {
+    uint64_t m = loadU64LE(data);
+    v3 ^= m;
+    sipRound(v0, v1, v2, v3);
+    sipRound(v0, v1, v2, v3);
+    v0 ^= m;
+  }
+
+  uint64_t last = static_cast<uint64_t>(length) << 56;
+  for (size_t i = 0; i < length % 8; i++) {
+    last |= static_cast<uint64_t>(data[i]) << (8 * i);
+  }
+  v3 ^= last;
+  sipRound(v0, v1, v2, v3);
+  sipRound(v0, v1, v2, v3);
+  v0 ^= last;
+
+  v2 ^= 0xff;
+  for (int i = 0; i < 4; i++) {
+    sipRound(v0, v1, v2, v3);
+  }
+  return v0 ^ v1 ^ v2 ^ v3;
+}
+
+/**
+ * Compare two buffers in a time that does not depend on their content, so a forger cannot learn how many
+ * bytes of a tag are correct.
+ */
+inline bool constantTimeEquals(const uint8_t* a, const uint8_t* b, size_t length) {
+  uint8_t diff = 0;
+  for (size_t i = 0; i < length; i++) {
+    diff |= a[i] ^ b[i];
+  }
+  return diff == 0;
+}
+
+/**
+ * Compute the MAC of a payload over its direction and its wire bytes, excluding the hmac field itself.
+ * @param direction The direction the payload is sent in.
+ * @return The truncated tag to store in pkt.hmac.
+ */
+inline uint32_t computeFrameMac(const LoraMacKey& key, LoraDirection direction, const LoraPayload& pkt) {
+  uint8_t input[1 + LORA_FRAME_MAX_BYTES];
+  input[0]    = static_cast<uint8_t>(direction);
+  size_t size = writeFrame(pkt, input + 1) - LORA_FRAME_HMAC_BYTES;
+  return static_cast<uint32_t>(sipHash24(key, input, 1 + size));
+}
+
+/**
+ * Check the hmac field of a received payload.
+ * @param direction The direction the payload was received in.
+ * @return true if the tag matches the content of the payload.
+ */
+inline bool verifyFrameMac(const LoraMacKey& key, LoraDirection direction, const LoraPayload& pkt) {
+  uint8_t expected[LORA_FRAME_HMAC_BYTES];
+  uint8_t received[LORA_FRAME_HMAC_BYTES];
+  WireField<uint32_t>::write(expected, computeFrameMac(key, direction, pkt));
+  WireField<uint32_t>::write(received, pkt.hmac);
+  return constantTimeEquals(expected, received, LORA_FRAME_HMAC_BYTES);
+}
+
+#endif // LORA_MAC_H
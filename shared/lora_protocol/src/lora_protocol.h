@@ -0,0 +1,504 @@
+#ifndef LORA_PROTOCOL_H
+#define LORA_PROTOCOL_H
+
+#include <optional>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <tuple>
+#include <type_traits>
+
+/*
+Wire format shared by the edge and the gateway firmware. Both projects include this header so the payload types
+and layouts can no longer drift apart.
+
+LoRa frame (big-endian fields):
+[ID:1][COUNTER:4][TS:4][TYPE:1][LENGTH:1][DATA:0-200][HMAC:4]
+
+The content of DATA is described per payload type by a PayloadLayout specialization (see below).
+*/
+
+enum class PayloadType : uint8_t {
+  UNKNOWN                 = 0x00, // 0: Bad data
+  EDGE_HEARTBEAT          = 0x01, // 1: Edge    -> Heartbeat message sent periodically to indicate that the system is alive, with the current alarm state included in the payload data
+  MOTION_STATE            = 0x02, // 2: Edge    -> Message sent when motion is detected, with the motion state (e.g., detected or not detected) included in the payload data
+  EVENT_BATCH             = 0x03, // 3: Edge    -> Several events (motion, state transitions, wrong codes, RTC corrections) aggregated in one frame
+  TRANSFER_STATUS         = 0x04, // 4: Edge    -> Fragments of a time range transfer received so far, or the commit of the new rule set
+  SET_COMBINATION         = 0x11, // 17: Broker -> Set the expected combination
+  SET_TIME_RANGE          = 0x12, // 18: Broker -> Set the monitored time range
+  SET_ALARM_STATE         = 0x13, // 19: Broker -> Set the alarm state
+  SET_RTC_TIME            = 0x14, // 20: Broker -> Set the RTC time
+  SET_HEARTBEAT_POLICY    = 0x15, // 21: Broker -> Set the intervals and jitter of the adaptive heartbeat
+  SET_TIME_RANGE_FRAGMENT = 0x16, // 22: Broker -> Part of a time range rule set too large for a single frame
+  RENEW_EPOCH             = 0x17, // 23: Gateway -> Send a v1 frame, the epoch of the last v2 frames was missed
+};
+
+#define MAX_PAYLOAD_DATA_SIZE   200
+#define LORA_FRAME_HEADER_BYTES 11 // id + counter + ts + type + length
+#define LORA_FRAME_HMAC_BYTES   4
+#define LORA_FRAME_MAX_BYTES    (LORA_FRAME_HEADER_BYTES + MAX_PAYLOAD_DATA_SIZE + LORA_FRAME_HMAC_BYTES)
+
+struct LoraPayload {
+  uint8_t     id;                          // 1 byte : ID of the sender node, set by the sender
+  uint32_t    counter;                     // 4 bytes : Frame counter of the sender, strictly increasing for each frame sent, used to reject replayed frames
+  uint32_t    ts;                          // 4 bytes : Unix timestamp of when the payload was created, set by the sender
+  PayloadType type;                        // 1 byte : Type of the payload (e.g., heartbeat, motion state, configuration, etc.), set by the sender
+  uint8_t     length;                      // 1 byte : Length of the payload data in bytes, set by the sender
+  uint8_t     data[MAX_PAYLOAD_DATA_SIZE]; // MAX_PAYLOAD_DATA_SIZE bytes : Payload data, content depends on the payload type, set by the sender
+  uint32_t    hmac;                        // 4 bytes : HMAC signature of the payload for integrity and authenticity verification
+} __attribute__((packed));
+
+static_assert(sizeof(LoraPayload) == LORA_FRAME_MAX_BYTES, "LoraPayload must match the size of the largest frame on the wire");
+
+/**
+ * Convert a uint8_t potentially representing an PayloadType into its enum value or return nullopt
+ * @param raw The raw uint8_t value to convert
+ * @return PayloadType correspondig to the raw value or nullopt
+ */
+constexpr std::optional<PayloadType> parsePayloadType(uint8_t raw) {
+  switch (raw) {
+  case 0x00: return PayloadType::UNKNOWN;
+  case 0x01: return PayloadType::EDGE_HEARTBEAT;
+  case 0x02: return PayloadType::MOTION_STATE;
+  case 0x03: return PayloadType::EVENT_BATCH;
+  case 0x04: return PayloadType::TRANSFER_STATUS;
+  case 0x11: return PayloadType::SET_COMBINATION;
+  case 0x12: return PayloadType::SET_TIME_RANGE;
+  case 0x13: return PayloadType::SET_ALARM_STATE;
+  case 0x14: return PayloadType::SET_RTC_TIME;
+  case 0x15: return PayloadType::SET_HEARTBEAT_POLICY;
+  case 0x16: return PayloadType::SET_TIME_RANGE_FRAGMENT;
+  case 0x17: return PayloadType::RENEW_EPOCH;
+  default:   return std::nullopt; // Invalid value
+  }
+}
+
+/**
+ * @return true for the payload types sent by the edge nodes to the gateway.
+ */
+constexpr bool isUplinkType(PayloadType type) {
+  return static_cast<uint8_t>(type) >= 0x01 && static_cast<uint8_t>(type) <= 0x0F;
+}
+
+/**
+ * @return true for the payload types sent by the gateway to the edge nodes.
+ */
+constexpr bool isDownlinkType(PayloadType type) {
+  return static_cast<uint8_t>(type) >= 0x11;
+}
+
+// --- FIELD ENCODING ---
+
+/**
+ * Wire encoding of a single body field: integers and enums are written big-endian on sizeof(T) bytes.
+ */
+template <typename T>
+struct WireField {
+  static_assert(std::is_integral<T>::value || std::is_enum<T>::value, "Only integers, enums and byte arrays can be sent on the wire");
+  using Unsigned = typename std::make_unsigned<T>::type;
+
+  static constexpr size_t SIZE = sizeof(T);
+
+  static void write(uint8_t* out, const T& value) {
+    Unsigned raw = static_cast<Unsigned>(value);
+    for (size_t i = 0; i < SIZE; i++) {
+      out[i] = static_cast<uint8_t>(raw >> (8 * (SIZE - 1 - i)));
+    }
+  }
+
+  static void read(const uint8_t* in, T& value) {
+    Unsigned raw = 0;
+    for (size_t i = 0; i < SIZE; i++) {
+      raw = static_cast<Unsigned>((raw << 8) | in[i]);
+    }
+    value = static_cast<T>(raw);
+  }
+};
+
+/**
+ * Wire encoding of a byte array field: bytes are copied as-is.
+ */
+template <size_t N>
+struct WireField<uint8_t[N]> {
+  static constexpr size_t SIZE = N;
+
+  static void write(uint8_t* out, const uint8_t (&value)[N]) { memcpy(out, value, N); }
+  static void read(const uint8_t* in, uint8_t (&value)[N]) { memcpy(value, in, N); }
+};
+
+template <typename Body, typename Member>
+constexpr size_t memberWireSize(Member Body::*) {
+  return WireField<Member>::SIZE;
+}
+
+/**
+ * @return The number of bytes taken on the wire by a list of member pointers.
+ */
+template <typename Fields>
+constexpr size_t fieldsWireSize(const Fields& fields) {
+  return std::apply([](auto... members) { return (memberWireSize(members) + ... + size_t(0)); }, fields);
+}
+
+template <typename Body, typename Member>
+void writeMember(const Body& body, Member Body::* member, uint8_t* out, size_t& offset) {
+  WireField<Member>::write(out + offset, body.*member);
+  offset += WireField<Member>::SIZE;
+}
+
+template <typename Body, typename Member>
+void readMember(const uint8_t* in, Member Body::* member, Body& body, size_t& offset) {
+  WireField<Member>::read(in + offset, body.*member);
+  offset += WireField<Member>::SIZE;
+}
+
+template <typename Body, typename Fields>
+size_t writeFields(const Body& body, const Fields& fields, uint8_t* out) {
+  size_t offset = 0;
+  std::apply([&](auto... members) { ((writeMember(body, members, out, offset)), ...); }, fields);
+  return offset;
+}
+
+template <typename Body, typename Fields>
+size_t readFields(const uint8_t* in, const Fields& fields, Body& body) {
+  size_t offset = 0;
+  std::apply([&](auto... members) { ((readMember(in, members, body, offset)), ...); }, fields);
+  return offset;
+}
+
+// --- PAYLOAD LAYOUTS ---
+
+struct HeartbeatBody {
+  uint8_t  alarmState;    // Current AlarmState of the edge
+  uint8_t  airtimeUsage;  // Part of the duty-cycle airtime budget of the edge in use, in percent
+  uint16_t nextHeartbeat; // Seconds until the next periodic heartbeat, the node is offline if nothing is received by then
+};
+
+struct MotionStateBody {
+  uint8_t motion; // 1 if motion is detected, 0 otherwise
+};
+
+/**
+ * Kind of an event of an EVENT_BATCH payload, and content of its value.
+ */
+enum class EventKind : uint8_t {
+  MOTION           = 1, // Motion sensor edge, value: MotionStateBody
+  STATE_TRANSITION = 2, // Alarm state change, value: HeartbeatBody sent with the new state
+  WRONG_CODE       = 3, // Wrong combination entered, value: [attempt][maximum attempts]
+  RTC_CORRECTION   = 4, // RTC corrected from the gateway time, value: correction in seconds (int32_t)
+};
+
+struct EventRecord {
+  uint8_t  kind;     // EventKind
+  uint16_t offsetMs; // Time of the event after the ts field of the frame, in milliseconds
+  uint8_t  value[4]; // Content depending on the kind, big-endian, padded with zeros
+};
+
+struct TransferStatusBody {
+  uint8_t  transferId;   // Transfer the status is about
+  uint8_t  state;        // TransferState
+  uint16_t receivedMask; // Bit i set when fragment i was received
+};
+
+struct CombinationBody {
+  uint8_t digits[4]; // New secret combination, each digit from 0 to 9
+};
+
+struct TimeRangeRuleRecord {
+  uint8_t  weekDayMask;  // 0-6 (0-Sunday, 1-Monday, ... , 6-Saturday)
+  uint32_t hourMask;     // 0-23 hours as bits
+  uint32_t monthDayMask; // 1-31 days as bits
+  uint16_t monthMask;    // 1-12 months as bits
+};
+
+struct TimeRangeFragmentHeader {
+  uint8_t  transferId;    // Same for all the fragments of a rule set, changes for each new rule set
+  uint8_t  fragmentIndex; // Position of the fragment, from 0 to fragmentCount - 1
+  uint8_t  fragmentCount; // Number of fragments of the rule set
+  uint8_t  ruleCount;     // Number of rules of the whole rule set
+  uint32_t ruleSetHash;   // transferRuleSetHash() of the whole rule set, tells apart two transfers given the same ID
+};
+
+struct AlarmStateBody {
+  uint8_t alarmState; // AlarmState to switch to
+};
+
+struct RtcTimeBody {}; // The time to set is carried by the ts field of the frame
+
+struct RenewEpochBody {}; // The request itself is the whole message
+
+struct HeartbeatPolicyBody {
+  uint16_t minInterval;   // Heartbeat interval after a change, in seconds
+  uint16_t maxInterval;   // Heartbeat interval reached by doubling while nothing changes, in seconds (equal to minInterval for a fixed interval)
+  uint8_t  jitterPercent; // Random variation of each interval, from 0 to 50 percent
+};
+
+/**
+ * Compile-time description of the DATA field of each payload type.
+ * - Body:     Structure holding the decoded fields
+ * - FIELDS:   Members of Body in wire order
+ * - REPEATED: Whether DATA holds a list of Body records (e.g. time range rules) instead of a single one
+ */
+template <PayloadType T>
+struct PayloadLayout; // No layout for UNKNOWN
+
+template <>
+struct PayloadLayout<PayloadType::EDGE_HEARTBEAT> {
+  using Body                     = HeartbeatBody;
+  static constexpr auto FIELDS   = std::make_tuple(&HeartbeatBody::alarmState, &HeartbeatBody::airtimeUsage, &HeartbeatBody::nextHeartbeat);
+  static constexpr bool REPEATED = false;
+};
+
+template <>
+struct PayloadLayout<PayloadType::MOTION_STATE> {
+  using Body                     = MotionStateBody;
+  static constexpr auto FIELDS   = std::make_tuple(&MotionStateBody::motion);
+  static constexpr bool REPEATED = false;
+};
+
+template <>
+struct PayloadLayout<PayloadType::EVENT_BATCH> {
+  using Body                     = EventRecord;
+  static constexpr auto FIELDS   = std::make_tuple(&EventRecord::kind, &EventRecord::offsetMs, &EventRecord::value);
+  static constexpr bool REPEATED = true;
+};
+
+template <>
+struct PayloadLayout<PayloadType::TRANSFER_STATUS> {
+  using Body                     = TransferStatusBody;
+  static constexpr auto FIELDS   = std::make_tuple(&TransferStatusBody::transferId, &TransferStatusBody::state, &TransferStatusBody::receivedMask);
+  static constexpr bool REPEATED = false;
+};
+
+template <>
+struct PayloadLayout<PayloadType::SET_COMBINATION> {
+  using Body                     = CombinationBody;
+  static constexpr auto FIELDS   = std::make_tuple(&CombinationBody::digits);
+  static constexpr bool REPEATED = false;
+};
+
+template <>
+struct PayloadLayout<PayloadType::SET_TIME_RANGE> {
+  using Body                     = TimeRangeRuleRecord;
+  static constexpr auto FIELDS   = std::make_tuple(&TimeRangeRuleRecord::weekDayMask, &TimeRangeRuleRecord::hourMask, &TimeRangeRuleRecord::monthDayMask, &TimeRangeRuleRecord::monthMask);
+  static constexpr bool REPEATED = true;
+};
+
+template <>
+struct PayloadLayout<PayloadType::SET_ALARM_STATE> {
+  using Body                     = AlarmStateBody;
+  static constexpr auto FIELDS   = std::make_tuple(&AlarmStateBody::alarmState);
+  static constexpr bool REPEATED = false;
+};
+
+template <>
+struct PayloadLayout<PayloadType::SET_RTC_TIME> {
+  using Body                     = RtcTimeBody;
+  static constexpr auto FIELDS   = std::make_tuple();
+  static constexpr bool REPEATED = false;
+};
+
+template <>
+struct PayloadLayout<PayloadType::SET_HEARTBEAT_POLICY> {
+  using Body                     = HeartbeatPolicyBody;
+  static constexpr auto FIELDS   = std::make_tuple(&HeartbeatPolicyBody::minInterval, &HeartbeatPolicyBody::maxInterval, &HeartbeatPolicyBody::jitterPercent);
+  static constexpr bool REPEATED = false;
+};
+
+// The header is followed by the SET_TIME_RANGE records of the fragment, see lora_transfer.h
+template <>
+struct PayloadLayout<PayloadType::SET_TIME_RANGE_FRAGMENT> {
+  using Body                     = TimeRangeFragmentHeader;
+  static constexpr auto FIELDS   = std::make_tuple(&TimeRangeFragmentHeader::transferId, &TimeRangeFragmentHeader::fragmentIndex, &TimeRangeFragmentHeader::fragmentCount, &TimeRangeFragmentHeader::ruleCount, &TimeRangeFragmentHeader::ruleSetHash);
+  static constexpr bool REPEATED = false;
+};
+
+template <>
+struct PayloadLayout<PayloadType::RENEW_EPOCH> {
+  using Body                     = RenewEpochBody;
+  static constexpr auto FIELDS   = std::make_tuple();
+  static constexpr bool REPEATED = false;
+};
+
+/**
+ * Number of bytes of a single Body (or record for repeated layouts) on the wire.
+ */
+template <PayloadType T>
+constexpr size_t BODY_WIRE_SIZE = fieldsWireSize(PayloadLayout<T>::FIELDS);
+
+static_assert(BODY_WIRE_SIZE<PayloadType::EDGE_HEARTBEAT> == 4, "EDGE_HEARTBEAT body is 4 bytes");
+static_assert(BODY_WIRE_SIZE<PayloadType::MOTION_STATE> == 1, "MOTION_STATE body is 1 byte");
+static_assert(BODY_WIRE_SIZE<PayloadType::EVENT_BATCH> == 7, "EVENT_BATCH records are 7 bytes");
+static_assert(BODY_WIRE_SIZE<PayloadType::TRANSFER_STATUS> == 4, "TRANSFER_STATUS body is 4 bytes");
+static_assert(BODY_WIRE_SIZE<PayloadType::SET_COMBINATION> == 4, "SET_COMBINATION body is 4 bytes");
+static_assert(BODY_WIRE_SIZE<PayloadType::SET_TIME_RANGE> == 11, "SET_TIME_RANGE records are 11 bytes");
+static_assert(BODY_WIRE_SIZE<PayloadType::SET_ALARM_STATE> == 1, "SET_ALARM_STATE body is 1 byte");
+static_assert(BODY_WIRE_SIZE<PayloadType::SET_RTC_TIME> == 0, "SET_RTC_TIME has no body");
+static_assert(BODY_WIRE_SIZE<PayloadType::SET_HEARTBEAT_POLICY> == 5, "SET_HEARTBEAT_POLICY body is 5 bytes");
+static_assert(BODY_WIRE_SIZE<PayloadType::SET_TIME_RANGE_FRAGMENT> == 8, "SET_TIME_RANGE_FRAGMENT header is 8 bytes");
+static_assert(BODY_WIRE_SIZE<PayloadType::RENEW_EPOCH> == 0, "RENEW_EPOCH has no body");
+
+/**
+ * Maximum number of records of a repeated layout fitting in a single frame.
+ */
+template <PayloadType T>
+constexpr size_t MAX_RECORDS = MAX_PAYLOAD_DATA_SIZE / BODY_WIRE_SIZE<T>;
+
+static_assert(MAX_RECORDS<PayloadType::SET_TIME_RANGE> == 18, "18 time range rules fit in a frame");
+static_assert(MAX_RECORDS<PayloadType::EVENT_BATCH> == 28, "28 events fit in a frame");
+
+/**
+ * @return The minimum DATA length for the given payload type, or -1 if the type has no layout.
+ */
+constexpr int minPayloadLength(PayloadType type) {
+  switch (type) {
+  case PayloadType::EDGE_HEARTBEAT:          return BODY_WIRE_SIZE<PayloadType::EDGE_HEARTBEAT>;
+  case PayloadType::MOTION_STATE:            return BODY_WIRE_SIZE<PayloadType::MOTION_STATE>;
+  case PayloadType::EVENT_BATCH:             return BODY_WIRE_SIZE<PayloadType::EVENT_BATCH>;
+  case PayloadType::TRANSFER_STATUS:         return BODY_WIRE_SIZE<PayloadType::TRANSFER_STATUS>;
+  case PayloadType::SET_COMBINATION:         return BODY_WIRE_SIZE<PayloadType::SET_COMBINATION>;
+  case PayloadType::SET_TIME_RANGE:          return BODY_WIRE_SIZE<PayloadType::SET_TIME_RANGE>;
+  case PayloadType::SET_ALARM_STATE:         return BODY_WIRE_SIZE<PayloadType::SET_ALARM_STATE>;
+  case PayloadType::SET_RTC_TIME:            return BODY_WIRE_SIZE<PayloadType::SET_RTC_TIME>;
+  case PayloadType::SET_HEARTBEAT_POLICY:    return BODY_WIRE_SIZE<PayloadType::SET_HEARTBEAT_POLICY>;
+  case PayloadType::SET_TIME_RANGE_FRAGMENT: return BODY_WIRE_SIZE<PayloadType::SET_TIME_RANGE_FRAGMENT> + BODY_WIRE_SIZE<PayloadType::SET_TIME_RANGE>;
+  case PayloadType::RENEW_EPOCH:             return BODY_WIRE_SIZE<PayloadType::RENEW_EPOCH>;
+  default:                                   return -1;
+  }
+}
+
+/**
+ * Check that a DATA length is consistent with the layout of the given payload type.
+ * Trailing bytes after a fixed body are tolerated so older senders padding the data keep working.
+ */
+constexpr bool isPayloadLengthValid(PayloadType type, uint8_t length) {
+  int minLength = minPayloadLength(type);
+  if (minLength < 0 || length < minLength || length > MAX_PAYLOAD_DATA_SIZE) return false;
+  if (type == PayloadType::SET_TIME_RANGE) return length % BODY_WIRE_SIZE<PayloadType::SET_TIME_RANGE> == 0;
+  if (type == PayloadType::EVENT_BATCH) return length % BODY_WIRE_SIZE<PayloadType::EVENT_BATCH> == 0;
+  if (type == PayloadType::SET_TIME_RANGE_FRAGMENT) return (length - BODY_WIRE_SIZE<PayloadType::SET_TIME_RANGE_FRAGMENT>) % BODY_WIRE_SIZE<PayloadType::SET_TIME_RANGE> == 0;
+  return true;
+}
+
+// --- TYPED ENCODERS / DECODERS ---
+
+/**
+ * Fill the type, length and data fields of a payload from a typed body.
+ */
+template <PayloadType T>
+void encodePayload(const typename PayloadLayout<T>::Body& body, LoraPayload& pkt) {
+  static_assert(!PayloadLayout<T>::REPEATED, "Use appendPayloadRecord() for repeated layouts");
+  pkt.type   = T;
+  pkt.length = static_cast<uint8_t>(writeFields(body, PayloadLayout<T>::FIELDS, pkt.data));
+}
+
+/**
+ * Decode the data field of a payload into a typed body.
+ * @return false if the payload has another type or is too short for the body.
+ */
+template <PayloadType T>
+bool decodePayload(const LoraPayload& pkt, typename PayloadLayout<T>::Body& body) {
+  static_assert(!PayloadLayout<T>::REPEATED, "Use decodePayloadRecord() for repeated layouts");
+  if (pkt.type != T || pkt.length < BODY_WIRE_SIZE<T>) return false;
+  readFields(pkt.data, PayloadLayout<T>::FIELDS, body);
+  return true;
+}
+
+/**
+ * @return The number of complete records held by a payload with a repeated layout.
+ */
+template <PayloadType T>
+size_t payloadRecordCount(const LoraPayload& pkt) {
+  static_assert(PayloadLayout<T>::REPEATED, "Only repeated layouts hold records");
+  return pkt.type == T ? pkt.length / BODY_WIRE_SIZE<T> : 0;
+}
+
+/**
+ * Decode the record at the given index of a payload with a repeated layout.
+ * @return false if the index is out of range.
+ */
+template <PayloadType T>
+bool decodePayloadRecord(const LoraPayload& pkt, size_t index, typename PayloadLayout<T>::Body& record) {
+  if (index >= payloadRecordCount<T>(pkt)) return false;
+  readFields(pkt.data + index * BODY_WIRE_SIZE<T>, PayloadLayout<T>::FIELDS, record);
+  return true;
+}
+
+/**
+ * Append a record to a payload with a repeated layout. Set pkt.length to 0 before appending the first record.
+ * @return false if the record does not fit in the payload.
+ */
+template <PayloadType T>
+bool appendPayloadRecord(const typename PayloadLayout<T>::Body& record, LoraPayload& pkt) {
+  static_assert(PayloadLayout<T>::REPEATED, "Use encodePayload() for fixed layouts");
+  if (pkt.length + BODY_WIRE_SIZE<T> > MAX_PAYLOAD_DATA_SIZE) return false;
+  pkt.type = T;
+  pkt.length += static_cast<uint8_t>(writeFields(record, PayloadLayout<T>::FIELDS, pkt.data + pkt.length));
+  return true;
+}
+
+// --- EVENT BATCHES ---
+
+/**
+ * Rebuild the payload a single event of an EVENT_BATCH payload stands for, so receivers can handle batched events
+ * like the payloads sent one by one: MOTION gives a MOTION_STATE payload, STATE_TRANSITION an EDGE_HEARTBEAT payload,
+ * the other kinds an EVENT_BATCH payload holding this event only.
+ * The id and counter are the ones of the batch, ts is the time of the event. The hmac is left at 0: it authenticates the
+ * whole batch, not the event.
+ * @return false if the index is out of range or the kind is unknown.
+ */
+inline bool expandEventRecord(const LoraPayload& batch, size_t index, LoraPayload& pkt) {
+  EventRecord record;
+  if (!decodePayloadRecord<PayloadType::EVENT_BATCH>(batch, index, record)) return false;
+
+  pkt.id      = batch.id;
+  pkt.counter = batch.counter;
+  pkt.ts      = batch.ts + record.offsetMs / 1000;
+  pkt.hmac    = 0;
+
+  switch (static_cast<EventKind>(record.kind)) {
+  case EventKind::MOTION:
+    encodePayload<PayloadType::MOTION_STATE>({.motion = record.value[0]}, pkt);
+    return true;
+  case EventKind::STATE_TRANSITION:
+    pkt.type   = PayloadType::EDGE_HEARTBEAT;
+    pkt.length = BODY_WIRE_SIZE<PayloadType::EDGE_HEARTBEAT>;
+    memcpy(pkt.data, record.value, BODY_WIRE_SIZE<PayloadType::EDGE_HEARTBEAT>);
+    return true;
+  case EventKind::WRONG_CODE:
+  case EventKind::RTC_CORRECTION:
+    record.offsetMs %= 1000; // The whole seconds moved to ts
+    pkt.length = 0;
+    return appendPayloadRecord<PayloadType::EVENT_BATCH>(record, pkt);
+  default:
+    return false;
+  }
+}
+
+// --- FRAME ENCODING ---
+
+/**
+ * @return The number of bytes taken by the payload on the wire.
+ */
+inline size_t frameWireSize(const LoraPayload& pkt) {
+  return LORA_FRAME_HEADER_BYTES + pkt.length + LORA_FRAME_HMAC_BYTES;
+}
+
+/**
+ * Serialize a payload in wire order (big-endian fields).
+ * @param out Buffer of at least LORA_FRAME_MAX_BYTES bytes.
+ * @return The number of bytes written.
+ */
+inline size_t writeFrame(const LoraPayload& pkt, uint8_t* out) {
+  size_t length = pkt.length > MAX_PAYLOAD_DATA_SIZE ? MAX_PAYLOAD_DATA_SIZE : pkt.length;
+
+  WireField<uint8_t>::write(out, pkt.id);
+  WireField<uint32_t>::write(out + 1, pkt.counter);
+  WireField<uint32_t>::write(out + 5, pkt.ts);
+  WireField<PayloadType>::write(out + 9, pkt.type);
+  WireField<uint8_t>::write(out + 10, static_cast<uint8_t>(length));
+  memcpy(out + LORA_FRAME_HEADER_BYTES, pkt.data, length);
+  WireField<uint32_t>::write(out + LORA_FRAME_HEADER_BYTES + length, pkt.hmac);
+  return LORA_FRAME_HEADER_BYTES + length + LORA_FRAME_HMAC_BYTES;
+}
+
+#endif // LORA_PROTOCOL_H
@@ -0,0 +1,71 @@
+#ifndef LORA_REPLAY_H
+#define LORA_REPLAY_H
+
+#include <stdint.h>
+
+#define REPLAY_WINDOW_SIZE         64 // Number of counters below the highest one that are remembered
+#define COMPACT_REPLAY_WINDOW_SIZE 32 // Same, for the windows kept for many peers (e.g. every node of the gateway)
+
+/**
+ * Sliding window of the frame counters received from a peer, used to reject replayed frames in O(1).
+ * Counters above the highest accepted one are new. Counters in the last SIZE values are new if their bit is not set
+ * yet, so frames reordered by the radio are still accepted once. Older counters are rejected.
+ * Counter 0 is never accepted, senders start counting at 1.
+ * @tparam Bitmap Unsigned integer holding one bit per counter of the window.
+ */
+template <typename Bitmap>
+class BasicReplayWindow {
+public:
+  static constexpr uint32_t SIZE = sizeof(Bitmap) * 8;
+
+  BasicReplayWindow() { restore(0); }
+
+  /**
+   * Reset the window after a reboot: every counter up to the given one is considered as already received.
+   * @param highestCounter The highest counter known to have been received (e.g. read from EEPROM).
+   */
+  void restore(uint32_t highestCounter) {
+    highest = highestCounter;
+    seen    = static_cast<Bitmap>(~Bitmap(0));
+  }
+
+  /**
+   * Check whether a counter has not been received yet. Does not modify the window: call accept() once the
+   * frame is authenticated, so a forged frame cannot move the window.
+   * @return true if the counter is new.
+   */
+  bool check(uint32_t counter) const {
+    if (counter > highest) return true;
+    uint32_t age = highest - counter;
+    if (age >= SIZE) return false;
+    return ((seen >> age) & 1) == 0;
+  }
+
+  /**
+   * Mark a counter as received.
+   * @return true if the highest counter changed.
+   */
+  bool accept(uint32_t counter) {
+    if (counter > highest) {
+      uint32_t shift = counter - highest;
+      seen           = static_cast<Bitmap>((shift >= SIZE ? 0 : seen << shift) | 1);
+      highest        = counter;
+      return true;
+    }
+    seen |= static_cast<Bitmap>(Bitmap(1) << (highest - counter));
+    return false;
+  }
+
+  uint32_t highestCounter() const { return highest; }
+
+private:
+  uint32_t highest; // Highest counter accepted so far
+  Bitmap   seen;    // Bit i is set if counter (highest - i) was accepted
+};
+
+using ReplayWindow        = BasicReplayWindow<uint64_t>;
+using CompactReplayWindow = BasicReplayWindow<uint32_t>;
+
+static_assert(ReplayWindow::SIZE == REPLAY_WINDOW_SIZE && CompactReplayWindow::SIZE == COMPACT_REPLAY_WINDOW_SIZE, "One bit per counter of the window");
+
+#endif // LORA_REPLAY_H
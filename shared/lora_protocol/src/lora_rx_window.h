@@ -0,0 +1,186 @@
+#ifndef LORA_RX_WINDOW_H
+#define LORA_RX_WINDOW_H
+
+#include "lora_airtime.h"
+#include "lora_at_engine.h"
+#include "lora_protocol.h"
+
+/*
+Class-A style receive windows, opt-in with LORA_CLASS_A in the edge and gateway firmware.
+The edge only listens for a short window after each of its uplinks and keeps the LoRa module asleep otherwise.
+The gateway holds the downlinks of each node and sends them LORA_RX_DELAY_MS after the end of an uplink of the node,
+inside its window. A downlink received by the edge opens a new window, so several held downlinks are sent in a row.
+
+        uplink           RX_DELAY          downlink         RX_DELAY          downlink
+edge    [TX]-------------------------------[RX]-------------------------------[RX]--...--sleep
+gateway [RX]--------------------------------[TX]-------------------------------[TX]
+
+Both modules talk to their board over a 9600 baud UART, slow next to the frames: the gateway learns of an uplink once
+the module printed its +TEST: LEN and RX lines, up to 0.5 s after its end, and its downlink only goes on the air once
+the AT+TEST=TXLRPKT command was written, up to 0.5 s more. The gateway counts the delay from the end of the uplink on
+the air, and the window of the edge covers the writing of the command.
+*/
+
+#define LORA_RX_DELAY_MS         1000 // Delay between the end of a frame and the downlink sent in the window it opens
+#define LORA_RX_WINDOW_LATE_MS   250  // A window the gateway reaches later than this is skipped, the downlinks wait for the next one
+#define LORA_RX_WINDOW_SLACK_MS  100  // Extra listening time of the edge, for the loop latency of the gateway
+#define LORA_DOWNLINK_QUEUE_SIZE 8    // Downlinks held by the gateway, all nodes together
+
+/**
+ * @param hexChars The number of hex characters of the frame.
+ * @return The time the module takes to print the +TEST: LEN and +TEST: RX lines of a frame received, after its end.
+ */
+constexpr uint32_t loraRxReportMs(size_t hexChars) {
+  return loraAtUartMs(LORA_AT_RX_INFO_LINE_MAX + LORA_AT_LINE_MAX - LORA_FRAME_MAX_BYTES * 2 + hexChars);
+}
+
+/**
+ * @param frameBytes The number of bytes of the frame.
+ * @return The time from the AT+TEST=TXLRPKT command sent to the module to the end of the frame on the air.
+ */
+constexpr uint32_t loraTxMs(const LoraRfConfig& config, size_t frameBytes) {
+  return loraAtUartMs(LORA_AT_COMMAND_MAX - LORA_FRAME_MAX_BYTES * 2 + frameBytes * 2) + loraTimeOnAirUs(config, frameBytes) / 1000;
+}
+
+/**
+ * @return How long the edge listens after the end of a frame: until the largest downlink, sent by the gateway up to
+ * LORA_RX_WINDOW_LATE_MS after the delay, is fully received.
+ */
+constexpr uint32_t loraRxWindowMs(const LoraRfConfig& config) {
+  return LORA_RX_DELAY_MS + LORA_RX_WINDOW_LATE_MS + loraTxMs(config, LORA_FRAME_MAX_BYTES) + LORA_RX_WINDOW_SLACK_MS;
+}
+
+inline constexpr uint32_t LORA_RX_WINDOW_MS = loraRxWindowMs(LORA_RF_CONFIG);
+
+static_assert(loraRxReportMs(LORA_FRAME_MAX_BYTES * 2) < LORA_RX_DELAY_MS, "The gateway must learn of the largest uplink before its window is due");
+
+/**
+ * Receive window of the edge, opened at the end of each uplink and of each downlink received.
+ */
+class ReceiveWindow {
+public:
+  /**
+   * @param durationMs How long the window lasts, the one of LORA_RF_CONFIG unless the simulation uses another one.
+   */
+  explicit ReceiveWindow(uint32_t durationMs = LORA_RX_WINDOW_MS) : durationMs(durationMs) {}
+
+  void open(uint32_t nowMs) {
+    openedMs = nowMs;
+    isOpened = true;
+  }
+
+  void close() { isOpened = false; }
+
+  bool isOpen() const { return isOpened; }
+
+  /**
+   * @return true once an open window lasted its duration without being renewed.
+   */
+  bool isExpired(uint32_t nowMs) const { return isOpened && (int32_t)(nowMs - openedMs) >= (int32_t)durationMs; }
+
+private:
+  uint32_t durationMs;
+  bool     isOpened = false;
+  uint32_t openedMs = 0; // millis() at the end of the last frame sent or received
+};
+
+/**
+ * Downlinks held by the gateway until the next receive window of their node.
+ * Payloads are held unsigned, the caller sets their counter and MAC when they are sent so counters follow the order
+ * of transmission.
+ */
+class DownlinkQueue {
+public:
+  /**
+   * Hold a downlink until the next window of the node pkt.id.
+   * @return false if the queue is full, the downlink is then dropped.
+   */
+  bool push(const LoraPayload& pkt) {
+    for (Entry& entry : entries) {
+      if (entry.used) continue;
+      entry.pkt   = pkt;
+      entry.order = nextOrder++;
+      entry.used  = true;
+      return true;
+    }
+    return false;
+  }
+
+  /**
+   * An uplink of the node was received: its window opens LORA_RX_DELAY_MS after its end. Replaces the window of
+   * another node not served yet.
+   * @param endMs millis() at the end of the uplink on the air, i.e. before its lines were printed (see loraRxReportMs()).
+   */
+  void onUplink(uint8_t nodeId, uint32_t endMs) {
+    windowNode = nodeId;
+    windowDue  = endMs + LORA_RX_DELAY_MS;
+    windowOpen = true;
+  }
+
+  /**
+   * @return The oldest downlink of the node whose window is due now, or nullptr. Call sent() or skipWindow() afterwards.
+   */
+  const LoraPayload* peek(uint32_t nowMs) {
+    if (!windowOpen || (int32_t)(nowMs - windowDue) < 0) return nullptr;
+    if (nowMs - windowDue > LORA_RX_WINDOW_LATE_MS) { // Missed, the edge may stop listening before the end of the downlink
+      windowOpen = false;
+      return nullptr;
+    }
+    int index = findOldest(windowNode);
+    if (index < 0) windowOpen = false;
+    return index < 0 ? nullptr : &entries[index].pkt;
+  }
+
+  /**
+   * The downlink returned by peek() was sent: it is removed, and the next one of the node is due in the window its
+   * reception opens.
+   * @param txMs The time from its AT command to its end on the air (see loraTxMs()).
+   */
+  void sent(uint32_t nowMs, uint32_t txMs) {
+    int index = findOldest(windowNode);
+    if (index >= 0) entries[index].used = false;
+    windowDue  = nowMs + txMs + LORA_RX_DELAY_MS;
+    windowOpen = findOldest(windowNode) >= 0;
+  }
+
+  /**
+   * The downlink returned by peek() could not be sent (e.g. duty cycle): it waits for the next window.
+   */
+  void skipWindow() { windowOpen = false; }
+
+  /**
+   * @return The number of downlinks held for the node.
+   */
+  size_t pending(uint8_t nodeId) const {
+    size_t count = 0;
+    for (const Entry& entry : entries) {
+      if (entry.used && entry.pkt.id == nodeId) count++;
+    }
+    return count;
+  }
+
+private:
+  struct Entry {
+    LoraPayload pkt;
+    uint16_t    order; // Insertion order, to send the downlinks of a node in FIFO order
+    bool        used;
+  };
+
+  Entry    entries[LORA_DOWNLINK_QUEUE_SIZE] = {};
+  uint16_t nextOrder                         = 0;
+  bool     windowOpen                        = false;
+  uint8_t  windowNode                        = 0; // Node of the next window
+  uint32_t windowDue                         = 0; // millis() when the downlink must be sent
+
+  int findOldest(uint8_t nodeId) const {
+    int oldest = -1;
+    for (int i = 0; i < LORA_DOWNLINK_QUEUE_SIZE; i++) {
+      if (!entries[i].used || entries[i].pkt.id != nodeId) continue;
+      // Orders are compared by difference so the wrap-around of nextOrder keeps the FIFO order
+      if (oldest < 0 || (int16_t)(entries[i].order - entries[oldest].order) < 0) oldest = i;
+    }
+    return oldest;
+  }
+};
+
+#endif // LORA_RX_WINDOW_H
@@ -0,0 +1,329 @@
+#ifndef LORA_TRANSFER_H
+#define LORA_TRANSFER_H
+
+#include "lora_protocol.h"
+
+/*
+Fragmented transfer of a time range rule set too large for a single SET_TIME_RANGE frame (up to 255 rules).
+The sender splits the rules into SET_TIME_RANGE_FRAGMENT payloads of TRANSFER_RULES_PER_FRAGMENT rules, all tagged
+with the same transfer ID and hash of the whole rule set. The receiver keeps a bitmap of the fragments received and
+stages their rules apart from the active ones: the new rule set is only committed once every fragment is there.
+The receiver sends the bitmap in a TRANSFER_STATUS uplink when the fragments stop coming in, so the sender only
+retransmits the missing ones, and a last TRANSFER_STATUS once the rule set is committed.
+*/
+
+#define LORA_TRANSFER_MAX_FRAGMENTS  16    // Size of the receivedMask bitmap
+#define LORA_TRANSFER_STATUS_DELAY   8000  // Silence after the last fragment before the receiver reports the missing ones, in ms
+#define LORA_TRANSFER_STATUS_TIMEOUT 30000 // Time the sender waits for a status after its last fragment before retransmitting, in ms
+#define LORA_TRANSFER_RETRY_DELAY    5000  // Time the sender waits after a fragment could not be sent (e.g. duty cycle), in ms
+#define LORA_TRANSFER_MAX_RETRIES    3     // Rounds without progress before a transfer is abandoned, on both sides
+
+/**
+ * State reported by a TRANSFER_STATUS payload.
+ */
+enum class TransferState : uint8_t {
+  IN_PROGRESS = 0, // Some fragments are missing, see receivedMask
+  COMMITTED   = 1, // Every fragment was received, the new rule set is active
+  ABANDONED   = 2, // No progress after LORA_TRANSFER_MAX_RETRIES reports, or a single-frame rule set was received meanwhile
+};
+
+inline constexpr size_t TRANSFER_HEADER_BYTES       = BODY_WIRE_SIZE<PayloadType::SET_TIME_RANGE_FRAGMENT>;
+inline constexpr size_t TRANSFER_RULE_BYTES         = BODY_WIRE_SIZE<PayloadType::SET_TIME_RANGE>;
+inline constexpr size_t TRANSFER_RULES_PER_FRAGMENT = (MAX_PAYLOAD_DATA_SIZE - TRANSFER_HEADER_BYTES) / TRANSFER_RULE_BYTES;
+inline constexpr size_t TRANSFER_MAX_RULES          = 255;
+
+static_assert(TRANSFER_RULES_PER_FRAGMENT == 17, "17 time range rules fit in a fragment");
+
+/**
+ * @return The number of fragments needed to send the given number of rules.
+ */
+constexpr uint8_t transferFragmentCount(uint8_t ruleCount) {
+  return static_cast<uint8_t>((ruleCount + TRANSFER_RULES_PER_FRAGMENT - 1) / TRANSFER_RULES_PER_FRAGMENT);
+}
+
+static_assert(transferFragmentCount(TRANSFER_MAX_RULES) <= LORA_TRANSFER_MAX_FRAGMENTS, "The largest rule set must fit in the bitmap");
+
+/**
+ * @return The number of rules carried by the fragment at the given index, every fragment is full except the last one.
+ */
+constexpr size_t transferFragmentRules(uint8_t ruleCount, uint8_t fragmentIndex) {
+  size_t first = (size_t)fragmentIndex * TRANSFER_RULES_PER_FRAGMENT;
+  if (first >= ruleCount) return 0;
+  return ruleCount - first < TRANSFER_RULES_PER_FRAGMENT ? ruleCount - first : TRANSFER_RULES_PER_FRAGMENT;
+}
+
+/**
+ * @return The bitmap with one bit set per fragment of the transfer.
+ */
+constexpr uint16_t transferCompleteMask(uint8_t fragmentCount) {
+  return fragmentCount >= LORA_TRANSFER_MAX_FRAGMENTS ? 0xFFFF : static_cast<uint16_t>((1u << fragmentCount) - 1);
+}
+
+/**
+ * FNV-1a hash of a rule set in SET_TIME_RANGE wire format. The 8-bit transfer ID of a new rule set may be the one of
+ * the last rule set committed, so the receiver compares the hash as well before answering that it is committed.
+ */
+inline uint32_t transferRuleSetHash(const uint8_t* ruleBytes, uint8_t ruleCount) {
+  uint32_t hash = (2166136261u ^ ruleCount) * 16777619u;
+  for (size_t i = 0; i < (size_t)ruleCount * TRANSFER_RULE_BYTES; i++) {
+    hash = (hash ^ ruleBytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * @return The number of rules carried by a SET_TIME_RANGE_FRAGMENT payload.
+ */
+inline size_t fragmentRuleCount(const LoraPayload& pkt) {
+  if (pkt.type != PayloadType::SET_TIME_RANGE_FRAGMENT || pkt.length < TRANSFER_HEADER_BYTES) return 0;
+  return (pkt.length - TRANSFER_HEADER_BYTES) / TRANSFER_RULE_BYTES;
+}
+
+/**
+ * Decode the rule at the given index of a SET_TIME_RANGE_FRAGMENT payload (index within the fragment).
+ * @return false if the index is out of range.
+ */
+inline bool decodeFragmentRule(const LoraPayload& pkt, size_t index, TimeRangeRuleRecord& record) {
+  if (index >= fragmentRuleCount(pkt)) return false;
+  readFields(pkt.data + TRANSFER_HEADER_BYTES + index * TRANSFER_RULE_BYTES, PayloadLayout<PayloadType::SET_TIME_RANGE>::FIELDS, record);
+  return true;
+}
+
+/**
+ * Receiving side of a transfer: tracks the fragments received and tells when the rule set can be committed.
+ * Staging and committing the rules is left to the caller (EEPROM on the edge).
+ */
+class TransferReassembly {
+public:
+  enum class Result : uint8_t {
+    INVALID,   // Inconsistent header, ignored
+    STAGED,    // New fragment, stage its rules
+    COMPLETE,  // Last missing fragment, stage its rules then commit the rule set
+    DUPLICATE, // Fragment already staged, nothing to do
+    COMMITTED, // Fragment of the transfer already committed, the sender missed the final status: send it again
+  };
+
+  TransferReassembly() : active(false), hasCommitted(false), transferId(0), committedId(0), fragmentCount(0), ruleCount(0), receivedMask(0), committedMask(0), reports(0), ruleSetHash(0), committedHash(0), lastFragmentMs(0) {}
+
+  /**
+   * Record a fragment. A fragment of another rule set than the current one (transfer ID, rule count or hash) abandons
+   * the current transfer.
+   * @param rulesInFragment The number of rules carried by the fragment, checked against the header.
+   */
+  Result accept(const TimeRangeFragmentHeader& header, size_t rulesInFragment, uint32_t nowMs) {
+    if (header.ruleCount == 0 || header.fragmentCount != transferFragmentCount(header.ruleCount) || header.fragmentIndex >= header.fragmentCount) return Result::INVALID;
+    if (rulesInFragment != transferFragmentRules(header.ruleCount, header.fragmentIndex)) return Result::INVALID;
+    if (hasCommitted && header.transferId == committedId && header.ruleSetHash == committedHash) return Result::COMMITTED;
+
+    if (!active || header.transferId != transferId || header.ruleCount != ruleCount || header.ruleSetHash != ruleSetHash) {
+      active        = true;
+      transferId    = header.transferId;
+      fragmentCount = header.fragmentCount;
+      ruleCount     = header.ruleCount;
+      ruleSetHash   = header.ruleSetHash;
+      receivedMask  = 0;
+    }
+    lastFragmentMs = nowMs;
+
+    uint16_t bit = static_cast<uint16_t>(1u << header.fragmentIndex);
+    if (receivedMask & bit) return Result::DUPLICATE;
+    receivedMask |= bit;
+    reports = 0;
+
+    if (receivedMask != transferCompleteMask(fragmentCount)) return Result::STAGED;
+    active        = false;
+    hasCommitted  = true;
+    committedId   = transferId;
+    committedMask = receivedMask;
+    committedHash = ruleSetHash;
+    return Result::COMPLETE;
+  }
+
+  /**
+   * Check whether the sender must be told which fragments are missing, after LORA_TRANSFER_STATUS_DELAY without any
+   * fragment. The transfer is abandoned after LORA_TRANSFER_MAX_RETRIES reports without progress.
+   * @param status Filled with the status to send when true is returned.
+   */
+  bool pollStatus(uint32_t nowMs, TransferStatusBody& status) {
+    if (!active || nowMs - lastFragmentMs < LORA_TRANSFER_STATUS_DELAY) return false;
+    lastFragmentMs = nowMs;
+    if (++reports > LORA_TRANSFER_MAX_RETRIES) active = false;
+    status = {
+        .transferId   = transferId,
+        .state        = static_cast<uint8_t>(active ? TransferState::IN_PROGRESS : TransferState::ABANDONED),
+        .receivedMask = receivedMask,
+    };
+    return true;
+  }
+
+  /**
+   * Abandon the transfer in progress, because a rule set received in a single frame was written over its staged
+   * fragments. A later fragment of the same transfer starts it over.
+   * @param status Filled with the status telling the sender, when true is returned.
+   * @return false if no transfer is in progress.
+   */
+  bool abandon(TransferStatusBody& status) {
+    if (!active) return false;
+    active = false;
+    status = {
+        .transferId   = transferId,
+        .state        = static_cast<uint8_t>(TransferState::ABANDONED),
+        .receivedMask = receivedMask,
+    };
+    return true;
+  }
+
+  /**
+   * @return The status announcing the commit of the last completed transfer.
+   */
+  TransferStatusBody committedStatus() const {
+    return {
+        .transferId   = committedId,
+        .state        = static_cast<uint8_t>(TransferState::COMMITTED),
+        .receivedMask = committedMask,
+    };
+  }
+
+private:
+  bool     active;         // A transfer is in progress
+  bool     hasCommitted;   // committedId is valid
+  uint8_t  transferId;     // Transfer in progress
+  uint8_t  committedId;    // Last transfer committed
+  uint8_t  fragmentCount;  // Fragments of the transfer in progress
+  uint8_t  ruleCount;      // Rules of the transfer in progress
+  uint16_t receivedMask;   // Fragments of the transfer in progress received so far
+  uint16_t committedMask;  // Fragments of the last transfer committed
+  uint8_t  reports;        // Statuses sent since the last new fragment
+  uint32_t ruleSetHash;    // Rule set of the transfer in progress
+  uint32_t committedHash;  // Rule set of the last transfer committed
+  uint32_t lastFragmentMs; // millis() of the last fragment, or of the last status sent
+};
+
+/**
+ * Sending side of a transfer: holds the whole rule set and hands out the fragments still to send.
+ */
+class TransferSender {
+public:
+  enum class Event : uint8_t {
+    NONE,
+    COMMITTED, // The receiver committed the rule set, the transfer is over
+    FAILED,    // No progress after LORA_TRANSFER_MAX_RETRIES rounds, or abandoned by the receiver
+  };
+
+  TransferSender() : active(false), transferId(0), ruleCount(0), fragmentCount(0), pendingMask(0), ackedMask(0), retries(0), current(0), ruleSetHash(0), lastSentMs(0), deferredUntilMs(0) {}
+
+  /**
+   * Buffer of TRANSFER_MAX_RULES rules to fill in SET_TIME_RANGE wire format before calling begin(), so the rule set
+   * is not copied. Filling it cancels the transfer in progress.
+   */
+  uint8_t* ruleBuffer() {
+    active = false;
+    return ruleBytes;
+  }
+
+  /**
+   * Start a new transfer of the rules written in ruleBuffer().
+   * @param count The number of rules written.
+   * @return false if the rule count is 0 or above TRANSFER_MAX_RULES.
+   */
+  bool begin(uint8_t id, size_t count, uint32_t nowMs) {
+    if (count == 0 || count > TRANSFER_MAX_RULES) return false;
+    active          = true;
+    transferId      = id;
+    ruleCount       = static_cast<uint8_t>(count);
+    fragmentCount   = transferFragmentCount(ruleCount);
+    ruleSetHash     = transferRuleSetHash(ruleBytes, ruleCount);
+    pendingMask     = transferCompleteMask(fragmentCount);
+    ackedMask       = 0;
+    retries         = 0;
+    lastSentMs      = nowMs;
+    deferredUntilMs = nowMs;
+    return true;
+  }
+
+  bool isActive() const { return active; }
+  uint8_t getTransferId() const { return transferId; }
+
+  /**
+   * Build the next fragment to send, if any is pending and no deferral is running.
+   * Call fragmentSent() or deferFragment() depending on the outcome of the transmission.
+   * @param pkt Type, length and data are filled.
+   */
+  bool nextFragment(uint32_t nowMs, LoraPayload& pkt) {
+    if (!active || !pendingMask || (int32_t)(nowMs - deferredUntilMs) < 0) return false;
+    current = 0;
+    while (!(pendingMask & (1u << current))) current++;
+
+    encodePayload<PayloadType::SET_TIME_RANGE_FRAGMENT>({.transferId = transferId, .fragmentIndex = current, .fragmentCount = fragmentCount, .ruleCount = ruleCount, .ruleSetHash = ruleSetHash}, pkt);
+    size_t rules = transferFragmentRules(ruleCount, current);
+    memcpy(pkt.data + pkt.length, ruleBytes + (size_t)current * TRANSFER_RULES_PER_FRAGMENT * TRANSFER_RULE_BYTES, rules * TRANSFER_RULE_BYTES);
+    pkt.length += static_cast<uint8_t>(rules * TRANSFER_RULE_BYTES);
+    return true;
+  }
+
+  void fragmentSent(uint32_t nowMs) {
+    pendingMask &= static_cast<uint16_t>(~(1u << current));
+    lastSentMs = nowMs;
+  }
+
+  void deferFragment(uint32_t nowMs) { deferredUntilMs = nowMs + LORA_TRANSFER_RETRY_DELAY; }
+
+  /**
+   * A fragment handed over by fragmentSent() was only transmitted now (e.g. held until a receive window): the status
+   * timeout counts from now.
+   */
+  void restartTimeout(uint32_t nowMs) { lastSentMs = nowMs; }
+
+  /**
+   * Handle a TRANSFER_STATUS of the receiver: only the fragments it did not receive are scheduled again.
+   */
+  Event onStatus(const TransferStatusBody& status, uint32_t nowMs) {
+    if (!active || status.transferId != transferId) return Event::NONE;
+
+    switch (static_cast<TransferState>(status.state)) {
+    case TransferState::COMMITTED:
+      active = false;
+      return Event::COMMITTED;
+    case TransferState::IN_PROGRESS:
+      if (status.receivedMask != ackedMask) retries = 0; // Progress
+      ackedMask   = status.receivedMask & transferCompleteMask(fragmentCount);
+      pendingMask = transferCompleteMask(fragmentCount) & ~ackedMask;
+      lastSentMs  = nowMs;
+      return Event::NONE;
+    default:
+      active = false;
+      return Event::FAILED;
+    }
+  }
+
+  /**
+   * Retransmit the fragments not acknowledged yet when no status arrived within LORA_TRANSFER_STATUS_TIMEOUT of the
+   * last fragment sent.
+   */
+  Event poll(uint32_t nowMs) {
+    if (!active || pendingMask || nowMs - lastSentMs < LORA_TRANSFER_STATUS_TIMEOUT) return Event::NONE;
+    if (++retries > LORA_TRANSFER_MAX_RETRIES) {
+      active = false;
+      return Event::FAILED;
+    }
+    pendingMask = transferCompleteMask(fragmentCount) & ~ackedMask;
+    lastSentMs  = nowMs;
+    return Event::NONE;
+  }
+
+private:
+  bool     active;
+  uint8_t  transferId;
+  uint8_t  ruleCount;
+  uint8_t  fragmentCount;
+  uint16_t pendingMask;     // Fragments still to send in the current round
+  uint16_t ackedMask;       // Fragments the receiver reported as received
+  uint8_t  retries;         // Rounds without progress
+  uint8_t  current;         // Fragment returned by the last nextFragment()
+  uint32_t ruleSetHash;     // transferRuleSetHash() of ruleBytes, sent in every fragment
+  uint32_t lastSentMs;      // millis() of the last fragment sent or status received
+  uint32_t deferredUntilMs; // No fragment is sent before this millis()
+  uint8_t  ruleBytes[TRANSFER_MAX_RULES * TRANSFER_RULE_BYTES];
+};
+
+#endif // LORA_TRANSFER_H
@@ -0,0 +1,92 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <chrono>
+#include <functional>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+/*
+Microbenchmarks of the hot paths of the firmwares, run on the host. Each benchmark runs its body in a loop for samples
+of about BENCH_SAMPLE_NS, and keeps the fastest sample: the others were slowed down by the rest of the system. The
+samples of all the benchmarks are taken in turn, BENCH_SAMPLES rounds, so a slow period of the machine does not fall on
+a single benchmark. The heap allocations are counted by replacing the global operator new.
+*/
+
+#define BENCH_SAMPLES   7
+#define BENCH_SAMPLE_NS 20000000 // 20 ms per sample
+
+/**
+ * Measure of a benchmark, also the format of a line of the baseline file.
+ */
+struct BenchResult {
+  std::string name;
+  double      nsPerOp;
+  double      allocsPerOp;
+};
+
+/**
+ * Prevent the compiler from removing a computation whose result is not used.
+ */
+template <typename T>
+inline void benchKeep(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Number of heap allocations since the start of the process
+uint64_t benchAllocations();
+
+class BenchRunner {
+public:
+  /**
+   * @param filter Only the benchmarks whose name contains this text are added, nullptr for all.
+   */
+  explicit BenchRunner(const char* filter) : filter(filter) {}
+
+  /**
+   * Add a benchmark, its body is called once per operation.
+   */
+  template <typename Body>
+  void add(const std::string& name, Body body) {
+    if (filter && name.find(filter) == std::string::npos) return;
+    benchmarks.push_back({name, [body](uint64_t iterations) mutable {
+                            auto start = std::chrono::steady_clock::now();
+                            for (uint64_t i = 0; i < iterations; i++) {
+                              body();
+                            }
+                            return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+                          }});
+  }
+
+  /**
+   * Measure every benchmark added.
+   * @return The measures, in the order the benchmarks were added.
+   */
+  std::vector<BenchResult> run();
+
+private:
+  struct Benchmark {
+    std::string                           name;
+    std::function<uint64_t(uint64_t)>     loop; // Runs the body this many times, returns the time taken in nanoseconds
+  };
+
+  const char*            filter;
+  std::vector<Benchmark> benchmarks;
+};
+
+/**
+ * Write the results as a baseline: one "<name> <ns/op> <allocs/op>" line per benchmark.
+ * @return false if the file cannot be written.
+ */
+bool writeBaseline(const char* path, const std::vector<BenchResult>& results);
+
+/**
+ * Read a baseline written by writeBaseline(), '#' starting a comment.
+ * @return false if the file cannot be read or a line is invalid.
+ */
+bool readBaseline(const char* path, std::vector<BenchResult>& baseline);
+
+#endif // BENCHMARK_H
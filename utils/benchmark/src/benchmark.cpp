@@ -0,0 +1,90 @@
+#include "benchmark.h"
+#include <new>
+#include <stdlib.h>
+
+static uint64_t allocations = 0;
+
+uint64_t benchAllocations() {
+  return allocations;
+}
+
+// Every allocation of the C++ code goes through these, including the String of the native build (std::string)
+void* operator new(size_t size) {
+  allocations++;
+  void* p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+  free(p);
+}
+
+void operator delete[](void* p) noexcept {
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+  free(p);
+}
+
+std::vector<BenchResult> BenchRunner::run() {
+  std::vector<BenchResult> results;
+  std::vector<uint64_t>    iterations;
+  for (Benchmark& benchmark : benchmarks) {
+    // Calibration: the number of operations of a sample, doubled until it lasts long enough
+    uint64_t count = 1;
+    while (benchmark.loop(count) < BENCH_SAMPLE_NS / 10 && count < (1ULL << 40)) {
+      count *= 2;
+    }
+    iterations.push_back(count * 10);
+
+    // The allocations do not depend on the time, one pass is enough
+    uint64_t before = allocations;
+    benchmark.loop(count);
+    results.push_back({benchmark.name, 0, (double)(allocations - before) / count});
+  }
+
+  for (int round = 0; round < BENCH_SAMPLES; round++) {
+    for (size_t i = 0; i < benchmarks.size(); i++) {
+      double ns = (double)benchmarks[i].loop(iterations[i]) / iterations[i];
+      if (round == 0 || ns < results[i].nsPerOp) results[i].nsPerOp = ns;
+    }
+  }
+  return results;
+}
+
+bool writeBaseline(const char* path, const std::vector<BenchResult>& results) {
+  FILE* file = fopen(path, "w");
+  if (!file) return false;
+  fprintf(file, "# <name> <ns/op> <allocs/op>\n");
+  for (const BenchResult& result : results) {
+    fprintf(file, "%s %.2f %.3f\n", result.name.c_str(), result.nsPerOp, result.allocsPerOp);
+  }
+  return fclose(file) == 0;
+}
+
+bool readBaseline(const char* path, std::vector<BenchResult>& baseline) {
+  FILE* file = fopen(path, "r");
+  if (!file) return false;
+
+  char line[256];
+  bool valid = true;
+  while (valid && fgets(line, sizeof(line), file)) {
+    char   name[128];
+    double nsPerOp, allocsPerOp;
+    if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0') continue;
+    valid = sscanf(line, "%127s %lf %lf", name, &nsPerOp, &allocsPerOp) == 3;
+    if (valid) baseline.push_back({name, nsPerOp, allocsPerOp});
+  }
+  fclose(file);
+  return valid;
+}
@@ -0,0 +1,368 @@
+#include "benchmark.h"
+#include <lora_frame_decoder.h>
+#include <lora_frame_v2.h>
+#include <lora_event_ring.h>
+#include <lora_hex.h>
+#include <lora_mac.h>
+#include <main.h>
+#include <memory>
+#include <time_range.h>
+
+/*
+Microbenchmarks of the hot paths of the edge and gateway firmwares, built for the host with the native shim.
+  --filter <text>        Only the benchmarks whose name contains this text
+  --save <file>          Write the results as a baseline
+  --compare <file>       Compare with a baseline, exit with 1 if a benchmark regressed
+  --threshold <percent>  Slowdown allowed before a benchmark is a regression (default: 25)
+A benchmark regresses when its ns/op grows by more than the threshold, or when it allocates more than in the baseline.
+*/
+#define BENCH_DEFAULT_THRESHOLD 25
+
+/**
+ * Print discarding its output, to measure the formatting alone.
+ */
+class NullPrint : public Print {
+public:
+  size_t write(uint8_t) override { return 1; }
+  size_t write(const uint8_t*, size_t size) override { return size; }
+  using Print::write;
+};
+
+static const uint8_t BENCH_KEY[LORA_MAC_KEY_BYTES] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
+
+/**
+ * @return A signed heartbeat, the most frequent uplink.
+ */
+static LoraPayload heartbeatPayload(const LoraMacKey& key) {
+  LoraPayload pkt = {};
+  pkt.id          = 1;
+  pkt.counter     = 1234;
+  pkt.ts          = 1790000000;
+  encodePayload<PayloadType::EDGE_HEARTBEAT>({.alarmState = 1, .airtimeUsage = 3, .nextHeartbeat = 600}, pkt);
+  pkt.hmac = computeFrameMac(key, LoraDirection::UPLINK, pkt);
+  return pkt;
+}
+
+/**
+ * @return A signed event batch of LORA_EVENT_FLUSH_COUNT events, as flushed by the event ring of the edge.
+ */
+static LoraPayload eventBatchPayload(const LoraMacKey& key) {
+  LoraPayload pkt = {};
+  pkt.id          = 1;
+  pkt.counter     = 1235;
+  pkt.ts          = 1790000000;
+  for (uint8_t i = 0; i < LORA_EVENT_FLUSH_COUNT; i++) {
+    appendPayloadRecord<PayloadType::EVENT_BATCH>({.kind = static_cast<uint8_t>(EventKind::MOTION), .offsetMs = (uint16_t)(i * 1500), .value = {(uint8_t)(i % 2)}}, pkt);
+  }
+  pkt.hmac = computeFrameMac(key, LoraDirection::UPLINK, pkt);
+  return pkt;
+}
+
+/**
+ * @return A signed rule set filling a downlink, the largest frame the edge receives.
+ */
+static LoraPayload timeRangeCommand(const LoraMacKey& key) {
+  LoraPayload pkt = {};
+  pkt.id          = 1;
+  pkt.counter     = 43;
+  pkt.ts          = 1790000000;
+  while (pkt.length + BODY_WIRE_SIZE<PayloadType::SET_TIME_RANGE> <= MAX_PAYLOAD_DATA_SIZE) {
+    appendPayloadRecord<PayloadType::SET_TIME_RANGE>({.weekDayMask = 0x3E, .hourMask = 0x00FFFF00, .monthDayMask = TIME_RANGE_WEEKLY_MONTH_DAYS, .monthMask = TIME_RANGE_WEEKLY_MONTHS}, pkt);
+  }
+  pkt.hmac = computeFrameMac(key, LoraDirection::DOWNLINK, pkt);
+  return pkt;
+}
+
+/*
+String path of the edge before LoraFrameDecoder (listenForPayload(), hexToPayloadBE() and parseU32BE() of lora_comm.cpp),
+with the counter field added to the frames since and without its prints. Only kept as the reference of the
+edge/rxLine benchmarks: each byte goes through a substring() and strtoul().
+*/
+static uint32_t legacyParseU32BE(const String& s, size_t offset) {
+  uint32_t value = 0;
+  for (size_t i = 0; i < 4; i++) {
+    String byteStr = s.substring(offset + i * 2, offset + i * 2 + 2);
+    value          = (value << 8) | (uint32_t)strtoul(byteStr.c_str(), nullptr, 16);
+  }
+  return value;
+}
+
+static bool legacyHexToPayload(const String& hex, LoraPayload& pkt) {
+  size_t offset = 0;
+  pkt.id        = (uint8_t)strtoul(hex.substring(offset, offset + 2).c_str(), nullptr, 16);
+  offset += 2;
+  pkt.counter = legacyParseU32BE(hex, offset);
+  offset += 8;
+  pkt.ts = legacyParseU32BE(hex, offset);
+  offset += 8;
+  uint32_t rawType = strtoul(hex.substring(offset, offset + 2).c_str(), nullptr, 16);
+  if (auto type = parsePayloadType(rawType)) {
+    pkt.type = type.value();
+  } else {
+    return false;
+  }
+  offset += 2;
+  pkt.length = (uint8_t)strtoul(hex.substring(offset, offset + 2).c_str(), nullptr, 16);
+  offset += 2;
+
+  if (hex.length() < (unsigned int)(LORA_FRAME_HEADER_BYTES + pkt.length + LORA_FRAME_HMAC_BYTES) * 2) {
+    return false; // Check expected length based on the length field
+  }
+
+  for (size_t i = 0; i < pkt.length; i++) {
+    pkt.data[i] = (uint8_t)strtoul(hex.substring(offset, offset + 2).c_str(), nullptr, 16);
+    offset += 2;
+  }
+
+  pkt.hmac = legacyParseU32BE(hex, offset);
+  return true;
+}
+
+/**
+ * @param chars A line printed by the module, as read by Serial1.readStringUntil('\n').
+ * @return true if the line holds a payload, decoded into pkt.
+ */
+static bool legacyDecodeLine(const char* chars, LoraPayload& pkt) {
+  String line = chars;
+  line.trim();
+  if (!line.startsWith("+TEST: RX \"")) return false;
+
+  int q1 = line.indexOf('"');
+  int q2 = line.indexOf('"', q1 + 1);
+  if (q1 < 0 || q2 <= q1) return false;
+  String hex = line.substring(q1 + 1, q2);
+  return hex.length() >= (LORA_FRAME_HEADER_BYTES + LORA_FRAME_HMAC_BYTES) * 2 && legacyHexToPayload(hex, pkt);
+}
+
+/**
+ * onLoraLine() of the edge: the characters of a line fed to the decoder, then the end of the line.
+ * @return true if the line holds a payload, decoded into pkt.
+ */
+static bool decoderDecodeLine(LoraFrameDecoder& decoder, const std::string& line, LoraPayload& pkt) {
+  bool decoded = false;
+  for (char c : line) {
+    if (decoder.feed(c) == LoraFrameDecoder::Result::FRAME) {
+      pkt     = decoder.payload();
+      decoded = true;
+    }
+  }
+  decoder.feed('\n');
+  return decoded;
+}
+
+/**
+ * @return Rules matching none of the times of March: isMonitoringTime() checks all of them, its worst case.
+ */
+static std::vector<TimeRangeRule> monitoringRules(size_t count) {
+  std::vector<TimeRangeRule> rules(count);
+  uint32_t                   state = 0x9E3779B9;
+  for (TimeRangeRule& rule : rules) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    rule = {
+        .weekDayMask  = (uint8_t)(0x7F & (state | 0x01)),
+        .hourMask     = 0xFFFFFF & (state | 0x000F00),
+        .monthDayMask = 0x7FFFFFFF & ~(state >> 8),
+        .monthMask    = (uint16_t)(0xFFF & ~(1 << (12 - 3))), // Every month but March
+    };
+  }
+  return rules;
+}
+
+static void benchEdge(BenchRunner& runner, const LoraMacKey& key) {
+  LoraPayload heartbeat                         = heartbeatPayload(key);
+  LoraPayload batch                             = eventBatchPayload(key);
+  LoraEpoch   epoch                             = {.ts = heartbeat.ts - 60, .ms = 0, .valid = true};
+  uint8_t     frame[LORA_FRAME_MAX_BYTES]       = {};
+  char        hex[LORA_FRAME_MAX_BYTES * 2 + 1] = {};
+
+  // transmitPayload(): the uplink to the hex of the AT command
+  runner.add("edge/uplinkToHex/v1/heartbeat", [=]() mutable { benchKeep(bytesToHex(frame, writeFrame(heartbeat, frame), hex)); });
+  runner.add("edge/uplinkToHex/v1/batch", [=]() mutable { benchKeep(bytesToHex(frame, writeFrame(batch, frame), hex)); });
+  runner.add("edge/uplinkToHex/v2/heartbeat", [=]() mutable { benchKeep(bytesToHex(frame, writeFrameV2(key, heartbeat, epoch, 60000, frame), hex)); });
+
+  // onLoraLine(): the hex of a downlink to its payload, then its MAC
+  LoraPayload command = {};
+  command.id          = 1;
+  command.counter     = 42;
+  command.ts          = 1790000000;
+  encodePayload<PayloadType::SET_ALARM_STATE>({.alarmState = 1}, command);
+  command.hmac         = computeFrameMac(key, LoraDirection::DOWNLINK, command);
+  size_t commandLength = bytesToHex(frame, writeFrame(command, frame), hex);
+  runner.add("edge/hexToDownlink", [=] {
+    LoraFrameDecoder decoder;
+    benchKeep(decoder.decodeHex(hex, commandLength) == LoraFrameDecoder::Result::FRAME && verifyFrameMac(key, LoraDirection::DOWNLINK, decoder.payload()));
+  });
+
+  // onLoraLine(): a whole line printed by the module, against the String path the decoder replaced
+  std::string alarmStateLine = LORA_RX_PREFIX + std::string(hex, commandLength) + "\"";
+  std::string timeRangeLine  = LORA_RX_PREFIX + std::string(hex, bytesToHex(frame, writeFrame(timeRangeCommand(key), frame), hex)) + "\"";
+  runner.add("edge/rxLine/legacy/alarmState", [=] {
+    LoraPayload pkt;
+    benchKeep(legacyDecodeLine(alarmStateLine.c_str(), pkt));
+  });
+  runner.add("edge/rxLine/legacy/timeRange", [=] {
+    LoraPayload pkt;
+    benchKeep(legacyDecodeLine(timeRangeLine.c_str(), pkt));
+  });
+  runner.add("edge/rxLine/decoder/alarmState", [=, decoder = LoraFrameDecoder()]() mutable {
+    LoraPayload pkt;
+    benchKeep(decoderDecodeLine(decoder, alarmStateLine, pkt));
+  });
+  runner.add("edge/rxLine/decoder/timeRange", [=, decoder = LoraFrameDecoder()]() mutable {
+    LoraPayload pkt;
+    benchKeep(decoderDecodeLine(decoder, timeRangeLine, pkt));
+  });
+}
+
+static void benchMac(BenchRunner& runner, const LoraMacKey& key) {
+  LoraPayload heartbeat = heartbeatPayload(key);
+  LoraPayload batch     = eventBatchPayload(key);
+  uint8_t     frame[LORA_FRAME_MAX_BYTES];
+  size_t      size = writeFrame(heartbeat, frame);
+
+  runner.add("mac/computeFrameMac/heartbeat", [=] { benchKeep(computeFrameMac(key, LoraDirection::UPLINK, heartbeat)); });
+  runner.add("mac/computeFrameMac/batch", [=] { benchKeep(computeFrameMac(key, LoraDirection::UPLINK, batch)); });
+  runner.add("mac/computeFrameMacV2/heartbeat", [=] { benchKeep(computeFrameMacV2(key, heartbeat.counter, true, heartbeat.ts, frame, size)); });
+}
+
+static void benchGateway(BenchRunner& runner, const LoraMacKey& key) {
+  LoraPayload    heartbeat = heartbeatPayload(key);
+  LoraPayload    batch     = eventBatchPayload(key);
+  LoraRxMetadata meta      = {.rssi = -72, .snr = 9, .valid = true};
+  NullPrint      out;
+  uint8_t        frame[LORA_FRAME_MAX_BYTES];
+  char           heartbeatHex[LORA_FRAME_MAX_BYTES * 2 + 1];
+  char           batchHex[LORA_FRAME_MAX_BYTES * 2 + 1];
+  size_t         heartbeatLength = bytesToHex(frame, writeFrame(heartbeat, frame), heartbeatHex);
+  size_t         batchLength     = bytesToHex(frame, writeFrame(batch, frame), batchHex);
+
+  // Uplinks: from the hex of the LoRa module to the Json line of the host
+  runner.add("gateway/hexToPayload/heartbeat", [=] {
+    LoraPayload pkt;
+    benchKeep(hexToPayload(heartbeatHex, heartbeatLength, pkt));
+  });
+  runner.add("gateway/hexToPayload/batch", [=] {
+    LoraPayload pkt;
+    benchKeep(hexToPayload(batchHex, batchLength, pkt));
+  });
+  runner.add("gateway/payloadToJson/heartbeat", [=]() mutable { payloadToJson(heartbeat, meta, out); });
+  runner.add("gateway/payloadToJson/batch", [=]() mutable { payloadToJson(batch, meta, out); });
+
+  // Downlinks: from the Json line of the host to the hex of the AT command, written in place as enqueueTransmit() does
+  const char  json[]  = "{\"id\":1,\"ts\":1790000000,\"type\":19,\"length\":1,\"data\":\"01\",\"hmac\":\"00000000\"}";
+  LoraPayload command = jsonToPayload(json, sizeof(json) - 1);
+  runner.add("gateway/jsonToPayload", [=] { benchKeep(jsonToPayload(json, sizeof(json) - 1)); });
+  runner.add("gateway/writeDownlink", [=]() mutable {
+    char hex[LORA_FRAME_MAX_BYTES * 2 + 1];
+    benchKeep(bytesToHex(frame, writeFrame(command, frame), hex));
+  });
+}
+
+static void benchTimeRanges(BenchRunner& runner) {
+  iarduino_RTC rtc(RTC_DS1307);
+  rtc.weekday = 3;
+  rtc.Hours   = 14;
+  rtc.day     = 18;
+  rtc.month   = 3;
+
+  for (size_t count : {1, 18, 255}) {
+    std::vector<TimeRangeRule> rules = monitoringRules(count);
+    auto                       checker = std::make_shared<TimeRangeChecker>(); // Owns a copy of the rules, shared by the copies of the lambda
+    checker->setTimeRanges(rules.data(), rules.size());
+
+    runner.add("edge/isMonitoringTime/" + std::to_string(count), [=]() mutable { benchKeep(checker->isMonitoringTime(rtc)); });
+  }
+
+  // The reference of the index, and the index when the date changes at each check
+  std::vector<TimeRangeRule> rules   = monitoringRules(255);
+  auto                       checker = std::make_shared<TimeRangeChecker>();
+  checker->setTimeRanges(rules.data(), rules.size());
+  runner.add("edge/isMonitoringTimeLinear/255", [=] { benchKeep(checker->isMonitoringTimeLinear(3, 14, 18, 3)); });
+  runner.add("edge/isMonitoringTime/255/newDay", [=]() mutable {
+    rtc.day = rtc.day == 18 ? 19 : 18;
+    benchKeep(checker->isMonitoringTime(rtc));
+  });
+}
+
+/**
+ * Print the results, compared with the baseline if any.
+ * @return The number of regressions.
+ */
+static size_t report(const std::vector<BenchResult>& results, const std::vector<BenchResult>& baseline, double thresholdPercent) {
+  size_t regressions = 0;
+  printf("%-36s %10s %10s", "benchmark", "ns/op", "allocs/op");
+  if (!baseline.empty()) printf(" %10s %8s", "baseline", "change");
+  printf("\n");
+
+  for (const BenchResult& result : results) {
+    printf("%-36s %10.1f %10.2f", result.name.c_str(), result.nsPerOp, result.allocsPerOp);
+
+    const BenchResult* reference = nullptr;
+    for (const BenchResult& entry : baseline) {
+      if (entry.name == result.name) reference = &entry;
+    }
+    if (reference) {
+      double change    = 100 * (result.nsPerOp - reference->nsPerOp) / reference->nsPerOp;
+      bool   slower    = change > thresholdPercent;
+      bool   allocates = result.allocsPerOp > reference->allocsPerOp + 0.005;
+      printf(" %10.1f %+7.1f%%%s%s", reference->nsPerOp, change, slower ? "  SLOWER" : "", allocates ? "  ALLOCATES" : "");
+      if (slower || allocates) regressions++;
+    } else if (!baseline.empty()) {
+      printf(" %10s", "new");
+    }
+    printf("\n");
+  }
+  return regressions;
+}
+
+static int usage(const char* program) {
+  fprintf(stderr, "Usage: %s [--filter <text>] [--save <file>] [--compare <file>] [--threshold <percent>]\n", program);
+  return 2;
+}
+
+int main(int argc, char** argv) {
+  const char* filter    = nullptr;
+  const char* save      = nullptr;
+  const char* compare   = nullptr;
+  double      threshold = BENCH_DEFAULT_THRESHOLD;
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 < argc && strcmp(argv[i], "--filter") == 0) {
+      filter = argv[++i];
+    } else if (i + 1 < argc && strcmp(argv[i], "--save") == 0) {
+      save = argv[++i];
+    } else if (i + 1 < argc && strcmp(argv[i], "--compare") == 0) {
+      compare = argv[++i];
+    } else if (i + 1 < argc && strcmp(argv[i], "--threshold") == 0 && atof(argv[i + 1]) > 0) {
+      threshold = atof(argv[++i]);
+    } else {
+      return usage(argv[0]);
+    }
+  }
+
+  std::vector<BenchResult> baseline;
+  if (compare && !readBaseline(compare, baseline)) {
+    fprintf(stderr, "Cannot read the baseline %s\n", compare);
+    return 2;
+  }
+
+  LoraMacKey  key = loraMacKeyFromBytes(BENCH_KEY);
+  BenchRunner runner(filter);
+  benchEdge(runner, key);
+  benchMac(runner, key);
+  benchGateway(runner, key);
+  benchTimeRanges(runner);
+
+  std::vector<BenchResult> results     = runner.run();
+  size_t                   regressions = report(results, baseline, threshold);
+  if (save && !writeBaseline(save, results)) {
+    perror(save);
+    return 2;
+  }
+  if (regressions > 0) {
+    printf("%zu regression(s) over the baseline (threshold %.0f%%)\n", regressions, threshold);
+    return 1;
+  }
+  return 0;
+}
@@ -8,12 +8,24 @@
 /*
 EEPROM storage layout (starting at address 0):
 - 0-3: Secret combination (4 bytes, each byte represents a digit from 0 to 9)
-- 100: Number of time range rules (1 byte, max 255 rules)
-- 101-...: Time range rules (16 bytes each, defined by the TimeRangeRule structure)
+- 4-16: LoRa frame counters and heartbeat policy, managed by the edge firmware (left untouched by this utility)
+- 17: Active bank of time range rules (1 for bank B, any other value for bank A)
+- 18: LoRa node ID (1 to 251), erased to use the default ID of the edge firmware
+- 19-34: LoRa MAC key shared with the gateway (16 bytes), erased to use the default development key
+- 100: Bank A, number of time range rules (1 byte, max 255 rules)
+- 101-2905: Bank A, time range rules (11 bytes each, defined by the TimeRangeRule structure)
+- 3000-5805: Bank B, same layout, written by the edge firmware when it receives new rules over LoRa
+
+This utility reads the active bank, and always writes bank A then makes it the active one.
 */
 #define EEPROM_SECRET_COMBINATION_ADDRESS     0
+#define EEPROM_TIME_RANGE_BANK_ADDRESS        17
+#define EEPROM_LORA_NODE_ID_ADDRESS           18
+#define EEPROM_LORA_MAC_KEY_ADDRESS           19
+#define EEPROM_LORA_MAC_KEY_BYTES             16
 #define EEPROM_TIME_RANGE_RULES_COUNT_ADDRESS 100
 #define EEPROM_TIME_RANGE_RULES_START_ADDRESS 101
+#define EEPROM_TIME_RANGE_BANK_B_ADDRESS      3000
 
 /**
  * Structure to hold the data retrieved from EEPROM at startup, including the secret combination and the number of time range rules stored.
@@ -28,5 +40,6 @@ EEPROMSetupData setupEEPROM(); // Retrieve the secret combination and number of
 void retrieveTimeRangeRulesEEPROM(TimeRangeRule* rules, size_t& ruleCount);
 void storeTimeRangeRulesEEPROM(TimeRangeRule* rules, size_t& ruleCount);
 void storeSecretCombinationEEPROM(const std::array<int, 4>& combination);
+void storeLoraIdentityEEPROM(uint8_t nodeId, const uint8_t (&key)[EEPROM_LORA_MAC_KEY_BYTES]);
 
 #endif // EEPROM_DRIVER_H
\ No newline at end of file
@@ -1,5 +1,12 @@
 #include "eeprom_driver.h"
 
+/**
+ * @return The address of the rule count of the active bank, its rules start at the next address.
+ */
+static int activeTimeRangeBankAddress() {
+  return EEPROM.read(EEPROM_TIME_RANGE_BANK_ADDRESS) == 1 ? EEPROM_TIME_RANGE_BANK_B_ADDRESS : EEPROM_TIME_RANGE_RULES_COUNT_ADDRESS;
+}
+
 /**
  * Retrieve the secret combination and number of time range rules from EEPROM at startup.
  * @return An EEPROMSetupData structure containing the secret combination and the number of time range rules stored in EEPROM.
@@ -18,7 +25,7 @@ EEPROMSetupData setupEEPROM() {
   }
 
   // Read number of time range rules
-  data.timeRangeRulesCount = EEPROM.read(EEPROM_TIME_RANGE_RULES_COUNT_ADDRESS);
+  data.timeRangeRulesCount = EEPROM.read(activeTimeRangeBankAddress());
   Serial.print("Read time range rules count from EEPROM: ");
   Serial.println(data.timeRangeRulesCount);
 
@@ -39,7 +46,8 @@ void retrieveTimeRangeRulesEEPROM(TimeRangeRule* rules, size_t& ruleCount) {
   }
 
   // Read number of time range rules stored in EEPROM
-  uint8_t storedRuleCount = EEPROM.read(EEPROM_TIME_RANGE_RULES_COUNT_ADDRESS);
+  int     bankAddress     = activeTimeRangeBankAddress();
+  uint8_t storedRuleCount = EEPROM.read(bankAddress);
 
   if (storedRuleCount > ruleCount) {
     Serial.println("Warning: Provided ruleCount (" + String(ruleCount) + ") does not match the number of rules stored in EEPROM (" + String(storedRuleCount) + "). Only the first " + String(ruleCount) + " rules will be retrieved.");
@@ -50,7 +58,7 @@ void retrieveTimeRangeRulesEEPROM(TimeRangeRule* rules, size_t& ruleCount) {
 
   for (size_t i = 0; i < ruleCount; i++) {
     // Calculate the base address for the current rule
-    int baseAddress = EEPROM_TIME_RANGE_RULES_START_ADDRESS + i * TIME_RANGE_RULE_BYTES;
+    int baseAddress = bankAddress + 1 + i * TIME_RANGE_RULE_BYTES;
 
     // Read each byte of the TimeRangeRule structure from EEPROM and reconstruct the structure
     rules[i].weekDayMask  = EEPROM.read(baseAddress);
@@ -108,6 +116,9 @@ void storeTimeRangeRulesEEPROM(TimeRangeRule* rules, size_t& ruleCount) {
     Serial.print(", monthMask=");
     Serial.println(rules[i].monthMask, BIN);
   }
+
+  // Bank A now holds the rules
+  EEPROM.write(EEPROM_TIME_RANGE_BANK_ADDRESS, 0);
 }
 
 /**
@@ -124,3 +135,18 @@ void storeSecretCombinationEEPROM(const std::array<int, 4>& combination) {
     Serial.println(value);
   }
 }
+
+/**
+ * Store the LoRa identity of the edge node. The same ID and key must be registered in the node table of the gateway.
+ * @param nodeId The node ID, from 1 to 251 (higher IDs are reserved for v2 frames).
+ * @param key The 16-byte MAC key of the node, it must differ from the key of every other node.
+ */
+void storeLoraIdentityEEPROM(uint8_t nodeId, const uint8_t (&key)[EEPROM_LORA_MAC_KEY_BYTES]) {
+  EEPROM.write(EEPROM_LORA_NODE_ID_ADDRESS, nodeId);
+  for (int i = 0; i < EEPROM_LORA_MAC_KEY_BYTES; i++) {
+    EEPROM.write(EEPROM_LORA_MAC_KEY_ADDRESS + i, key[i]);
+  }
+
+  Serial.print("Stored LoRa node ID in EEPROM: ");
+  Serial.println(nodeId);
+}
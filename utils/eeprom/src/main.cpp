@@ -22,6 +22,10 @@ void setup() {
   Serial.println("Setting secret combination to {" + String(secretCombination[0]) + ", " + String(secretCombination[1]) + ", " + String(secretCombination[2]) + ", " + String(secretCombination[3]) + "} for testing purposes");
   storeSecretCombinationEEPROM(secretCombination);
 
+  // Example LoRa identity, register the same ID and key in the gateway: {"cmd":"node_set","id":2,"key":"000102030405060708090a0b0c0d0e0f"}
+  // uint8_t loraKey[EEPROM_LORA_MAC_KEY_BYTES] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
+  // storeLoraIdentityEEPROM(2, loraKey);
+
   // Example time range rule (always active)
   // size_t        ruleCount = 1;
   // TimeRangeRule rules[1];
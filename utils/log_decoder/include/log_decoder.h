@@ -0,0 +1,53 @@
+#ifndef LOG_DECODER_H
+#define LOG_DECODER_H
+
+#include <log_catalog.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+#define LOG_DECODER_FRAME_MAX_BYTES 256 // Longer runs between two delimiters are text, a record is at most 64 bytes
+
+/**
+ * Renders the Serial output of the edge as text: the log records between 0x00 delimiters (see deferred_log.h) are
+ * formatted with the format strings of the catalog, the rest of the stream is printed as it is.
+ */
+class LogDecoder {
+public:
+  explicit LogDecoder(FILE* out) : out(out) {}
+
+  /**
+   * Decode the next byte of the stream, the complete lines are printed at once.
+   */
+  void feed(uint8_t byte);
+
+  /**
+   * @return The number of frames that could not be decoded, e.g. cut by a reset of the board or sent by a firmware
+   * built from another catalog.
+   */
+  uint32_t getInvalidFrames() const { return invalidFrames; }
+
+  /**
+   * @return false if the LOG_START record of the firmware carried the hash of another catalog.
+   */
+  bool isCatalogMatching() const { return catalogMatching; }
+
+  /**
+   * Format a record: the ID, millis() and the arguments of the message, without the COBS encoding.
+   * @param text Filled with the message, without line ending.
+   * @return false if the record does not match the catalog.
+   */
+  static bool formatRecord(const uint8_t* record, size_t length, LogId& id, uint32_t& ms, std::string& text);
+
+private:
+  FILE*    out;
+  bool     inFrame = true; // Whether the bytes since the last delimiter may be a frame, the stream may start in one
+  uint8_t  frame[LOG_DECODER_FRAME_MAX_BYTES];
+  size_t   frameLength     = 0;
+  uint32_t invalidFrames   = 0;
+  bool     catalogMatching = true;
+
+  void endFrame();
+};
+
+#endif // LOG_DECODER_H
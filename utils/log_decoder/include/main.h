@@ -0,0 +1,12 @@
+#ifndef MAIN_H
+#define MAIN_H
+
+#include "log_decoder.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#endif // MAIN_H
@@ -0,0 +1,186 @@
+#include "log_decoder.h"
+#include <time.h>
+
+/**
+ * Reads the unsigned LEB128 varints and the byte arguments of a record.
+ */
+class RecordReader {
+public:
+  RecordReader(const uint8_t* record, size_t length) : record(record), length(length) {}
+
+  bool readVarint(uint32_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 35 && position < length; shift += 7) {
+      uint8_t byte = record[position++];
+      value |= (uint32_t)(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+  }
+
+  bool readBytes(const uint8_t*& bytes, uint32_t count) {
+    if (length - position < count) return false;
+    bytes = record + position;
+    position += count;
+    return true;
+  }
+
+  bool atEnd() const { return position == length; }
+
+private:
+  const uint8_t* record;
+  size_t         length;
+  size_t         position = 0;
+};
+
+static void appendFormat(std::string& text, const char* format, uint32_t value) {
+  char buffer[16];
+  snprintf(buffer, sizeof(buffer), format, value);
+  text += buffer;
+}
+
+static void appendBinary(std::string& text, uint32_t value) {
+  int bit = 31;
+  while (bit > 0 && !(value >> bit & 1)) bit--; // No leading zeros, as Serial.print(value, BIN)
+  for (; bit >= 0; bit--) {
+    text += (value >> bit & 1) ? '1' : '0';
+  }
+}
+
+static void appendTime(std::string& text, uint32_t unixTime) {
+  time_t    seconds = unixTime;
+  struct tm utc;
+  char      buffer[32];
+  gmtime_r(&seconds, &utc);
+  strftime(buffer, sizeof(buffer), "%d-%m-%Y, %H:%M:%S UTC", &utc);
+  text += buffer;
+}
+
+/**
+ * Append the argument of a conversion to the text.
+ * @return false if the record does not hold the argument.
+ */
+static bool appendArgument(std::string& text, char conversion, RecordReader& reader) {
+  uint32_t value;
+  if (!reader.readVarint(value)) return false;
+
+  switch (conversion) {
+  case 'u': appendFormat(text, "%u", value); break;
+  case 'd': appendFormat(text, "%d", value); break;
+  case 'x': appendFormat(text, "%X", value); break;
+  case 'c': text += (char)value; break;
+  case 'b': appendBinary(text, value); break;
+  case 't': appendTime(text, value); break;
+  case 'S':
+    if (value < sizeof(LOG_ALARM_STATES) / sizeof(LOG_ALARM_STATES[0])) {
+      text += LOG_ALARM_STATES[value];
+    } else {
+      appendFormat(text, "UNKNOWN(%u)", value);
+    }
+    break;
+  case 'h': {
+    uint32_t       count;
+    const uint8_t* bytes;
+    if (!reader.readVarint(count) || count > value || !reader.readBytes(bytes, count)) return false;
+    for (uint32_t i = 0; i < count; i++) {
+      appendFormat(text, "%02X", bytes[i]);
+    }
+    if (count < value) appendFormat(text, "... (%u bytes)", value);
+    break;
+  }
+  default: return false; // Not a conversion of the catalog
+  }
+  return true;
+}
+
+bool LogDecoder::formatRecord(const uint8_t* record, size_t length, LogId& id, uint32_t& ms, std::string& text) {
+  if (length == 0 || record[0] >= static_cast<uint8_t>(LogId::COUNT)) return false;
+  id = static_cast<LogId>(record[0]);
+
+  RecordReader reader(record + 1, length - 1);
+  if (!reader.readVarint(ms)) return false;
+
+  text.clear();
+  for (const char* c = LOG_FORMATS[record[0]]; *c != '\0'; c++) {
+    if (*c != '%') {
+      text += *c;
+    } else if (*++c == '%') {
+      text += '%';
+    } else if (!appendArgument(text, *c, reader)) {
+      return false;
+    }
+  }
+  return reader.atEnd();
+}
+
+void LogDecoder::feed(uint8_t byte) {
+  if (!inFrame) {
+    if (byte == 0) {
+      inFrame     = true;
+      frameLength = 0;
+    } else {
+      fputc(byte, out);
+    }
+    return;
+  }
+
+  if (byte == 0) {
+    endFrame();
+  } else if (frameLength < sizeof(frame)) {
+    frame[frameLength++] = byte;
+  } else { // Too long for a record, the delimiter was the end of a frame followed by text
+    fwrite(frame, 1, frameLength, out);
+    fputc(byte, out);
+    inFrame = false;
+  }
+}
+
+/**
+ * Decode the bytes between two delimiters. If they are not a valid record, they were text or a frame cut short, and
+ * the last delimiter may be the start of a frame.
+ */
+void LogDecoder::endFrame() {
+  if (frameLength == 0) return; // Start delimiter after the end of the previous frame
+
+  // COBS: each code byte is the distance to the next zero, or to the end of the frame
+  uint8_t record[LOG_DECODER_FRAME_MAX_BYTES];
+  size_t  recordLength = 0;
+  bool    valid        = true;
+  for (size_t i = 0; i < frameLength && valid;) {
+    size_t code = frame[i++];
+    valid       = i + code - 1 <= frameLength;
+    for (size_t j = 1; j < code && valid; j++) {
+      record[recordLength++] = frame[i++];
+    }
+    if (i < frameLength) record[recordLength++] = 0;
+  }
+
+  LogId       id;
+  uint32_t    ms;
+  std::string text;
+  if (valid && formatRecord(record, recordLength, id, ms, text)) {
+    static const char LEVELS[] = {'-', 'E', 'W', 'I', 'D'};
+    fprintf(out, "[%6u.%03u] %c %s\n", ms / 1000, ms % 1000, LEVELS[logLevelOf(id)], text.c_str());
+
+    RecordReader start(record + 1, recordLength - 1);
+    uint32_t     hash;
+    if (id == LogId::LOG_START && start.readVarint(ms) && start.readVarint(hash) && hash != LOG_CATALOG_HASH) {
+      catalogMatching = false;
+      fprintf(out, "Warning: the firmware was built from another log catalog (%08X, this decoder has %08X), messages may be wrong\n", hash, LOG_CATALOG_HASH);
+    }
+    frameLength = 0;
+    inFrame     = false;
+    return;
+  }
+
+  bool printable = true;
+  for (size_t i = 0; i < frameLength; i++) {
+    printable = printable && (frame[i] >= 0x20 || frame[i] == '\r' || frame[i] == '\n' || frame[i] == '\t');
+  }
+  if (printable) {
+    fwrite(frame, 1, frameLength, out);
+  } else {
+    invalidFrames++;
+  }
+  frameLength = 0;
+}
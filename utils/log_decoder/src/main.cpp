@@ -0,0 +1,56 @@
+#include "main.h"
+
+/*
+Prints the Serial output of the edge as text, the log records being formatted with the catalog of the firmware.
+  log_decoder [<path>]   Reads the given file, or serial port at 115200 baud, or stdin when no path is given
+*/
+
+static int usage(const char* program) {
+  fprintf(stderr, "Usage: %s [<capture file or serial port>]\n", program);
+  return 2;
+}
+
+/**
+ * Switch a serial port to raw mode at the baud rate of the edge, nothing to do for a file.
+ * @return false if the port could not be configured.
+ */
+static bool configurePort(int fd) {
+  if (!isatty(fd)) return true;
+
+  struct termios options;
+  if (tcgetattr(fd, &options) != 0) return false;
+  cfmakeraw(&options);
+  cfsetispeed(&options, B115200);
+  cfsetospeed(&options, B115200);
+  return tcsetattr(fd, TCSANOW, &options) == 0;
+}
+
+int main(int argc, char** argv) {
+  if (argc > 2 || (argc == 2 && argv[1][0] == '-')) return usage(argv[0]);
+
+  int fd = STDIN_FILENO;
+  if (argc == 2) {
+    fd = open(argv[1], O_RDONLY | O_NOCTTY);
+    if (fd < 0 || !configurePort(fd)) {
+      fprintf(stderr, "Cannot open %s: %s\n", argv[1], strerror(errno));
+      return 1;
+    }
+  }
+
+  // Line buffered, so the lines show up as soon as they are received from a board
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+
+  LogDecoder decoder(stdout);
+  uint8_t    buffer[256];
+  ssize_t    count;
+  while ((count = read(fd, buffer, sizeof(buffer))) > 0) {
+    for (ssize_t i = 0; i < count; i++) {
+      decoder.feed(buffer[i]);
+    }
+  }
+
+  if (decoder.getInvalidFrames() > 0) {
+    fprintf(stderr, "%u frames could not be decoded\n", decoder.getInvalidFrames());
+  }
+  return decoder.isCatalogMatching() ? 0 : 1;
+}
@@ -0,0 +1,10 @@
+#ifndef MAIN_H
+#define MAIN_H
+
+#include "simulation.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#endif // MAIN_H
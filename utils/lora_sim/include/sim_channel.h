@@ -0,0 +1,80 @@
+#ifndef SIM_CHANNEL_H
+#define SIM_CHANNEL_H
+
+#include <lora_airtime.h>
+#include <lora_protocol.h>
+#include <random>
+#include <vector>
+
+/*
+Radio channel shared by the edges and the gateway: one frequency and one spreading factor, every radio in range of
+every other one.
+- Pure ALOHA: two transmissions overlapping in time are both lost, for every receiver (no capture effect).
+- Each frame is also lost with a fixed probability, for the fading and the interference from outside the network.
+- A radio does not receive while it is transmitting or switching back to receive mode (see SimRadio).
+*/
+
+#define SIM_GATEWAY_ID 0 // Sender of the downlinks, and receiver of the uplinks
+
+/**
+ * A frame on the air, with the data the simulation needs once it is received.
+ */
+struct Transmission {
+  uint32_t id;
+  uint8_t  sender;    // Node ID, or SIM_GATEWAY_ID
+  uint8_t  receiver;  // Node ID of a downlink, SIM_GATEWAY_ID for an uplink
+  uint64_t startUs;   // Simulated time of the first symbol
+  uint64_t endUs;     // Simulated time of the last symbol
+  uint64_t createdUs; // Time of the oldest event, state or command carried by the frame, for the latency
+  uint8_t  events;    // Events carried by an event batch
+  bool     collided;  // Overlapped another transmission
+  bool     lost;      // Lost by the channel
+  bool     chained;   // Downlink sent in the window renewed by the previous downlink of its edge
+  uint8_t  frame[LORA_FRAME_MAX_BYTES];
+  size_t   size;
+};
+
+/**
+ * Receive side of a radio: it is deaf while it transmits, then while the module switches back to receive mode.
+ */
+struct SimRadio {
+  uint64_t deafFromUs  = 0;
+  uint64_t deafUntilUs = 0;
+
+  bool canReceive(const Transmission& tx) const { return tx.endUs <= deafFromUs || tx.startUs >= deafUntilUs; }
+};
+
+class RadioChannel {
+public:
+  RadioChannel(const LoraRfConfig& config, double lossRatio, uint32_t seed) : config(config), lossRatio(lossRatio), random(seed) {}
+
+  /**
+   * @return The time-on-air of a frame of this size, in microseconds.
+   */
+  uint32_t airtimeUs(size_t size) const { return loraTimeOnAirUs(config, size); }
+
+  /**
+   * Put a frame on the air at tx.startUs, it collides with every frame still on the air.
+   */
+  void begin(Transmission& tx);
+
+  /**
+   * Take a frame off the air at its end.
+   * @return The frame, with its collided and lost flags final.
+   */
+  Transmission end(uint32_t id);
+
+  /**
+   * @return The airtime of all the frames ended so far, in microseconds.
+   */
+  uint64_t busyUs() const { return totalAirtimeUs; }
+
+private:
+  LoraRfConfig              config;
+  double                    lossRatio;
+  std::mt19937              random;
+  std::vector<Transmission> onAir;
+  uint64_t                  totalAirtimeUs = 0;
+};
+
+#endif // SIM_CHANNEL_H
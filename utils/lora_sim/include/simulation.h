@@ -0,0 +1,221 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "sim_channel.h"
+#include <deque>
+#include <ingress_filter.h>
+#include <lora_airtime.h>
+#include <lora_event_ring.h>
+#include <lora_frame_v2.h>
+#include <lora_heartbeat.h>
+#include <lora_mac.h>
+#include <lora_outbox.h>
+#include <lora_replay.h>
+#include <lora_rx_window.h>
+#include <queue>
+#include <random>
+#include <unordered_map>
+
+/*
+Discrete-event simulation of N edges and one gateway sharing the channel. The edges run the uplink path of the
+firmware: the heartbeat scheduler, the event ring, the outbox, the duty-cycle governor and the v1/v2 framing, with the
+same classes. The gateway runs its uplink pipeline (decoding, MAC, replay window, ingress filter) and sends the
+commands of the host. The edges listen at all times, or with classA only in the window after their frames
+(LORA_CLASS_A): the gateway then holds the commands in its DownlinkQueue until the window of their edge.
+The AT commands are sent to the module over its 9600 baud UART before each frame, and the module is deaf until it is
+back in receive mode after it. The module prints each frame received over the same UART.
+*/
+
+#define SIM_START_UNIX       1790000000 // Unix time at the start of the simulation
+#define SIM_LOGIC_TICK_US    100000     // SECURITY_LOGIC_TIME_INTERVAL of the edge
+#define SIM_BUDGET_RETRY_US  100000     // Delay before checking the duty-cycle budget again
+#define SIM_BOOT_SPREAD_US   10000000   // The edges boot at random within this delay
+#define SIM_UART_BAUD        9600       // UART of the LoRa module
+#define SIM_RX_SWITCH_CHARS  50         // "+TEST: TX DONE", then AT+TEST=RXLRPKT and its answer
+#define SIM_TX_COMMAND_CHARS 20         // AT+TEST=TXLRPKT,"" and the line ending, around the hex frame
+#define SIM_TX_DONE_CHARS    16         // "+TEST: TX DONE" and the line ending, the edge opens its window once it read it
+#define SIM_RX_REPORT_CHARS  56         // "+TEST: LEN:..., RSSI:..., SNR:..." and +TEST: RX "", around the hex frame
+
+/**
+ * Parameters of a run.
+ */
+struct SimConfig {
+  size_t   nodes;           // Number of edges, up to LORA_V1_MAX_NODE_ID
+  double   hours;           // Simulated duration
+  double   lossPercent;     // Frames lost by the channel, besides the collisions
+  double   changesPerHour;  // Alarm state changes per edge (arming, disarming), each restarts the heartbeats
+  double   alarmsPerDay;    // Intrusions per edge: a motion event and an alarm state, sent at once
+  double   commandsPerHour; // Downlinks per edge sent by the host
+  uint8_t  spreadingFactor; // 7 to 12, at 125 kHz
+  bool     classA;          // LORA_CLASS_A: the edges only listen in the window after their frames
+  bool     largeCommands;   // The commands are full SET_TIME_RANGE_FRAGMENT payloads instead of SET_ALARM_STATE
+  uint32_t seed;
+};
+
+/**
+ * Counters and samples of a run.
+ */
+struct SimResults {
+  size_t uplinksSent      = 0; // Frames put on the air by the edges
+  size_t uplinksDelivered = 0; // Frames accepted by the gateway and forwarded to the host
+  size_t uplinksCollided  = 0;
+  size_t uplinksLost      = 0; // Lost by the channel, or sent while the gateway was transmitting
+  size_t uplinksRejected  = 0; // Received but not authenticated, e.g. a v2 frame after a lost epoch
+  size_t uplinksStale     = 0; // v2 frames whose delta counts from a lost epoch (part of uplinksRejected)
+  size_t uplinksFiltered  = 0; // Dropped by the ingress filter of the gateway
+  size_t uplinksDeferred  = 0; // Times an edge waited for its duty-cycle budget
+  size_t eventsRecorded   = 0;
+  size_t eventsDelivered  = 0;
+
+  size_t downlinksRequested = 0; // Commands of the host
+  size_t downlinksSent      = 0;
+  size_t downlinksDropped   = 0; // Over the duty-cycle budget of the gateway
+  size_t downlinksRefused   = 0; // The queue of the held downlinks was full (classA)
+  size_t downlinksMissed    = 0; // Received by the module of the edge after the end of its window (classA)
+  size_t epochsRequested    = 0; // RENEW_EPOCH downlinks queued by the gateway after a stale v2 frame
+  size_t epochsRenewed      = 0; // RENEW_EPOCH downlinks received by their edge
+  size_t downlinksOrphaned  = 0; // Missed as the previous downlink, which renews the window, did not reach the edge (classA)
+  size_t downlinksDelivered = 0;
+
+  std::vector<uint32_t> uplinkLatencyMs;   // From the event, state or heartbeat to its reception by the gateway
+  std::vector<uint32_t> downlinkLatencyMs; // From the command of the host to its reception by the edge
+  std::vector<uint64_t> nodeAirtimeUs;     // Per edge
+  uint64_t              gatewayAirtimeUs = 0;
+  uint64_t              channelBusyUs    = 0;
+  uint64_t              durationUs       = 0;
+};
+
+class Simulation {
+public:
+  explicit Simulation(const SimConfig& config);
+
+  SimResults run();
+
+private:
+  enum class EventType : uint8_t {
+    EDGE_WAKE,     // The edge runs its loop
+    EDGE_ACTIVITY, // The alarm state of the edge changes
+    TX_START,      // The first symbol of a frame is sent
+    TX_END,        // The last symbol of a frame is sent
+    COMMAND,       // The host sends a command to an edge
+    GATEWAY_WAKE,  // The gateway radio is back in receive mode
+  };
+
+  struct Event {
+    uint64_t  atUs;
+    uint64_t  order; // Events at the same time run in the order they were scheduled
+    EventType type;
+    uint32_t  target;     // Edge index or transmission ID
+    uint32_t  generation; // EDGE_WAKE: ignored if the edge was rescheduled since
+
+    bool operator>(const Event& other) const { return atUs != other.atUs ? atUs > other.atUs : order > other.order; }
+  };
+
+  // Time and content of a payload waiting in the outbox, found again through its sequence number
+  struct Pending {
+    uint64_t createdUs;
+    uint8_t  events;
+  };
+
+  struct Edge {
+    uint8_t    id;
+    LoraMacKey key;
+    uint64_t   bootUs;
+    bool       armed = false;
+
+    // Uplink path of lora_comm.cpp
+    LoraOutbox         outbox;
+    LoraEventRing      ring;
+    HeartbeatScheduler heartbeat;
+    DutyCycleGovernor  dutyCycle;
+    uint64_t           heartbeatDueUs   = 0;
+    uint32_t           txCounter        = 0;
+    LoraEpoch          txEpoch          = {};
+    uint8_t            framesSinceEpoch = 0;
+    ReplayWindow       rxWindow;
+    ReceiveWindow      downlinkWindow;
+    SimRadio           radio;
+    uint64_t           idleAtUs      = 0; // The module accepts the next frame from this time
+    uint64_t           airtimeUs     = 0;
+    bool               waitingBudget = false; // The next payload waits for the duty-cycle budget
+
+    // Bookkeeping of the simulation
+    std::deque<uint64_t>                  ringUs; // Time of each event in the ring
+    std::unordered_map<uint32_t, Pending> pending;
+    uint32_t                              nextSequence   = 0;
+    uint32_t                              wakeGeneration = 0;
+    uint64_t                              wakeAtUs       = UINT64_MAX;
+    uint64_t                              windowOpenUs   = 0; // Opening of downlinkWindow, to wake the edge at its end
+  };
+
+  struct GatewayNode {
+    LoraMacKey   key;
+    ReplayWindow rxWindow;
+    LoraEpoch    epoch     = {};
+    uint32_t     txCounter = 0;
+    bool         renewed   = false; // The window of the edge was renewed by a downlink since its last uplink
+  };
+
+  struct Command {
+    uint8_t  node;
+    uint64_t requestedUs;
+    bool     renewEpoch = false; // RENEW_EPOCH requested by the gateway itself, not a command of the host
+  };
+
+  SimConfig    config;
+  LoraRfConfig rfConfig;
+  RadioChannel channel;
+  std::mt19937 random;
+  SimResults   results;
+  uint64_t     nowUs     = 0;
+  uint64_t     nextOrder = 0;
+  uint32_t     nextTxId  = 1;
+
+  std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+  std::vector<Edge>                                                    edges;
+  std::unordered_map<uint32_t, Transmission>                           scheduled; // Frames waiting for their TX_START
+
+  std::vector<GatewayNode> gatewayNodes;
+  IngressFilter            ingress;
+  DutyCycleGovernor        gatewayDutyCycle;
+  SimRadio                 gatewayRadio;
+  uint64_t                 gatewayIdleAtUs = 0;
+  std::deque<Command>      commands;
+  DownlinkQueue            heldDownlinks; // classA
+  std::deque<Command>      heldCommands;  // The commands held in heldDownlinks, in the order they were held
+
+  void     schedule(uint64_t atUs, EventType type, uint32_t target, uint32_t generation = 0);
+  uint64_t exponentialDelayUs(double perHour);
+  uint32_t nowMs() const { return (uint32_t)(nowUs / 1000); }
+  uint32_t unixTime() const { return SIM_START_UNIX + (uint32_t)(nowUs / 1000000); }
+  uint64_t nextLogicTick(const Edge& edge, uint64_t atUs) const;
+
+  void edgeLoop(Edge& edge);
+  void edgeActivity(Edge& edge);
+  void edgeHeartbeat(Edge& edge);
+  void edgeRecord(Edge& edge, EventKind kind, const uint8_t (&value)[4], bool alarm);
+  void edgeQueue(Edge& edge, LoraPayload& pkt, OutboxPriority priority, const Pending& pending);
+  void edgeTransmit(Edge& edge, LoraPayload& pkt, uint32_t airtimeUs, const Pending& pending);
+  void edgeReschedule(Edge& edge);
+  void edgeReceive(Edge& edge, const Transmission& tx);
+  bool isEpochDue(const Edge& edge) const;
+
+  void gatewayLoop();
+  void gatewayServeWindow();
+  void gatewayReceive(const Transmission& tx);
+  bool gatewaySend(const Command& command, LoraPayload& pkt);
+  void commandPayload(const Command& command, LoraPayload& pkt);
+
+  void startTransmission(Transmission& tx, uint64_t commandChars);
+
+  // Time to send this many characters over the UART of the LoRa module
+  static uint64_t uartUs(uint64_t chars) { return chars * 10 * 1000000 / SIM_UART_BAUD; }
+  static uint8_t  reservedAirtimePercent(OutboxPriority priority);
+};
+
+/**
+ * @return The value below which this fraction of the samples fall (nearest rank), 0 without samples.
+ */
+uint32_t percentile(std::vector<uint32_t> samples, double fraction);
+
+#endif // SIMULATION_H
@@ -0,0 +1,125 @@
+#include "main.h"
+
+/*
+Capacity planning of the LoRa network: runs the simulation for each number of edges and prints one line per run.
+  --nodes <list>    Numbers of edges to simulate, comma-separated (default: 1,10,50,100)
+  --hours <h>       Simulated duration (default: 24)
+  --loss <percent>  Frames lost by the channel besides the collisions (default: 1)
+  --changes <n>     Alarm state changes per edge and per hour (default: 2)
+  --alarms <n>      Intrusions per edge and per day (default: 1)
+  --commands <n>    Commands of the host per edge and per hour (default: 0.5)
+  --sf <7..12>      Spreading factor (default: the one of LORA_RFCFG_CMD)
+  --class-a         The edges only listen in the window after their frames (LORA_CLASS_A)
+  --large-commands  The commands are full time range fragments, the largest downlinks
+  --seed <n>        Seed of the random draws, a run is reproducible (default: 1)
+*/
+
+static int usage(const char* program) {
+  fprintf(stderr, "Usage: %s [--nodes <n,n,...>] [--hours <h>] [--loss <percent>] [--changes <per hour>] [--alarms <per day>] [--commands <per hour>] [--sf <7..12>] [--class-a] [--large-commands] [--seed <n>]\n", program);
+  return 2;
+}
+
+/**
+ * Parse a comma-separated list of node counts.
+ * @return false if a count is not between 1 and LORA_V1_MAX_NODE_ID.
+ */
+static bool parseNodeCounts(const char* list, std::vector<size_t>& counts) {
+  counts.clear();
+  while (*list) {
+    char*         end;
+    unsigned long count = strtoul(list, &end, 10);
+    if (end == list || count < 1 || count > LORA_V1_MAX_NODE_ID || (*end != ',' && *end != '\0')) return false;
+    counts.push_back(count);
+    list = *end == ',' ? end + 1 : end;
+  }
+  return !counts.empty();
+}
+
+static double ratioPercent(size_t part, size_t total) {
+  return total ? 100.0 * part / total : 0;
+}
+
+static void printHeader() {
+  printf("%5s %9s %6s %6s %6s %6s %6s %6s | %7s %7s %7s | %6s %7s %7s %7s | %6s %6s %6s\n", "nodes", "uplinks", "PDR%", "coll%", "lost%", "rej%", "filt%", "evts%", "p50 ms", "p95 ms", "p99 ms",
+         "down%", "p50 ms", "p95 ms", "p99 ms", "s/h", "max", "load%");
+}
+
+/**
+ * One line per run: uplinks, their latency, downlinks and their latency, airtime per edge and load of the channel.
+ */
+static void printResults(size_t nodes, double hours, const SimResults& results) {
+  double   meanAirtimeS = 0;
+  uint64_t maxAirtimeUs = 0;
+  for (uint64_t airtimeUs : results.nodeAirtimeUs) {
+    meanAirtimeS += airtimeUs / 1e6 / results.nodeAirtimeUs.size();
+    if (airtimeUs > maxAirtimeUs) maxAirtimeUs = airtimeUs;
+  }
+
+  printf("%5zu %9zu %6.2f %6.2f %6.2f %6.2f %6.2f %6.2f | %7u %7u %7u | %6.2f %7u %7u %7u | %6.2f %6.2f %6.2f\n", nodes, results.uplinksSent,
+         ratioPercent(results.uplinksDelivered, results.uplinksSent), ratioPercent(results.uplinksCollided, results.uplinksSent), ratioPercent(results.uplinksLost, results.uplinksSent),
+         ratioPercent(results.uplinksRejected, results.uplinksSent), ratioPercent(results.uplinksFiltered, results.uplinksSent), ratioPercent(results.eventsDelivered, results.eventsRecorded),
+         percentile(results.uplinkLatencyMs, 0.50), percentile(results.uplinkLatencyMs, 0.95), percentile(results.uplinkLatencyMs, 0.99), ratioPercent(results.downlinksDelivered, results.downlinksRequested),
+         percentile(results.downlinkLatencyMs, 0.50), percentile(results.downlinkLatencyMs, 0.95), percentile(results.downlinkLatencyMs, 0.99), meanAirtimeS / hours, maxAirtimeUs / 1e6 / hours,
+         100.0 * results.channelBusyUs / results.durationUs);
+  if (results.uplinksDeferred > 0 || results.downlinksDropped > 0) {
+    printf("      %zu uplinks deferred by the duty cycle of the edges, %zu downlinks dropped by the duty cycle of the gateway\n", results.uplinksDeferred, results.downlinksDropped);
+  }
+  if (results.uplinksStale > 0) {
+    printf("      %zu v2 uplinks rejected after the loss of their epoch, %zu RENEW_EPOCH requested, %zu received\n", results.uplinksStale, results.epochsRequested, results.epochsRenewed);
+  }
+  if (results.downlinksMissed > 0 || results.downlinksOrphaned > 0 || results.downlinksRefused > 0) {
+    printf("      %zu downlinks received after the window of their edge, %zu after a lost downlink, %zu refused by the queue of held downlinks\n", results.downlinksMissed,
+           results.downlinksOrphaned, results.downlinksRefused);
+  }
+}
+
+int main(int argc, char** argv) {
+  std::vector<size_t> nodeCounts = {1, 10, 50, 100};
+  SimConfig           config     = {
+                    .nodes           = 0,
+                    .hours           = 24,
+                    .lossPercent     = 1,
+                    .changesPerHour  = 2,
+                    .alarmsPerDay    = 1,
+                    .commandsPerHour = 0.5,
+                    .spreadingFactor = LORA_RF_CONFIG.spreadingFactor,
+                    .classA          = false,
+                    .largeCommands   = false,
+                    .seed            = 1,
+  };
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 < argc && strcmp(argv[i], "--nodes") == 0 && parseNodeCounts(argv[i + 1], nodeCounts)) {
+      i++;
+    } else if (i + 1 < argc && strcmp(argv[i], "--hours") == 0 && atof(argv[i + 1]) > 0) {
+      config.hours = atof(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "--loss") == 0 && atof(argv[i + 1]) >= 0 && atof(argv[i + 1]) <= 100) {
+      config.lossPercent = atof(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "--changes") == 0 && atof(argv[i + 1]) >= 0) {
+      config.changesPerHour = atof(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "--alarms") == 0 && atof(argv[i + 1]) >= 0) {
+      config.alarmsPerDay = atof(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "--commands") == 0 && atof(argv[i + 1]) >= 0) {
+      config.commandsPerHour = atof(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "--sf") == 0 && atoi(argv[i + 1]) >= 7 && atoi(argv[i + 1]) <= 12) {
+      config.spreadingFactor = (uint8_t)atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--class-a") == 0) {
+      config.classA = true;
+    } else if (strcmp(argv[i], "--large-commands") == 0) {
+      config.largeCommands = true;
+    } else if (i + 1 < argc && strcmp(argv[i], "--seed") == 0) {
+      config.seed = strtoul(argv[++i], nullptr, 10);
+    } else {
+      return usage(argv[0]);
+    }
+  }
+
+  printf("SF%u, %.1f h, %.1f%% loss, %.2f changes/h, %.2f alarms/day, %.2f %scommands/h per edge, %s, seed %u\n", config.spreadingFactor, config.hours, config.lossPercent, config.changesPerHour,
+         config.alarmsPerDay, config.commandsPerHour, config.largeCommands ? "large " : "", config.classA ? "class A" : "always listening", config.seed);
+  printHeader();
+  for (size_t nodes : nodeCounts) {
+    config.nodes = nodes;
+    Simulation simulation(config);
+    printResults(nodes, config.hours, simulation.run());
+  }
+  return 0;
+}
@@ -0,0 +1,23 @@
+#include "sim_channel.h"
+
+void RadioChannel::begin(Transmission& tx) {
+  for (Transmission& other : onAir) {
+    if (other.endUs > tx.startUs) {
+      other.collided = true;
+      tx.collided    = true;
+    }
+  }
+  tx.lost = std::uniform_real_distribution<double>(0, 1)(random) < lossRatio;
+  onAir.push_back(tx);
+}
+
+Transmission RadioChannel::end(uint32_t id) {
+  for (size_t i = 0; i < onAir.size(); i++) {
+    if (onAir[i].id != id) continue;
+    Transmission tx = onAir[i];
+    onAir.erase(onAir.begin() + i);
+    totalAirtimeUs += tx.endUs - tx.startUs;
+    return tx;
+  }
+  return Transmission{};
+}
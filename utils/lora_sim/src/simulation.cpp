@@ -0,0 +1,524 @@
+#include "simulation.h"
+#include <algorithm>
+#include <lora_frame_decoder.h>
+#include <lora_frame_v2.h>
+#include <lora_hex.h>
+#include <lora_transfer.h>
+
+// AlarmState values of the edge (security_code.h)
+#define SIM_STATE_INACTIVE   0
+#define SIM_STATE_MONITORING 1
+#define SIM_STATE_TRIGGERED  2
+
+/**
+ * @return The RF configuration of the firmware with another spreading factor.
+ */
+static LoraRfConfig withSpreadingFactor(uint8_t spreadingFactor) {
+  LoraRfConfig rfConfig    = LORA_RF_CONFIG;
+  rfConfig.spreadingFactor = spreadingFactor;
+  return rfConfig;
+}
+
+Simulation::Simulation(const SimConfig& config)
+    : config(config), rfConfig(withSpreadingFactor(config.spreadingFactor)), channel(rfConfig, config.lossPercent / 100, config.seed ^ 0x5EED5EED), random(config.seed) {
+  gatewayNodes.resize(config.nodes + 1);
+  edges.resize(config.nodes);
+  for (size_t i = 0; i < config.nodes; i++) {
+    Edge& edge = edges[i];
+    edge.id    = (uint8_t)(i + 1);
+
+    // A key different for each node, known by both sides as after a pairing
+    uint8_t key[LORA_MAC_KEY_BYTES];
+    for (size_t b = 0; b < LORA_MAC_KEY_BYTES; b++) {
+      key[b] = (uint8_t)(edge.id * 31 + b * 7);
+    }
+    edge.key                  = loraMacKeyFromBytes(key);
+    gatewayNodes[edge.id].key = edge.key;
+    edge.bootUs               = std::uniform_int_distribution<uint64_t>(0, SIM_BOOT_SPREAD_US)(random);
+    edge.downlinkWindow       = ReceiveWindow(loraRxWindowMs(rfConfig));
+    edge.heartbeat.seed(((uint32_t)edge.id << 24) ^ (uint32_t)random());
+  }
+}
+
+SimResults Simulation::run() {
+  results.durationUs = (uint64_t)(config.hours * 3600e6);
+  results.nodeAirtimeUs.assign(config.nodes, 0);
+
+  for (size_t i = 0; i < edges.size(); i++) {
+    // The boot announces the first alarm state, like setup() of the edge
+    schedule(edges[i].bootUs, EventType::EDGE_ACTIVITY, (uint32_t)i);
+    if (config.commandsPerHour > 0) schedule(exponentialDelayUs(config.commandsPerHour), EventType::COMMAND, (uint32_t)i);
+  }
+
+  while (!events.empty()) {
+    Event event = events.top();
+    if (event.atUs > results.durationUs) break;
+    events.pop();
+    nowUs = event.atUs;
+
+    switch (event.type) {
+    case EventType::EDGE_WAKE: {
+      Edge& edge = edges[event.target];
+      if (event.generation != edge.wakeGeneration) break; // Rescheduled since
+      edge.wakeAtUs = UINT64_MAX;
+      edgeLoop(edge);
+      break;
+    }
+    case EventType::EDGE_ACTIVITY: edgeActivity(edges[event.target]); break;
+    case EventType::TX_START: {
+      auto it = scheduled.find(event.target);
+      channel.begin(it->second);
+      schedule(it->second.endUs, EventType::TX_END, event.target);
+      scheduled.erase(it);
+      break;
+    }
+    case EventType::TX_END: {
+      Transmission tx = channel.end(event.target);
+      if (tx.receiver == SIM_GATEWAY_ID) {
+        gatewayReceive(tx);
+      } else {
+        edgeReceive(edges[tx.receiver - 1], tx);
+      }
+      break;
+    }
+    case EventType::COMMAND:
+      results.downlinksRequested++;
+      commands.push_back({edges[event.target].id, nowUs});
+      schedule(nowUs + exponentialDelayUs(config.commandsPerHour), EventType::COMMAND, event.target);
+      gatewayLoop();
+      break;
+    case EventType::GATEWAY_WAKE: gatewayLoop(); break;
+    }
+  }
+
+  for (size_t i = 0; i < edges.size(); i++) {
+    results.nodeAirtimeUs[i] = edges[i].airtimeUs;
+  }
+  results.channelBusyUs = channel.busyUs();
+  return results;
+}
+
+void Simulation::schedule(uint64_t atUs, EventType type, uint32_t target, uint32_t generation) {
+  events.push({.atUs = atUs, .order = nextOrder++, .type = type, .target = target, .generation = generation});
+}
+
+/**
+ * @return The delay until the next occurrence of a Poisson process of this rate.
+ */
+uint64_t Simulation::exponentialDelayUs(double perHour) {
+  return (uint64_t)(std::exponential_distribution<double>(perHour / 3600e6)(random)) + 1;
+}
+
+/**
+ * @return The first iteration of the security logic of the edge at or after the given time.
+ */
+uint64_t Simulation::nextLogicTick(const Edge& edge, uint64_t atUs) const {
+  if (atUs <= edge.bootUs) return edge.bootUs;
+  uint64_t ticks = (atUs - edge.bootUs + SIM_LOGIC_TICK_US - 1) / SIM_LOGIC_TICK_US;
+  return edge.bootUs + ticks * SIM_LOGIC_TICK_US;
+}
+
+/**
+ * What the edge does at an iteration of its main loop: the periodic heartbeat of runSecurityLogic(), then loopLora().
+ */
+void Simulation::edgeLoop(Edge& edge) {
+  if (edge.heartbeat.isDue(nowMs())) edgeHeartbeat(edge);
+
+  // serveDownlinkWindow(): no uplink is sent while the window is open, the module then goes to sleep
+  bool listening = edge.downlinkWindow.isOpen() && !edge.downlinkWindow.isExpired(nowMs());
+  if (!listening) edge.downlinkWindow.close();
+
+  if (nowUs >= edge.idleAtUs && !listening) {
+    // Events wait in the ring while the outbox is full
+    if (edge.ring.isFlushDue(nowMs()) && edge.outbox.size() < LORA_OUTBOX_SIZE) {
+      LoraPayload pkt;
+      bool        alarm;
+      pkt.id = edge.id;
+      if (edge.ring.takeBatch(pkt, alarm)) {
+        size_t   count     = pkt.length / BODY_WIRE_SIZE<PayloadType::EVENT_BATCH>;
+        uint64_t createdUs = edge.ringUs.front();
+        edge.ringUs.erase(edge.ringUs.begin(), edge.ringUs.begin() + std::min(count, edge.ringUs.size()));
+        edgeQueue(edge, pkt, alarm ? OutboxPriority::ALARM : OutboxPriority::STATE_CHANGE, {.createdUs = createdUs, .events = (uint8_t)count});
+      }
+    }
+
+    OutboxPriority     priority;
+    const LoraPayload* next = edge.outbox.peek(priority);
+    if (next) {
+      size_t   size      = isEpochDue(edge) ? 0 : writeFrameV2(edge.key, *next, edge.txEpoch, nowMs(), nullptr);
+      uint32_t airtimeUs = channel.airtimeUs(size ? size : frameWireSize(*next));
+      if (edge.dutyCycle.tryConsume(airtimeUs, reservedAirtimePercent(priority), nowMs())) {
+        LoraPayload pkt;
+        edge.outbox.pop(pkt);
+        auto    it      = edge.pending.find(pkt.counter);
+        Pending pending = it != edge.pending.end() ? it->second : Pending{.createdUs = nowUs, .events = 0};
+        if (it != edge.pending.end()) edge.pending.erase(it);
+        edge.waitingBudget = false;
+        edgeTransmit(edge, pkt, airtimeUs, pending);
+      } else if (!edge.waitingBudget) {
+        edge.waitingBudget = true;
+        results.uplinksDeferred++;
+      }
+    }
+  }
+
+  edgeReschedule(edge);
+}
+
+/**
+ * The alarm state of the edge changes: it is armed or disarmed, or an intrusion triggers it. Happens on an iteration
+ * of the security logic.
+ */
+void Simulation::edgeActivity(Edge& edge) {
+  double alarmsPerHour = config.alarmsPerDay / 24;
+  double totalPerHour  = config.changesPerHour + alarmsPerHour;
+  bool   booting       = edge.heartbeatDueUs == 0;
+
+  uint8_t state;
+  if (!booting && std::uniform_real_distribution<double>(0, totalPerHour)(random) < alarmsPerHour) {
+    // loraSendMotionState(true) then setAlarmState(TRIGGERED), the batch is flushed at once
+    edgeRecord(edge, EventKind::MOTION, {1}, false);
+    state = SIM_STATE_TRIGGERED;
+  } else {
+    if (!booting) edge.armed = !edge.armed;
+    state = edge.armed ? SIM_STATE_MONITORING : SIM_STATE_INACTIVE;
+  }
+
+  // loraSendAlarmState(): the event carries the heartbeat of the new state
+  uint16_t      nextHeartbeat = edge.heartbeat.restart(nowMs());
+  HeartbeatBody heartbeat     = {.alarmState = state, .airtimeUsage = edge.dutyCycle.usagePercent(nowMs()), .nextHeartbeat = nextHeartbeat};
+  edge.heartbeatDueUs         = nowUs + (uint64_t)nextHeartbeat * 1000000;
+
+  uint8_t value[4];
+  writeFields(heartbeat, PayloadLayout<PayloadType::EDGE_HEARTBEAT>::FIELDS, value);
+  edgeRecord(edge, EventKind::STATE_TRANSITION, value, state == SIM_STATE_TRIGGERED);
+
+  if (totalPerHour > 0) {
+    schedule(nextLogicTick(edge, nowUs + exponentialDelayUs(totalPerHour)), EventType::EDGE_ACTIVITY, edge.id - 1);
+  }
+  edgeLoop(edge);
+}
+
+/**
+ * loraSendHeartbeat() of the edge: queue a heartbeat, the next one is sent after a longer interval.
+ */
+void Simulation::edgeHeartbeat(Edge& edge) {
+  uint16_t nextHeartbeat = edge.heartbeat.backOff(nowMs());
+  edge.heartbeatDueUs    = nowUs + (uint64_t)nextHeartbeat * 1000000;
+
+  LoraPayload pkt;
+  pkt.id = edge.id;
+  pkt.ts = unixTime();
+  encodePayload<PayloadType::EDGE_HEARTBEAT>({.alarmState = (uint8_t)(edge.armed ? SIM_STATE_MONITORING : SIM_STATE_INACTIVE), .airtimeUsage = edge.dutyCycle.usagePercent(nowMs()), .nextHeartbeat = nextHeartbeat}, pkt);
+  edgeQueue(edge, pkt, OutboxPriority::HEARTBEAT, {.createdUs = nowUs, .events = 0});
+}
+
+/**
+ * recordEvent() of the edge, the time of each event is kept for the latency of its batch.
+ */
+void Simulation::edgeRecord(Edge& edge, EventKind kind, const uint8_t (&value)[4], bool alarm) {
+  if (edge.ringUs.size() >= LORA_EVENT_RING_SIZE) edge.ringUs.pop_front(); // The oldest event is dropped
+  edge.ring.record(kind, value, alarm, unixTime(), nowMs());
+  edge.ringUs.push_back(nowUs);
+  results.eventsRecorded++;
+}
+
+/**
+ * queuePayload() of the edge. The payload carries a sequence number in its counter, set for real when it is sent, to
+ * find its creation time and its events again.
+ */
+void Simulation::edgeQueue(Edge& edge, LoraPayload& pkt, OutboxPriority priority, const Pending& pending) {
+  pkt.counter = ++edge.nextSequence;
+  if (edge.outbox.push(pkt, priority)) edge.pending[pkt.counter] = pending;
+}
+
+/**
+ * transmitPayload() of the edge: number, sign and send the payload, as a v2 frame unless the epoch is due.
+ */
+void Simulation::edgeTransmit(Edge& edge, LoraPayload& pkt, uint32_t airtimeUs, const Pending& pending) {
+  pkt.counter = ++edge.txCounter;
+
+  Transmission tx = {};
+  tx.id           = nextTxId++;
+  tx.sender       = edge.id;
+  tx.receiver     = SIM_GATEWAY_ID;
+  tx.createdUs    = pending.createdUs;
+  tx.events       = pending.events;
+  tx.size         = isEpochDue(edge) ? 0 : writeFrameV2(edge.key, pkt, edge.txEpoch, nowMs(), tx.frame);
+  if (tx.size) {
+    edge.framesSinceEpoch++;
+  } else {
+    pkt.hmac              = computeFrameMac(edge.key, LoraDirection::UPLINK, pkt);
+    edge.txEpoch          = {.ts = pkt.ts, .ms = nowMs(), .valid = true, .id = (uint8_t)pkt.counter, .renewing = false};
+    edge.framesSinceEpoch = 0;
+    tx.size               = writeFrame(pkt, tx.frame);
+  }
+
+  startTransmission(tx, SIM_TX_COMMAND_CHARS + 2 * tx.size);
+  edge.radio    = {.deafFromUs = tx.startUs, .deafUntilUs = tx.endUs + uartUs(SIM_RX_SWITCH_CHARS)};
+  edge.idleAtUs = edge.radio.deafUntilUs;
+  edge.airtimeUs += airtimeUs;
+  results.uplinksSent++;
+  if (config.classA) { // onLoraTransmitted(): the window opens once the module printed TX DONE
+    edge.windowOpenUs = tx.endUs + uartUs(SIM_TX_DONE_CHARS);
+    edge.downlinkWindow.open((uint32_t)(edge.windowOpenUs / 1000));
+  }
+}
+
+/**
+ * Wake the edge at the next iteration where it has something to do: a heartbeat, a flush of the ring, or a payload
+ * of the outbox once the radio is idle or the budget may have refilled.
+ */
+void Simulation::edgeReschedule(Edge& edge) {
+  uint64_t atUs    = nextLogicTick(edge, edge.heartbeatDueUs);
+  uint64_t readyUs = edge.idleAtUs; // The radio is idle and the window is over
+  if (edge.downlinkWindow.isOpen()) readyUs = std::max(readyUs, edge.windowOpenUs + (uint64_t)loraRxWindowMs(rfConfig) * 1000);
+
+  if (!edge.ringUs.empty()) {
+    uint64_t flushUs = edge.ring.isFlushDue(nowMs()) ? nowUs : edge.ringUs.front() + (uint64_t)LORA_EVENT_FLUSH_DELAY * 1000;
+    flushUs          = std::max(flushUs, readyUs);
+    if (flushUs <= nowUs) flushUs = nowUs + SIM_BUDGET_RETRY_US; // The outbox is full
+    atUs = std::min(atUs, flushUs);
+  }
+  if (edge.outbox.size() > 0) {
+    atUs = std::min(atUs, nowUs < readyUs ? readyUs : nowUs + SIM_BUDGET_RETRY_US);
+  }
+
+  if (atUs == edge.wakeAtUs) return;
+  edge.wakeAtUs = atUs;
+  schedule(atUs, EventType::EDGE_WAKE, edge.id - 1, ++edge.wakeGeneration);
+}
+
+/**
+ * A downlink ended: the edge decodes it like onLoraLine() if it heard it cleanly, and with classA if its module was
+ * still listening.
+ */
+void Simulation::edgeReceive(Edge& edge, const Transmission& tx) {
+  if (tx.collided || tx.lost || !edge.radio.canReceive(tx)) return;
+  if (config.classA && (!edge.downlinkWindow.isOpen() || edge.downlinkWindow.isExpired(nowMs()))) {
+    if (tx.chained) {
+      results.downlinksOrphaned++;
+    } else {
+      results.downlinksMissed++;
+    }
+    return;
+  }
+
+  char             hex[LORA_FRAME_MAX_BYTES * 2 + 1];
+  size_t           length = bytesToHex(tx.frame, tx.size, hex);
+  LoraFrameDecoder decoder;
+  if (decoder.decodeHex(hex, length) != LoraFrameDecoder::Result::FRAME) return;
+
+  const LoraPayload& pkt = decoder.payload();
+  if (pkt.id != edge.id || !edge.rxWindow.check(pkt.counter) || !verifyFrameMac(edge.key, LoraDirection::DOWNLINK, pkt)) return;
+  edge.rxWindow.accept(pkt.counter);
+  if (pkt.type == PayloadType::RENEW_EPOCH) { // processLoraPayload(): the heartbeat sent at once is a v1 frame
+    results.epochsRenewed++;
+    edge.txEpoch.valid = false;
+    edgeHeartbeat(edge);
+    edgeReschedule(edge);
+  } else {
+    results.downlinksDelivered++;
+    results.downlinkLatencyMs.push_back((uint32_t)((nowUs - tx.createdUs) / 1000));
+  }
+  if (config.classA) { // The window is renewed once the module printed the frame, the gateway may send another one
+    edge.windowOpenUs = nowUs + uartUs(SIM_RX_REPORT_CHARS + 2 * tx.size);
+    edge.downlinkWindow.open((uint32_t)(edge.windowOpenUs / 1000));
+  }
+}
+
+bool Simulation::isEpochDue(const Edge& edge) const {
+  return !edge.txEpoch.valid || edge.framesSinceEpoch >= LORA_V2_EPOCH_INTERVAL;
+}
+
+/**
+ * Send the oldest command of the host once the gateway radio is idle. A command over the duty-cycle budget of the
+ * gateway is dropped, as the gateway firmware does. With classA, the commands are held until the window of their edge.
+ */
+void Simulation::gatewayLoop() {
+  if (config.classA) {
+    gatewayServeWindow();
+    return;
+  }
+  while (!commands.empty() && nowUs >= gatewayIdleAtUs) {
+    Command command = commands.front();
+    commands.pop_front();
+
+    LoraPayload pkt;
+    commandPayload(command, pkt);
+    if (!gatewaySend(command, pkt)) results.downlinksDropped++;
+  }
+}
+
+/**
+ * holdDownlink() then serveDownlinkWindow() of the gateway: the commands are held, and the oldest one of the node whose
+ * window is due is sent. A command over the duty-cycle budget waits for the next window.
+ */
+void Simulation::gatewayServeWindow() {
+  for (const Command& command : commands) {
+    LoraPayload pkt;
+    commandPayload(command, pkt);
+    if (heldDownlinks.push(pkt)) {
+      heldCommands.push_back(command);
+    } else {
+      results.downlinksRefused++;
+    }
+  }
+  commands.clear();
+
+  const LoraPayload* held = heldDownlinks.peek(nowMs());
+  if (!held || nowUs < gatewayIdleAtUs) return; // A window missed while the radio is busy is skipped by the next peek()
+
+  auto command = std::find_if(heldCommands.begin(), heldCommands.end(), [&](const Command& c) { return c.node == held->id; });
+  LoraPayload pkt = *held;
+  if (!gatewaySend(*command, pkt)) {
+    heldDownlinks.skipWindow();
+    return;
+  }
+  heldCommands.erase(command);
+  gatewayNodes[pkt.id].renewed = true;
+
+  uint32_t txMs = loraTxMs(rfConfig, frameWireSize(pkt));
+  heldDownlinks.sent(nowMs(), txMs);
+  if (heldDownlinks.pending(pkt.id) > 0) schedule(((uint64_t)nowMs() + txMs + LORA_RX_DELAY_MS) * 1000, EventType::GATEWAY_WAKE, 0);
+}
+
+/**
+ * The payload of a command of the host, without its counter and MAC: SET_ALARM_STATE, or with largeCommands a full
+ * fragment of a time range transfer, the largest downlink.
+ */
+void Simulation::commandPayload(const Command& command, LoraPayload& pkt) {
+  pkt    = {};
+  pkt.id = command.node;
+  pkt.ts = unixTime();
+  if (command.renewEpoch) {
+    pkt.ts = 0; // No time, the edge keeps its RTC
+    encodePayload<PayloadType::RENEW_EPOCH>({}, pkt);
+    return;
+  }
+  if (!config.largeCommands) {
+    encodePayload<PayloadType::SET_ALARM_STATE>({.alarmState = SIM_STATE_MONITORING}, pkt);
+    return;
+  }
+  uint8_t rules = (uint8_t)TRANSFER_RULES_PER_FRAGMENT;
+  encodePayload<PayloadType::SET_TIME_RANGE_FRAGMENT>({.transferId = 1, .fragmentIndex = 0, .fragmentCount = 1, .ruleCount = rules, .ruleSetHash = 0}, pkt);
+  pkt.length += (uint8_t)(rules * TRANSFER_RULE_BYTES); // Rules left at 0, the edge only checks the MAC here
+}
+
+/**
+ * Number, sign and send a command once the gateway radio is idle.
+ * @return false if the command is over the duty-cycle budget of the gateway, it was not sent.
+ */
+bool Simulation::gatewaySend(const Command& command, LoraPayload& pkt) {
+  GatewayNode& node = gatewayNodes[command.node];
+  pkt.counter       = ++node.txCounter;
+  pkt.hmac          = computeFrameMac(node.key, LoraDirection::DOWNLINK, pkt);
+
+  Transmission tx = {};
+  tx.id           = nextTxId++;
+  tx.sender       = SIM_GATEWAY_ID;
+  tx.receiver     = command.node;
+  tx.createdUs    = command.requestedUs;
+  tx.chained      = config.classA && node.renewed;
+  tx.size         = writeFrame(pkt, tx.frame);
+
+  uint32_t airtimeUs = channel.airtimeUs(tx.size);
+  if (!gatewayDutyCycle.tryConsume(airtimeUs, 0, nowMs())) return false;
+
+  startTransmission(tx, SIM_TX_COMMAND_CHARS + 2 * tx.size);
+  gatewayRadio    = {.deafFromUs = tx.startUs, .deafUntilUs = tx.endUs + uartUs(SIM_RX_SWITCH_CHARS)};
+  gatewayIdleAtUs = gatewayRadio.deafUntilUs;
+  results.gatewayAirtimeUs += airtimeUs;
+  results.downlinksSent++;
+  schedule(gatewayIdleAtUs, EventType::GATEWAY_WAKE, 0);
+  return true;
+}
+
+/**
+ * An uplink ended: the gateway decodes it like hexToUplink(), then runs it through its ingress filter.
+ */
+void Simulation::gatewayReceive(const Transmission& tx) {
+  if (tx.collided) {
+    results.uplinksCollided++;
+    return;
+  }
+  if (tx.lost || !gatewayRadio.canReceive(tx)) {
+    results.uplinksLost++;
+    return;
+  }
+
+  char             hex[LORA_FRAME_MAX_BYTES * 2 + 1];
+  size_t           length = bytesToHex(tx.frame, tx.size, hex);
+  LoraFrameDecoder decoder;
+  LoraPayload      pkt;
+  GatewayNode&     node          = gatewayNodes[tx.sender];
+  bool             authenticated = false;
+  if (isFrameV2(tx.frame[0])) {
+    FrameV2Result result = decoder.decodeHex(hex, length) == LoraFrameDecoder::Result::FRAME_V2 ? decodeFrameV2(node.key, decoder.frameV2(), decoder.frameV2Size(), node.rxWindow, node.epoch, nowMs(), pkt)
+                                                                                                   : FrameV2Result::MALFORMED;
+    authenticated        = result == FrameV2Result::OK;
+    if (result == FrameV2Result::STALE_EPOCH) {
+      results.uplinksStale++;
+      if (!node.epoch.renewing) { // requestEpochRenewal()
+        node.epoch.renewing = true;
+        results.epochsRequested++;
+        commands.push_back({tx.sender, nowUs, true});
+        schedule(nowUs, EventType::GATEWAY_WAKE, 0);
+      }
+    }
+  } else if (decoder.decodeHex(hex, length) == LoraFrameDecoder::Result::FRAME) {
+    pkt           = decoder.payload();
+    authenticated = isPayloadLengthValid(pkt.type, pkt.length) && isUplinkType(pkt.type) && node.rxWindow.check(pkt.counter) && verifyFrameMac(node.key, LoraDirection::UPLINK, pkt);
+    if (authenticated) node.epoch = {.ts = pkt.ts, .ms = nowMs(), .valid = true, .id = (uint8_t)pkt.counter, .renewing = false};
+  }
+  if (!authenticated) {
+    results.uplinksRejected++;
+    return;
+  }
+  node.rxWindow.accept(pkt.counter);
+  if (config.classA) { // The window counts from the end of the uplink, the gateway firmware takes out the time of its lines
+    uint32_t endMs = (uint32_t)(tx.endUs / 1000);
+    heldDownlinks.onUplink(tx.sender, endMs);
+    node.renewed = false;
+    if (heldDownlinks.pending(tx.sender) > 0) schedule(((uint64_t)endMs + LORA_RX_DELAY_MS) * 1000, EventType::GATEWAY_WAKE, 0);
+  }
+
+  if (ingress.check(pkt, nowMs()) != IngressFilter::Verdict::FORWARD) {
+    results.uplinksFiltered++;
+    return;
+  }
+  results.uplinksDelivered++;
+  results.eventsDelivered += tx.events;
+  results.uplinkLatencyMs.push_back((uint32_t)((nowUs - tx.createdUs) / 1000));
+}
+
+/**
+ * The frame is sent to the module over its UART with the AT command, then goes on the air.
+ */
+void Simulation::startTransmission(Transmission& tx, uint64_t commandChars) {
+  tx.startUs       = nowUs + uartUs(commandChars);
+  tx.endUs         = tx.startUs + channel.airtimeUs(tx.size);
+  scheduled[tx.id] = tx;
+  schedule(tx.startUs, EventType::TX_START, tx.id);
+}
+
+/**
+ * reservedAirtimePercent() of the edge.
+ */
+uint8_t Simulation::reservedAirtimePercent(OutboxPriority priority) {
+  switch (priority) {
+  case OutboxPriority::ALARM:        return 0;
+  case OutboxPriority::STATE_CHANGE: return 10;
+  case OutboxPriority::HEARTBEAT:    return 25;
+  case OutboxPriority::TELEMETRY:
+  default:                           return 50;
+  }
+}
+
+uint32_t percentile(std::vector<uint32_t> samples, double fraction) {
+  if (samples.empty()) return 0;
+  size_t rank = (size_t)(fraction * samples.size());
+  if (rank >= samples.size()) rank = samples.size() - 1;
+  std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+  return samples[rank];
+}